@@ -0,0 +1,150 @@
+/****************************************************************************
+  Benchmark of the evaluation of candidate communities for high degree nodes.
+
+  A planted partition graph is generated, to which a number of hubs are added
+  that are connected to a large number of random nodes. The partition is
+  first optimised, so that the hubs have many different neighbouring
+  communities, after which, for each hub, all its neighbouring communities
+  are evaluated both by calling diff_move for every community and by a single
+  call to diff_move_all. The average time per hub for both approaches is
+  reported as CSV on the standard output, for ModularityVertexPartition and
+  RBConfigurationVertexPartition.
+
+  Usage: leiden_bench_degree [n [k [hubs [hub_degree [repetitions]]]]]
+    n           -- Number of nodes (default 20000).
+    k           -- Number of planted communities (default 200).
+    hubs        -- Number of hubs (default 10).
+    hub_degree  -- Degree of each hub (default 20000).
+    repetitions -- Number of times all hubs are evaluated (default 10).
+****************************************************************************/
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include "Optimiser.h"
+#include "ModularityVertexPartition.h"
+#include "RBConfigurationVertexPartition.h"
+
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+/****************************************************************************
+  Generate an undirected planted partition graph with average degree 10 and
+  10% of the edges between communities, where node v belongs to planted
+  community v % k. The first nb_hubs nodes are additionally connected to
+  hub_degree random nodes each.
+****************************************************************************/
+void hub_graph(igraph_t* graph, Id n, Id k, Id nb_hubs, Id hub_degree, Id seed)
+{
+  std::mt19937_64 gen(seed);
+  std::uniform_int_distribution<Id> node(0, n - 1);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  Id m = 5*n;
+  Id block_size = n/k;
+
+  igraph_vector_t edges;
+  igraph_vector_init(&edges, 2*(m + nb_hubs*hub_degree));
+  for (Id e = 0; e < m; e++)
+  {
+    Id u = node(gen), v = u;
+    while (v == u)
+    {
+      v = node(gen);
+      if (uniform(gen) >= 0.1)
+        v = (v % block_size)*k + u % k;  // Same community as u
+    }
+    VECTOR(edges)[2*e] = u;
+    VECTOR(edges)[2*e + 1] = v;
+  }
+  for (Id h = 0; h < nb_hubs; h++)
+  {
+    for (Id i = 0; i < hub_degree; i++)
+    {
+      Id e = m + h*hub_degree + i;
+      Id v = h;
+      while (v == h)
+        v = node(gen);
+      VECTOR(edges)[2*e] = h;
+      VECTOR(edges)[2*e + 1] = v;
+    }
+  }
+  igraph_create(graph, &edges, n, false);
+  igraph_vector_destroy(&edges);
+}
+
+template <class Partition> void bench_hubs(const char* name, igraph_t* g, Id nb_hubs, Id repetitions)
+{
+  // The partition takes ownership of the graph
+  Graph* graph = new Graph(g);
+  Partition partition(graph);
+  Optimiser optimiser;
+  optimiser.set_rng_seed(0);
+  optimiser.optimise_partition(&partition);
+
+  vector< vector<Id> > comms(nb_hubs);
+  Id nb_comms = 0;
+  for (Id h = 0; h < nb_hubs; h++)
+  {
+    comms[h] = partition.get_neigh_comms(h, IGRAPH_ALL);
+    sort(comms[h].begin(), comms[h].end());
+    comms[h].erase(unique(comms[h].begin(), comms[h].end()), comms[h].end());
+    nb_comms += comms[h].size();
+  }
+
+  // The hubs are evaluated in turn, so that the weights to the neighbouring
+  // communities of a hub are never cached from its previous evaluation.
+  vector<Weight> gains;
+  Weight checksum_single = 0.0, checksum_all = 0.0;
+  auto start = steady_clock::now();
+  for (Id r = 0; r < repetitions; r++)
+    for (Id h = 0; h < nb_hubs; h++)
+      for (Id comm : comms[h])
+        checksum_single += partition.diff_move(h, comm);
+  duration<double> elapsed_single = steady_clock::now() - start;
+
+  start = steady_clock::now();
+  for (Id r = 0; r < repetitions; r++)
+  {
+    for (Id h = 0; h < nb_hubs; h++)
+    {
+      partition.diff_move_all(h, comms[h], gains);
+      for (Weight gain : gains)
+        checksum_all += gain;
+    }
+  }
+  duration<double> elapsed_all = steady_clock::now() - start;
+
+  // Both approaches should give the same result
+  if (checksum_single != checksum_all)
+    cerr << "Results of diff_move and diff_move_all differ for " << name << "." << endl;
+
+  Id nb_evaluations = repetitions*nb_hubs;
+  std::cout << name << ",diff_move," << graph->vcount() << "," << graph->ecount() << ","
+            << nb_comms/nb_hubs << "," << 1e6*elapsed_single.count()/nb_evaluations << endl;
+  std::cout << name << ",diff_move_all," << graph->vcount() << "," << graph->ecount() << ","
+            << nb_comms/nb_hubs << "," << 1e6*elapsed_all.count()/nb_evaluations << endl;
+}
+
+int main(int argc, char** argv)
+{
+  Id n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 20000;
+  Id k = argc > 2 ? strtoull(argv[2], nullptr, 10) : 200;
+  Id nb_hubs = argc > 3 ? strtoull(argv[3], nullptr, 10) : 10;
+  Id hub_degree = argc > 4 ? strtoull(argv[4], nullptr, 10) : 20000;
+  Id repetitions = argc > 5 ? strtoull(argv[5], nullptr, 10) : 10;
+
+  if (k < 1 || n < 2*k || nb_hubs < 1 || nb_hubs >= n)
+  {
+    cerr << "There should be at least one hub and two nodes per planted community." << endl;
+    return EXIT_FAILURE;
+  }
+
+  igraph_t g;
+  hub_graph(&g, n, k, nb_hubs, hub_degree, 0);
+
+  std::cout << "partition,method,nodes,edges,communities_per_hub,microseconds_per_hub" << endl;
+  bench_hubs<ModularityVertexPartition>("modularity", &g, nb_hubs, repetitions);
+  bench_hubs<RBConfigurationVertexPartition>("rbconfiguration", &g, nb_hubs, repetitions);
+
+  igraph_destroy(&g);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,108 @@
+/****************************************************************************
+  Benchmark of the node orders of Optimiser::move_nodes.
+
+  A planted partition graph is generated, after which the partition is
+  optimised repeatedly until there is no further improvement, for each node
+  order. The number of iterations until convergence, the wall time and the
+  resulting quality are reported as CSV on the standard output.
+
+  Usage: leiden_bench_order [n [k [degree [mu [repetitions]]]]]
+    n           -- Number of nodes (default 100000).
+    k           -- Number of planted communities (default 100).
+    degree      -- Average degree (default 10).
+    mu          -- Fraction of edges between communities (default 0.3).
+    repetitions -- Number of runs (seeds) per node order (default 5).
+****************************************************************************/
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include "Optimiser.h"
+#include "ModularityVertexPartition.h"
+
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+/****************************************************************************
+  Generate an undirected planted partition graph without self-loops, where
+  node v belongs to planted community v % k.
+****************************************************************************/
+void planted_partition(igraph_t* graph, Id n, Id k, double degree, double mu, Id seed)
+{
+  std::mt19937_64 gen(seed);
+  std::uniform_int_distribution<Id> node(0, n - 1);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  Id m = (Id)(n*degree/2);
+  Id block_size = n/k;
+
+  igraph_vector_t edges;
+  igraph_vector_init(&edges, 2*m);
+  for (Id e = 0; e < m; e++)
+  {
+    Id u = node(gen), v = u;
+    while (v == u)
+    {
+      v = node(gen);
+      if (uniform(gen) >= mu)
+        v = (v % block_size)*k + u % k;  // Same community as u
+    }
+    VECTOR(edges)[2*e] = u;
+    VECTOR(edges)[2*e + 1] = v;
+  }
+  igraph_create(graph, &edges, n, false);
+  igraph_vector_destroy(&edges);
+}
+
+int main(int argc, char** argv)
+{
+  Id n = argc > 1 ? strtoull(argv[1], nullptr, 10) : 100000;
+  Id k = argc > 2 ? strtoull(argv[2], nullptr, 10) : 100;
+  double degree = argc > 3 ? atof(argv[3]) : 10;
+  double mu = argc > 4 ? atof(argv[4]) : 0.3;
+  Id repetitions = argc > 5 ? strtoull(argv[5], nullptr, 10) : 5;
+  const Id max_iterations = 100;
+
+  if (k < 1 || n < 2*k)
+  {
+    cerr << "There should be at least two nodes per planted community." << endl;
+    return EXIT_FAILURE;
+  }
+
+  igraph_t g;
+  planted_partition(&g, n, k, degree, mu, 0);
+
+  const int orders[] = {Optimiser::RAND_ORDER, Optimiser::DEGREE_ORDER,
+                        Optimiser::CHANGE_ORDER, Optimiser::IMPROV_ORDER};
+  const char* order_names[] = {"random", "degree", "change", "improv"};
+
+  std::cout << "order,repetition,nodes,edges,iterations,seconds,quality,communities" << endl;
+  for (Id o = 0; o < sizeof(orders)/sizeof(orders[0]); o++)
+  {
+    for (Id r = 0; r < repetitions; r++)
+    {
+      Optimiser optimiser;
+      optimiser.set_rng_seed(r);
+      optimiser.node_order = orders[o];
+      // The partition takes ownership of the graph
+      Graph* graph = new Graph(&g);
+      ModularityVertexPartition partition(graph);
+
+      auto start = steady_clock::now();
+      Id iterations = 0;
+      Weight improv;
+      do
+      {
+        improv = optimiser.optimise_partition(&partition);
+        iterations++;
+      } while (improv > 0 && iterations < max_iterations);
+      duration<double> elapsed = steady_clock::now() - start;
+
+      std::cout << order_names[o] << "," << r << ","
+                << graph->vcount() << "," << graph->ecount() << ","
+                << iterations << "," << elapsed.count() << ","
+                << partition.quality() << "," << partition.n_communities() << endl;
+    }
+  }
+
+  igraph_destroy(&g);
+  return EXIT_SUCCESS;
+}
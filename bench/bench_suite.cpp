@@ -0,0 +1,301 @@
+/****************************************************************************
+  Benchmark suite of the main steps of the Leiden algorithm.
+
+  For each synthetic graph generator and each scale, and for each quality
+  function, the following steps are timed:
+    graph           -- Construction of a Graph from an igraph graph.
+    init_admin      -- Initialisation of the administration of a partition
+                       (through set_membership) with all nodes in their own
+                       community.
+    move_nodes      -- Optimiser::move_nodes, starting from singletons.
+    merge_nodes     -- Optimiser::merge_nodes, starting from singletons.
+    refine          -- Constrained refinement of singletons within the
+                       partition found by move_nodes, using the refinement
+                       routine of the optimiser (merge_nodes_constrained by
+                       default).
+    collapse_graph  -- Collapsing the graph according to the refined
+                       partition.
+    optimise        -- Optimiser::optimise_partition, starting from
+                       singletons.
+
+  The graphs are undirected and have an average degree of 10. The generators
+  are
+    er              -- Erdos-Renyi graph.
+    sbm             -- Planted partition graph with communities of 100 nodes
+                       and 30% of the edges between communities.
+    lfr             -- LFR-like graph, with power-law degrees (exponent 2.5),
+                       power-law community sizes (exponent 1.5, between 20
+                       and 1000 nodes) and 30% of the edges between
+                       communities.
+    powerlaw        -- Chung-Lu graph with power-law degrees (exponent 2.5).
+
+  The results are reported as CSV on the standard output, one line per step,
+  so that they can be tracked over time.
+
+  Usage: leiden_bench_suite [min_edges [max_edges [repetitions]]]
+    min_edges   -- Number of edges of the smallest graph (default 10000).
+    max_edges   -- Maximum number of edges (default 10000000). The number of
+                   edges is increased ten-fold for each scale.
+    repetitions -- Number of runs (seeds) per graph and quality function
+                   (default 1).
+****************************************************************************/
+#include <chrono>
+#include <random>
+#include <cstdlib>
+#include <cmath>
+#include "Optimiser.h"
+#include "ModularityVertexPartition.h"
+#include "CPMVertexPartition.h"
+#include "RBConfigurationVertexPartition.h"
+#include "RBERVertexPartition.h"
+#include "SignificanceVertexPartition.h"
+#include "SurpriseVertexPartition.h"
+
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+/****************************************************************************
+  Create an undirected graph with n nodes from a list of edges, given as
+  consecutive pairs of nodes.
+****************************************************************************/
+void create_graph(igraph_t* graph, vector<Id> const& edge_list, Id n)
+{
+  igraph_vector_t edges;
+  igraph_vector_init(&edges, edge_list.size());
+  for (Id i = 0; i < edge_list.size(); i++)
+    VECTOR(edges)[i] = edge_list[i];
+  igraph_create(graph, &edges, n, false);
+  igraph_vector_destroy(&edges);
+}
+
+void erdos_renyi(igraph_t* graph, Id n, Id m, Id seed)
+{
+  std::mt19937_64 gen(seed);
+  std::uniform_int_distribution<Id> node(0, n - 1);
+  vector<Id> edges(2*m);
+  for (Id e = 0; e < m; e++)
+  {
+    Id u = node(gen), v = u;
+    while (v == u)
+      v = node(gen);
+    edges[2*e] = u;
+    edges[2*e + 1] = v;
+  }
+  create_graph(graph, edges, n);
+}
+
+void planted_partition(igraph_t* graph, Id n, Id m, Id seed)
+{
+  std::mt19937_64 gen(seed);
+  std::uniform_int_distribution<Id> node(0, n - 1);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  Id k = n/100 > 1 ? n/100 : 1;
+  Id block_size = n/k;
+  vector<Id> edges(2*m);
+  for (Id e = 0; e < m; e++)
+  {
+    Id u = node(gen), v = u;
+    while (v == u)
+    {
+      v = node(gen);
+      if (uniform(gen) >= 0.3)
+        v = (v % block_size)*k + u % k;  // Same community as u
+    }
+    edges[2*e] = u;
+    edges[2*e + 1] = v;
+  }
+  create_graph(graph, edges, n);
+}
+
+/****************************************************************************
+  Generate power-law distributed weights with the given exponent, with a
+  minimum of 1 and a maximum of max_weight.
+****************************************************************************/
+vector<double> power_law_weights(Id n, double exponent, double max_weight, std::mt19937_64& gen)
+{
+  std::uniform_real_distribution<double> uniform(0, 1);
+  vector<double> weights(n);
+  for (Id i = 0; i < n; i++)
+    weights[i] = std::min(pow(1.0 - uniform(gen), -1.0/(exponent - 1.0)), max_weight);
+  return weights;
+}
+
+void lfr_like(igraph_t* graph, Id n, Id m, Id seed)
+{
+  std::mt19937_64 gen(seed);
+  std::uniform_real_distribution<double> uniform(0, 1);
+  vector<double> degrees = power_law_weights(n, 2.5, sqrt(n), gen);
+
+  // Communities of consecutive nodes with power-law distributed sizes
+  vector<Id> community(n);
+  vector< vector<Id> > community_nodes;
+  vector< std::discrete_distribution<Id> > community_node;
+  for (Id v = 0; v < n; )
+  {
+    Id size = std::min((Id)(20*pow(1.0 - uniform(gen), -1.0/0.5)), (Id)1000);
+    size = std::min(size, n - v);
+    vector<Id> nodes(size);
+    vector<double> nodes_degrees(size);
+    for (Id i = 0; i < size; i++, v++)
+    {
+      community[v] = community_nodes.size();
+      nodes[i] = v;
+      nodes_degrees[i] = degrees[v];
+    }
+    community_nodes.push_back(nodes);
+    community_node.push_back(std::discrete_distribution<Id>(nodes_degrees.begin(), nodes_degrees.end()));
+  }
+
+  std::discrete_distribution<Id> node(degrees.begin(), degrees.end());
+  vector<Id> edges(2*m);
+  for (Id e = 0; e < m; e++)
+  {
+    Id u = node(gen), v = u;
+    while (v == u)
+    {
+      if (uniform(gen) < 0.3 || community_nodes[community[u]].size() == 1)
+        v = node(gen);
+      else
+        v = community_nodes[community[u]][community_node[community[u]](gen)];
+    }
+    edges[2*e] = u;
+    edges[2*e + 1] = v;
+  }
+  create_graph(graph, edges, n);
+}
+
+void power_law(igraph_t* graph, Id n, Id m, Id seed)
+{
+  std::mt19937_64 gen(seed);
+  vector<double> degrees = power_law_weights(n, 2.5, sqrt(n), gen);
+  std::discrete_distribution<Id> node(degrees.begin(), degrees.end());
+  vector<Id> edges(2*m);
+  for (Id e = 0; e < m; e++)
+  {
+    Id u = node(gen), v = u;
+    while (v == u)
+      v = node(gen);
+    edges[2*e] = u;
+    edges[2*e + 1] = v;
+  }
+  create_graph(graph, edges, n);
+}
+
+/****************************************************************************
+  Create a partition with all nodes in their own community. For CPM the
+  resolution parameter is set to the density of the graph, so that the
+  partitions are comparable to those of the other quality functions.
+****************************************************************************/
+template <class Partition> Partition* new_partition(Graph* graph)
+{
+  return new Partition(graph);
+}
+
+template <> CPMVertexPartition* new_partition<CPMVertexPartition>(Graph* graph)
+{
+  return new CPMVertexPartition(graph, graph->density());
+}
+
+void report(const char* generator, const char* quality, Graph* graph, const char* step, Id repetition,
+            duration<double> elapsed, MutableVertexPartition* partition)
+{
+  std::cout << generator << "," << quality << "," << graph->vcount() << "," << graph->ecount() << ","
+            << step << "," << repetition << "," << elapsed.count() << ","
+            << partition->quality() << "," << partition->n_communities() << endl;
+}
+
+template <class Partition> void bench_steps(const char* generator, const char* quality, igraph_t* g, Id repetition)
+{
+  Optimiser optimiser;
+  optimiser.set_rng_seed(repetition);
+
+  auto start = steady_clock::now();
+  Graph* graph = new Graph(g);
+  duration<double> elapsed = steady_clock::now() - start;
+
+  // This partition takes ownership of the graph, so it should be deleted last
+  Partition* partition = new_partition<Partition>(graph);
+  report(generator, quality, graph, "graph", repetition, elapsed, partition);
+
+  vector<Id> singletons = range(graph->vcount());
+  start = steady_clock::now();
+  partition->set_membership(singletons);
+  elapsed = steady_clock::now() - start;
+  report(generator, quality, graph, "init_admin", repetition, elapsed, partition);
+
+  start = steady_clock::now();
+  optimiser.move_nodes(partition);
+  elapsed = steady_clock::now() - start;
+  report(generator, quality, graph, "move_nodes", repetition, elapsed, partition);
+
+  Partition* merge_partition = partition->create(graph);
+  start = steady_clock::now();
+  optimiser.merge_nodes(merge_partition);
+  elapsed = steady_clock::now() - start;
+  report(generator, quality, graph, "merge_nodes", repetition, elapsed, merge_partition);
+  delete merge_partition;
+
+  Partition* refined_partition = partition->create(graph);
+  start = steady_clock::now();
+  if (optimiser.refine_routine == Optimiser::MOVE_NODES)
+    optimiser.move_nodes_constrained(refined_partition, optimiser.refine_consider_comms, partition);
+  else
+    optimiser.merge_nodes_constrained(refined_partition, optimiser.refine_consider_comms, partition);
+  elapsed = steady_clock::now() - start;
+  report(generator, quality, graph, "refine", repetition, elapsed, refined_partition);
+
+  start = steady_clock::now();
+  Graph* collapsed_graph = graph->collapse_graph(refined_partition);
+  elapsed = steady_clock::now() - start;
+  report(generator, quality, graph, "collapse_graph", repetition, elapsed, refined_partition);
+  delete collapsed_graph;
+  delete refined_partition;
+
+  Partition* optimised_partition = partition->create(graph);
+  start = steady_clock::now();
+  optimiser.optimise_partition(optimised_partition);
+  elapsed = steady_clock::now() - start;
+  report(generator, quality, graph, "optimise", repetition, elapsed, optimised_partition);
+  delete optimised_partition;
+
+  delete partition;
+}
+
+int main(int argc, char** argv)
+{
+  Id min_edges = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000;
+  Id max_edges = argc > 2 ? strtoull(argv[2], nullptr, 10) : 10000000;
+  Id repetitions = argc > 3 ? strtoull(argv[3], nullptr, 10) : 1;
+
+  if (min_edges < 10)
+  {
+    cerr << "There should be at least 10 edges." << endl;
+    return EXIT_FAILURE;
+  }
+
+  typedef void (*Generator)(igraph_t*, Id, Id, Id);
+  const Generator generators[] = {erdos_renyi, planted_partition, lfr_like, power_law};
+  const char* generator_names[] = {"er", "sbm", "lfr", "powerlaw"};
+
+  std::cout << "generator,quality,nodes,edges,step,repetition,seconds,quality_value,communities" << endl;
+  for (Id m = min_edges; m <= max_edges; m *= 10)
+  {
+    Id n = m/5;
+    for (Id i = 0; i < sizeof(generators)/sizeof(generators[0]); i++)
+    {
+      igraph_t g;
+      generators[i](&g, n, m, 0);
+      for (Id r = 0; r < repetitions; r++)
+      {
+        bench_steps<ModularityVertexPartition>(generator_names[i], "modularity", &g, r);
+        bench_steps<CPMVertexPartition>(generator_names[i], "cpm", &g, r);
+        bench_steps<RBConfigurationVertexPartition>(generator_names[i], "rbconfiguration", &g, r);
+        bench_steps<RBERVertexPartition>(generator_names[i], "rber", &g, r);
+        bench_steps<SignificanceVertexPartition>(generator_names[i], "significance", &g, r);
+        bench_steps<SurpriseVertexPartition>(generator_names[i], "surprise", &g, r);
+      }
+      igraph_destroy(&g);
+    }
+  }
+  return EXIT_SUCCESS;
+}
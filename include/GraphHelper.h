@@ -7,6 +7,11 @@
 #include <exception>
 #include <queue>
 #include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <memory>
+#include <mutex>
 
 //#ifdef DEBUG
 #include <iostream>
@@ -35,6 +40,14 @@ static_assert(sizeof(Weight) == sizeof(igraph_real_t), "Weight should be compati
 
 class MutableVertexPartition;
 
+//! \brief Mutex serialising all calls to igraph that may allocate memory
+//!
+//! Unless igraph is built with thread-local storage (which setup.py disables),
+//! it keeps the memory to free on an error in global variables, so that graphs
+//! can only be used by several threads (each by one thread at a time) if such
+//! calls are never made concurrently.
+std::mutex& igraph_mutex();
+
 vector<Id> range(Id n);
 queue<Id> queue_range(Id n);
 
@@ -43,6 +56,66 @@ bool orderCSize(const Id* A, const Id* B);
 Weight KL(Weight q, Weight p);
 Weight KLL(Weight q, Weight p);
 
+/****************************************************************************
+  Fast approximation of the natural logarithm of x > 0, with an absolute
+  error below 1e-10.
+
+  Writing x = m 2^e with m in [1, 2), the first bits of m select a centre c
+  from a lookup table with log(c) and 1/c, so that
+  log(x) = e log(2) + log(c) + log(1 + r) with r = m/c - 1 and |r| < 1/256,
+  where log(1 + r) is approximated by its series up to r^3. Subnormal
+  numbers, zero, infinity and NaN fall back on log.
+****************************************************************************/
+struct FastLogTable
+{
+  static const int BITS = 7;
+  static const int SIZE = 1 << BITS;
+  double log_c[SIZE];
+  double inv_c[SIZE];
+  FastLogTable();
+};
+extern const FastLogTable fast_log_table;
+// Natural logarithm of 2 (M_LN2 is not part of standard C++)
+static const double LN2 = 0.693147180559945309417232121458;
+
+inline double fast_log(double x)
+{
+  uint64_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+  int64_t e = (int64_t)((bits >> 52) & 0x7ff);
+  if (e == 0 || e == 0x7ff)
+    return log(x);
+  e -= 1023;
+  size_t idx = (bits >> (52 - FastLogTable::BITS)) & (FastLogTable::SIZE - 1);
+  // Set the exponent to zero, so that m is in [1, 2)
+  bits = (bits & 0x000fffffffffffffULL) | 0x3ff0000000000000ULL;
+  double m;
+  memcpy(&m, &bits, sizeof(m));
+  double r = m*fast_log_table.inv_c[idx] - 1.0;
+  return e*LN2 + fast_log_table.log_c[idx] + r*(1.0 - r*(0.5 - r*(1.0/3.0)));
+}
+
+/****************************************************************************
+  Approximation of KLL using fast_log, with an absolute error below 2e-10,
+  given log(p) and log(1 - p), which are often the same for many calls.
+****************************************************************************/
+inline Weight KLL_fast(Weight q, Weight p, Weight log_p, Weight log_1_p)
+{
+  Weight KL = 0.0;
+  if (q > 0.0 && p > 0.0)
+    KL += q*(fast_log(q) - log_p);
+  if (q < 1.0 && p < 1.0)
+    KL += (1.0-q)*(fast_log(1.0-q) - log_1_p);
+  if (q < p)
+    KL *= -1;
+  return KL;
+}
+
+inline Weight KLL_fast(Weight q, Weight p)
+{
+  return KLL_fast(q, p, fast_log(p), fast_log(1.0-p));
+}
+
 template <class T> T sum(vector<T> vec)
 {
   T sum_of_elems = T();
@@ -61,12 +134,212 @@ struct LeidenException: std::runtime_error
     virtual ~LeidenException()=default;
 };
 
-inline Id get_random_int(Id from, Id to, igraph_rng_t* rng) noexcept
+/****************************************************************************
+  Counter-based random number generator.
+
+  The n-th random number of a generator is a hash (the finaliser of
+  splitmix64) of its counter n and its key, so that generating a number is a
+  few inlined multiplications rather than an indirect call through igraph's
+  RNG interface, and copying or skipping ahead is trivial.
+
+  Independent streams for parallel (sub)problems are obtained through
+  stream(i), which derives a new key from the key of the generator and i,
+  and starts at counter 0. The numbers of stream(i) therefore only depend on
+  the seed and i, and not on the order in which the streams are created or
+  used, so that parallel computations are reproducible.
+****************************************************************************/
+class RNG
+{
+  public:
+    RNG() noexcept : _key(mix(0)), _counter(0) {};
+    RNG(uint64_t seed) noexcept : _key(mix(seed)), _counter(0) {};
+
+    inline void seed(uint64_t seed) noexcept
+    {
+      this->_key = mix(seed);
+      this->_counter = 0;
+    };
+
+    // Independent generator for stream i, derived from this generator's key
+    inline RNG stream(uint64_t i) const noexcept
+    {
+      RNG rng;
+      rng._key = mix(this->_key ^ mix(i + STREAM_INCREMENT));
+      return rng;
+    };
+
+    inline uint64_t next() noexcept
+    {
+      return mix(this->_key + (++this->_counter)*GOLDEN_GAMMA);
+    };
+
+    // Uniform random integer in [from, to], without modulo bias
+    inline uint64_t get_int(uint64_t from, uint64_t to) noexcept
+    {
+      uint64_t range = to - from + 1;
+      if (range == 0) // The full range of 64 bits
+        return this->next();
+      // Reject the lowest (2^64 mod range) numbers, so that the remaining
+      // numbers are a multiple of range.
+      uint64_t threshold = (0 - range) % range;
+      uint64_t r = this->next();
+      while (r < threshold)
+        r = this->next();
+      return from + r % range;
+    };
+
+  private:
+    static const uint64_t GOLDEN_GAMMA = 0x9E3779B97F4A7C15ULL;
+    static const uint64_t STREAM_INCREMENT = 0xD1B54A32D192ED03ULL;
+
+    static inline uint64_t mix(uint64_t z) noexcept
+    {
+      z = (z ^ (z >> 30))*0xBF58476D1CE4E5B9ULL;
+      z = (z ^ (z >> 27))*0x94D049BB133111EBULL;
+      return z ^ (z >> 31);
+    };
+
+    uint64_t _key;
+    uint64_t _counter;
+};
+
+inline Id get_random_int(Id from, Id to, RNG* rng) noexcept
+{
+  return rng->get_int(from, to);
+};
+
+void shuffle(vector<Id>& v, RNG* rng);
+
+/****************************************************************************
+  Queue of vertices for the (constrained) local moving of nodes.
+
+  A vertex is contained at most once in the queue (which is tracked by the
+  queued flags), so that a ring buffer with a capacity of n vertices suffices.
+  The buffer is only reallocated when it should grow, so that the same queue
+  can be reused for all levels of an optimisation run.
+
+  Optionally, the queue is divided in a number of priority buckets, each of
+  which is a separate ring buffer. Vertices are popped in FIFO order from the
+  bucket with the highest priority (the highest index) that is not empty.
+****************************************************************************/
+class VertexQueue
+{
+  public:
+    VertexQueue();
+
+    //! \brief Empty the queue and make it suitable for n vertices
+    //!
+    //! \param n Id  - number of vertices
+    //! \param nb_buckets Id  - number of priority buckets
+    void reset(Id n, Id nb_buckets=1);
+
+    //! \brief Push all n vertices in a random order in the lowest bucket
+    //! \pre The queue is empty
+    //!
+    //! \param rng RNG*  - random number generator used for shuffling
+    void push_all_shuffled(RNG* rng);
+
+    //! \brief Stably sort the vertices in the lowest bucket
+    //! \pre Only push_all_shuffled() was called since the last reset()
+    //!
+    //! \param comp Compare  - strict weak ordering of the vertices
+    template <class Compare> void sort(Compare comp)
+    {
+      Id* first = &this->_buffer[this->_head[0]];
+      std::stable_sort(first, first + this->_count[0], comp);
+    };
+
+    //! \brief Push the vertex unless it is already queued
+    //!
+    //! \param v Id  - vertex to be pushed
+    //! \param bucket Id  - priority bucket, clipped to the available buckets
+    //! \return bool  - whether the vertex was actually pushed
+    inline bool push(Id v, Id bucket=0) noexcept
+    {
+      if (this->_queued[v])
+        return false;
+      if (bucket >= this->_nb_buckets)
+        bucket = this->_nb_buckets - 1;
+      Id* buf = &this->_buffer[bucket*this->_capacity];
+      Id pos = this->_head[bucket] + this->_count[bucket];
+      if (pos >= this->_capacity)
+        pos -= this->_capacity;
+      buf[pos] = v;
+      this->_count[bucket]++;
+      this->_queued[v] = true;
+      if (bucket > this->_top)
+        this->_top = bucket;
+      this->_size++;
+      return true;
+    };
+
+    //! \brief Pop the first vertex of the highest priority non-empty bucket
+    //! \pre The queue is not empty
+    inline Id pop() noexcept
+    {
+      while (this->_count[this->_top] == 0)
+        this->_top--;
+      Id bucket = this->_top;
+      Id v = this->_buffer[bucket*this->_capacity + this->_head[bucket]];
+      if (++this->_head[bucket] == this->_capacity)
+        this->_head[bucket] = 0;
+      this->_count[bucket]--;
+      this->_queued[v] = false;
+      this->_size--;
+      return v;
+    };
+
+    inline bool empty() const noexcept { return this->_size == 0; };
+    inline Id size() const noexcept { return this->_size; };
+    inline bool is_queued(Id v) const noexcept { return this->_queued[v]; };
+    inline Id nb_buckets() const noexcept { return this->_nb_buckets; };
+    // Memory (in bytes) allocated by the queue
+    inline size_t memory() const noexcept
+    {
+      return (this->_buffer.capacity() + this->_head.capacity() + this->_count.capacity())*sizeof(Id) +
+             this->_queued.capacity()*sizeof(char);
+    };
+
+  private:
+    vector<Id> _buffer;  // nb_buckets consecutive ring buffers of _capacity
+    vector<Id> _head;    // Position of the first vertex per bucket
+    vector<Id> _count;   // Number of vertices per bucket
+    vector<char> _queued;  // Whether a vertex is currently in the queue
+
+    Id _capacity;
+    Id _nb_buckets;
+    Id _size;
+    Id _top;  // Highest bucket that may be non-empty
+};
+
+/****************************************************************************
+  Changes of the edges of a graph, applied at once by Graph::change_edges.
+  The weights of the updated edges are changed first, then the removed edges
+  are removed, and finally the added edges are added, so that the ids of the
+  updated and removed edges are those before any change.
+****************************************************************************/
+struct EdgeDelta
 {
-  return igraph_rng_get_integer(rng, from, to);
+  vector< pair<Id, Id> > added_edges;
+  vector<Weight> added_weights;   // Weights of the added edges, or empty for a weight of 1
+  vector<Id> removed_edges;
+  vector<Id> updated_edges;
+  vector<Weight> updated_weights; // New weights of the updated edges
 };
 
-void shuffle(vector<Id>& v, igraph_rng_t* rng);
+/****************************************************************************
+  Neighbours and incident edges of all active vertices of a graph in one
+  direction, in compressed sparse row format, in the order in which igraph
+  lists them.
+****************************************************************************/
+struct Adjacency
+{
+  // The neighbours of active vertex i are neighbours[start[i]], ...,
+  // neighbours[start[i + 1] - 1], along the edges at the same positions
+  vector<Id> start;
+  vector<Id> neighbours;
+  vector<Id> edges;
+};
 
 class Graph
 {
@@ -92,6 +365,27 @@ class Graph
     Graph(igraph_t* graph, int correct_self_loops);
     Graph(igraph_t* graph);
     Graph();
+    //! \brief Sparse graph, of which only some vertices are materialised
+    //!
+    //! The graph has n vertices, of which only the given (active) vertices
+    //! are the vertices of the igraph_t, vertex i of the igraph_t being
+    //! vertex vertices[i] of the graph. All other vertices are isolated, with
+    //! a node size and self weight of 0, so that the graph is equivalent to
+    //! one with all n vertices, while its memory only scales with the number
+    //! of active vertices and edges. All methods take and return the vertices
+    //! of the graph, and not of the igraph_t. A sparse graph cannot be
+    //! changed dynamically.
+    //! \param vertices  - active vertices, in increasing order
+    //! \param n  - number of vertices of the graph
+    Graph(igraph_t* graph,
+      vector<Weight> const& edge_weights,
+      vector<Id> const& node_sizes,
+      vector<Weight> const& node_self_weights, int correct_self_loops,
+      vector<Id> const& vertices, Id n);
+    Graph(igraph_t* graph,
+      vector<Weight> const& edge_weights,
+      vector<Id> const& node_sizes, int correct_self_loops,
+      vector<Id> const& vertices, Id n);
 
     // C++11+ constructors
     //! \brief Graph construction from the fully initialized attributed igraph
@@ -121,14 +415,97 @@ class Graph
     Id possible_edges(Id n) const noexcept;
 
     Graph* collapse_graph(MutableVertexPartition* partition) const;
+    //! \brief Collapse the graphs of several layers at once
+    //!
+    //! Graphs constructed on the same igraph_t are layers with the same
+    //! topology, which only differ in their edge weights, node sizes and self
+    //! weights. Given partitions of these layers with the same membership,
+    //! the topology is aggregated only once, and the collapsed graphs of all
+    //! layers share a single collapsed igraph_t (which is destroyed with the
+    //! last of them), each with its own edge weights and node sizes.
+    //! \param graphs  - graphs on the same igraph_t
+    //! \param partitions  - partitions of the graphs, with the same membership
+    //! \return vector<Graph*>  - collapsed graph of every layer
+    static vector<Graph*> collapse_graphs(vector<const Graph*> const& graphs, vector<MutableVertexPartition*> const& partitions);
+    //! \brief Layers of slices coupled by a coupling graph (see slices_to_layers
+    //! in the Python package)
+    //!
+    //! All layers have the nodes of all slices, node i of slice s being node
+    //! offset(s) + i, where offset(s) is the number of nodes in the slices
+    //! before s. Layer s has the edges of slice s, and a node size of 1 for
+    //! the nodes of slice s and of 0 for all other nodes. The last layer has
+    //! the interslice edges, which connect the nodes with the same id in two
+    //! slices that are coupled, with the weight of the coupling edge, and a
+    //! node size of 0 for all nodes. Each layer owns its igraph_t.
+    //! \param slice_ids  - ids of the nodes of each slice, unique per slice
+    //! \param slice_edges  - edges of each slice, between its own nodes
+    //! \param slice_weights  - weights of the edges of each slice
+    //! \param coupling_edges  - pairs of coupled slices
+    //! \param coupling_weights  - weights of the coupling edges
+    //! \param directed  - whether the slices are directed
+    //! \param coupling_directed  - whether the coupling edges are directed;
+    //!                             if not, interslice edges go from the lower
+    //!                             to the higher slice
+    //! \return vector<Graph*>  - layer of every slice and the interslice layer
+    static vector<Graph*> slices_to_layers(vector< vector<Id> > const& slice_ids,
+      vector< vector< pair<Id, Id> > > const& slice_edges,
+      vector< vector<Weight> > const& slice_weights,
+      vector< pair<Id, Id> > const& coupling_edges,
+      vector<Weight> const& coupling_weights,
+      int directed, int coupling_directed);
+    //! \brief Layers of coupled slices, of which the layers of the slices are
+    //! sparse graphs if sparse, with only the nodes of their own slice active
+    //! (the interslice layer is never sparse)
+    static vector<Graph*> slices_to_layers(vector< vector<Id> > const& slice_ids,
+      vector< vector< pair<Id, Id> > > const& slice_edges,
+      vector< vector<Weight> > const& slice_weights,
+      vector< pair<Id, Id> > const& coupling_edges,
+      vector<Weight> const& coupling_weights,
+      int directed, int coupling_directed, int sparse);
+    //! \brief Graph on the same igraph_t (which it does not own) with the same
+    //! edge weights, node sizes, self weights and adjacency, but its own
+    //! neighbour caches, so that it can be used concurrently with this graph
+    //! (e.g. in another thread). It should no longer be used once this graph
+    //! is changed.
+    Graph* clone() const;
+
+    //! \brief Dynamic updates of the graph
+    //!
+    //! The edges are changed in place, after which the strengths, degrees,
+    //! self weights, total weight and density are updated for the changed
+    //! edges only, and all attached partitions are notified to update their
+    //! community weights. Removing edges renumbers the remaining edges
+    //! consecutively, keeping their order (as igraph_delete_edges does).
+    //! Adding or removing edges changes the igraph_t, which is first copied
+    //! if it is not owned by this graph alone (e.g. the igraph_t of a
+    //! python-igraph graph), so that other graphs on it are not affected.
+    //! Clones of this graph should no longer be used. A sparse graph cannot
+    //! be changed.
+    //! \param edges  - edges (pairs of nodes) to add, or ids of the edges to
+    //!                 remove or update
+    //! \param weights  - weights of the edges to add, or their new weights
+    void add_edges(vector< pair<Id, Id> > const& edges, vector<Weight> const& weights);
+    void add_edges(vector< pair<Id, Id> > const& edges);
+    void remove_edges(vector<Id> const& edges);
+    void update_weights(vector<Id> const& edges, vector<Weight> const& weights);
+    //! \brief Apply all changes of delta at once, see EdgeDelta
+    //!
+    //! \return vector<Id>  - the endpoints of the changed edges, in increasing
+    //!                       order, from which a warm start may proceed
+    vector<Id> change_edges(EdgeDelta const& delta);
+
+    //! \brief Attach a partition to (or detach it from) the graph, so that it
+    //! is notified of the dynamic updates of the graph
+    void attach(MutableVertexPartition* partition);
+    void detach(MutableVertexPartition* partition);
 
     vector<Id> const& get_neighbour_edges(Id v, igraph_neimode_t mode) const noexcept;
     vector<Id> const& get_neighbours(Id v, igraph_neimode_t mode) const;
-    Id get_random_neighbour(Id v, igraph_neimode_t mode, igraph_rng_t* rng) const;
+    Id get_random_neighbour(Id v, igraph_neimode_t mode, RNG* rng) const;
 
     pair<Id, Id> get_endpoints(Id e) const noexcept;
 
-    inline Id get_random_node(igraph_rng_t* rng) const noexcept
+    inline Id get_random_node(RNG* rng) const noexcept
     {
       return get_random_int(0, vcount() - 1, rng);
     };
@@ -136,7 +513,25 @@ class Graph
     inline const igraph_t* get_igraph() const noexcept  { return _graph; };
     //inline igraph_t* get_igraph() noexcept  { return _graph; };
 
-    inline Id vcount() const noexcept  { return igraph_vcount(_graph); };
+    inline Id vcount() const noexcept  { return _is_sparse ? _vcount : igraph_vcount(_graph); };
+    //! Number of active vertices, i.e. of the vertices of the igraph_t, which
+    //! are all vertices unless the graph is sparse
+    inline Id active_vcount() const noexcept  { return igraph_vcount(_graph); };
+    inline bool is_sparse() const noexcept { return _is_sparse; };
+    //! Vertex of the graph of active vertex i
+    inline Id vertex(Id i) const noexcept  { return _is_sparse ? _vertices[i] : i; };
+    //! Active vertex (i.e. vertex of the igraph_t) of vertex v of the graph,
+    //! or NO_VERTEX if v is not active
+    inline Id vertex_index(Id v) const noexcept
+    {
+      if (!_is_sparse)
+        return v;
+      Id i = v - _vertex_offset;  // Wraps around if v < _vertex_offset
+      if (i >= _vertex_range)
+        return NO_VERTEX;
+      return _vertex_index.empty() ? i : _vertex_index[i];
+    };
+    static const Id NO_VERTEX = numeric_limits<Id>::max();
     inline Id ecount() const noexcept { return igraph_ecount(_graph); };
     inline Weight total_weight() const noexcept { return _total_weight; };
     inline Id total_size() const noexcept { return _total_size; };
@@ -165,36 +560,52 @@ class Graph
       igraph_integer_t v1, v2;
       igraph_edge(_graph, e, &v1, &v2);
       vector<Id> edge(2);
-      edge[0] = v1; edge[1] = v2;
+      edge[0] = vertex(v1); edge[1] = vertex(v2);
       return edge;
     }
 
     // Get size of node based on attribute (or 1.0 if there is none).
     inline Id node_size(Id v) const noexcept
-    { return _node_sizes[v]; };
+    {
+      if (!_is_sparse)
+        return _node_sizes[v];
+      Id i = vertex_index(v);
+      return i != NO_VERTEX ? _node_sizes[i] : 0;
+    };
 
     // Get self weight of node based on attribute (or set to 0.0 if there is none)
     inline Weight node_self_weight(Id v) const noexcept
-    { return _node_self_weights[v]; };
+    {
+      if (!_is_sparse)
+        return _node_self_weights[v];
+      Id i = vertex_index(v);
+      return i != NO_VERTEX ? _node_self_weights[i] : 0.0;
+    };
 
     inline Id degree(Id v, igraph_neimode_t mode) const
     {
+      Id i = v;
+      if (_is_sparse && (i = vertex_index(v)) == NO_VERTEX)  // An inactive vertex
+        return 0;
       if (mode == IGRAPH_IN)
-        return _degree_in[v];
+        return _degree_in[i];
       else if (mode == IGRAPH_OUT)
-        return _degree_out[v];
+        return _degree_out[i];
       else if (mode == IGRAPH_ALL)
-        return _degree_all[v];
+        return _degree_all[i];
       else
         throw LeidenException("Incorrect mode specified.");
     };
 
     inline Weight strength(Id v, igraph_neimode_t mode) const
     {
+      Id i = v;
+      if (_is_sparse && (i = vertex_index(v)) == NO_VERTEX)
+        return 0.0;
       if (mode == IGRAPH_IN)
-        return _strength_in[v];
+        return _strength_in[i];
       else if (mode == IGRAPH_OUT)
-        return _strength_out[v];
+        return _strength_out[i];
       else
         throw LeidenException("Incorrect mode specified.");
     };
@@ -205,8 +616,28 @@ class Graph
   //protected:
     //! Whether to remove _graph on destruction
     bool  _remove_graph;
+    //! Collapsed igraph_t shared with the collapsed graphs of other layers,
+    //! removed with the last of them (see collapse_graphs)
+    std::shared_ptr<igraph_t>  _shared_graph;
     //! Owner partition of this Graph to be destroyed with it
     const MutableVertexPartition  *_owner;
+    //! Partitions to notify of dynamic updates
+    vector<MutableVertexPartition*> _partitions;
+
+    //! Whether only the _vertices of the _vcount vertices are materialised,
+    //! while all per vertex administration below is only kept for these
+    //! active vertices. The active vertices (in increasing order) lie in the
+    //! _vertex_range vertices from _vertex_offset on. If they are contiguous,
+    //! such as the nodes of a slice, vertex v is active vertex
+    //! v - _vertex_offset, and _vertex_index is empty. Otherwise, it is active
+    //! vertex _vertex_index[v - _vertex_offset] (or NO_VERTEX).
+    bool _is_sparse;
+    Id _vcount;
+    vector<Id> _vertices;
+    Id _vertex_offset;
+    Id _vertex_range;
+    vector<Id> _vertex_index;
+    void set_vertices(vector<Id> const& vertices, Id n);
 
     // Utility variables to easily access the strength of each node
     vector<Weight> _strength_in;
@@ -221,6 +652,18 @@ class Graph
     vector<Id> _node_sizes; // Used for the size of the nodes.
     vector<Weight> _node_self_weights; // Used for the self weight of the nodes.
 
+    //! Adjacency of the active vertices out, in and all, or only all if the
+    //! graph is undirected, copied from igraph once, so that the neighbours
+    //! are found without calling igraph. Clones share the adjacency, which is
+    //! replaced (and not changed) when edges are added or removed.
+    std::shared_ptr< const vector<Adjacency> > _adjacency;
+    Adjacency const& adjacency(igraph_neimode_t mode) const noexcept;
+    // Copy the adjacency from igraph, with igraph_mutex locked by the caller
+    void set_adjacency();
+    // Graph on the same igraph_t as other, with the same administration and
+    // adjacency (see clone)
+    explicit Graph(const Graph* other);
+
     void cache_neighbours(Id v, igraph_neimode_t mode) const noexcept;
     mutable vector<Id> _cached_neighs_from; mutable Id _current_node_cache_neigh_from;
     mutable vector<Id> _cached_neighs_to;   mutable Id _current_node_cache_neigh_to;
@@ -241,6 +684,15 @@ class Graph
     Weight _density;
 
     void init_admin();
+    // Make sure that the igraph_t may be changed in place, by copying it if
+    // it is not owned by this graph alone
+    void own_igraph();
+    void set_density();
+    void clear_neighbour_caches();
+    // Update the strengths, degrees, self weights and total weight (but not
+    // the density) for a change of weight w of the edge (from, to), and of
+    // degree (+1 for an added, -1 for a removed and 0 for an updated edge).
+    void update_edge_admin(Id from, Id to, Weight w, int degree);
     void set_defaults();
     void set_default_edge_weight();
     void set_default_node_size();
@@ -13,6 +13,18 @@ class LinearResolutionParameterVertexPartition : public ResolutionParameterVerte
     LinearResolutionParameterVertexPartition(const Graph* graph, Weight resolution_parameter);
     LinearResolutionParameterVertexPartition(const Graph* graph);
     virtual ~LinearResolutionParameterVertexPartition();
+
+    // The quality is linear in the resolution parameter, i.e.
+    //   quality(resolution_parameter) = (2 - directed)*(total_weight_in_all_comms()
+    //                                     - resolution_parameter*resolution_penalty())
+    // where the penalty (e.g. the possible edges in all communities for CPM)
+    // only depends on the partition, not on the resolution parameter. Both are
+    // kept up to date when moving nodes, so that the quality for any
+    // resolution parameter takes constant time.
+    virtual Weight resolution_penalty() const
+    {
+      throw LeidenException("Function not implemented. This should be implemented in a derived class, since the base class does not implement a specific method.");
+    };
 };
 
 #endif // RESOLUTIONPARAMETERVERTEXPARTITION_H
@@ -0,0 +1,48 @@
+#ifndef MEMBERSHIPIO_H
+#define MEMBERSHIPIO_H
+
+#include "GraphHelper.h"
+#include <string>
+
+using std::string;
+
+/****************************************************************************
+Binary output of a membership, and optionally of its hierarchy, so that it
+can be loaded (or memory mapped) without any parsing.
+
+The file starts with a header of 64 bytes, in native byte order:
+
+  offset  size  field
+       0     8  magic "LEIDENMB"
+       8     8  byte order mark 0x0102030405060708
+      16     4  version (1)
+      20     4  width of each entry in bytes (4 or 8)
+      24     8  number of nodes n
+      32     8  number of communities (largest community plus one)
+      40     8  number of levels L
+      48    16  reserved (zero)
+
+followed by the L sizes of the levels (8 bytes each), and then by the
+membership (n entries) and the L levels. Each of these arrays starts at a
+multiple of 64 bytes, and is padded with zeros to such a multiple. The
+entries are unsigned integers of 4 bytes if all values fit, and of 8 bytes
+otherwise, independent of the platform.
+
+Level 0 maps the nodes to the communities of the first level, and level l
+maps the communities of level l - 1 to those of level l, so that each entry
+of a level is smaller than the size of the next level.
+****************************************************************************/
+void write_membership(string const& filename, vector<Id> const& membership);
+void write_membership(string const& filename, vector<Id> const& membership, vector< vector<Id> > const& levels);
+
+// The sizes of the header are checked against the size of the file before
+// anything is allocated, so that a truncated or corrupt file is an error.
+void read_membership(string const& filename, vector<Id>& membership, vector< vector<Id> >& levels);
+
+// Convert a binary membership file to the text clustering format, with one
+// line of nodes per community, for the membership or, if level is given, for
+// the communities of the nodes at that level of the hierarchy.
+void membership_to_text(string const& filename, string const& text_filename);
+void membership_to_text(string const& filename, string const& text_filename, Id level);
+
+#endif // MEMBERSHIPIO_H
@@ -14,7 +14,11 @@ class ModularityVertexPartition: public MutableVertexPartition
     virtual ModularityVertexPartition* create(const Graph* graph, vector<Id> const& membership) const;
 
     virtual Weight diff_move(Id v, Id new_comm);
+    virtual void diff_move_all(Id v, vector<Id> const& candidates, vector<Weight>& gains);
     virtual Weight quality() const;
+
+  private:
+    template <bool directed, bool sparse> void diff_move_all_impl(Id v, vector<Id> const& candidates, vector<Weight>& gains);
 };
 
 #endif // MODULARITYVERTEXPARTITION_H
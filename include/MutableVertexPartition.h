@@ -7,6 +7,9 @@
 #include <set>
 #include <utility>
 #include <algorithm>
+#include <unordered_map>
+#include <atomic>
+#include <mutex>
 
 using std::string;
 using std::map;
@@ -41,6 +44,14 @@ The basic idea is that diff_move computes the difference in the quality
 function if we call move_node for the same move. Using this framework, the
 Leiden method in the optimisation class can call these general functions in
 order to optimise the quality function.
+
+For a sparse graph (see Graph::is_sparse), only the active vertices have a
+community, and the administration is only kept for the communities of the
+active vertices, so that its memory scales with the number of active
+vertices rather than of all vertices. Moving a vertex that is not active has
+no effect. The number of communities is then taken from the membership it is
+set from (for example, the membership of all vertices that is given to
+set_membership), so that it is the same as for partitions of other layers.
 *****************************************************************************/
 class MutableVertexPartition
 {
@@ -64,20 +75,67 @@ class MutableVertexPartition
     virtual MutableVertexPartition* create(const Graph* graph) const;
     virtual MutableVertexPartition* create(const Graph* graph, vector<Id> const& membership) const;
 
-    inline Id membership(Id v) const noexcept { return this->_membership[v]; };
+    // Community of v, or NO_COMMUNITY if v is not active in a sparse graph
+    inline Id membership(Id v) const noexcept
+    {
+      return this->graph->is_sparse() ? this->membership<true>(v) : this->membership<false>(v);
+    };
+    // Idem, for a graph that is known to be sparse or not, see
+    // total_weight_in_comm<sparse>.
+    template <bool sparse> inline Id membership(Id v) const noexcept
+    {
+      if (!sparse)
+        return this->_membership[v];
+      Id i = this->graph->vertex_index(v);
+      return i != Graph::NO_VERTEX ? this->_membership[i] : NO_COMMUNITY;
+    };
+    // Community of every vertex, or of every active vertex of a sparse graph
     inline vector<Id> const& membership() const noexcept { return this->_membership; };
+    static const Id NO_COMMUNITY = numeric_limits<Id>::max();
 
     Id csize(Id comm) const noexcept;
+    template <bool sparse> inline Id csize(Id comm) const noexcept
+    {
+      return sparse ? this->csize(comm) : this->_csize[comm];
+    };
     Id cnodes(Id comm) const noexcept;
     vector<Id> get_community(Id comm) const noexcept;
     vector< vector<Id> > get_communities() const noexcept;
+
+    // Nodes in community comm (in increasing order) as the range [begin, end)
+    // of a compact index of all communities. The index is rebuilt when nodes
+    // have moved since it was last used, see update_community_index.
+    inline vector<Id>::const_iterator community_begin(Id comm) const
+    {
+      this->update_community_index();
+      return this->_community_members.begin() + this->_community_start[comm];
+    };
+    inline vector<Id>::const_iterator community_end(Id comm) const
+    {
+      this->update_community_index();
+      return this->_community_members.begin() + this->_community_start[comm + 1];
+    };
     Id n_communities() const noexcept;
 
     void move_node(Id v,Id new_comm);
+    // Update the community weights for a change of weight w (negative for a
+    // removal) of the edge (v, u), see Graph::add_edges.
+    void update_edge_weight(Id v, Id u, Weight w);
+    //! \brief Change the edges of the graph of this partition, see
+    //! Graph::change_edges, updating this (and any other attached) partition
+    //!
+    //! \return vector<Id>  - the endpoints of the changed edges
+    vector<Id> change_edges(EdgeDelta const& delta);
     virtual Weight diff_move(Id v, Id new_comm)
     {
       throw LeidenException("Function not implemented. This should be implemented in a derived class, since the base class does not implement a specific method.");
     };
+    //! \brief Differences in quality (see diff_move) when moving v to each candidate community
+    //!
+    //! \param v Id  - node to be moved
+    //! \param candidates vector<Id> const&  - candidate communities
+    //! \param[out] gains vector<Weight>&  - diff_move(v, candidates[i]) for each candidate
+    virtual void diff_move_all(Id v, vector<Id> const& candidates, vector<Weight>& gains);
     virtual Weight quality() const
     {
       throw LeidenException("Function not implemented. This should be implemented in a derived class, since the base class does not implement a specific method.");
@@ -98,15 +156,83 @@ class MutableVertexPartition
 
     void from_partition(MutableVertexPartition* partition);
 
-    inline Weight total_weight_in_comm(Id comm) const noexcept  { return comm < _n_communities ? this->_total_weight_in_comm[comm] : 0.0; };
-    inline Weight total_weight_from_comm(Id comm) const noexcept  { return comm < _n_communities ? this->_total_weight_from_comm[comm] : 0.0; };
-    inline Weight total_weight_to_comm(Id comm) const noexcept { return comm < _n_communities ? this->_total_weight_to_comm[comm] : 0.0; };
+    inline Weight total_weight_in_comm(Id comm) const noexcept  { return this->graph->is_sparse() ? this->total_weight_in_comm<true>(comm) : (comm < _n_communities ? this->_total_weight_in_comm[comm] : 0.0); };
+    inline Weight total_weight_from_comm(Id comm) const noexcept  { return this->graph->is_sparse() ? this->total_weight_from_comm<true>(comm) : (comm < _n_communities ? this->_total_weight_from_comm[comm] : 0.0); };
+    inline Weight total_weight_to_comm(Id comm) const noexcept { return this->graph->is_sparse() ? this->total_weight_to_comm<true>(comm) : (comm < _n_communities ? this->_total_weight_to_comm[comm] : 0.0); };
+
+    // Idem, for a graph that is known to be sparse or not, so that kernels
+    // only need to check this once (see for example diff_move_all). If not
+    // sparse, comm should be a community (i.e. less than n_communities()),
+    // which is not checked.
+    template <bool sparse> inline Weight total_weight_in_comm(Id comm) const noexcept
+    {
+      if (!sparse)
+        return this->_total_weight_in_comm[comm];
+      Id s = this->slot(comm);
+      return s < this->_total_weight_in_comm.size() ? this->_total_weight_in_comm[s] : 0.0;
+    };
+    template <bool sparse> inline Weight total_weight_from_comm(Id comm) const noexcept
+    {
+      if (!sparse)
+        return this->_total_weight_from_comm[comm];
+      Id s = this->slot(comm);
+      return s < this->_total_weight_from_comm.size() ? this->_total_weight_from_comm[s] : 0.0;
+    };
+    template <bool sparse> inline Weight total_weight_to_comm(Id comm) const noexcept
+    {
+      if (!sparse)
+        return this->_total_weight_to_comm[comm];
+      Id s = this->slot(comm);
+      return s < this->_total_weight_to_comm.size() ? this->_total_weight_to_comm[s] : 0.0;
+    };
 
     inline Weight total_weight_in_all_comms() const noexcept  { return _total_weight_in_all_comms; };
     inline Id total_possible_edges_in_all_comms() const noexcept  { return _total_possible_edges_in_all_comms; };
+    // Sum over all communities of total_weight_from_comm(c)*total_weight_to_comm(c)
+    inline Weight total_weight_from_to_all_comms() const noexcept  { return _total_weight_from_to_all_comms; };
+
+    // Total weight going from node v to community comm (and vice versa)
+    inline Weight weight_to_comm(Id v, Id comm) const noexcept
+    {
+      if (!this->graph->is_sparse())
+      {
+        vector<Weight> const& weights = this->cached_weight_communities(v, IGRAPH_OUT);
+        return comm < weights.size() ? weights[comm] : 0;
+      }
+      return this->weight_to_comm<true>(v, comm);
+    };
+    inline Weight weight_from_comm(Id v, Id comm) const noexcept
+    {
+      if (!this->graph->is_sparse())
+      {
+        vector<Weight> const& weights = this->cached_weight_communities(v, IGRAPH_IN);
+        return comm < weights.size() ? weights[comm] : 0;
+      }
+      return this->weight_from_comm<true, true>(v, comm);
+    };
 
-    Weight weight_to_comm(Id v, Id comm) const noexcept;
-    Weight weight_from_comm(Id v, Id comm) const noexcept;
+    // Idem, for a graph that is known to be sparse or not, see
+    // total_weight_in_comm<sparse>. For undirected graphs the weight from a
+    // community is the same as the weight to a community, and only the latter
+    // needs to be cached.
+    template <bool sparse> inline Weight weight_to_comm(Id v, Id comm) const noexcept
+    {
+      vector<Weight> const& weights = this->cached_weight_communities(v, IGRAPH_OUT);
+      if (!sparse)
+        return weights[comm];
+      Id s = this->slot(comm);
+      return s < weights.size() ? weights[s] : 0;
+    };
+    template <bool directed, bool sparse> inline Weight weight_from_comm(Id v, Id comm) const noexcept
+    {
+      if (!directed)
+        return this->weight_to_comm<sparse>(v, comm);
+      vector<Weight> const& weights = this->cached_weight_communities(v, IGRAPH_IN);
+      if (!sparse)
+        return weights[comm];
+      Id s = this->slot(comm);
+      return s < weights.size() ? weights[s] : 0;
+    };
 
     vector<Id> const& get_neigh_comms(Id v, igraph_neimode_t) const;
     set<Id> get_neigh_comms(Id v, igraph_neimode_t mode, vector<Id> const& constrained_membership) const;
@@ -141,11 +267,99 @@ class MutableVertexPartition
     // Keep track of the total internal weight
     Weight _total_weight_in_all_comms;
     Id _total_possible_edges_in_all_comms;
+    // Keep track of the sum of the products of the outgoing and incoming
+    // weight of each community, which is recalculated from scratch after
+    // _nb_total_weight_from_to_updates exceeds the number of communities,
+    // see recalculate_total_weight_from_to_all_comms.
+    Weight _total_weight_from_to_all_comms;
+    Id _nb_total_weight_from_to_updates;
+    void recalculate_total_weight_from_to_all_comms();
+    inline void count_total_weight_from_to_update()
+    {
+      if (++this->_nb_total_weight_from_to_updates > this->_total_weight_from_comm.size())
+        this->recalculate_total_weight_from_to_all_comms();
+    };
     Id _n_communities;
 
-    vector<Id> _empty_communities;
-
+    // For a sparse graph, the administration of community c (_csize, _cnodes,
+    // the total weights and the cached weights) is at position
+    // _comm_slot[c - _comm_offset] (or NO_COMMUNITY), rather than at position
+    // c. The window of _comm_slot spans the communities of the active
+    // vertices, which lie close together for the nodes of a slice, and is
+    // extended when a vertex moves to a community outside of it. A position
+    // is released when its community becomes empty, and reused for the next
+    // new community.
+    Id _comm_offset;
+    vector<Id> _comm_slot;
+    vector<Id> _free_slots;
+    inline Id slot(Id comm) const noexcept
+    {
+      if (!this->graph->is_sparse())
+        return comm;
+      Id i = comm - this->_comm_offset;  // Wraps around if comm < _comm_offset
+      return i < this->_comm_slot.size() ? this->_comm_slot[i] : NO_COMMUNITY;
+    };
+    Id add_slot(Id comm);
+    void remove_slot(Id comm);
+    void set_active_membership(vector<Id> const& membership);
+
+    // Empty communities (i.e. with _cnodes[c] == 0), as a doubly linked list
+    // in the order in which they became empty, ending with
+    // _last_empty_community. The previous and next empty community of an
+    // empty community c are _empty_communities_prev[c] and
+    // _empty_communities_next[c] (or NO_COMMUNITY), so that a community can
+    // be removed in constant time without changing the order of the others.
+    vector<Id> _empty_communities_prev;
+    vector<Id> _empty_communities_next;
+    Id _last_empty_community;
+    Id _nb_empty_communities;
+
+    // Nodes of community c are _community_members[_community_start[c]] up to
+    // _community_members[_community_start[c + 1]] (exclusive). The index is
+    // built from const accessors, possibly by several threads that share the
+    // (unchanging) partition at once, so that it is built under a lock.
+    mutable std::atomic<bool> _community_index_valid;
+    mutable std::mutex _community_index_mutex;
+    mutable vector<Id> _community_start;
+    mutable vector<Id> _community_members;
+    inline void update_community_index() const
+    {
+      if (!this->_community_index_valid.load(std::memory_order_acquire))
+        this->build_community_index();
+    };
+    void build_community_index() const;
+    void add_to_empty_communities(Id comm);
+    void remove_from_empty_communities(Id comm);
+
+    // Cache the weights of v to (or from) its neighbouring communities. In an
+    // undirected graph all modes are the same, and only the cache of IGRAPH_ALL
+    // is used. In a directed graph, caching IGRAPH_ALL also caches IGRAPH_IN
+    // and IGRAPH_OUT, so that the incident edges of v are only scanned once.
     void cache_neigh_communities(Id v, igraph_neimode_t mode) const noexcept;
+    void add_weight_neigh_communities(Id v, igraph_neimode_t mode,
+      vector<Weight>& weights, vector<Id>& neigh_comms, vector<Weight>* weights_all, vector<Id>* neigh_comms_all) const;
+    void reset_neigh_communities(vector<Weight>& weights, vector<Id>& neigh_comms) const;
+    inline vector<Weight> const& cached_weight_communities(Id v, igraph_neimode_t mode) const noexcept
+    {
+      if (mode == IGRAPH_ALL || !this->graph->is_directed())
+      {
+        if (this->_current_node_cache_community_all != v)
+          this->cache_neigh_communities(v, IGRAPH_ALL);
+        return this->_cached_weight_all_community;
+      }
+      else if (mode == IGRAPH_OUT)
+      {
+        if (this->_current_node_cache_community_to != v)
+          this->cache_neigh_communities(v, IGRAPH_OUT);
+        return this->_cached_weight_to_community;
+      }
+      else
+      {
+        if (this->_current_node_cache_community_from != v)
+          this->cache_neigh_communities(v, IGRAPH_IN);
+        return this->_cached_weight_from_community;
+      }
+    };
 
     mutable Id _current_node_cache_community_from; mutable vector<Weight> _cached_weight_from_community; mutable vector<Id> _cached_neigh_comms_from;
     mutable Id _current_node_cache_community_to;   mutable vector<Weight> _cached_weight_to_community;   mutable vector<Id> _cached_neigh_comms_to;
@@ -158,4 +372,21 @@ class MutableVertexPartition
 
 };
 
+/****************************************************************************
+Comparison of two memberships of the same nodes, based on their contingency
+table, i.e. the number of nodes in each pair of communities. The community
+numbers need not be consecutive, and logarithms are natural.
+****************************************************************************/
+struct MembershipComparison
+{
+  Weight nmi; // Normalised mutual information, 2 I(A, B) / (H(A) + H(B))
+  Weight ari; // Adjusted Rand index
+  Weight vi;  // Variation of information, H(A) + H(B) - 2 I(A, B)
+};
+
+// Compare membership1 and membership2 on nb_threads threads (all cores if 0).
+// See compare_memberships in the source.
+MembershipComparison compare_memberships(vector<Id> const& membership1, vector<Id> const& membership2);
+MembershipComparison compare_memberships(vector<Id> const& membership1, vector<Id> const& membership2, Id nb_threads);
+
 #endif // MUTABLEVERTEXPARTITION_H
@@ -2,14 +2,59 @@
 #define OPTIMISER_H
 #include "GraphHelper.h"
 #include "MutableVertexPartition.h"
+#include "LinearResolutionParameterVertexPartition.h"
 #include <set>
 #include <map>
+#include <chrono>
+#include <functional>
 
 #include <iostream>
 using std::cerr;
 using std::endl;
 using std::set;
 using std::map;
+using std::chrono::steady_clock;
+using std::chrono::duration;
+
+/****************************************************************************
+Statistics of an optimisation, to see where the time is spent.
+
+The statistics are only collected when compiled with STATISTICS defined, so
+that otherwise the optimisation does not incur any cost at all. They are
+reset at the start of each optimise_partition, while calling move_nodes,
+merge_nodes or their constrained variants directly simply accumulates them.
+****************************************************************************/
+struct OptimiserStatistics
+{
+  OptimiserStatistics();
+  void reset();
+
+  vector<Id> level_nodes; // Number of nodes of the (collapsed) graph per level of optimise_partition
+  vector<Id> level_edges; // Number of edges of the (collapsed) graph per level of optimise_partition
+  vector<Id> nb_moves_per_pass; // Number of moves per pass of (constrained) move_nodes, a pass being all nodes that were queued at its start
+
+  double move_seconds;       // Time spent moving (or merging) nodes
+  double refine_seconds;     // Time spent in the refinement
+  double collapse_seconds;   // Time spent collapsing graphs
+  double init_admin_seconds; // Time spent creating partitions and setting their membership
+
+  Id nb_visits;      // Number of times a node was considered for moving
+  Id nb_moves;       // Number of times a node was actually moved
+  Id nb_reactivations; // Number of times a stable neighbour of a moved node was queued again
+  Id nb_diff_moves;  // Number of evaluations of diff_move, summed over all layers
+  Id nb_candidates;  // Number of candidate communities, summed over all visits
+
+  size_t peak_scratch_memory; // Largest memory (in bytes) of the buffers of the optimiser
+};
+
+/****************************************************************************
+Callback reporting the progress of the optimisation. It is called with the
+current level of optimise_partition (starting from 0, which is also used
+when calling move_nodes or merge_nodes directly) and the number of node
+visits so far in the current call of move_nodes or merge_nodes. Returning
+false stops the optimisation.
+****************************************************************************/
+typedef std::function<bool(Id level, Id nb_visits)> ProgressCallback;
 
 /****************************************************************************
 Class for doing community detection using the Leiden algorithm.
@@ -32,8 +77,29 @@ class Optimiser
     // Each node will be in the same community in all graphs, and the graphs are expected to have identical nodes
     // Optionally we can loop over all possible communities instead of only the neighbours. In the case of negative
     // layer weights this may be necessary.
+    // Layers may be sparse (see Graph::is_sparse), such as the slices of a
+    // temporal network, in which case a node is only considered in the layers
+    // in which it is active. At least one layer should not be sparse, which is
+    // then used as the first layer. The other functions below require that
+    // the first layer is not sparse.
     Weight optimise_partition(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights);
 
+    // Warm start from the current membership of the partitions, for example
+    // the partition found for a previous snapshot of a graph that has since
+    // changed. Only the changed nodes (e.g. the endpoints of inserted or
+    // deleted edges) and their neighbours are initially queued for moving,
+    // and only the communities affected by the change are refined, the other
+    // communities being aggregated as a whole.
+    Weight optimise_partition(MutableVertexPartition* partition, vector<Id> const& changed_nodes);
+    Weight optimise_partition(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights, vector<Id> const& changed_nodes);
+    // Idem, but also set moved_nodes to the nodes whose community changed,
+    // from which a next iteration may be warm started.
+    Weight optimise_partition(MutableVertexPartition* partition, vector<Id> const& changed_nodes, vector<Id>& moved_nodes);
+    Weight optimise_partition(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights, vector<Id> const& changed_nodes, vector<Id>& moved_nodes);
+    // Warm start after changing the edges of the graph of the partition (see
+    // Graph::change_edges), from the endpoints of the changed edges.
+    Weight optimise_partition(MutableVertexPartition* partition, EdgeDelta const& delta);
+
     Weight move_nodes(MutableVertexPartition* partition);
     Weight move_nodes(MutableVertexPartition* partition, int consider_comms);
     Weight move_nodes(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights);
@@ -54,7 +120,41 @@ class Optimiser
     Weight merge_nodes_constrained(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights, MutableVertexPartition* constrained_partition);
     Weight merge_nodes_constrained(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights, int consider_comms, MutableVertexPartition* constrained_partition);
 
-    inline void set_rng_seed(Id seed) noexcept { igraph_rng_seed(&rng, seed); };
+    // Resolution profile: the partitions (of the same type and on the same
+    // graph as partition) that are optimal for some range of resolution
+    // parameters within [resolution_min, resolution_max], found by bisecting
+    // this range on nb_threads threads (all cores if 0). The partitions are
+    // sorted by resolution parameter and should be deleted by the caller,
+    // before partition if it owns the graph. See resolution_profile in the
+    // source for the other parameters.
+    vector<LinearResolutionParameterVertexPartition*> resolution_profile(LinearResolutionParameterVertexPartition* partition,
+      Weight resolution_min, Weight resolution_max);
+    vector<LinearResolutionParameterVertexPartition*> resolution_profile(LinearResolutionParameterVertexPartition* partition,
+      Weight resolution_min, Weight resolution_max, Weight min_diff_bisect_value, Weight min_diff_resolution,
+      bool linear_bisection, int number_iterations, Id nb_threads);
+
+    // Resolution sweep: a partition for each of the resolution parameters,
+    // which are processed from large to small, each partition starting from
+    // the partition found for the next larger resolution parameter. With
+    // aggregate, the communities of that partition are not split, so that
+    // the optimisation can start from its aggregate graph. The partitions
+    // are sorted by resolution parameter and should be deleted by the
+    // caller, as for resolution_profile.
+    vector<LinearResolutionParameterVertexPartition*> resolution_sweep(LinearResolutionParameterVertexPartition* partition,
+      vector<Weight> resolutions);
+    vector<LinearResolutionParameterVertexPartition*> resolution_sweep(LinearResolutionParameterVertexPartition* partition,
+      vector<Weight> resolutions, bool aggregate);
+
+    // Ensemble: nb_runs independent optimisations of partition, each from its
+    // current membership with its own random stream, on nb_threads threads
+    // (all cores if 0). The partition is set to the best partition found, of
+    // which the quality is returned. If edge_agreement is not nullptr, it is
+    // set to the fraction of the runs in which the endpoints of each edge are
+    // in the same community. See ensemble in the source.
+    Weight ensemble(MutableVertexPartition* partition, Id nb_runs);
+    Weight ensemble(MutableVertexPartition* partition, Id nb_runs, int number_iterations, Id nb_threads, vector<Weight>* edge_agreement);
+
+    inline void set_rng_seed(Id seed) noexcept { rng.seed(seed); };
 
     virtual ~Optimiser();
 
@@ -64,6 +164,23 @@ class Optimiser
     int optimise_routine; // What routine to use for optimisation
     int refine_routine; // What routine to use for optimisation
     int consider_empty_community; // Determine whether to consider moving nodes to an empty community
+    int node_order; // Indicates in what order nodes are considered when moving nodes. Should be one of the parameters below
+
+    OptimiserStatistics statistics; // Only collected when compiled with STATISTICS
+
+    // Progress reporting and cancellation. The progress callback is called at
+    // the start of each level of optimise_partition, and every
+    // progress_interval node visits (if not 0) in the (constrained) moving
+    // and merging of nodes. If it returns false, or if more than time_limit
+    // seconds (if not 0) have passed since the start of optimise_partition,
+    // the optimisation stops as soon as possible. Every move improves the
+    // quality, so the partition is then the best one found so far.
+    ProgressCallback progress_callback;
+    Id progress_interval;
+    double time_limit;
+    // Whether the last call of optimise_partition, or of moving or merging
+    // nodes, was stopped early.
+    inline bool stopped() const noexcept { return this->_stopped; };
 
     static const int ALL_COMMS = 1;       // Consider all communities for improvement.
     static const int ALL_NEIGH_COMMS = 2; // Consider all neighbour communities for improvement.
@@ -73,12 +190,106 @@ class Optimiser
     static const int MOVE_NODES = 10;  // Use move node routine
     static const int MERGE_NODES = 11; // Use merge node routine
 
+    static const int RAND_ORDER = 20;    // Consider nodes in a random order, and reconsider unstable neighbours in the order they became unstable.
+    static const int DEGREE_ORDER = 21;  // Consider nodes in order of decreasing degree (random for equal degrees).
+    static const int CHANGE_ORDER = 22;  // Reconsider first the neighbours whose neighbourhood changed most, relative to their strength.
+    static const int IMPROV_ORDER = 23;  // Reconsider first the neighbours of nodes that moved with the largest improvement.
+
   protected:
 
   private:
     void print_settings();
 
-    igraph_rng_t rng;
+    // Implementation of optimise_partition and move_nodes, where changed_nodes
+    // or nodes (if not nullptr) are the nodes from which to start, and
+    // moved_nodes (if not nullptr) is set to the nodes that changed community.
+    Weight optimise_partition(vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights, vector<Id> const* changed_nodes, vector<Id>* moved_nodes);
+    Weight move_nodes(vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights, int consider_comms, int consider_empty_community, vector<Id> const* nodes);
+
+    // Call the progress callback and check the time limit, returning whether
+    // the optimisation should continue.
+    bool check_progress(Id nb_visits);
+    // Count the visit of a node and check the progress every progress_interval
+    // visits, returning whether the optimisation should continue.
+    inline bool visit_node(Id& nb_visits)
+    {
+      nb_visits++;
+      return this->progress_interval == 0 ||
+             nb_visits % this->progress_interval != 0 ||
+             this->check_progress(nb_visits);
+    };
+    bool _stopped;
+    Id _level;  // Current level of optimise_partition
+    bool _has_deadline;
+    steady_clock::time_point _deadline;
+    #ifdef STATISTICS
+      void update_peak_scratch_memory();
+    #endif
+
+    RNG rng;
+
+    // Queue of unstable nodes, reused by the (constrained) moving of nodes to
+    // avoid allocating it for every level.
+    VertexQueue _vertex_queue;
+    // Number of priority buckets of the queue for CHANGE_ORDER and IMPROV_ORDER
+    static const Id NB_PRIORITY_BUCKETS = 16;
+    // Degrees of the nodes (summed over all layers) for DEGREE_ORDER
+    vector<Id> _node_degrees;
+
+    // Candidate communities for moving a node, and their (weighted) improvements.
+    // _comm_is_candidate flags which communities were already added.
+    vector<Id> _comms;
+    vector<char> _comm_is_candidate;
+    vector<Weight> _improvs;
+    vector<Weight> _layer_improvs;
+    inline void add_candidate_comm(Id comm)
+    {
+      if (comm >= this->_comm_is_candidate.size())
+        this->_comm_is_candidate.resize(comm + 1, false);
+      if (!this->_comm_is_candidate[comm])
+      {
+        this->_comm_is_candidate[comm] = true;
+        this->_comms.push_back(comm);
+      }
+    };
+    // Sort the candidates, so that ties are always resolved in the same way,
+    // and clear their flags for the next node.
+    inline void sort_candidate_comms()
+    {
+      sort(this->_comms.begin(), this->_comms.end());
+      for (Id comm : this->_comms)
+        this->_comm_is_candidate[comm] = false;
+    };
+    template <class Partition> void diff_move_candidates(Id v, vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights);
+
+    // Layers in which each node is active, in increasing order, so that the
+    // loops over the layers for a node skip the sparse layers in which the
+    // node is not active (see Graph::is_sparse). The layers of node v are
+    // _active_layers[_active_layers_start[v]] up to (exclusive)
+    // _active_layers[_active_layers_start[v + 1]], unless all layers are
+    // active for all nodes, in which case _active_layers simply lists all layers.
+    vector<Id> _active_layers;
+    vector<Id> _active_layers_start;
+    bool _all_layers_active;
+    void index_active_layers(vector<const Graph*> const& graphs);
+    inline Id const* active_layers_begin(Id v) const
+    {
+      return this->_active_layers.data() + (this->_all_layers_active ? 0 : this->_active_layers_start[v]);
+    };
+    inline Id const* active_layers_end(Id v) const
+    {
+      return this->_all_layers_active ? this->_active_layers.data() + this->_active_layers.size()
+                                      : this->_active_layers.data() + this->_active_layers_start[v + 1];
+    };
+
+    // Implementation of move_nodes and merge_nodes (and their constrained
+    // variants) for partitions that are all of the type Partition, so that
+    // the quality function is not called virtually. The generic
+    // MutableVertexPartition kernel is used otherwise.
+    template <class Partition> Weight move_nodes_kernel(vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights, int consider_comms, int consider_empty_community, vector<Id> const* nodes);
+    template <class Partition> Weight merge_nodes_kernel(vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights, int consider_comms);
+    template <class Partition> Weight move_nodes_constrained_kernel(vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights, int consider_comms, MutableVertexPartition* constrained_partition);
+    template <class Partition> Weight merge_nodes_constrained_kernel(vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights, int consider_comms, MutableVertexPartition* constrained_partition);
 };
 
 template <class T> T* Optimiser::find_partition(const Graph* graph)
@@ -16,7 +16,12 @@ class RBERVertexPartition : public LinearResolutionParameterVertexPartition
     virtual RBERVertexPartition* create(const Graph* graph, vector<Id> const& membership) const;
 
     virtual Weight diff_move(Id v, Id new_comm);
+    virtual void diff_move_all(Id v, vector<Id> const& candidates, vector<Weight>& gains);
     virtual Weight quality(Weight resolution_parameter) const;
+    virtual Weight resolution_penalty() const;
+
+  private:
+    template <bool directed, bool sparse> void diff_move_all_impl(Id v, vector<Id> const& candidates, vector<Weight>& gains);
 };
 
 #endif // RBERVERTEXPARTITION_H
@@ -9,12 +9,26 @@ class SignificanceVertexPartition : public MutableVertexPartition
   public:
     SignificanceVertexPartition(const Graph* graph, vector<Id> const& membership);
     SignificanceVertexPartition(const Graph* graph);
+    SignificanceVertexPartition(const Graph* graph, vector<Id> const& membership, bool fast_kl);
+    SignificanceVertexPartition(const Graph* graph, bool fast_kl);
     virtual ~SignificanceVertexPartition();
     virtual SignificanceVertexPartition* create(const Graph* graph) const;
     virtual SignificanceVertexPartition* create(const Graph* graph, vector<Id> const& membership) const;
 
     virtual Weight diff_move(Id v, Id new_comm);
+    virtual void diff_move_all(Id v, vector<Id> const& candidates, vector<Weight>& gains);
     virtual Weight quality() const;
+
+    // Whether to approximate the KL divergence (see KLL_fast) when calculating
+    // the difference of moving nodes. The quality itself is always exact.
+    bool fast_kl;
+
+  private:
+    template <bool directed, bool fast, bool sparse> void diff_move_all_impl(Id v, vector<Id> const& candidates, vector<Weight>& gains);
+    inline Weight diff_KLL(Weight q, Weight p) const
+    {
+      return this->fast_kl ? KLL_fast(q, p) : KLL(q, p);
+    };
 };
 
 #endif // SIGNIFICANCEVERTEXPARTITION_H
@@ -15,6 +15,7 @@
 #include "RBERVertexPartition.h"
 #include "CPMVertexPartition.h"
 #include "Optimiser.h"
+#include "MembershipIO.h"
 
 #include "python_partition_interface.h"
 #include "python_optimiser_interface.h"
@@ -36,6 +37,7 @@ extern "C"
       {"_new_RBConfigurationVertexPartition",                       (PyCFunction)_new_RBConfigurationVertexPartition,                       METH_VARARGS | METH_KEYWORDS, ""},
 
       {"_MutableVertexPartition_diff_move",                         (PyCFunction)_MutableVertexPartition_diff_move,                         METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_diff_move_all",                     (PyCFunction)_MutableVertexPartition_diff_move_all,                     METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_move_node",                         (PyCFunction)_MutableVertexPartition_move_node,                         METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_get_py_igraph",                     (PyCFunction)_MutableVertexPartition_get_py_igraph,                     METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_aggregate_partition",               (PyCFunction)_MutableVertexPartition_aggregate_partition,               METH_VARARGS | METH_KEYWORDS, ""},
@@ -52,9 +54,18 @@ extern "C"
       {"_MutableVertexPartition_weight_from_comm",                  (PyCFunction)_MutableVertexPartition_weight_from_comm,                  METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_get_membership",                    (PyCFunction)_MutableVertexPartition_get_membership,                    METH_VARARGS | METH_KEYWORDS, ""},
       {"_MutableVertexPartition_set_membership",                    (PyCFunction)_MutableVertexPartition_set_membership,                    METH_VARARGS | METH_KEYWORDS, ""},
+      {"_MutableVertexPartition_change_edges",                      (PyCFunction)_MutableVertexPartition_change_edges,                      METH_VARARGS | METH_KEYWORDS, ""},
       {"_ResolutionParameterVertexPartition_get_resolution",        (PyCFunction)_ResolutionParameterVertexPartition_get_resolution,        METH_VARARGS | METH_KEYWORDS, ""},
       {"_ResolutionParameterVertexPartition_set_resolution",        (PyCFunction)_ResolutionParameterVertexPartition_set_resolution,        METH_VARARGS | METH_KEYWORDS, ""},
       {"_ResolutionParameterVertexPartition_quality",               (PyCFunction)_ResolutionParameterVertexPartition_quality,               METH_VARARGS | METH_KEYWORDS, ""},
+      {"_LinearResolutionParameterVertexPartition_quality_terms",   (PyCFunction)_LinearResolutionParameterVertexPartition_quality_terms,   METH_VARARGS | METH_KEYWORDS, ""},
+
+      {"_slices_to_layers",                                         (PyCFunction)_slices_to_layers,                                         METH_VARARGS | METH_KEYWORDS, ""},
+      {"_slices_to_partitions",                                     (PyCFunction)_slices_to_partitions,                                     METH_VARARGS | METH_KEYWORDS, ""},
+      {"_compare_memberships",                                      (PyCFunction)_compare_memberships,                                      METH_VARARGS | METH_KEYWORDS, ""},
+      {"_write_membership",                                         (PyCFunction)_write_membership,                                         METH_VARARGS | METH_KEYWORDS, ""},
+      {"_read_membership",                                          (PyCFunction)_read_membership,                                          METH_VARARGS | METH_KEYWORDS, ""},
+      {"_membership_to_text",                                       (PyCFunction)_membership_to_text,                                       METH_VARARGS | METH_KEYWORDS, ""},
 
 
       {"_new_Optimiser",                            (PyCFunction)_new_Optimiser,                            METH_NOARGS,                  ""},
@@ -71,6 +82,7 @@ extern "C"
       {"_Optimiser_set_refine_routine",             (PyCFunction)_Optimiser_set_refine_routine,             METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_set_consider_empty_community",   (PyCFunction)_Optimiser_set_consider_empty_community,   METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_set_refine_partition",           (PyCFunction)_Optimiser_set_refine_partition,           METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_set_node_order",                 (PyCFunction)_Optimiser_set_node_order,                 METH_VARARGS | METH_KEYWORDS, ""},
 
       {"_Optimiser_get_consider_comms",             (PyCFunction)_Optimiser_get_consider_comms,             METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_get_refine_consider_comms",      (PyCFunction)_Optimiser_get_refine_consider_comms,      METH_VARARGS | METH_KEYWORDS, ""},
@@ -78,9 +90,19 @@ extern "C"
       {"_Optimiser_get_refine_routine",             (PyCFunction)_Optimiser_get_refine_routine,             METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_get_consider_empty_community",   (PyCFunction)_Optimiser_get_consider_empty_community,   METH_VARARGS | METH_KEYWORDS, ""},
       {"_Optimiser_get_refine_partition",           (PyCFunction)_Optimiser_get_refine_partition,           METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_node_order",                 (PyCFunction)_Optimiser_get_node_order,                 METH_VARARGS | METH_KEYWORDS, ""},
 
       {"_Optimiser_set_rng_seed",                   (PyCFunction)_Optimiser_set_rng_seed,                   METH_VARARGS | METH_KEYWORDS, ""},
 
+      {"_Optimiser_set_progress_callback",          (PyCFunction)_Optimiser_set_progress_callback,          METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_set_time_limit",                 (PyCFunction)_Optimiser_set_time_limit,                 METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_time_limit",                 (PyCFunction)_Optimiser_get_time_limit,                 METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_stopped",                    (PyCFunction)_Optimiser_get_stopped,                    METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_get_statistics",                 (PyCFunction)_Optimiser_get_statistics,                 METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_resolution_profile",             (PyCFunction)_Optimiser_resolution_profile,             METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_resolution_sweep",               (PyCFunction)_Optimiser_resolution_sweep,               METH_VARARGS | METH_KEYWORDS, ""},
+      {"_Optimiser_ensemble",                       (PyCFunction)_Optimiser_ensemble,                       METH_VARARGS | METH_KEYWORDS, ""},
+
       {NULL}
   };
 
@@ -145,6 +167,11 @@ extern "C"
       PyModule_AddIntConstant(module, "MOVE_NODES", Optimiser::MOVE_NODES);
       PyModule_AddIntConstant(module, "MERGE_NODES", Optimiser::MERGE_NODES);
 
+      PyModule_AddIntConstant(module, "RAND_ORDER", Optimiser::RAND_ORDER);
+      PyModule_AddIntConstant(module, "DEGREE_ORDER", Optimiser::DEGREE_ORDER);
+      PyModule_AddIntConstant(module, "CHANGE_ORDER", Optimiser::CHANGE_ORDER);
+      PyModule_AddIntConstant(module, "IMPROV_ORDER", Optimiser::IMPROV_ORDER);
+
       if (module == NULL)
           INITERROR;
       struct module_state *st = GETSTATE(module);
@@ -26,6 +26,8 @@
 PyObject* capsule_Optimiser(Optimiser* optimiser);
 Optimiser* decapsule_Optimiser(PyObject* py_optimiser);
 void del_Optimiser(PyObject* py_optimiser);
+vector<Id> nodes_from_py(PyObject* py_nodes);
+PyObject* nodes_to_py(vector<Id> const& nodes);
 
 #ifdef __cplusplus
 extern "C"
@@ -45,6 +47,7 @@ extern "C"
   PyObject* _Optimiser_set_refine_routine(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_set_consider_empty_community(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_set_refine_partition(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_set_node_order(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_set_rng_seed(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _Optimiser_get_consider_comms(PyObject *self, PyObject *args, PyObject *keywds);
@@ -53,6 +56,16 @@ extern "C"
   PyObject* _Optimiser_get_refine_routine(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_get_consider_empty_community(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _Optimiser_get_refine_partition(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_node_order(PyObject *self, PyObject *args, PyObject *keywds);
+
+  PyObject* _Optimiser_set_progress_callback(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_set_time_limit(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_time_limit(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_stopped(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_get_statistics(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_resolution_profile(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_resolution_sweep(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _Optimiser_ensemble(PyObject *self, PyObject *args, PyObject *keywds);
 
 #ifdef __cplusplus
 }
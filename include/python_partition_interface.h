@@ -15,6 +15,7 @@
 #include "RBERVertexPartition.h"
 #include "CPMVertexPartition.h"
 #include "Optimiser.h"
+#include "MembershipIO.h"
 
 #include <sstream>
 
@@ -33,6 +34,10 @@ Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_weights, int ch
 Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_weights, PyObject* py_node_sizes);
 Graph* create_graph_from_py(PyObject* py_obj_graph, PyObject* py_weights, PyObject* py_node_sizes, int check_positive_weight);
 
+PyObject* py_igraph_from_graph(const Graph* graph);
+
+vector<Id> membership_from_py(PyObject* py_membership);
+
 PyObject* capsule_MutableVertexPartition(MutableVertexPartition* partition);
 MutableVertexPartition* decapsule_MutableVertexPartition(PyObject* py_partition);
 
@@ -50,6 +55,7 @@ extern "C"
   PyObject* _new_RBConfigurationVertexPartition(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _MutableVertexPartition_diff_move(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _MutableVertexPartition_diff_move_all(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _MutableVertexPartition_move_node(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _MutableVertexPartition_aggregate_partition(PyObject *self, PyObject *args, PyObject *keywds);
@@ -70,11 +76,21 @@ extern "C"
 
   PyObject* _MutableVertexPartition_get_membership(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _MutableVertexPartition_set_membership(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _MutableVertexPartition_change_edges(PyObject *self, PyObject *args, PyObject *keywds);
 
   PyObject* _ResolutionParameterVertexPartition_get_resolution(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _ResolutionParameterVertexPartition_set_resolution(PyObject *self, PyObject *args, PyObject *keywds);
   PyObject* _ResolutionParameterVertexPartition_quality(PyObject *self, PyObject *args, PyObject *keywds);
 
+  PyObject* _LinearResolutionParameterVertexPartition_quality_terms(PyObject *self, PyObject *args, PyObject *keywds);
+
+  PyObject* _slices_to_layers(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _slices_to_partitions(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _compare_memberships(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _write_membership(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _read_membership(PyObject *self, PyObject *args, PyObject *keywds);
+  PyObject* _membership_to_text(PyObject *self, PyObject *args, PyObject *keywds);
+
 #ifdef __cplusplus
 }
 #endif
@@ -328,8 +328,8 @@ class BuildConfiguration(object):
         self.include_dirs = []
         self.library_dirs = []
         self.libraries = []
-        self.extra_compile_args = ["-std=c++14", "-Weffc++"]
-        self.extra_link_args = []
+        self.extra_compile_args = ["-std=c++14", "-Weffc++", "-pthread"]
+        self.extra_link_args = ["-pthread"]
         self.extra_objects = []
         self.show_progress_bar = True
         self.static_extension = False
@@ -489,6 +489,9 @@ class BuildConfiguration(object):
             elif option == "--no-wait":
                 opts_to_remove.append(idx)
                 self.wait = False                
+            elif option == "--statistics":
+                opts_to_remove.append(idx)
+                self.extra_compile_args.append("-DSTATISTICS")
             elif option.startswith("--c-core-version"):
                 opts_to_remove.append(idx)
                 if option == "--c-core-version":
@@ -115,23 +115,68 @@ Weight CPMVertexPartition::diff_move(Id v, Id new_comm)
   return diff;
 }
 
-Weight CPMVertexPartition::quality(Weight resolution_parameter) const
+/*****************************************************************************
+  Calculate the difference in moving node v to each of the candidate
+  communities, see diff_move. The terms for leaving the old community do not
+  depend on the candidate, and are only calculated once.
+******************************************************************************/
+template <bool directed, bool sparse>
+void CPMVertexPartition::diff_move_all_impl(Id v, vector<Id> const& candidates, vector<Weight>& gains)
 {
   #ifdef DEBUG
-    cerr << "Weight CPMVertexPartition::quality()" << endl;
+    cerr << "void CPMVertexPartition::diff_move_all_impl<" << directed << ", " << sparse << ">(" << v << ", " << candidates.size() << " candidates)" << endl;
   #endif
-  Weight mod = 0.0;
-  for (Id c = 0; c < this->n_communities(); c++)
+  Id nb_candidates = candidates.size();
+  gains.assign(nb_candidates, 0.0);
+  Id old_comm = this->membership<sparse>(v);
+  Id nsize = this->graph->node_size(v);
+  Weight self_weight = this->graph->node_self_weight(v);
+  // Subtracted from the possible edges if self loops are not counted
+  Weight loop_correction = this->graph->correct_self_loops() ? 0.0 : 1.0;
+
+  Weight possible_edge_difference_old = nsize*(2.0*this->csize<sparse>(old_comm) - nsize - loop_correction);
+  Weight diff_old = this->weight_to_comm<sparse>(v, old_comm) + this->weight_from_comm<directed, sparse>(v, old_comm) -
+      self_weight - this->resolution_parameter*possible_edge_difference_old;
+
+  for (Id i = 0; i < nb_candidates; i++)
   {
-    Id csize = this->csize(c);
-    Weight w = this->total_weight_in_comm(c);
-    Id comm_possible_edges = this->graph->possible_edges(csize);
+    Id new_comm = candidates[i];
+    if (new_comm == old_comm)
+      continue;
+    Weight possible_edge_difference_new = nsize*(2.0*this->csize<sparse>(new_comm) + nsize - loop_correction);
+    Weight diff_new = this->weight_to_comm<sparse>(v, new_comm) + this->weight_from_comm<directed, sparse>(v, new_comm) + self_weight -
+        this->resolution_parameter*possible_edge_difference_new;
+    gains[i] = diff_new - diff_old;
+  }
+}
 
-    #ifdef DEBUG
-      cerr << "\t" << "Comm: " << c << ", w_c=" << w << ", n_c=" << csize << ", comm_possible_edges=" << comm_possible_edges << ", p=" << this->graph->density() << "." << endl;
-    #endif
-    mod += w - resolution_parameter*comm_possible_edges;
+void CPMVertexPartition::diff_move_all(Id v, vector<Id> const& candidates, vector<Weight>& gains)
+{
+  if (this->graph->is_directed())
+  {
+    if (this->graph->is_sparse())
+      this->diff_move_all_impl<true, true>(v, candidates, gains);
+    else
+      this->diff_move_all_impl<true, false>(v, candidates, gains);
   }
+  else
+  {
+    if (this->graph->is_sparse())
+      this->diff_move_all_impl<false, true>(v, candidates, gains);
+    else
+      this->diff_move_all_impl<false, false>(v, candidates, gains);
+  }
+}
+
+Weight CPMVertexPartition::quality(Weight resolution_parameter) const
+{
+  #ifdef DEBUG
+    cerr << "Weight CPMVertexPartition::quality()" << endl;
+  #endif
+  // The internal weight and the possible edges of all communities are kept
+  // up to date when moving nodes, so that the sum over all communities of
+  // w_c - resolution_parameter*possible_edges(n_c) is readily available.
+  Weight mod = this->total_weight_in_all_comms() - resolution_parameter*this->resolution_penalty();
   #ifdef DEBUG
     cerr << "exit Weight CPMVertexPartition::quality()" << endl;
     cerr << "return " << mod << endl << endl;
@@ -139,3 +184,12 @@ Weight CPMVertexPartition::quality(Weight resolution_parameter) const
   return (2.0 - this->graph->is_directed())*mod;
 }
 
+/****************************************************************************
+  The penalty is simply the number of possible edges in all communities,
+  which is kept up to date when moving nodes.
+*****************************************************************************/
+Weight CPMVertexPartition::resolution_penalty() const
+{
+  return this->total_possible_edges_in_all_comms();
+}
+
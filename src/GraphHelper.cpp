@@ -1,5 +1,6 @@
 #include <string>  // to_string
 #include <cassert>
+#include <algorithm>  // fill
 #include <type_traits>
 #include "GraphHelper.h"
 #include "MutableVertexPartition.h"
@@ -14,6 +15,12 @@ using std::move;
 using std::remove_pointer_t;
 
 
+std::mutex& igraph_mutex()
+{
+  static std::mutex mutex;
+  return mutex;
+}
+
 vector<Id> range(Id n)
 {
   vector<Id> range_vec(n);
@@ -44,9 +51,11 @@ bool orderCSize(const Id* A, const Id* B)
     return A[1] > B[1];
 }
 
-void shuffle(vector<Id>& v, igraph_rng_t* rng)
+void shuffle(vector<Id>& v, RNG* rng)
 {
   Id n = v.size();
+  if (n == 0)
+    return;
   for (Id idx = n - 1; idx > 0; idx--)
   {
     Id rand_idx = get_random_int(0, idx, rng);
@@ -56,6 +65,50 @@ void shuffle(vector<Id>& v, igraph_rng_t* rng)
   }
 }
 
+VertexQueue::VertexQueue(): _buffer(), _head(), _count(), _queued(),
+  _capacity(0), _nb_buckets(0), _size(0), _top(0)
+{}
+
+void VertexQueue::reset(Id n, Id nb_buckets)
+{
+  if (nb_buckets < 1)
+    nb_buckets = 1;
+  // Only grow the buffers, so that reusing the queue for smaller (aggregate)
+  // graphs does not allocate anything.
+  if (this->_buffer.size() < n*nb_buckets)
+    this->_buffer.resize(n*nb_buckets);
+  if (this->_queued.size() < n)
+    this->_queued.resize(n);
+  this->_capacity = n;
+  this->_nb_buckets = nb_buckets;
+  this->_head.assign(nb_buckets, 0);
+  this->_count.assign(nb_buckets, 0);
+  std::fill(this->_queued.begin(), this->_queued.begin() + n, false);
+  this->_size = 0;
+  this->_top = 0;
+}
+
+void VertexQueue::push_all_shuffled(RNG* rng)
+{
+  Id n = this->_capacity;
+  Id* buf = &this->_buffer[0];
+  for (Id i = 0; i < n; i++)
+    buf[i] = i;
+  // Shuffle in place, in the same way as shuffle() does
+  for (Id idx = n - 1; idx > 0 && idx < n; idx--)
+  {
+    Id rand_idx = get_random_int(0, idx, rng);
+    Id tmp = buf[idx];
+    buf[idx] = buf[rand_idx];
+    buf[rand_idx] = tmp;
+  }
+  this->_head[0] = 0;
+  this->_count[0] = n;
+  std::fill(this->_queued.begin(), this->_queued.begin() + n, true);
+  this->_size = n;
+  this->_top = 0;
+}
+
 /****************************************************************************
   The binary Kullback-Leibler divergence.
 ****************************************************************************/
@@ -81,10 +134,25 @@ Weight KLL(Weight q, Weight p)
   return KL;
 }
 
+FastLogTable::FastLogTable() : log_c(), inv_c()
+{
+  for (int i = 0; i < SIZE; i++)
+  {
+    // Centre of the interval [1 + i/SIZE, 1 + (i + 1)/SIZE)
+    double c = 1.0 + (i + 0.5)/SIZE;
+    log_c[i] = log(c);
+    inv_c[i] = 1.0/c;
+  }
+}
+
+const FastLogTable fast_log_table;
+
+const Id Graph::NO_VERTEX;
 
 Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights
   , vector<Id> const& node_sizes, vector<Weight> const& node_self_weights
   , int correct_self_loops): _graph(graph), _remove_graph(false), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
 {
   if (edge_weights.size() != this->ecount())
     throw LeidenException("Edge weights vector inconsistent length with the edge count of the graph.");
@@ -106,6 +174,7 @@ Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights
 Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights
   , vector<Id> const& node_sizes, vector<Weight> const& node_self_weights)
   : _graph(graph), _remove_graph(false), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
 {
   if (edge_weights.size() != this->ecount())
     throw LeidenException("Edge weights vector inconsistent length with the edge count of the graph.");
@@ -125,6 +194,7 @@ Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights
 Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights
   , vector<Id> const& node_sizes, int correct_self_loops)
   : _graph(graph), _remove_graph(false), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
 {
   if (edge_weights.size() != this->ecount())
     throw LeidenException("Edge weights vector inconsistent length with the edge count of the graph.");
@@ -142,6 +212,7 @@ Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights
 
 Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights
   , vector<Id> const& node_sizes): _graph(graph), _remove_graph(false), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
 {
   if (edge_weights.size() != this->ecount())
     throw LeidenException("Edge weights vector inconsistent length with the edge count of the graph.");
@@ -160,6 +231,7 @@ Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights
 
 Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights, int correct_self_loops)
   : _graph(graph), _remove_graph(false), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
 {
   this->_correct_self_loops = correct_self_loops;
   if (edge_weights.size() != this->ecount())
@@ -173,6 +245,7 @@ Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights, int correct_se
 
 Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights): _graph(graph)
   , _remove_graph(false), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
 {
   if (edge_weights.size() != this->ecount())
     throw LeidenException("Edge weights vector inconsistent length with the edge count of the graph.");
@@ -188,6 +261,7 @@ Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights): _graph(graph)
 
 Graph::Graph(igraph_t* graph, vector<Id> const& node_sizes, int correct_self_loops)
   : _graph(graph), _remove_graph(false), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
 {
   this->_correct_self_loops = correct_self_loops;
 
@@ -203,6 +277,7 @@ Graph::Graph(igraph_t* graph, vector<Id> const& node_sizes, int correct_self_loo
 
 Graph::Graph(igraph_t* graph, vector<Id> const& node_sizes): _graph(graph)
   , _remove_graph(false), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
 {
   this->set_defaults();
   this->_is_weighted = false;
@@ -220,6 +295,7 @@ Graph::Graph(igraph_t* graph, vector<Id> const& node_sizes): _graph(graph)
 
 Graph::Graph(igraph_t* graph, int correct_self_loops): _graph(graph)
   , _remove_graph(false), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
 {
   this->set_defaults();
   this->_correct_self_loops = correct_self_loops;
@@ -229,6 +305,7 @@ Graph::Graph(igraph_t* graph, int correct_self_loops): _graph(graph)
 }
 
 Graph::Graph(igraph_t* graph): _graph(graph), _remove_graph(false), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
   , _correct_self_loops(has_self_loops())
 {
   this->set_defaults();
@@ -238,6 +315,7 @@ Graph::Graph(igraph_t* graph): _graph(graph), _remove_graph(false), _owner(nullp
 }
 
 Graph::Graph(): _graph(new igraph_t()), _remove_graph(true), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
   , _is_weighted(false), _correct_self_loops(false)
 {
   set_defaults();
@@ -245,6 +323,82 @@ Graph::Graph(): _graph(new igraph_t()), _remove_graph(true), _owner(nullptr)
   set_self_weights();
 }
 
+Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights
+  , vector<Id> const& node_sizes, vector<Weight> const& node_self_weights
+  , int correct_self_loops, vector<Id> const& vertices, Id n)
+  : _graph(graph), _remove_graph(false), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
+{
+  this->set_vertices(vertices, n);
+
+  if (edge_weights.size() != this->ecount())
+    throw LeidenException("Edge weights vector inconsistent length with the edge count of the graph.");
+  this->_edge_weights = edge_weights;
+  this->_is_weighted = true;
+
+  if (node_sizes.size() != this->active_vcount())
+    throw LeidenException("Node size vector inconsistent length with the active vertex count of the graph.");
+  this->_node_sizes = node_sizes;
+
+  if (node_self_weights.size() != this->active_vcount())
+    throw LeidenException("Node self weights vector inconsistent length with the active vertex count of the graph.");
+  this->_node_self_weights = node_self_weights;
+
+  this->_correct_self_loops = correct_self_loops;
+  this->init_admin();
+}
+
+Graph::Graph(igraph_t* graph, vector<Weight> const& edge_weights
+  , vector<Id> const& node_sizes, int correct_self_loops
+  , vector<Id> const& vertices, Id n)
+  : _graph(graph), _remove_graph(false), _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
+{
+  this->set_vertices(vertices, n);
+
+  if (edge_weights.size() != this->ecount())
+    throw LeidenException("Edge weights vector inconsistent length with the edge count of the graph.");
+  this->_edge_weights = edge_weights;
+  this->_is_weighted = true;
+
+  if (node_sizes.size() != this->active_vcount())
+    throw LeidenException("Node size vector inconsistent length with the active vertex count of the graph.");
+  this->_node_sizes = node_sizes;
+
+  this->_correct_self_loops = correct_self_loops;
+  this->init_admin();
+  this->set_self_weights();
+}
+
+/****************************************************************************
+  Make the graph sparse, with the given active vertices out of n vertices.
+*****************************************************************************/
+void Graph::set_vertices(vector<Id> const& vertices, Id n)
+{
+  if (vertices.size() != this->active_vcount())
+    throw LeidenException("Active vertices inconsistent length with the vertex count of the igraph.");
+  for (Id i = 0; i < vertices.size(); i++)
+  {
+    if (vertices[i] >= n)
+      throw LeidenException("Active vertex is not a vertex of the graph.");
+    if (i > 0 && vertices[i] <= vertices[i - 1])
+      throw LeidenException("Active vertices should be unique and in increasing order.");
+  }
+  this->_is_sparse = true;
+  this->_vcount = n;
+  this->_vertices = vertices;
+  this->_vertex_offset = vertices.empty() ? 0 : vertices.front();
+  this->_vertex_range = vertices.empty() ? 0 : vertices.back() - vertices.front() + 1;
+  // Contiguous active vertices are found by their offset only
+  this->_vertex_index.clear();
+  if (this->_vertex_range > vertices.size())
+  {
+    this->_vertex_index.resize(this->_vertex_range, NO_VERTEX);
+    for (Id i = 0; i < vertices.size(); i++)
+      this->_vertex_index[vertices[i] - this->_vertex_offset] = i;
+  }
+}
+
 //Graph::Graph(bool clean) noexcept: _graph(nullptr), _remove_graph(false)
 //  , _strength_in(), _strength_out(), _degree_in(), _degree_out(), _degree_all()
 //  , _edge_weights(), _node_sizes(), _node_self_weights()
@@ -258,7 +412,9 @@ Graph::Graph(): _graph(new igraph_t()), _remove_graph(true), _owner(nullptr)
 //{}
 
 Graph::Graph(igraph_t&& gr) noexcept: _graph(new igraph_t(move(gr))), _remove_graph(true)
-  , _owner(nullptr), _is_weighted(igraph_cattribute_has_attr(_graph, IGRAPH_ATTRIBUTE_EDGE, "weight"))
+  , _owner(nullptr)
+  , _is_sparse(false), _vcount(0), _vertex_offset(0), _vertex_range(0)
+  , _is_weighted(igraph_cattribute_has_attr(_graph, IGRAPH_ATTRIBUTE_EDGE, "weight"))
   , _correct_self_loops(has_self_loops())
 {
   if(_is_weighted) {
@@ -281,11 +437,15 @@ Graph::Graph(igraph_t&& gr) noexcept: _graph(new igraph_t(move(gr))), _remove_gr
   set_self_weights();
 }
 
-Graph::Graph(Graph&& other) noexcept: _graph(other._graph), _remove_graph(false), _owner(nullptr)
+Graph::Graph(Graph&& other) noexcept: _graph(other._graph), _remove_graph(false)
+  , _shared_graph(move(other._shared_graph)), _owner(nullptr)
+  , _is_sparse(other._is_sparse), _vcount(other._vcount)
+  , _vertices(move(other._vertices)), _vertex_offset(other._vertex_offset)
+  , _vertex_range(other._vertex_range), _vertex_index(move(other._vertex_index))
   , _strength_in(move(other._strength_in)), _strength_out(move(other._strength_out))
   , _degree_in(move(other._degree_in)), _degree_out(move(other._degree_out)), _degree_all(move(other._degree_all))
   , _edge_weights(move(other._edge_weights)), _node_sizes(move(other._node_sizes))
-  , _node_self_weights(move(other._node_self_weights))
+  , _node_self_weights(move(other._node_self_weights)), _adjacency(move(other._adjacency))
   , _cached_neighs_from(move(other._cached_neighs_from)), _current_node_cache_neigh_from(other._current_node_cache_neigh_from)
   , _cached_neighs_to(move(other._cached_neighs_to)), _current_node_cache_neigh_to(other._current_node_cache_neigh_to)
   , _cached_neighs_all(move(other._cached_neighs_all)), _current_node_cache_neigh_all(other._current_node_cache_neigh_all)
@@ -309,6 +469,7 @@ Graph::~Graph()
   {
     _remove_graph = false;
     // Note: igraph_destroy() includes destruction of the graph attributes if defined any
+    std::lock_guard<std::mutex> lock(igraph_mutex());
     igraph_destroy(_graph);
     delete _graph;
     _graph = nullptr;
@@ -321,6 +482,13 @@ Graph& Graph::operator=(Graph&& other) noexcept
   other._graph = nullptr;
   _remove_graph = other._remove_graph;
   other._remove_graph = false;
+  _shared_graph = move(other._shared_graph);
+  _is_sparse = other._is_sparse;
+  _vcount = other._vcount;
+  _vertices = move(other._vertices);
+  _vertex_offset = other._vertex_offset;
+  _vertex_range = other._vertex_range;
+  _vertex_index = move(other._vertex_index);
   //other._owner = nullptr;  // Note: other's owner should still be capable to release it's memory
 
   _edge_weights = move(other._edge_weights);
@@ -339,6 +507,7 @@ Graph& Graph::operator=(Graph&& other) noexcept
   _degree_out = move(other._degree_out);
   _degree_all = move(other._degree_all);
 
+  _adjacency = move(other._adjacency);
   _cached_neighs_from = move(other._cached_neighs_from);
   _current_node_cache_neigh_from = other._current_node_cache_neigh_from;
   _cached_neighs_to = move(other._cached_neighs_to);
@@ -373,6 +542,7 @@ int Graph::has_self_loops() const
   if(!_graph)
     return has_self_loops;
 
+  std::lock_guard<std::mutex> lock(igraph_mutex());
   igraph_eit_t  eit;  // Edge iterator
   int err = igraph_eit_create(_graph, igraph_ess_all(IGRAPH_EDGEORDER_ID), &eit);
   if(err)
@@ -426,7 +596,7 @@ void Graph::set_default_edge_weight()
 
 void Graph::set_default_node_size()
 {
-  Id n = this->vcount();
+  Id n = this->active_vcount();
 
   // Set default node size of 1
   this->_node_sizes.clear(); this->_node_sizes.resize(n);
@@ -435,14 +605,15 @@ void Graph::set_default_node_size()
 
 void Graph::set_self_weights()
 {
-  Id n = this->vcount();
+  Id n = this->active_vcount();
 
   // Set default self_weights of the total weight of any possible self-loops
   this->_node_self_weights.clear(); this->_node_self_weights.resize(n);
+  std::lock_guard<std::mutex> lock(igraph_mutex());
   for (Id v = 0; v < n; v++)
   {
     #ifdef DEBUG
-      cerr << "\t" << "Size node " << v << ": " << this->node_size(v) << endl;
+      cerr << "\t" << "Size node " << v << ": " << this->_node_sizes[v] << endl;
     #endif
     Weight self_weight = 0.0;
     // There should be only one self loop
@@ -473,12 +644,14 @@ void Graph::init_admin()
   //if (!this->is_directed())
   //  this->_total_weight *= 2.0;
 
-  const Id n = vcount();
+  // The administration of the vertices is only kept for the active vertices
+  const Id n = active_vcount();
 
   _total_size = 0;
   for (Id v = 0; v < n; v++)
-    _total_size += node_size(v);
+    _total_size += _node_sizes[v];
 
+  std::lock_guard<std::mutex> lock(igraph_mutex());
   igraph_vector_t res;
 
   // Init weights vector
@@ -526,7 +699,14 @@ void Graph::init_admin()
   _degree_all.assign(igraph_vector_e_ptr(&res, 0), igraph_vector_e_ptr(&res, n));
 
   igraph_vector_destroy(&res);
+  this->set_adjacency();
+
+  this->set_density();
+  this->clear_neighbour_caches();
+}
 
+void Graph::set_density()
+{
   // Calculate density;
   Weight w = total_weight();
   Id n_size = total_size();
@@ -544,6 +724,11 @@ void Graph::init_admin()
     this->_density = w/normalise;
   else
     this->_density = 2*w/normalise;
+}
+
+void Graph::clear_neighbour_caches()
+{
+  const Id n = vcount();
 
   this->_current_node_cache_neigh_edges_from = n + 1;
   this->_current_node_cache_neigh_edges_to = n + 1;
@@ -554,6 +739,373 @@ void Graph::init_admin()
   this->_current_node_cache_neigh_all = n + 1;
 }
 
+/****************************************************************************
+  Copy the neighbours and incident edges of all active vertices from igraph,
+  in the order of igraph_incident, see Adjacency. The neighbour along an
+  incident edge is its other endpoint, so that a self loop, which igraph
+  lists twice for all neighbours (or for an undirected graph), has the vertex
+  itself as neighbour twice. The neighbours of a sparse graph are vertices of
+  the graph, and not of the igraph_t.
+*****************************************************************************/
+void Graph::set_adjacency()
+{
+  const Id n = this->active_vcount();
+  const bool directed = this->is_directed();
+  igraph_neimode_t modes[3] = {IGRAPH_ALL, IGRAPH_OUT, IGRAPH_IN};
+  std::shared_ptr< vector<Adjacency> > adjacency = std::make_shared< vector<Adjacency> >(directed ? 3 : 1);
+
+  igraph_vector_t incident_edges;
+  int err = igraph_vector_init(&incident_edges, 0);
+  if(err)
+    throw LeidenException("set_adjacency(), igraph_vector_init() failed: " + to_string(err));
+  for (Id mode_i = 0; mode_i < adjacency->size(); mode_i++)
+  {
+    igraph_neimode_t mode = modes[mode_i];
+    Adjacency& adj = (*adjacency)[mode_i];
+    adj.start.resize(n + 1);
+    adj.start[0] = 0;
+    adj.neighbours.reserve(mode == IGRAPH_ALL ? 2*this->ecount() : this->ecount());
+    adj.edges.reserve(adj.neighbours.capacity());
+    for (Id i = 0; i < n; i++)
+    {
+      err = igraph_incident(_graph, &incident_edges, i, mode);
+      if(err)
+      {
+        igraph_vector_destroy(&incident_edges);
+        throw LeidenException("set_adjacency(), igraph_incident() failed: " + to_string(err));
+      }
+      Id degree = igraph_vector_size(&incident_edges);
+      for (Id k = 0; k < degree; k++)
+      {
+        Id e = (Id)VECTOR(incident_edges)[k];
+        igraph_integer_t from, to;
+        igraph_edge(_graph, e, &from, &to);
+        Id u = mode == IGRAPH_OUT ? to : (mode == IGRAPH_IN ? from : ((Id)from == i ? to : from));
+        adj.edges.push_back(e);
+        adj.neighbours.push_back(this->vertex(u));
+      }
+      adj.start[i + 1] = adj.edges.size();
+    }
+  }
+  igraph_vector_destroy(&incident_edges);
+  this->_adjacency = adjacency;
+}
+
+Adjacency const& Graph::adjacency(igraph_neimode_t mode) const noexcept
+{
+  if (!this->is_directed() || mode == IGRAPH_ALL)
+    return (*this->_adjacency)[0];
+  return (*this->_adjacency)[mode == IGRAPH_OUT ? 1 : 2];
+}
+
+/****************************************************************************
+  Dynamic updates of the graph.
+
+  The underlying igraph_t is changed in place, after which the adjacency
+  is copied from it again, so that the neighbours and incident edges are
+  always those of igraph. If the igraph_t is not owned by
+  this graph alone (e.g. it is that of a python-igraph graph, or it is shared
+  by the collapsed graphs of several layers), it is first copied, so that the
+  other graphs on it remain valid. Edges are added and removed through
+  igraph_add_edges and
+  igraph_delete_edges, which rebuild the igraph index in a single pass, so
+  that a batch of edges should preferably be changed at once. All other
+  administration (strengths, degrees, self weights and total weight of the
+  graph, and the community weights of the attached partitions) is only
+  updated for the changed edges, rather than recomputed.
+****************************************************************************/
+void Graph::add_edges(vector< pair<Id, Id> > const& edges)
+{
+  this->add_edges(edges, vector<Weight>(edges.size(), 1.0));
+}
+
+void Graph::add_edges(vector< pair<Id, Id> > const& edges, vector<Weight> const& weights)
+{
+  if (weights.size() != edges.size())
+    throw LeidenException("Weights vector inconsistent length with the number of edges to add.");
+
+  Id n = this->vcount();
+  Id nb_edges = edges.size();
+  for (Id i = 0; i < nb_edges; i++)
+  {
+    if (edges[i].first >= n || edges[i].second >= n)
+      throw LeidenException("Cannot add an edge to a node that is not in the graph.");
+    if (std::isnan(weights[i]))
+      throw LeidenException("Cannot accept NaN weights.");
+  }
+  this->own_igraph();
+
+  {
+    std::lock_guard<std::mutex> lock(igraph_mutex());
+    igraph_vector_t new_edges;
+    int err = igraph_vector_init(&new_edges, 2*nb_edges);
+    if(err)
+      throw LeidenException("add_edges(), igraph_vector_init() failed: " + to_string(err));
+    for (Id i = 0; i < nb_edges; i++)
+    {
+      VECTOR(new_edges)[2*i] = edges[i].first;
+      VECTOR(new_edges)[2*i + 1] = edges[i].second;
+    }
+    err = igraph_add_edges(this->_graph, &new_edges, nullptr);
+    igraph_vector_destroy(&new_edges);
+    if(err)
+      throw LeidenException("add_edges(), igraph_add_edges() failed: " + to_string(err));
+    this->set_adjacency();
+  }
+
+  for (Id i = 0; i < nb_edges; i++)
+  {
+    this->_edge_weights.push_back(weights[i]);
+    if (weights[i] != 1.0)
+      this->_is_weighted = true;
+    this->update_edge_admin(edges[i].first, edges[i].second, weights[i], 1);
+  }
+  this->set_density();
+  this->clear_neighbour_caches();
+
+  for (MutableVertexPartition* partition : this->_partitions)
+    for (Id i = 0; i < nb_edges; i++)
+      partition->update_edge_weight(edges[i].first, edges[i].second, weights[i]);
+}
+
+void Graph::remove_edges(vector<Id> const& edges)
+{
+  Id m = this->ecount();
+  for (Id e : edges)
+    if (e >= m)
+      throw LeidenException("Cannot remove an edge that is not in the graph.");
+  this->own_igraph();
+
+  // Remove every edge only once, also if it is listed multiple times
+  vector<bool> removed(m, false);
+  vector<Id> removed_edges;
+  removed_edges.reserve(edges.size());
+  for (Id e : edges)
+  {
+    if (!removed[e])
+    {
+      removed[e] = true;
+      removed_edges.push_back(e);
+    }
+  }
+  Id nb_edges = removed_edges.size();
+
+  vector< pair<Id, Id> > endpoints(nb_edges);
+  vector<Weight> weights(nb_edges);
+  for (Id i = 0; i < nb_edges; i++)
+  {
+    endpoints[i] = this->get_endpoints(removed_edges[i]);
+    weights[i] = this->edge_weight(removed_edges[i]);
+  }
+  {
+    std::lock_guard<std::mutex> lock(igraph_mutex());
+    igraph_vector_t igraph_edges;
+    int err = igraph_vector_init(&igraph_edges, nb_edges);
+    if(err)
+      throw LeidenException("remove_edges(), igraph_vector_init() failed: " + to_string(err));
+    for (Id i = 0; i < nb_edges; i++)
+      VECTOR(igraph_edges)[i] = removed_edges[i];
+    err = igraph_delete_edges(this->_graph, igraph_ess_vector(&igraph_edges));
+    igraph_vector_destroy(&igraph_edges);
+    if(err)
+      throw LeidenException("remove_edges(), igraph_delete_edges() failed: " + to_string(err));
+    this->set_adjacency();
+  }
+
+  // Renumber the edge weights in the same way as igraph renumbers the edges
+  Id new_e = 0;
+  for (Id e = 0; e < m; e++)
+    if (!removed[e])
+      this->_edge_weights[new_e++] = this->_edge_weights[e];
+  this->_edge_weights.resize(new_e);
+
+  for (Id i = 0; i < nb_edges; i++)
+    this->update_edge_admin(endpoints[i].first, endpoints[i].second, -weights[i], -1);
+  this->set_density();
+  this->clear_neighbour_caches();
+
+  for (MutableVertexPartition* partition : this->_partitions)
+    for (Id i = 0; i < nb_edges; i++)
+      partition->update_edge_weight(endpoints[i].first, endpoints[i].second, -weights[i]);
+}
+
+void Graph::update_weights(vector<Id> const& edges, vector<Weight> const& weights)
+{
+  if (this->_is_sparse)
+    throw LeidenException("Cannot change a sparse graph.");
+  if (weights.size() != edges.size())
+    throw LeidenException("Weights vector inconsistent length with the number of edges to update.");
+
+  Id m = this->ecount();
+  Id nb_edges = edges.size();
+  for (Id i = 0; i < nb_edges; i++)
+  {
+    if (edges[i] >= m)
+      throw LeidenException("Cannot update the weight of an edge that is not in the graph.");
+    if (std::isnan(weights[i]))
+      throw LeidenException("Cannot accept NaN weights.");
+  }
+
+  for (Id i = 0; i < nb_edges; i++)
+  {
+    Id e = edges[i];
+    pair<Id, Id> endpoints = this->get_endpoints(e);
+    Weight diff = weights[i] - this->_edge_weights[e];
+    this->_edge_weights[e] = weights[i];
+    this->update_edge_admin(endpoints.first, endpoints.second, diff, 0);
+    for (MutableVertexPartition* partition : this->_partitions)
+      partition->update_edge_weight(endpoints.first, endpoints.second, diff);
+  }
+  this->_is_weighted = true;
+  this->set_density();
+}
+
+/****************************************************************************
+  Apply all changes of delta, and return the endpoints of the changed edges
+  (in increasing order, without duplicates). Everything is checked before
+  the graph is changed, so that the graph is left unchanged if the delta is
+  invalid. The endpoints of the updated and removed edges are determined
+  before any change, as the removal renumbers the edges.
+****************************************************************************/
+vector<Id> Graph::change_edges(EdgeDelta const& delta)
+{
+  #ifdef DEBUG
+    cerr << "vector<Id> Graph::change_edges(+" << delta.added_edges.size() << ", -" << delta.removed_edges.size() << ", ~" << delta.updated_edges.size() << ")" << endl;
+  #endif
+  if (this->_is_sparse)
+    throw LeidenException("Cannot change a sparse graph.");
+  if (!delta.added_weights.empty() && delta.added_weights.size() != delta.added_edges.size())
+    throw LeidenException("Weights vector inconsistent length with the number of edges to add.");
+  if (delta.updated_weights.size() != delta.updated_edges.size())
+    throw LeidenException("Weights vector inconsistent length with the number of edges to update.");
+
+  const Id n = this->vcount();
+  const Id m = this->ecount();
+  vector<Id> changed_nodes;
+  changed_nodes.reserve(2*(delta.added_edges.size() + delta.removed_edges.size() + delta.updated_edges.size()));
+  for (Id i = 0; i < delta.added_edges.size(); i++)
+  {
+    if (delta.added_edges[i].first >= n || delta.added_edges[i].second >= n)
+      throw LeidenException("Cannot add an edge to a node that is not in the graph.");
+    if (!delta.added_weights.empty() && std::isnan(delta.added_weights[i]))
+      throw LeidenException("Cannot accept NaN weights.");
+    changed_nodes.push_back(delta.added_edges[i].first);
+    changed_nodes.push_back(delta.added_edges[i].second);
+  }
+  for (Id e : delta.removed_edges)
+  {
+    if (e >= m)
+      throw LeidenException("Cannot remove an edge that is not in the graph.");
+    pair<Id, Id> endpoints = this->get_endpoints(e);
+    changed_nodes.push_back(endpoints.first);
+    changed_nodes.push_back(endpoints.second);
+  }
+  for (Id i = 0; i < delta.updated_edges.size(); i++)
+  {
+    if (delta.updated_edges[i] >= m)
+      throw LeidenException("Cannot update the weight of an edge that is not in the graph.");
+    if (std::isnan(delta.updated_weights[i]))
+      throw LeidenException("Cannot accept NaN weights.");
+    pair<Id, Id> endpoints = this->get_endpoints(delta.updated_edges[i]);
+    changed_nodes.push_back(endpoints.first);
+    changed_nodes.push_back(endpoints.second);
+  }
+
+  if (!delta.updated_edges.empty())
+    this->update_weights(delta.updated_edges, delta.updated_weights);
+  if (!delta.removed_edges.empty())
+    this->remove_edges(delta.removed_edges);
+  if (!delta.added_edges.empty())
+  {
+    if (delta.added_weights.empty())
+      this->add_edges(delta.added_edges);
+    else
+      this->add_edges(delta.added_edges, delta.added_weights);
+  }
+
+  std::sort(changed_nodes.begin(), changed_nodes.end());
+  changed_nodes.erase(std::unique(changed_nodes.begin(), changed_nodes.end()), changed_nodes.end());
+  #ifdef DEBUG
+    cerr << "exit Graph::change_edges(), " << changed_nodes.size() << " changed nodes." << endl;
+  #endif
+  return changed_nodes;
+}
+
+/****************************************************************************
+  Make sure that the igraph_t may be changed in place. Unless this graph is
+  its only owner, the igraph_t is copied (without any attributes, which are
+  not used by the graph), and this graph becomes the owner of the copy.
+****************************************************************************/
+void Graph::own_igraph()
+{
+  if (this->_is_sparse)
+    throw LeidenException("Cannot change a sparse graph.");
+  if (this->_remove_graph || (this->_shared_graph && this->_shared_graph.use_count() == 1))
+    return;
+
+  const Id m = this->ecount();
+  std::lock_guard<std::mutex> lock(igraph_mutex());
+  igraph_vector_t edges;
+  int err = igraph_vector_init(&edges, 2*m);
+  if(err)
+    throw LeidenException("own_igraph(), igraph_vector_init() failed: " + to_string(err));
+  for (Id e = 0; e < m; e++)
+  {
+    pair<Id, Id> endpoints = this->get_endpoints(e);
+    VECTOR(edges)[2*e] = endpoints.first;
+    VECTOR(edges)[2*e + 1] = endpoints.second;
+  }
+  igraph_t* graph = new igraph_t();
+  err = igraph_create(graph, &edges, this->vcount(), this->is_directed());
+  igraph_vector_destroy(&edges);
+  if(err)
+  {
+    delete graph;
+    throw LeidenException("own_igraph(), igraph_create() failed: " + to_string(err));
+  }
+
+  this->_graph = graph;
+  this->_remove_graph = true;
+  this->_shared_graph.reset();
+  this->clear_neighbour_caches();
+}
+
+void Graph::update_edge_admin(Id from, Id to, Weight w, int degree)
+{
+  this->_total_weight += w;
+
+  // Self-loops are counted twice in the (undirected) strength and degree,
+  // in the same way as igraph_strength and igraph_degree do.
+  this->_strength_out[from] += w;
+  this->_strength_in[to] += w;
+  this->_degree_out[from] += degree;
+  this->_degree_in[to] += degree;
+  if (!this->is_directed())
+  {
+    this->_strength_out[to] += w;
+    this->_strength_in[from] += w;
+    this->_degree_out[to] += degree;
+    this->_degree_in[from] += degree;
+  }
+  this->_degree_all[from] += degree;
+  this->_degree_all[to] += degree;
+
+  if (from == to)
+    this->_node_self_weights[from] += w;
+}
+
+void Graph::attach(MutableVertexPartition* partition)
+{
+  this->_partitions.push_back(partition);
+}
+
+void Graph::detach(MutableVertexPartition* partition)
+{
+  vector<MutableVertexPartition*>::iterator it = std::find(this->_partitions.begin(), this->_partitions.end(), partition);
+  if (it != this->_partitions.end())
+    this->_partitions.erase(it);
+}
+
 void Graph::cache_neighbour_edges(Id v, igraph_neimode_t mode) const noexcept
 {
   #ifdef DEBUG
@@ -576,16 +1128,18 @@ void Graph::cache_neighbour_edges(Id v, igraph_neimode_t mode) const noexcept
       this->_current_node_cache_neigh_edges_all = v;
       _cached_neigh_edges = &_cached_neigh_edges_all;
   }
-  igraph_vector_t incident_edges;
-  int err = igraph_vector_init(&incident_edges, 0)
-    || igraph_incident(_graph, &incident_edges, v, mode);
-  if(err)
-    throw LeidenException("cache_neighbour_edges(), incident_edges failed: " + to_string(err));
-  assert(degree(v, mode) == igraph_vector_size(&incident_edges)
+  // An inactive vertex of a sparse graph has no edges
+  Id i = this->vertex_index(v);
+  if (i == NO_VERTEX)
+  {
+    _cached_neigh_edges->clear();
+    return;
+  }
+  Adjacency const& adjacency = this->adjacency(mode);
+  _cached_neigh_edges->assign(adjacency.edges.begin() + adjacency.start[i]
+    , adjacency.edges.begin() + adjacency.start[i + 1]);
+  assert(degree(v, mode) == _cached_neigh_edges->size()
     && "cache_neighbour_edges(), incident_edges are not synchronized with the vertex degree");
-  _cached_neigh_edges->assign(igraph_vector_e_ptr(&incident_edges, 0)
-    , igraph_vector_e_ptr(&incident_edges, igraph_vector_size(&incident_edges)));
-  igraph_vector_destroy(&incident_edges);
 
   #ifdef DEBUG
     cerr << "Degree: " << degree(v, mode) << endl;
@@ -628,7 +1182,7 @@ pair<Id, Id> Graph::get_endpoints(Id e) const noexcept
 {
   igraph_integer_t from, to;
   igraph_edge(this->_graph, e,&from, &to);
-  return make_pair<Id, Id>((Id)from, (Id)to);
+  return make_pair<Id, Id>(this->vertex((Id)from), this->vertex((Id)to));
 }
 
 void Graph::cache_neighbours(Id v, igraph_neimode_t mode) const noexcept
@@ -653,16 +1207,17 @@ void Graph::cache_neighbours(Id v, igraph_neimode_t mode) const noexcept
       this->_current_node_cache_neigh_all = v;
       _cached_neighs = &(this->_cached_neighs_all);
   }
-  igraph_vector_t neighbours;
-  int err = igraph_vector_init(&neighbours, 0)
-    || igraph_neighbors(_graph, &neighbours, v, mode);
-  if(err)
-    throw LeidenException("get_endpoints(), neighbours failed: " + to_string(err));
-  assert(degree(v, mode) == igraph_vector_size(&neighbours)
+  Id i = this->vertex_index(v);
+  if (i == NO_VERTEX)
+  {
+    _cached_neighs->clear();
+    return;
+  }
+  Adjacency const& adjacency = this->adjacency(mode);
+  _cached_neighs->assign(adjacency.neighbours.begin() + adjacency.start[i]
+    , adjacency.neighbours.begin() + adjacency.start[i + 1]);
+  assert(degree(v, mode) == _cached_neighs->size()
     && "cache_neighbours(), neighbours are not synchronized with the vertex degree");
-  _cached_neighs->assign(igraph_vector_e_ptr(&neighbours, 0)
-    , igraph_vector_e_ptr(&neighbours, igraph_vector_size(&neighbours)));
-  igraph_vector_destroy(&neighbours);
 
   #ifdef DEBUG
     cerr << "Degree: " << >degree(v, mode) << endl;
@@ -713,13 +1268,13 @@ vector< Id > const& Graph::get_neighbours(Id v, igraph_neimode_t mode) const
 /********************************************************************************
  * This should return a random neighbour in O(1)
  ********************************************************************************/
-Id Graph::get_random_neighbour(Id v, igraph_neimode_t mode, igraph_rng_t* rng) const
+Id Graph::get_random_neighbour(Id v, igraph_neimode_t mode, RNG* rng) const
 {
-  Id node=v;
   Id rand_neigh = -1;
 
   if (this->degree(v, mode) <= 0)
     throw LeidenException("Cannot select a random neighbour for an isolated node.");
+  Id node = this->vertex_index(v);
 
   if (igraph_is_directed(this->_graph) && mode != IGRAPH_ALL)
   {
@@ -732,7 +1287,7 @@ Id Graph::get_random_neighbour(Id v, igraph_neimode_t mode, igraph_rng_t* rng) c
       Id rand_neigh_idx = get_random_int(cum_degree_this_node, cum_degree_next_node - 1, rng);
       // Return the neighbour at that index
       #ifdef DEBUG
-        cerr << "Degree: " << this->degree(node, mode) << " diff in cumulative: " << cum_degree_next_node - cum_degree_this_node << endl;
+        cerr << "Degree: " << this->degree(v, mode) << " diff in cumulative: " << cum_degree_next_node - cum_degree_this_node << endl;
       #endif
       rand_neigh = VECTOR(this->_graph->to)[ (Id)VECTOR(this->_graph->oi)[rand_neigh_idx] ];
     }
@@ -744,7 +1299,7 @@ Id Graph::get_random_neighbour(Id v, igraph_neimode_t mode, igraph_rng_t* rng) c
       // Get a random index from them
       Id rand_neigh_idx = get_random_int(cum_degree_this_node, cum_degree_next_node - 1, rng);
       #ifdef DEBUG
-        cerr << "Degree: " << this->degree(node, mode) << " diff in cumulative: " << cum_degree_next_node - cum_degree_this_node << endl;
+        cerr << "Degree: " << this->degree(v, mode) << " diff in cumulative: " << cum_degree_next_node - cum_degree_this_node << endl;
       #endif
       // Return the neighbour at that index
       rand_neigh = VECTOR(this->_graph->from)[ (Id)VECTOR(this->_graph->ii)[rand_neigh_idx] ];
@@ -765,7 +1320,7 @@ Id Graph::get_random_neighbour(Id v, igraph_neimode_t mode, igraph_rng_t* rng) c
     Id rand_idx = get_random_int(0, total_outdegree + total_indegree - 1, rng);
 
     #ifdef DEBUG
-      cerr << "Degree: " << this->degree(node, mode) << " diff in cumulative: " << total_outdegree + total_indegree << endl;
+      cerr << "Degree: " << this->degree(v, mode) << " diff in cumulative: " << total_outdegree + total_indegree << endl;
     #endif
     // From among in or out neighbours?
     if (rand_idx < total_outdegree)
@@ -780,7 +1335,31 @@ Id Graph::get_random_neighbour(Id v, igraph_neimode_t mode, igraph_rng_t* rng) c
     }
   }
 
-  return rand_neigh;
+  return this->vertex(rand_neigh);
+}
+
+/****************************************************************************
+  Creates a graph sharing the igraph_t of this graph, see clone in the
+  header. The administration is copied and the adjacency is shared, so that
+  igraph is not called at all.
+*****************************************************************************/
+Graph* Graph::clone() const
+{
+  return new Graph(this);
+}
+
+Graph::Graph(const Graph* other): _graph(other->_graph), _remove_graph(false), _owner(nullptr)
+  , _is_sparse(other->_is_sparse), _vcount(other->_vcount)
+  , _vertices(other->_vertices), _vertex_offset(other->_vertex_offset)
+  , _vertex_range(other->_vertex_range), _vertex_index(other->_vertex_index)
+  , _strength_in(other->_strength_in), _strength_out(other->_strength_out)
+  , _degree_in(other->_degree_in), _degree_out(other->_degree_out), _degree_all(other->_degree_all)
+  , _edge_weights(other->_edge_weights), _node_sizes(other->_node_sizes)
+  , _node_self_weights(other->_node_self_weights), _adjacency(other->_adjacency)
+  , _total_weight(other->_total_weight), _total_size(other->_total_size), _is_weighted(other->_is_weighted)
+  , _correct_self_loops(other->_correct_self_loops), _density(other->_density)
+{
+  this->clear_neighbour_caches();
 }
 
 /****************************************************************************
@@ -794,89 +1373,319 @@ Id Graph::get_random_neighbour(Id v, igraph_neimode_t mode, igraph_rng_t* rng) c
   graph.
 *****************************************************************************/
 Graph* Graph::collapse_graph(MutableVertexPartition* partition) const
+{
+  vector<const Graph*> graphs(1, this);
+  vector<MutableVertexPartition*> partitions(1, partition);
+  return Graph::collapse_graphs(graphs, partitions)[0];
+}
+
+/****************************************************************************
+  Collapses the graphs of several layers with the same topology.
+
+  The edges between communities are determined once, together with the
+  collapsed edge of every edge, after which the collapsed edge weights of
+  each layer are simply summed over the edges of that layer. The collapsed
+  edges are ordered by the community of their source and then of their
+  target, as for a single graph, and the self weight of a collapsed node is
+  the weight of its self loop, if any.
+*****************************************************************************/
+static void destroy_igraph(igraph_t* graph)
+{
+  std::lock_guard<std::mutex> lock(igraph_mutex());
+  igraph_destroy(graph);
+  delete graph;
+}
+
+vector<Graph*> Graph::collapse_graphs(vector<const Graph*> const& graphs, vector<MutableVertexPartition*> const& partitions)
 {
   #ifdef DEBUG
-    cerr << "Graph* Graph::collapse_graph(vector<Id> membership)" << endl;
+    cerr << "vector<Graph*> Graph::collapse_graphs(" << graphs.size() << " graphs)" << endl;
   #endif
-  Id m = this->ecount();
+  Id nb_layers = graphs.size();
+  if (nb_layers == 0 || partitions.size() != nb_layers)
+    throw LeidenException("Number of graphs and partitions to collapse should be equal and positive.");
+  const Graph* graph = graphs[0];
+  for (Id layer = 1; layer < nb_layers; layer++)
+    if (graphs[layer]->_graph != graph->_graph)
+      throw LeidenException("Only graphs with the same topology can be collapsed at once.");
+  MutableVertexPartition* partition = partitions[0];
+  Id m = graph->ecount();
+  Id n_collapsed = partition->n_communities();
 
   #ifdef DEBUG
-    cerr << "Current graph has " << this->vcount() << " nodes and " << this->ecount() << " edges." << endl;
-    cerr << "Collapsing to graph with " << partition->n_communities() << " nodes." << endl;
+    cerr << "Current graph has " << graph->vcount() << " nodes and " << m << " edges." << endl;
+    cerr << "Collapsing to graph with " << n_collapsed << " nodes." << endl;
   #endif
 
-  vector< map<Id, Weight> > collapsed_edge_weights(partition->n_communities());
+  // Collapsed node of each active node. A sparse graph collapses to a sparse
+  // graph of which only the communities of the active nodes are active,
+  // which are numbered in increasing order.
+  vector<Id> const& membership = partition->membership();
+  vector<Id> collapsed_vertices;
+  vector<Id> sparse_collapsed_node;
+  if (graph->_is_sparse)
+  {
+    for (Id layer = 1; layer < nb_layers; layer++)
+      if (!graphs[layer]->_is_sparse)
+        throw LeidenException("Only graphs with the same topology can be collapsed at once.");
+    collapsed_vertices = membership;
+    std::sort(collapsed_vertices.begin(), collapsed_vertices.end());
+    collapsed_vertices.erase(std::unique(collapsed_vertices.begin(), collapsed_vertices.end()), collapsed_vertices.end());
+    sparse_collapsed_node.resize(membership.size());
+    for (Id i = 0; i < membership.size(); i++)
+      sparse_collapsed_node[i] = std::lower_bound(collapsed_vertices.begin(), collapsed_vertices.end(), membership[i]) - collapsed_vertices.begin();
+  }
+  vector<Id> const& collapsed_node = graph->_is_sparse ? sparse_collapsed_node : membership;
+  Id n_active_collapsed = graph->_is_sparse ? collapsed_vertices.size() : n_collapsed;
 
+  // Collapsed edges per source community, mapping the target community to the
+  // index of the collapsed edge, which is only known once all are found.
+  vector< map<Id, Id> > collapsed_edge_idx(n_active_collapsed);
+  vector<Id*> collapsed_edge(m);
   igraph_integer_t v, u;
   for (Id e = 0; e < m; e++)
   {
-    Weight w = this->edge_weight(e);
-    igraph_edge(_graph, e, &v, &u);
-    Id v_comm = partition->membership((Id)v);
-    Id u_comm = partition->membership((Id)u);
-    if (collapsed_edge_weights[v_comm].count(u_comm) > 0)
-      collapsed_edge_weights[v_comm][u_comm] += w;
-    else
-      collapsed_edge_weights[v_comm][u_comm] = w;
+    igraph_edge(graph->_graph, e, &v, &u);
+    Id v_comm = collapsed_node[(Id)v];
+    Id u_comm = collapsed_node[(Id)u];
+    collapsed_edge[e] = &collapsed_edge_idx[v_comm][u_comm];
   }
 
-  // Now create vector for edges, first determined the number of edges
   Id m_collapsed = 0;
-  Id n_collapsed = partition->n_communities();
+  for (Id c = 0; c < n_active_collapsed; c++)
+    m_collapsed += collapsed_edge_idx[c].size();
 
-  for (vector< map<Id, Weight> >::iterator itr = collapsed_edge_weights.begin();
-       itr != collapsed_edge_weights.end(); itr++)
+  // Create graph based on edges, shared by all layers
+  igraph_t* collapsed_igraph = new igraph_t();
   {
-      m_collapsed += itr->size();
-  }
+    std::lock_guard<std::mutex> lock(igraph_mutex());
+    igraph_vector_t edges;
+    int err = igraph_vector_init(&edges, 2*m_collapsed); // Vector or edges with edges (edge[0], edge[1]), (edge[2], edge[3]), etc...
+    if(err)
+    {
+      delete collapsed_igraph;
+      throw LeidenException("collapse_graphs(), igraph_vector_init() failed: " + to_string(err));
+    }
 
-  igraph_vector_t edges;
-  vector<Weight> collapsed_weights(m_collapsed, 0.0);
-  Weight total_collapsed_weight = 0.0;
+    Id e_idx = 0;
+    for (Id c = 0; c < n_active_collapsed; c++)
+    {
+      for (pair<const Id, Id>& target : collapsed_edge_idx[c])
+      {
+        VECTOR(edges)[2*e_idx] = c;
+        VECTOR(edges)[2*e_idx+1] = target.first;
+        target.second = e_idx++;
+      }
+    }
 
-  int err = igraph_vector_init(&edges, 2*m_collapsed); // Vector or edges with edges (edge[0], edge[1]), (edge[2], edge[3]), etc...
-  if(err)
-    throw LeidenException("collapse_graph(), igraph_vector_init() failed: " + to_string(err));
+    err = igraph_create(collapsed_igraph, &edges, n_active_collapsed, graph->is_directed());
+    igraph_vector_destroy(&edges);
+    if(err)
+    {
+      delete collapsed_igraph;
+      throw LeidenException("collapse_graphs(), igraph_create() failed: " + to_string(err));
+    }
+  }
+  std::shared_ptr<igraph_t> shared_graph(collapsed_igraph, destroy_igraph);
 
-  Id e_idx = 0;
-  for (Id v = 0; v < n_collapsed; v++)
+  if ((Id) igraph_vcount(collapsed_igraph) != n_active_collapsed)
+    throw LeidenException("Something went wrong with collapsing the graph.");
+
+  vector<Graph*> collapsed_graphs(nb_layers);
+  for (Id layer = 0; layer < nb_layers; layer++)
   {
-    for (map<Id, Weight>::iterator itr = collapsed_edge_weights[v].begin();
-         itr != collapsed_edge_weights[v].end(); itr++)
+    vector<Weight> collapsed_weights(m_collapsed, 0.0);
+    for (Id e = 0; e < m; e++)
+      collapsed_weights[*collapsed_edge[e]] += graphs[layer]->edge_weight(e);
+
+    // Calculate new node sizes and self weights
+    vector<Id> csizes(n_active_collapsed, 0);
+    vector<Weight> self_weights(n_active_collapsed, 0.0);
+    for (Id c = 0; c < n_active_collapsed; c++)
     {
-      if (e_idx >= m_collapsed)
-        throw LeidenException("Maximum number of possible edges exceeded.");
-
-      Id u = itr->first;
-      Weight w = itr->second;
-      VECTOR(edges)[2*e_idx] = v;
-      VECTOR(edges)[2*e_idx+1] = u;
-      collapsed_weights[e_idx] = w;
-      total_collapsed_weight += w;
-      // next edge
-      e_idx += 1;
+      csizes[c] = partitions[layer]->csize(graph->_is_sparse ? collapsed_vertices[c] : c);
+      map<Id, Id>::const_iterator self_loop = collapsed_edge_idx[c].find(c);
+      if (self_loop != collapsed_edge_idx[c].end())
+        self_weights[c] = collapsed_weights[self_loop->second];
     }
+
+    Graph* G = graph->_is_sparse ?
+      new Graph(collapsed_igraph, collapsed_weights, csizes, self_weights, graphs[layer]->_correct_self_loops, collapsed_vertices, n_collapsed) :
+      new Graph(collapsed_igraph, collapsed_weights, csizes, self_weights, graphs[layer]->_correct_self_loops);
+    G->_shared_graph = shared_graph;
+    collapsed_graphs[layer] = G;
   }
+  #ifdef DEBUG
+    cerr << "exit Graph::collapse_graphs(" << graphs.size() << " graphs)" << endl << endl;
+  #endif
+  return collapsed_graphs;
+}
 
-  // Create graph based on edges
-  igraph_t* graph = new igraph_t();
-  err = igraph_create(graph, &edges, n_collapsed, this->is_directed());
-  if(err)
-    throw LeidenException("collapse_graph(), igraph_create() failed: " + to_string(err));
-  igraph_vector_destroy(&edges);
+/****************************************************************************
+  Creates the layers of coupled slices.
 
-  if ((Id) igraph_vcount(graph) != partition->n_communities())
-    throw LeidenException("Something went wrong with collapsing the graph.");
+  The nodes of each slice are sorted by their id once, so that the nodes
+  with the same id in two coupled slices are found by merging both sorted
+  lists, and no slice is ever searched for an id. All layers are created
+  directly from the edge lists, without an intermediate graph of all slices.
+*****************************************************************************/
+vector<Graph*> Graph::slices_to_layers(vector< vector<Id> > const& slice_ids,
+  vector< vector< pair<Id, Id> > > const& slice_edges,
+  vector< vector<Weight> > const& slice_weights,
+  vector< pair<Id, Id> > const& coupling_edges,
+  vector<Weight> const& coupling_weights,
+  int directed, int coupling_directed)
+{
+  return Graph::slices_to_layers(slice_ids, slice_edges, slice_weights,
+    coupling_edges, coupling_weights, directed, coupling_directed, false);
+}
 
-  // Calculate new node sizes
-  vector<Id> csizes(n_collapsed, 0);
-  for (Id c = 0; c < partition->n_communities(); c++)
-    csizes[c] = partition->csize(c);
+vector<Graph*> Graph::slices_to_layers(vector< vector<Id> > const& slice_ids,
+  vector< vector< pair<Id, Id> > > const& slice_edges,
+  vector< vector<Weight> > const& slice_weights,
+  vector< pair<Id, Id> > const& coupling_edges,
+  vector<Weight> const& coupling_weights,
+  int directed, int coupling_directed, int sparse)
+{
+  #ifdef DEBUG
+    cerr << "vector<Graph*> Graph::slices_to_layers(" << slice_ids.size() << " slices, " << coupling_edges.size() << " coupling edges)" << endl;
+  #endif
+  Id nb_slices = slice_ids.size();
+  if (slice_edges.size() != nb_slices || slice_weights.size() != nb_slices)
+    throw LeidenException("Number of edge lists and edge weights should be equal to the number of slices.");
+  if (coupling_weights.size() != coupling_edges.size())
+    throw LeidenException("Number of coupling weights should be equal to the number of coupling edges.");
+
+  vector<Id> offset(nb_slices + 1, 0);
+  vector< vector<Id> > sorted_nodes(nb_slices);
+  for (Id s = 0; s < nb_slices; s++)
+  {
+    vector<Id> const& ids = slice_ids[s];
+    Id n_s = ids.size();
+    offset[s + 1] = offset[s] + n_s;
+    if (slice_weights[s].size() != slice_edges[s].size())
+      throw LeidenException("Number of edge weights should be equal to the number of edges for slice " + to_string(s) + ".");
+    for (pair<Id, Id> const& edge : slice_edges[s])
+      if (edge.first >= n_s || edge.second >= n_s)
+        throw LeidenException("Edge outside of the nodes of slice " + to_string(s) + ".");
+
+    vector<Id>& nodes = sorted_nodes[s];
+    nodes = range(n_s);
+    std::sort(nodes.begin(), nodes.end(), [&ids](Id v, Id u) { return ids[v] < ids[u]; });
+    for (Id i = 1; i < n_s; i++)
+      if (ids[nodes[i]] == ids[nodes[i - 1]])
+        throw LeidenException("No unique IDs for slice " + to_string(s) + ", require unique IDs.");
+  }
+  Id n = offset[nb_slices];
+
+  // Interslice edges between the nodes with the same id in coupled slices
+  vector<Id> interslice_edges;
+  vector<Weight> interslice_weights;
+  for (Id c = 0; c < coupling_edges.size(); c++)
+  {
+    Id s = coupling_edges[c].first;
+    Id t = coupling_edges[c].second;
+    if (s >= nb_slices || t >= nb_slices)
+      throw LeidenException("Coupling edge between unknown slices.");
+    if (s == t)
+      continue;
+    if (!coupling_directed && t < s)
+      std::swap(s, t);
+
+    vector<Id> const& nodes_s = sorted_nodes[s];
+    vector<Id> const& nodes_t = sorted_nodes[t];
+    Id i = 0, j = 0;
+    while (i < nodes_s.size() && j < nodes_t.size())
+    {
+      Id id_s = slice_ids[s][nodes_s[i]];
+      Id id_t = slice_ids[t][nodes_t[j]];
+      if (id_s < id_t)
+        i++;
+      else if (id_t < id_s)
+        j++;
+      else
+      {
+        interslice_edges.push_back(offset[s] + nodes_s[i++]);
+        interslice_edges.push_back(offset[t] + nodes_t[j++]);
+        interslice_weights.push_back(coupling_weights[c]);
+      }
+    }
+  }
+
+  // Layer on its own igraph_t, which is removed with the layer, and which
+  // only has the given active vertices if these are not nullptr
+  auto new_layer = [n, directed](vector<Id> const& edges,
+    vector<Weight> const& weights, vector<Id> const& node_sizes,
+    vector<Id> const* vertices)
+  {
+    igraph_t* igraph = new igraph_t();
+    {
+      std::lock_guard<std::mutex> lock(igraph_mutex());
+      igraph_vector_t igraph_edges;
+      int err = igraph_vector_init(&igraph_edges, edges.size());
+      if(err)
+      {
+        delete igraph;
+        throw LeidenException("slices_to_layers(), igraph_vector_init() failed: " + to_string(err));
+      }
+      for (Id i = 0; i < edges.size(); i++)
+        VECTOR(igraph_edges)[i] = edges[i];
 
-  Graph* G = new Graph(graph, collapsed_weights, csizes, this->_correct_self_loops);
-  G->_remove_graph = true;
+      err = igraph_create(igraph, &igraph_edges, vertices ? vertices->size() : n, directed);
+      igraph_vector_destroy(&igraph_edges);
+      if(err)
+      {
+        delete igraph;
+        throw LeidenException("slices_to_layers(), igraph_create() failed: " + to_string(err));
+      }
+    }
+    std::shared_ptr<igraph_t> shared_graph(igraph, destroy_igraph);
+    Graph* G = vertices ? new Graph(igraph, weights, node_sizes, false, *vertices, n) :
+                          new Graph(igraph, weights, node_sizes, false);
+    G->_shared_graph = shared_graph;
+    return G;
+  };
+
+  vector<Graph*> layers;
+  layers.reserve(nb_slices + 1);
+  try
+  {
+    vector<Id> edges;
+    vector<Id> node_sizes(n, 0);
+    for (Id s = 0; s < nb_slices; s++)
+    {
+      // The nodes of a sparse layer are only those of its slice
+      Id first = sparse ? 0 : offset[s];
+      edges.resize(2*slice_edges[s].size());
+      for (Id e = 0; e < slice_edges[s].size(); e++)
+      {
+        edges[2*e] = first + slice_edges[s][e].first;
+        edges[2*e + 1] = first + slice_edges[s][e].second;
+      }
+      if (sparse)
+      {
+        vector<Id> vertices = range(offset[s + 1] - offset[s]);
+        for (Id& v : vertices)
+          v += offset[s];
+        layers.push_back(new_layer(edges, slice_weights[s], vector<Id>(vertices.size(), 1), &vertices));
+      }
+      else
+      {
+        std::fill(node_sizes.begin() + offset[s], node_sizes.begin() + offset[s + 1], 1);
+        layers.push_back(new_layer(edges, slice_weights[s], node_sizes, nullptr));
+        std::fill(node_sizes.begin() + offset[s], node_sizes.begin() + offset[s + 1], 0);
+      }
+    }
+    layers.push_back(new_layer(interslice_edges, interslice_weights, node_sizes, nullptr));
+  }
+  catch (...)
+  {
+    for (Graph* layer : layers)
+      delete layer;
+    throw;
+  }
   #ifdef DEBUG
-    cerr << "exit Graph::collapse_graph(vector<Id> membership)" << endl << endl;
+    cerr << "exit Graph::slices_to_layers(" << nb_slices << " slices), " << interslice_weights.size() << " interslice edges" << endl << endl;
   #endif
-  return G;
+  return layers;
 }
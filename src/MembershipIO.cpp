@@ -0,0 +1,382 @@
+#include "MembershipIO.h"
+#include <cstdio>
+#include <cerrno>
+
+#ifdef DEBUG
+  using std::cerr;
+  using std::endl;
+#endif
+
+static const char MAGIC[8] = {'L', 'E', 'I', 'D', 'E', 'N', 'M', 'B'};
+static const uint64_t BYTE_ORDER_MARK = 0x0102030405060708ULL;
+static const uint32_t VERSION = 1;
+static const size_t ALIGNMENT = 64;
+// Width of the entries of the file, which are either narrow or wide, and of
+// the level sizes, which are always wide, independent of the width of Id
+static const uint32_t NARROW_WIDTH = sizeof(uint32_t);
+static const uint32_t WIDE_WIDTH = sizeof(uint64_t);
+// Size of the blocks that are read and written at once
+static const size_t BLOCK_SIZE = 1 << 20;
+
+struct MembershipHeader
+{
+  char magic[8];
+  uint64_t byte_order_mark;
+  uint32_t version;
+  uint32_t width;
+  uint64_t nb_nodes;
+  uint64_t nb_communities;
+  uint64_t nb_levels;
+  uint64_t reserved[2];
+};
+static_assert(sizeof(MembershipHeader) == ALIGNMENT, "The header should take exactly one alignment block");
+
+using File = std::unique_ptr<FILE, int(*)(FILE*)>;
+
+static File open_file(string const& filename, const char* mode)
+{
+  File file(fopen(filename.c_str(), mode), &fclose);
+  if (!file)
+    throw LeidenException("Could not open " + filename + ": " + strerror(errno) + ".");
+  // The blocks are large enough, so that buffering would only copy them
+  setvbuf(file.get(), nullptr, _IONBF, 0);
+  return file;
+}
+
+static void write_bytes(FILE* file, const void* data, size_t size)
+{
+  if (size > 0 && fwrite(data, 1, size, file) != size)
+    throw LeidenException(string("Could not write membership: ") + strerror(errno) + ".");
+}
+
+static void read_bytes(FILE* file, void* data, size_t size)
+{
+  if (size > 0 && fread(data, 1, size, file) != size)
+    throw LeidenException("Could not read membership: the file is truncated or unreadable.");
+}
+
+static size_t padding_size(uint64_t size)
+{
+  return (ALIGNMENT - size % ALIGNMENT) % ALIGNMENT;
+}
+
+/****************************************************************************
+  Write the values of ids as entries of type Entry, in blocks of BLOCK_SIZE
+  bytes. The ids are written directly if Entry has the same width as Id, and
+  are converted into a block otherwise.
+*****************************************************************************/
+template <class Entry> static void write_entries(FILE* file, vector<Id> const& ids, vector<char>& block)
+{
+  const size_t n = ids.size();
+  const size_t per_block = BLOCK_SIZE/sizeof(Entry);
+  for (size_t start = 0; start < n; start += per_block)
+  {
+    const size_t end = std::min(start + per_block, n);
+    if (sizeof(Entry) == sizeof(Id))
+      write_bytes(file, ids.data() + start, (end - start)*sizeof(Entry));
+    else
+    {
+      Entry* entries = (Entry*) block.data();
+      for (size_t i = start; i < end; i++)
+        entries[i - start] = (Entry) ids[i];
+      write_bytes(file, entries, (end - start)*sizeof(Entry));
+    }
+  }
+}
+
+template <class Entry> static void read_entries(FILE* file, vector<Id>& ids, vector<char>& block)
+{
+  const size_t n = ids.size();
+  const size_t per_block = BLOCK_SIZE/sizeof(Entry);
+  for (size_t start = 0; start < n; start += per_block)
+  {
+    const size_t end = std::min(start + per_block, n);
+    if (sizeof(Entry) == sizeof(Id))
+      read_bytes(file, ids.data() + start, (end - start)*sizeof(Entry));
+    else
+    {
+      Entry* entries = (Entry*) block.data();
+      read_bytes(file, entries, (end - start)*sizeof(Entry));
+      for (size_t i = start; i < end; i++)
+        ids[i] = entries[i - start];
+    }
+  }
+}
+
+/****************************************************************************
+  Write the values of ids with the given width (NARROW_WIDTH or WIDE_WIDTH),
+  followed by zeros up to a multiple of ALIGNMENT bytes.
+*****************************************************************************/
+static void write_ids(FILE* file, vector<Id> const& ids, uint32_t width, vector<char>& block)
+{
+  if (width == WIDE_WIDTH)
+    write_entries<uint64_t>(file, ids, block);
+  else
+    write_entries<uint32_t>(file, ids, block);
+  const char padding[ALIGNMENT] = {0};
+  write_bytes(file, padding, padding_size((uint64_t) ids.size()*width));
+}
+
+static void read_ids(FILE* file, vector<Id>& ids, uint32_t width, vector<char>& block)
+{
+  if (width == WIDE_WIDTH)
+    read_entries<uint64_t>(file, ids, block);
+  else
+    read_entries<uint32_t>(file, ids, block);
+  char padding[ALIGNMENT];
+  read_bytes(file, padding, padding_size((uint64_t) ids.size()*width));
+}
+
+// Size of the file in bytes, keeping its position
+static uint64_t file_size(FILE* file)
+{
+  #ifdef _WIN32
+    int64_t position = _ftelli64(file);
+    if (position < 0 || _fseeki64(file, 0, SEEK_END) != 0)
+      throw LeidenException(string("Could not read membership: ") + strerror(errno) + ".");
+    int64_t size = _ftelli64(file);
+    if (size < 0 || _fseeki64(file, position, SEEK_SET) != 0)
+      throw LeidenException(string("Could not read membership: ") + strerror(errno) + ".");
+  #else
+    off_t position = ftello(file);
+    if (position < 0 || fseeko(file, 0, SEEK_END) != 0)
+      throw LeidenException(string("Could not read membership: ") + strerror(errno) + ".");
+    off_t size = ftello(file);
+    if (size < 0 || fseeko(file, position, SEEK_SET) != 0)
+      throw LeidenException(string("Could not read membership: ") + strerror(errno) + ".");
+  #endif
+  return (uint64_t) size;
+}
+
+static Id max_id(vector<Id> const& ids)
+{
+  Id max = 0;
+  for (Id id : ids)
+    if (id > max)
+      max = id;
+  return max;
+}
+
+/****************************************************************************
+  Write a membership, and optionally its hierarchy, to a binary file, see
+  MembershipIO.h for the layout.
+
+  Parameters:
+    filename   -- The file to write.
+    membership -- The membership of the nodes.
+    levels     -- The mappings of the levels of the hierarchy, where levels[0]
+                  maps the nodes to the communities of the first level, and
+                  levels[l] maps the communities of level l - 1 to those of
+                  level l.
+*****************************************************************************/
+void write_membership(string const& filename, vector<Id> const& membership)
+{
+  write_membership(filename, membership, vector< vector<Id> >());
+}
+
+void write_membership(string const& filename, vector<Id> const& membership, vector< vector<Id> > const& levels)
+{
+  #ifdef DEBUG
+    cerr << "void write_membership(" << filename << ", " << membership.size() << " nodes, " << levels.size() << " levels)" << endl;
+  #endif
+  const Id nb_levels = levels.size();
+  if (nb_levels > 0 && levels[0].size() != membership.size())
+    throw LeidenException("The first level should map all nodes.");
+  Id max = membership.empty() ? 0 : max_id(membership);
+  for (Id l = 0; l < nb_levels; l++)
+  {
+    Id max_level = levels[l].empty() ? 0 : max_id(levels[l]);
+    if (l + 1 < nb_levels && !levels[l].empty() && max_level >= levels[l + 1].size())
+      throw LeidenException("Each level should map all communities of the previous level.");
+    if (max_level > max)
+      max = max_level;
+  }
+
+  MembershipHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, MAGIC, sizeof(MAGIC));
+  header.byte_order_mark = BYTE_ORDER_MARK;
+  header.version = VERSION;
+  header.width = max <= std::numeric_limits<uint32_t>::max() ? NARROW_WIDTH : WIDE_WIDTH;
+  header.nb_nodes = membership.size();
+  header.nb_communities = membership.empty() ? 0 : max_id(membership) + 1;
+  header.nb_levels = nb_levels;
+
+  vector<Id> level_sizes(nb_levels);
+  for (Id l = 0; l < nb_levels; l++)
+    level_sizes[l] = levels[l].size();
+
+  File file = open_file(filename, "wb");
+  vector<char> block(BLOCK_SIZE);
+  write_bytes(file.get(), &header, sizeof(header));
+  write_ids(file.get(), level_sizes, WIDE_WIDTH, block);
+  write_ids(file.get(), membership, header.width, block);
+  for (Id l = 0; l < nb_levels; l++)
+    write_ids(file.get(), levels[l], header.width, block);
+
+  if (fclose(file.release()) != 0)
+    throw LeidenException("Could not write " + filename + ": " + strerror(errno) + ".");
+  #ifdef DEBUG
+    cerr << "exit write_membership(), width " << header.width << "." << endl;
+  #endif
+}
+
+/****************************************************************************
+  Read a membership, and its hierarchy (which is empty if none was written),
+  from a binary file written by write_membership.
+*****************************************************************************/
+void read_membership(string const& filename, vector<Id>& membership, vector< vector<Id> >& levels)
+{
+  #ifdef DEBUG
+    cerr << "void read_membership(" << filename << ")" << endl;
+  #endif
+  File file = open_file(filename, "rb");
+  MembershipHeader header;
+  read_bytes(file.get(), &header, sizeof(header));
+  if (memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+    throw LeidenException(filename + " is not a membership file.");
+  if (header.byte_order_mark != BYTE_ORDER_MARK)
+    throw LeidenException(filename + " was written with a different byte order.");
+  if (header.version != VERSION)
+    throw LeidenException(filename + " was written with an unsupported version.");
+  if (header.width != NARROW_WIDTH && header.width != WIDE_WIDTH)
+    throw LeidenException(filename + " has an invalid width.");
+
+  // Check the number of entries of every array against the size of the file
+  // before allocating it, so that a truncated or corrupt file cannot cause a
+  // huge allocation
+  uint64_t remaining = file_size(file.get()) - sizeof(header);
+  auto check_entries = [&](uint64_t nb_entries, uint32_t width)
+  {
+    if (nb_entries > remaining/width || nb_entries*width + padding_size(nb_entries*width) > remaining)
+      throw LeidenException(filename + " is truncated or corrupt.");
+    remaining -= nb_entries*width + padding_size(nb_entries*width);
+  };
+
+  vector<char> block(BLOCK_SIZE);
+  check_entries(header.nb_levels, WIDE_WIDTH);
+  vector<Id> level_sizes(header.nb_levels);
+  read_ids(file.get(), level_sizes, WIDE_WIDTH, block);
+  check_entries(header.nb_nodes, header.width);
+  for (Id l = 0; l < header.nb_levels; l++)
+    check_entries(level_sizes[l], header.width);
+
+  membership.resize(header.nb_nodes);
+  read_ids(file.get(), membership, header.width, block);
+  levels.resize(header.nb_levels);
+  for (Id l = 0; l < header.nb_levels; l++)
+  {
+    levels[l].resize(level_sizes[l]);
+    read_ids(file.get(), levels[l], header.width, block);
+  }
+  #ifdef DEBUG
+    cerr << "exit read_membership(), " << membership.size() << " nodes, " << levels.size() << " levels." << endl;
+  #endif
+}
+
+static void append_id(string& text, Id id)
+{
+  char digits[20];
+  int nb_digits = 0;
+  do
+  {
+    digits[nb_digits++] = '0' + id % 10;
+    id /= 10;
+  } while (id > 0);
+  while (nb_digits > 0)
+    text += digits[--nb_digits];
+}
+
+/****************************************************************************
+  Write the nodes of each non-empty community of membership on a line, in
+  order of the communities, after grouping the nodes by counting sort.
+*****************************************************************************/
+static void write_communities_text(string const& text_filename, vector<Id> const& membership)
+{
+  const Id n = membership.size();
+  const Id nb_comms = membership.empty() ? 0 : max_id(membership) + 1;
+
+  // The nodes of community c are nodes[start[c]], ..., nodes[start[c + 1] - 1]
+  vector<Id> start(nb_comms + 1, 0);
+  for (Id v = 0; v < n; v++)
+    start[membership[v] + 1]++;
+  Id nb_nonempty = 0;
+  for (Id c = 0; c < nb_comms; c++)
+  {
+    if (start[c + 1] > 0)
+      nb_nonempty++;
+    start[c + 1] += start[c];
+  }
+  vector<Id> nodes(n);
+  {
+    vector<Id> next(start.begin(), start.end() - 1);
+    for (Id v = 0; v < n; v++)
+      nodes[next[membership[v]]++] = v;
+  }
+
+  File file = open_file(text_filename, "w");
+  string text = "# Clusters: " + std::to_string(nb_nonempty) + ", Nodes: " + std::to_string(n) + ", Fuzzy: 0\n";
+  text.reserve(BLOCK_SIZE + 64);
+  for (Id c = 0; c < nb_comms; c++)
+  {
+    if (start[c] == start[c + 1])
+      continue;
+    for (Id i = start[c]; i < start[c + 1]; i++)
+    {
+      if (i > start[c])
+        text += ' ';
+      append_id(text, nodes[i]);
+      if (text.size() >= BLOCK_SIZE)
+      {
+        write_bytes(file.get(), text.data(), text.size());
+        text.clear();
+      }
+    }
+    text += '\n';
+  }
+  write_bytes(file.get(), text.data(), text.size());
+  if (fclose(file.release()) != 0)
+    throw LeidenException("Could not write " + text_filename + ": " + strerror(errno) + ".");
+}
+
+/****************************************************************************
+  Convert a binary membership file to the text clustering format (CNL): a
+  header line "# Clusters: <k>, Nodes: <n>, Fuzzy: 0", followed by a line
+  with the (space separated) nodes of each non-empty community, in order of
+  the communities. The nodes are numbered as in the membership.
+
+  Parameters:
+    filename      -- The binary membership file.
+    text_filename -- The text file to write.
+    level         -- If given, the communities of the nodes at this level of
+                     the hierarchy are written instead of the membership.
+*****************************************************************************/
+void membership_to_text(string const& filename, string const& text_filename)
+{
+  vector<Id> membership;
+  vector< vector<Id> > levels;
+  read_membership(filename, membership, levels);
+  write_communities_text(text_filename, membership);
+}
+
+void membership_to_text(string const& filename, string const& text_filename, Id level)
+{
+  vector<Id> membership;
+  vector< vector<Id> > levels;
+  read_membership(filename, membership, levels);
+  if (level >= levels.size())
+    throw LeidenException("The membership file has no level " + std::to_string(level) + ".");
+
+  // The community of each node at the given level
+  if (levels[0].size() != membership.size())
+    throw LeidenException("The levels of the membership file are inconsistent.");
+  membership = levels[0];
+  for (Id l = 1; l <= level; l++)
+    for (Id v = 0; v < membership.size(); v++)
+    {
+      if (membership[v] >= levels[l].size())
+        throw LeidenException("The levels of the membership file are inconsistent.");
+      membership[v] = levels[l][membership[v]];
+    }
+  write_communities_text(text_filename, membership);
+}
@@ -34,7 +34,7 @@ Weight ModularityVertexPartition::diff_move(Id v, Id new_comm)
   #ifdef DEBUG
     cerr << "Weight ModularityVertexPartition::diff_move(" << v << ", " << new_comm << ")" << endl;
   #endif
-  Id old_comm = this->_membership[v];
+  Id old_comm = this->membership(v);
   Weight diff = 0.0;
   Weight total_weight = this->graph->total_weight()*(2.0 - this->graph->is_directed());
   if (total_weight == 0.0)
@@ -116,6 +116,61 @@ Weight ModularityVertexPartition::diff_move(Id v, Id new_comm)
   return diff/m;
 }
 
+/*****************************************************************************
+  Calculate the difference in moving node v to each of the candidate
+  communities. The terms of the old community are calculated only once, but
+  otherwise this is identical to diff_move.
+******************************************************************************/
+template <bool directed, bool sparse>
+void ModularityVertexPartition::diff_move_all_impl(Id v, vector<Id> const& candidates, vector<Weight>& gains)
+{
+  #ifdef DEBUG
+    cerr << "void ModularityVertexPartition::diff_move_all_impl<" << directed << ", " << sparse << ">(" << v << ", " << candidates.size() << " candidates)" << endl;
+  #endif
+  Id nb_candidates = candidates.size();
+  gains.assign(nb_candidates, 0.0);
+  Id old_comm = this->membership<sparse>(v);
+  Weight total_weight = this->graph->total_weight()*(directed ? 1.0 : 2.0);
+  if (total_weight == 0.0)
+    return;
+
+  Weight k_out = this->graph->strength(v, IGRAPH_OUT);
+  Weight k_in = directed ? this->graph->strength(v, IGRAPH_IN) : k_out;
+  Weight self_weight = this->graph->node_self_weight(v);
+  Weight diff_old = (this->weight_to_comm<sparse>(v, old_comm) - k_out*this->total_weight_to_comm<sparse>(old_comm)/total_weight) + \
+             (this->weight_from_comm<directed, sparse>(v, old_comm) - k_in*this->total_weight_from_comm<sparse>(old_comm)/total_weight);
+
+  for (Id i = 0; i < nb_candidates; i++)
+  {
+    Id new_comm = candidates[i];
+    if (new_comm == old_comm)
+      continue;
+    Weight K_out_new = this->total_weight_from_comm<sparse>(new_comm) + k_out;
+    Weight K_in_new = this->total_weight_to_comm<sparse>(new_comm) + k_in;
+    Weight diff_new = (this->weight_to_comm<sparse>(v, new_comm) + self_weight - k_out*K_in_new/total_weight) + \
+               (this->weight_from_comm<directed, sparse>(v, new_comm) + self_weight - k_in*K_out_new/total_weight);
+    gains[i] = (diff_new - diff_old)/total_weight;
+  }
+}
+
+void ModularityVertexPartition::diff_move_all(Id v, vector<Id> const& candidates, vector<Weight>& gains)
+{
+  if (this->graph->is_directed())
+  {
+    if (this->graph->is_sparse())
+      this->diff_move_all_impl<true, true>(v, candidates, gains);
+    else
+      this->diff_move_all_impl<true, false>(v, candidates, gains);
+  }
+  else
+  {
+    if (this->graph->is_sparse())
+      this->diff_move_all_impl<false, true>(v, candidates, gains);
+    else
+      this->diff_move_all_impl<false, false>(v, candidates, gains);
+  }
+}
+
 
 /*****************************************************************************
   Give the modularity of the partition.
@@ -1,10 +1,28 @@
 #include "MutableVertexPartition.h"
+#include <thread>
+#include <mutex>
+#include <exception>
 
 #ifdef DEBUG
   using std::cerr;
   using std::endl;
 #endif
 
+const Id MutableVertexPartition::NO_COMMUNITY;
+
+/****************************************************************************
+  The number of communities of a membership vector, i.e. its largest
+  community plus one.
+*****************************************************************************/
+static Id max_community(vector<Id> const& membership)
+{
+  Id n_communities = 0;
+  for (Id c : membership)
+    if (c >= n_communities)
+      n_communities = c + 1;
+  return n_communities;
+}
+
 /****************************************************************************
   Create a new vertex partition.
 
@@ -28,19 +46,39 @@
                         recalculated each time."""
 *****************************************************************************/
 MutableVertexPartition::MutableVertexPartition(const Graph* graph, vector<Id> const& membership)
-: graph(graph), _membership(membership)
+: graph(graph), _n_communities(0), _comm_offset(0)
 {
   const_cast<Graph*>(graph)->owner(this);  // Note: the owner is not updated if already exists
   if (membership.size() != graph->vcount())
     throw LeidenException("Membership vector has incorrect size.");
+  this->_membership.resize(graph->active_vcount());
+  this->set_active_membership(membership);
   init_admin();
+  const_cast<Graph*>(graph)->attach(this);
 }
 
 MutableVertexPartition::MutableVertexPartition(const Graph* graph)
-: graph(graph), _membership(range(graph->vcount()))
+: graph(graph), _n_communities(graph->vcount()), _comm_offset(0)
 {
   const_cast<Graph*>(graph)->owner(this);  // Note: the owner is not updated if already exists
+  this->_membership.resize(graph->active_vcount());
+  for (Id i = 0; i < this->_membership.size(); i++)
+    this->_membership[i] = graph->vertex(i);
   init_admin();
+  const_cast<Graph*>(graph)->attach(this);
+}
+
+/****************************************************************************
+  Set the membership of the active vertices from the membership of all
+  vertices. For a sparse graph, the number of communities is also taken
+  from the membership of all vertices, see init_admin.
+*****************************************************************************/
+void MutableVertexPartition::set_active_membership(vector<Id> const& membership)
+{
+  for (Id i = 0; i < this->_membership.size(); i++)
+    this->_membership[i] = membership[this->graph->vertex(i)];
+  if (this->graph->is_sparse())
+    this->_n_communities = max_community(membership);
 }
 
 MutableVertexPartition* MutableVertexPartition::create(const Graph* graph) const
@@ -55,15 +93,19 @@ MutableVertexPartition* MutableVertexPartition::create(const Graph* graph
 }
 
 MutableVertexPartition::MutableVertexPartition(MutableVertexPartition&& other) noexcept
-  : graph(other.graph), _membership(other._membership)
+  : graph(other.graph), _membership(other._membership), _comm_offset(0), _community_index_valid(false)
 {
   other.graph = nullptr;
   const_cast<Graph*>(graph)->owner(this);  // ATTENTION: should be called only after nulling graph attribute of the previous owner
+  const_cast<Graph*>(graph)->detach(&other);
+  const_cast<Graph*>(graph)->attach(this);
 }
 
 MutableVertexPartition::~MutableVertexPartition()
 {
   this->clean_mem();
+  if(graph)
+    const_cast<Graph*>(graph)->detach(this);
   if(graph && graph->owner() == this) {
     delete graph;
     graph = nullptr;
@@ -72,9 +114,13 @@ MutableVertexPartition::~MutableVertexPartition()
 
 MutableVertexPartition& MutableVertexPartition::operator=(MutableVertexPartition&& other) noexcept
 {
+  if(graph)
+    const_cast<Graph*>(graph)->detach(this);
   graph = other.graph;
   other.graph = nullptr;
   const_cast<Graph*>(graph)->owner(this);  // ATTENTION: should be called only after nulling graph attribute of the previous owner
+  const_cast<Graph*>(graph)->detach(&other);
+  const_cast<Graph*>(graph)->attach(this);
 
   _membership = move(other._membership);
 }
@@ -84,28 +130,25 @@ void MutableVertexPartition::clean_mem()
 
 Id MutableVertexPartition::csize(Id comm) const noexcept
 {
-  if (comm < this->_csize.size())
-    return this->_csize[comm];
+  Id s = this->slot(comm);
+  if (s < this->_csize.size())
+    return this->_csize[s];
   else
     return 0;
 }
 
 Id MutableVertexPartition::cnodes(Id comm) const noexcept
 {
-  if (comm < this->_cnodes.size())
-    return this->_cnodes[comm];
+  Id s = this->slot(comm);
+  if (s < this->_cnodes.size())
+    return this->_cnodes[s];
   else
     return 0;
 }
 
 vector<Id> MutableVertexPartition::get_community(Id comm) const noexcept
 {
-  vector<Id> community;
-  community.reserve(this->_cnodes[comm]);
-  for (Id i = 0; i < this->graph->vcount(); i++)
-    if (this->_membership[i] == comm)
-      community.push_back(i);
-  return community;
+  return vector<Id>(this->community_begin(comm), this->community_end(comm));
 }
 
 vector< vector<Id> > MutableVertexPartition::get_communities() const noexcept
@@ -113,17 +156,37 @@ vector< vector<Id> > MutableVertexPartition::get_communities() const noexcept
   vector< vector<Id> > communities(this->_n_communities);
 
   for (Id c = 0; c < this->_n_communities; c++)
-  {
-    Id cn = this->_cnodes[c];
-    communities[c].reserve(cn);
-  }
-
-  for (Id i = 0; i < this->graph->vcount(); i++)
-      communities[this->_membership[i]].push_back(i);
+    communities[c].assign(this->community_begin(c), this->community_end(c));
 
   return communities;
 }
 
+/****************************************************************************
+  Build the index of the nodes in each community, by sorting the nodes on
+  their community (counting sort). Nodes remain in increasing order within
+  each community. Only the first of several threads that find the index
+  invalid builds it, the others wait for it under the lock.
+*****************************************************************************/
+void MutableVertexPartition::build_community_index() const
+{
+  std::lock_guard<std::mutex> lock(this->_community_index_mutex);
+  if (this->_community_index_valid.load(std::memory_order_relaxed))
+    return;
+
+  Id n = this->_membership.size();
+  // First let _community_start[c + 1] be the start of community c. This is
+  // used as insertion position, so that afterwards it is the end of c.
+  this->_community_start.assign(this->_n_communities + 1, 0);
+  for (Id c = 1; c < this->_n_communities; c++)
+    this->_community_start[c + 1] = this->_community_start[c] + this->cnodes(c - 1);
+
+  this->_community_members.resize(n);
+  for (Id i = 0; i < n; i++)
+    this->_community_members[this->_community_start[this->_membership[i] + 1]++] = this->graph->vertex(i);
+
+  this->_community_index_valid.store(true, std::memory_order_release);
+}
+
 Id MutableVertexPartition::n_communities() const noexcept
 {
   return this->_n_communities;
@@ -139,34 +202,89 @@ void MutableVertexPartition::init_admin()
     cerr << "void MutableVertexPartition::init_admin()" << endl;
   #endif
   Id n = this->graph->vcount();
+  // Only active vertices have a community in a sparse graph
+  Id n_active = this->_membership.size();
+  bool sparse = this->graph->is_sparse();
 
   // First determine number of communities (assuming they are consecutively numbered
   this->update_n_communities();
 
+  // Number of positions of the administration of the communities, which are
+  // only the communities of the active vertices in a sparse graph.
+  Id nb_slots = this->_n_communities;
+  if (sparse)
+  {
+    this->_comm_slot.clear();
+    this->_free_slots.clear();
+    this->_comm_offset = 0;
+    if (n_active > 0)
+    {
+      auto range = std::minmax_element(this->_membership.begin(), this->_membership.end());
+      this->_comm_offset = *range.first;
+      this->_comm_slot.resize(*range.second - *range.first + 1, NO_COMMUNITY);
+    }
+    nb_slots = 0;
+    for (Id c : this->_membership)
+      if (this->_comm_slot[c - this->_comm_offset] == NO_COMMUNITY)
+        this->_comm_slot[c - this->_comm_offset] = nb_slots++;
+  }
+
   // Reset administration
   this->_total_weight_in_comm.clear();
-  this->_total_weight_in_comm.resize(this->_n_communities);
+  this->_total_weight_in_comm.resize(nb_slots);
   this->_total_weight_from_comm.clear();
-  this->_total_weight_from_comm.resize(this->_n_communities);
+  this->_total_weight_from_comm.resize(nb_slots);
   this->_total_weight_to_comm.clear();
-  this->_total_weight_to_comm.resize(this->_n_communities);
+  this->_total_weight_to_comm.resize(nb_slots);
   this->_csize.clear();
-  this->_csize.resize(this->_n_communities);
+  this->_csize.resize(nb_slots);
   this->_cnodes.clear();
-  this->_cnodes.resize(this->_n_communities);
+  this->_cnodes.resize(nb_slots);
+
+  // There are never more communities than nodes, so by reserving this
+  // beforehand, adding empty communities does not need to reallocate.
+  this->_total_weight_in_comm.reserve(n_active);
+  this->_total_weight_from_comm.reserve(n_active);
+  this->_total_weight_to_comm.reserve(n_active);
+  this->_csize.reserve(n_active);
+  this->_cnodes.reserve(n_active);
+  this->_cached_weight_from_community.reserve(n_active);
+  this->_cached_weight_to_community.reserve(n_active);
+  this->_cached_weight_all_community.reserve(n_active);
+
+  this->_current_node_cache_community_from = n + 1; this->_cached_weight_from_community.resize(nb_slots, 0);
+  this->_current_node_cache_community_to = n + 1;   this->_cached_weight_to_community.resize(nb_slots, 0);
+  this->_current_node_cache_community_all = n + 1;  this->_cached_weight_all_community.resize(nb_slots, 0);
+  if (sparse)
+  {
+    // The positions of the cached communities are no longer known
+    this->_cached_weight_from_community.assign(nb_slots, 0); this->_cached_neigh_comms_from.clear();
+    this->_cached_weight_to_community.assign(nb_slots, 0);   this->_cached_neigh_comms_to.clear();
+    this->_cached_weight_all_community.assign(nb_slots, 0);  this->_cached_neigh_comms_all.clear();
+  }
 
-  this->_current_node_cache_community_from = n + 1; this->_cached_weight_from_community.resize(this->_n_communities, 0);
-  this->_current_node_cache_community_to = n + 1;   this->_cached_weight_to_community.resize(this->_n_communities, 0);
-  this->_current_node_cache_community_all = n + 1;  this->_cached_weight_all_community.resize(this->_n_communities, 0);
+  this->_community_index_valid.store(false, std::memory_order_relaxed);
 
-  this->_empty_communities.clear();
+  // Empty communities are only kept track of for a graph that is not sparse
+  this->_empty_communities_prev.clear();
+  this->_empty_communities_next.clear();
+  this->_last_empty_community = NO_COMMUNITY;
+  this->_nb_empty_communities = 0;
+  if (!sparse)
+  {
+    this->_empty_communities_prev.resize(this->_n_communities);
+    this->_empty_communities_prev.reserve(n);
+    this->_empty_communities_next.resize(this->_n_communities);
+    this->_empty_communities_next.reserve(n);
+  }
 
   this->_total_weight_in_all_comms = 0.0;
-  for (Id v = 0; v < n; v++)
+  for (Id i = 0; i < n_active; i++)
   {
-    Id v_comm = this->_membership[v];
+    Id v_comm = this->slot(this->_membership[i]);
+    Id node_size = this->graph->node_size(this->graph->vertex(i));
     // Update the community size
-    this->_csize[v_comm] += this->graph->node_size(v);
+    this->_csize[v_comm] += node_size;
     // Update the community size
     this->_cnodes[v_comm] += 1;
   }
@@ -178,8 +296,8 @@ void MutableVertexPartition::init_admin()
     Id v = endpoints.first;
     Id u = endpoints.second;
 
-    Id v_comm = this->_membership[v];
-    Id u_comm = this->_membership[u];
+    Id v_comm = this->slot(this->membership(v));
+    Id u_comm = this->slot(this->membership(u));
 
     // Get the weight of the edge
     Weight w = this->graph->edge_weight(e);
@@ -215,10 +333,11 @@ void MutableVertexPartition::init_admin()
     }
   }
 
+  this->recalculate_total_weight_from_to_all_comms();
   this->_total_possible_edges_in_all_comms = 0;
-  for (Id c = 0; c < this->_n_communities; c++)
+  for (Id c = 0; c < nb_slots; c++)
   {
-    Id n_c = this->csize(c);
+    Id n_c = this->_csize[c];
     Id possible_edges = this->graph->possible_edges(n_c);
 
     #ifdef DEBUG
@@ -230,8 +349,8 @@ void MutableVertexPartition::init_admin()
     // It is possible that some community have a zero size (if the order
     // is for example not consecutive. We add those communities to the empty
     // communities vector for consistency.
-    if (this->_cnodes[c] == 0)
-      this->_empty_communities.push_back(c);
+    if (!sparse && this->_cnodes[c] == 0)
+      this->add_to_empty_communities(c);
   }
 
   #ifdef DEBUG
@@ -240,14 +359,38 @@ void MutableVertexPartition::init_admin()
 
 }
 
+/****************************************************************************
+  Determine the number of communities from the membership. For a sparse
+  graph, the number of communities set from the membership of all vertices
+  is kept, unless the active vertices have a larger community.
+*****************************************************************************/
 void MutableVertexPartition::update_n_communities()
 {
-  this->_n_communities = 0;
-  for (Id i = 0; i < this->graph->vcount(); i++)
+  if (!this->graph->is_sparse())
+    this->_n_communities = 0;
+  for (Id i = 0; i < this->_membership.size(); i++)
     if (this->_membership[i] >= this->_n_communities)
       this->_n_communities = this->_membership[i] + 1;
 }
 
+/****************************************************************************
+  Calculate the sum over all communities of the product of their outgoing
+  and incoming weight from scratch. It is otherwise updated for each move of
+  a node and each change of an edge by subtracting the old and adding the new
+  products, which accumulates rounding errors. It is therefore recalculated
+  when the administration is initialised (for example when renumbering the
+  communities), and after as many updates as there are communities, so that
+  this takes constant time per update on average.
+*****************************************************************************/
+void MutableVertexPartition::recalculate_total_weight_from_to_all_comms()
+{
+  Weight total_weight_from_to_all_comms = 0.0;
+  for (Id s = 0; s < this->_total_weight_from_comm.size(); s++)
+    total_weight_from_to_all_comms += this->_total_weight_from_comm[s]*this->_total_weight_to_comm[s];
+  this->_total_weight_from_to_all_comms = total_weight_from_to_all_comms;
+  this->_nb_total_weight_from_to_updates = 0;
+}
+
 /****************************************************************************
  Renumber the communities so that they are numbered 0,...,q-1 where q is
  the number of communities. This also removes any empty communities, as they
@@ -281,16 +424,33 @@ vector<Id> MutableVertexPartition::renumber_communities(vector<MutableVertexPart
   // first - community
   // second - csize
   // third - number of nodes (may be aggregate nodes), to account for communities with zero weight.
+  // Partitions of sparse graphs only add the sizes of their own communities
+  vector<Id> total_csize(nb_comms, 0);
+  for (Id layer = 0; layer < nb_layers; layer++)
+  {
+    MutableVertexPartition* partition = partitions[layer];
+    if (partition->graph->is_sparse())
+    {
+      for (Id i = 0; i < partition->_comm_slot.size(); i++)
+      {
+        Id comm = partition->_comm_offset + i;
+        Id s = partition->_comm_slot[i];
+        if (s != NO_COMMUNITY && comm < nb_comms)
+          total_csize[comm] += partition->_csize[s];
+      }
+    }
+    else
+    {
+      for (Id i = 0; i < nb_comms; i++)
+        total_csize[i] += partition->csize(i);
+    }
+  }
   vector<Id*> csizes;
   for (Id i = 0; i < nb_comms; i++)
   {
-      Id csize = 0;
-      for (Id layer = 0; layer < nb_layers; layer++)
-        csize += partitions[layer]->csize(i);
-
       Id* row = new Id[3];
       row[0] = i;
-      row[1] = csize;
+      row[1] = total_csize[i];
       row[2] = partitions[0]->cnodes(i);
       csizes.push_back(row);
   }
@@ -307,8 +467,8 @@ vector<Id> MutableVertexPartition::renumber_communities(vector<MutableVertexPart
   }
 
   vector<Id> membership(n, 0);
-  for (Id i = 0; i < n; i++)
-    membership[i] = new_comm_id[partitions[0]->_membership[i]];
+  for (Id i = 0; i < partitions[0]->_membership.size(); i++)
+    membership[partitions[0]->graph->vertex(i)] = new_comm_id[partitions[0]->_membership[i]];
 
   return membership;
 }
@@ -320,19 +480,23 @@ vector<Id> MutableVertexPartition::renumber_communities(vector<MutableVertexPart
 *****************************************************************************/
 void MutableVertexPartition::renumber_communities(vector<Id> const& membership)
 {
+  // This initialises the administration, which also recalculates the
+  // incrementally updated totals from scratch.
   this->set_membership(membership);
 }
 
 Id MutableVertexPartition::get_empty_community()
 {
-  if (this->_empty_communities.empty())
+  if (this->graph->is_sparse())
+    throw LeidenException("Empty communities are not kept track of for a sparse graph.");
+  if (this->_nb_empty_communities == 0)
   {
     // If there was no empty community yet,
     // we will create a new one.
     add_empty_community();
   }
 
-  return this->_empty_communities.back();
+  return this->_last_empty_community;
 }
 
 void MutableVertexPartition::set_membership(vector<Id> const& membership)
@@ -340,13 +504,7 @@ void MutableVertexPartition::set_membership(vector<Id> const& membership)
   #ifdef DEBUG
     cerr << "void MutableVertexPartition::set_membership(" << &membership << ")" << endl;
   #endif
-  for (Id i = 0; i < this->graph->vcount(); i++)
-  {
-    this->_membership[i] = membership[i];
-    #ifdef DEBUG
-      cerr << "Setting membership[" << i << "] = " << membership[i] << "." << endl;
-    #endif
-  }
+  this->set_active_membership(membership);
 
   this->clean_mem();
   this->init_admin();
@@ -363,6 +521,9 @@ Id MutableVertexPartition::add_empty_community()
     throw LeidenException("There cannot be more communities than nodes, so there must already be an empty community.");
 
   Id new_comm = this->_n_communities - 1;
+  // The administration of a sparse graph is only kept for non-empty communities
+  if (this->graph->is_sparse())
+    return new_comm;
 
   this->_csize.resize(this->_n_communities);                  this->_csize[new_comm] = 0;
   this->_cnodes.resize(this->_n_communities);                 this->_cnodes[new_comm] = 0;
@@ -374,13 +535,119 @@ Id MutableVertexPartition::add_empty_community()
   this->_cached_weight_from_community.resize(this->_n_communities);
   this->_cached_weight_to_community.resize(this->_n_communities);
 
-  this->_empty_communities.push_back(new_comm);
+  this->_empty_communities_prev.resize(this->_n_communities);
+  this->_empty_communities_next.resize(this->_n_communities);
+  this->add_to_empty_communities(new_comm);
   #ifdef DEBUG
     cerr << "Added empty community " << new_comm << endl;
   #endif
   return new_comm;
 }
 
+/****************************************************************************
+  Keep track of an empty community. The community is added at the end, so
+  that it is the first to be returned by get_empty_community.
+*****************************************************************************/
+void MutableVertexPartition::add_to_empty_communities(Id comm)
+{
+  this->_empty_communities_prev[comm] = this->_last_empty_community;
+  this->_empty_communities_next[comm] = NO_COMMUNITY;
+  if (this->_last_empty_community != NO_COMMUNITY)
+    this->_empty_communities_next[this->_last_empty_community] = comm;
+  this->_last_empty_community = comm;
+  this->_nb_empty_communities++;
+}
+
+/****************************************************************************
+  Remove a community that is no longer empty, by unlinking it from its
+  previous and next empty community, so that the other empty communities
+  keep their order.
+*****************************************************************************/
+void MutableVertexPartition::remove_from_empty_communities(Id comm)
+{
+  #ifdef DEBUG
+    cerr << "Erasing empty community " << comm << endl;
+    if (this->_nb_empty_communities == 0)
+      cerr << "ERROR: empty community does not exist." << endl;
+  #endif
+  Id prev_comm = this->_empty_communities_prev[comm];
+  Id next_comm = this->_empty_communities_next[comm];
+  if (prev_comm != NO_COMMUNITY)
+    this->_empty_communities_next[prev_comm] = next_comm;
+  if (next_comm != NO_COMMUNITY)
+    this->_empty_communities_prev[next_comm] = prev_comm;
+  else
+    this->_last_empty_community = prev_comm;
+  this->_nb_empty_communities--;
+}
+
+/****************************************************************************
+  Create the administration of a new community of a sparse graph, reusing a
+  released position if there is one.
+*****************************************************************************/
+Id MutableVertexPartition::add_slot(Id comm)
+{
+  Id s;
+  if (!this->_free_slots.empty())
+  {
+    s = this->_free_slots.back();
+    this->_free_slots.pop_back();
+    this->_csize[s] = 0;
+    this->_cnodes[s] = 0;
+    this->_total_weight_in_comm[s] = 0;
+    this->_total_weight_from_comm[s] = 0;
+    this->_total_weight_to_comm[s] = 0;
+  }
+  else
+  {
+    s = this->_csize.size();
+    this->_csize.push_back(0);
+    this->_cnodes.push_back(0);
+    this->_total_weight_in_comm.push_back(0);
+    this->_total_weight_from_comm.push_back(0);
+    this->_total_weight_to_comm.push_back(0);
+    this->_cached_weight_from_community.push_back(0);
+    this->_cached_weight_to_community.push_back(0);
+    this->_cached_weight_all_community.push_back(0);
+  }
+  // Extend the window of the positions to comm, at the front by at least its
+  // size (if possible), so that repeated extensions take amortised constant
+  // time, as they do at the back.
+  if (this->_comm_slot.empty())
+    this->_comm_offset = comm;
+  if (comm < this->_comm_offset)
+  {
+    Id extension = std::max(this->_comm_offset - comm, std::min((Id)this->_comm_slot.size(), this->_comm_offset));
+    this->_comm_slot.insert(this->_comm_slot.begin(), extension, NO_COMMUNITY);
+    this->_comm_offset -= extension;
+  }
+  else if (comm - this->_comm_offset >= this->_comm_slot.size())
+    this->_comm_slot.resize(comm - this->_comm_offset + 1, NO_COMMUNITY);
+  this->_comm_slot[comm - this->_comm_offset] = s;
+  #ifdef DEBUG
+    cerr << "Added community " << comm << " at position " << s << endl;
+  #endif
+  return s;
+}
+
+/****************************************************************************
+  Release the administration of a community of a sparse graph that became
+  empty. The cached weights of the community are reset, so that they are
+  zero when the position is reused.
+*****************************************************************************/
+void MutableVertexPartition::remove_slot(Id comm)
+{
+  Id s = this->_comm_slot[comm - this->_comm_offset];
+  this->_cached_weight_from_community[s] = 0;
+  this->_cached_weight_to_community[s] = 0;
+  this->_cached_weight_all_community[s] = 0;
+  this->_comm_slot[comm - this->_comm_offset] = NO_COMMUNITY;
+  this->_free_slots.push_back(s);
+  #ifdef DEBUG
+    cerr << "Removed community " << comm << " at position " << s << endl;
+  #endif
+}
+
 /****************************************************************************
   Move a node to a new community and update the administration.
   Parameters:
@@ -394,6 +661,11 @@ void MutableVertexPartition::move_node(Id v,Id new_comm)
     if (new_comm >= this->n_communities())
       cerr << "ERROR: New community (" << new_comm << ") larger than total number of communities (" << this->n_communities() << ")." << endl;
   #endif
+  // A vertex that is not active in a sparse graph has no community
+  Id v_idx = this->graph->vertex_index(v);
+  if (v_idx == Graph::NO_VERTEX)
+    return;
+  bool sparse = this->graph->is_sparse();
   // Move node and update internal administration
   if (new_comm >= this->_n_communities)
   {
@@ -410,16 +682,28 @@ void MutableVertexPartition::move_node(Id v,Id new_comm)
 
   // Keep track of all possible edges in all communities;
   Id node_size = this->graph->node_size(v);
-  Id old_comm = this->_membership[v];
+  Id old_comm = this->_membership[v_idx];
+  // Positions of the administration of the old and new community, where
+  // the new community of a sparse graph may not have one yet.
+  Id old_slot = this->slot(old_comm);
+  Id new_slot = this->slot(new_comm);
+  if (new_slot == NO_COMMUNITY)
+    new_slot = this->add_slot(new_comm);
   #ifdef DEBUG
     cerr << "Node size: " << node_size << ", old comm: " << old_comm << ", new comm: " << new_comm << endl;
   #endif
+  // The products of the outgoing and incoming weights of the old and new
+  // community are replaced after moving the links below.
+  if (new_comm != old_comm)
+    this->_total_weight_from_to_all_comms -= this->_total_weight_from_comm[old_slot]*this->_total_weight_to_comm[old_slot]
+                                           + this->_total_weight_from_comm[new_slot]*this->_total_weight_to_comm[new_slot];
   // Incidentally, this is independent of whether we take into account self-loops or not
   // (i.e. whether we count as n_c^2 or as n_c(n_c - 1). Be careful to do this before the
   // adaptation of the community sizes, otherwise the calculations are incorrect.
   if (new_comm != old_comm)
   {
-    Weight delta_possible_edges_in_comms = 2.0*node_size*(ptrdiff_t)(this->_csize[new_comm] - this->_csize[old_comm] + node_size)/(2.0 - this->graph->is_directed());
+    this->_community_index_valid.store(false, std::memory_order_relaxed);
+    Weight delta_possible_edges_in_comms = 2.0*node_size*(ptrdiff_t)(this->_csize[new_slot] - this->_csize[old_slot] + node_size)/(2.0 - this->graph->is_directed());
     _total_possible_edges_in_all_comms += delta_possible_edges_in_comms;
     #ifdef DEBUG
       cerr << "Change in possible edges in all comms: " << delta_possible_edges_in_comms << endl;
@@ -428,10 +712,10 @@ void MutableVertexPartition::move_node(Id v,Id new_comm)
 
   // Remove from old community
   #ifdef DEBUG
-    cerr << "Removing from old community " << old_comm << ", community size: " << this->_csize[old_comm] << endl;
+    cerr << "Removing from old community " << old_comm << ", community size: " << this->_csize[old_slot] << endl;
   #endif
-  this->_cnodes[old_comm] -= 1;
-  this->_csize[old_comm] -= node_size;
+  this->_cnodes[old_slot] -= 1;
+  this->_csize[old_slot] -= node_size;
   #ifdef DEBUG
     cerr << "Removed from old community." << endl;
   #endif
@@ -439,45 +723,31 @@ void MutableVertexPartition::move_node(Id v,Id new_comm)
   // We have to use the size of the set of nodes rather than the csize
   // to account for nodes that have a zero size (i.e. community may not be empty, but
   // may have zero size).
-  if (this->_cnodes[old_comm] == 0)
+  if (!sparse && this->_cnodes[old_slot] == 0)
   {
     #ifdef DEBUG
       cerr << "Adding community " << old_comm << " to empty communities." << endl;
     #endif
-    this->_empty_communities.push_back(old_comm);
+    this->add_to_empty_communities(old_comm);
     #ifdef DEBUG
       cerr << "Added community " << old_comm << " to empty communities." << endl;
     #endif
   }
 
-  if (this->_cnodes[new_comm] == 0)
+  if (!sparse && this->_cnodes[new_slot] == 0)
   {
     #ifdef DEBUG
-      cerr << "Removing from empty communities (number of empty communities is " << this->_empty_communities.size() << ")." << endl;
-    #endif
-    vector<Id>::reverse_iterator it_comm = this->_empty_communities.rbegin();
-    while (it_comm != this->_empty_communities.rend() && *it_comm != new_comm)
-    {
-      #ifdef DEBUG
-        cerr << "Empty community " << *it_comm << " != new community " << new_comm << endl;
-      #endif
-      it_comm++;
-    }
-    #ifdef DEBUG
-      cerr << "Erasing empty community " << *it_comm << endl;
-      if (it_comm == this->_empty_communities.rend())
-        cerr << "ERROR: empty community does not exist." << endl;
+      cerr << "Removing from empty communities (number of empty communities is " << this->_nb_empty_communities << ")." << endl;
     #endif
-    if (it_comm != this->_empty_communities.rend())
-      this->_empty_communities.erase( (++it_comm).base() );
+    this->remove_from_empty_communities(new_comm);
   }
 
   #ifdef DEBUG
-    cerr << "Adding to new community " << new_comm << ", community size: " << this->_csize[new_comm] << endl;
+    cerr << "Adding to new community " << new_comm << ", community size: " << this->_csize[new_slot] << endl;
   #endif
   // Add to new community
-  this->_cnodes[new_comm] += 1;
-  this->_csize[new_comm] += this->graph->node_size(v);
+  this->_cnodes[new_slot] += 1;
+  this->_csize[new_slot] += this->graph->node_size(v);
 
   // Switch outgoing links
   #ifdef DEBUG
@@ -510,15 +780,15 @@ void MutableVertexPartition::move_node(Id v,Id new_comm)
       Id u = neighbours[idx];
       Id e = neighbour_edges[idx];
 
-      Id u_comm = this->_membership[u];
+      Id u_comm = this->membership(u);
       // Get the weight of the edge
       Weight w = this->graph->edge_weight(e);
       if (mode == IGRAPH_OUT)
       {
         // Remove the weight from the outgoing weights of the old community
-        this->_total_weight_from_comm[old_comm] -= w;
+        this->_total_weight_from_comm[old_slot] -= w;
         // Add the weight to the outgoing weights of the new community
-        this->_total_weight_from_comm[new_comm] += w;
+        this->_total_weight_from_comm[new_slot] += w;
         #ifdef DEBUG
           cerr << "\t" << "Moving link (" << v << "-" << u << ") "
                << "outgoing weight " << w
@@ -529,9 +799,9 @@ void MutableVertexPartition::move_node(Id v,Id new_comm)
       else if (mode == IGRAPH_IN)
       {
         // Remove the weight from the outgoing weights of the old community
-        this->_total_weight_to_comm[old_comm] -= w;
+        this->_total_weight_to_comm[old_slot] -= w;
         // Add the weight to the outgoing weights of the new community
-        this->_total_weight_to_comm[new_comm] += w;
+        this->_total_weight_to_comm[new_slot] += w;
         #ifdef DEBUG
           cerr << "\t" << "Moving link (" << v << "-" << u << ") "
                << "incoming weight " << w
@@ -547,7 +817,7 @@ void MutableVertexPartition::move_node(Id v,Id new_comm)
       if (old_comm == u_comm)
       {
         // Remove the internal weight
-        this->_total_weight_in_comm[old_comm] -= int_weight;
+        this->_total_weight_in_comm[old_slot] -= int_weight;
         this->_total_weight_in_all_comms -= int_weight;
         #ifdef DEBUG
           cerr << "\t" << "From link (" << v << "-" << u << ") "
@@ -560,7 +830,7 @@ void MutableVertexPartition::move_node(Id v,Id new_comm)
       if ((new_comm == u_comm) || (u == v))
       {
         // Add the internal weight
-        this->_total_weight_in_comm[new_comm] += int_weight;
+        this->_total_weight_in_comm[new_slot] += int_weight;
         this->_total_weight_in_all_comms += int_weight;
         #ifdef DEBUG
           cerr << "\t" << "From link (" << v << "-" << u << ") "
@@ -578,13 +848,70 @@ void MutableVertexPartition::move_node(Id v,Id new_comm)
     cerr << "Internal _total_weight_in_all_comms=" << this->_total_weight_in_all_comms
          << ", calculated check_total_weight_in_all_comms=" << check_total_weight_in_all_comms << endl;
   #endif
+  if (new_comm != old_comm)
+  {
+    this->_total_weight_from_to_all_comms += this->_total_weight_from_comm[old_slot]*this->_total_weight_to_comm[old_slot]
+                                           + this->_total_weight_from_comm[new_slot]*this->_total_weight_to_comm[new_slot];
+    this->count_total_weight_from_to_update();
+  }
   // Update the membership vector
-  this->_membership[v] = new_comm;
+  this->_membership[v_idx] = new_comm;
+  if (sparse && this->_cnodes[old_slot] == 0)
+    this->remove_slot(old_comm);
   #ifdef DEBUG
     cerr << "exit MutableVertexPartition::move_node(" << v << ", " << new_comm << ")" << endl << endl;
   #endif
 }
 
+/****************************************************************************
+  Update the administration for a change in the weight of an edge of the
+  graph, which is called by the graph for all its partitions whenever edges
+  are added, removed or reweighted.
+  Parameters:
+    v, u     -- Endpoints of the edge (from v to u for directed graphs).
+    w        -- Change in the weight of the edge, i.e. its weight for an
+                added edge, and minus its weight for a removed edge.
+*****************************************************************************/
+void MutableVertexPartition::update_edge_weight(Id v, Id u, Weight w)
+{
+  Id v_comm = this->_membership[v];
+  Id u_comm = this->_membership[u];
+
+  this->_total_weight_from_to_all_comms -= this->_total_weight_from_comm[v_comm]*this->_total_weight_to_comm[v_comm];
+  if (u_comm != v_comm)
+    this->_total_weight_from_to_all_comms -= this->_total_weight_from_comm[u_comm]*this->_total_weight_to_comm[u_comm];
+  this->_total_weight_from_comm[v_comm] += w;
+  this->_total_weight_to_comm[u_comm] += w;
+  if (!this->graph->is_directed())
+  {
+    this->_total_weight_from_comm[u_comm] += w;
+    this->_total_weight_to_comm[v_comm] += w;
+  }
+  this->_total_weight_from_to_all_comms += this->_total_weight_from_comm[v_comm]*this->_total_weight_to_comm[v_comm];
+  if (u_comm != v_comm)
+    this->_total_weight_from_to_all_comms += this->_total_weight_from_comm[u_comm]*this->_total_weight_to_comm[u_comm];
+  this->count_total_weight_from_to_update();
+  if (v_comm == u_comm)
+  {
+    this->_total_weight_in_comm[v_comm] += w;
+    this->_total_weight_in_all_comms += w;
+  }
+
+  // The cached weights to the neighbouring communities may have changed
+  Id n = this->graph->vcount();
+  this->_current_node_cache_community_from = n + 1;
+  this->_current_node_cache_community_to = n + 1;
+  this->_current_node_cache_community_all = n + 1;
+}
+
+/****************************************************************************
+  Change the edges of the graph, after which the graph updates the community
+  weights of all its partitions (including this one) by update_edge_weight.
+*****************************************************************************/
+vector<Id> MutableVertexPartition::change_edges(EdgeDelta const& delta)
+{
+  return const_cast<Graph*>(this->graph)->change_edges(delta);
+}
 
 /****************************************************************************
  Read new communities from coarser partition assuming that the community
@@ -593,17 +920,36 @@ void MutableVertexPartition::move_node(Id v,Id new_comm)
 ****************************************************************************/
 void MutableVertexPartition::from_coarse_partition(vector<Id> const& coarse_partition_membership)
 {
-  this->from_coarse_partition(coarse_partition_membership, this->_membership);
+  // The community of each active vertex is its node in the coarser partition
+  for (Id i = 0; i < this->_membership.size(); i++)
+    this->_membership[i] = coarse_partition_membership[this->_membership[i]];
+  if (this->graph->is_sparse())
+    this->_n_communities = max_community(coarse_partition_membership);
+
+  this->clean_mem();
+  this->init_admin();
 }
 
 void MutableVertexPartition::from_coarse_partition(MutableVertexPartition* coarse_partition)
 {
-  this->from_coarse_partition(coarse_partition, this->_membership);
+  for (Id i = 0; i < this->_membership.size(); i++)
+    this->_membership[i] = coarse_partition->membership(this->_membership[i]);
+  if (this->graph->is_sparse())
+    this->_n_communities = coarse_partition->n_communities();
+
+  this->clean_mem();
+  this->init_admin();
 }
 
 void MutableVertexPartition::from_coarse_partition(MutableVertexPartition* coarse_partition, vector<Id> const& coarse_node)
 {
-  this->from_coarse_partition(coarse_partition->membership(), coarse_node);
+  for (Id i = 0; i < this->_membership.size(); i++)
+    this->_membership[i] = coarse_partition->membership(coarse_node[this->graph->vertex(i)]);
+  if (this->graph->is_sparse())
+    this->_n_communities = coarse_partition->n_communities();
+
+  this->clean_mem();
+  this->init_admin();
 }
 
 /****************************************************************************
@@ -615,18 +961,20 @@ void MutableVertexPartition::from_coarse_partition(MutableVertexPartition* coars
 void MutableVertexPartition::from_coarse_partition(vector<Id> const& coarse_partition_membership, vector<Id> const& coarse_node)
 {
   // Read the coarser partition
-  for (Id v = 0; v < this->graph->vcount(); v++)
+  for (Id i = 0; i < this->_membership.size(); i++)
   {
     // In the coarser partition, the node should have the community id
     // as represented by the coarser_membership vector
-    Id v_level2 = coarse_node[v];
+    Id v_level2 = coarse_node[this->graph->vertex(i)];
 
     // In the coarser partition, this node is represented by v_level2
     Id v_comm_level2 = coarse_partition_membership[v_level2];
 
     // Set local membership to community found for node at second level
-    this->_membership[v] = v_comm_level2;
+    this->_membership[i] = v_comm_level2;
   }
+  if (this->graph->is_sparse())
+    this->_n_communities = max_community(coarse_partition_membership);
 
   this->clean_mem();
   this->init_admin();
@@ -640,118 +988,144 @@ void MutableVertexPartition::from_partition(MutableVertexPartition* partition)
 {
   // Assign the membership of every node in the supplied partition
   // to the one in this partition
-  for (Id v = 0; v < this->graph->vcount(); v++)
-    this->_membership[v] = partition->membership(v);
+  for (Id i = 0; i < this->_membership.size(); i++)
+    this->_membership[i] = partition->membership(this->graph->vertex(i));
+  if (this->graph->is_sparse())
+    this->_n_communities = partition->n_communities();
   this->clean_mem();
   this->init_admin();
 }
 
 /****************************************************************************
- Calculate what is the total weight going from a node to a community.
+ Calculate the difference in quality of moving a node to each of the
+ candidate communities, see diff_move. Derived classes may override this to
+ calculate the terms that only depend on the node once for all candidates.
 
     Parameters:
-      v      -- The node which to check.
-      comm   -- The community which to check.
+      v          -- The node which to move.
+      candidates -- The communities to which to move the node.
+      gains      -- The resulting differences, one for each candidate.
+*****************************************************************************/
+void MutableVertexPartition::diff_move_all(Id v, vector<Id> const& candidates, vector<Weight>& gains)
+{
+  Id nb_candidates = candidates.size();
+  gains.resize(nb_candidates);
+  for (Id i = 0; i < nb_candidates; i++)
+    gains[i] = this->diff_move(v, candidates[i]);
+}
+
+/****************************************************************************
+  Add the weights of the edges of v in the given direction to the cached
+  weights of the neighbouring communities, adding each community to the
+  cached neighbour communities once, when its weight first becomes non-zero.
+  Only in the rare case that negative weights cancel exactly, a community may
+  be added more than once.
 *****************************************************************************/
-Weight MutableVertexPartition::weight_to_comm(Id v, Id comm) const noexcept
+void MutableVertexPartition::add_weight_neigh_communities(Id v, igraph_neimode_t mode,
+  vector<Weight>& weights, vector<Id>& neigh_comms, vector<Weight>* weights_all, vector<Id>* neigh_comms_all) const
 {
-  if (this->_current_node_cache_community_to != v)
+  const Graph* graph = this->graph;
+  vector<Id> const& neighbours = graph->get_neighbours(v, mode);
+  vector<Id> const& neighbour_edges = graph->get_neighbour_edges(v, mode);
+  Id degree = neighbours.size();
+  for (Id idx = 0; idx < degree; idx++)
   {
-    this->cache_neigh_communities(v, IGRAPH_OUT);
-    this->_current_node_cache_community_to = v;
+    Id u = neighbours[idx];
+    Id comm = this->membership(u);
+    Id s = this->slot(comm);
+    // Get the weight of the edge
+    Weight w = graph->edge_weight(neighbour_edges[idx]);
+    // Self loops appear twice here if the graph is undirected, so divide by 2.0 in that case.
+    if (u == v && !graph->is_directed())
+        w /= 2.0;
+    #ifdef DEBUG
+      cerr << "\t" << "Edge (" << v << "-" << u << "), Comm (" << this->membership(v) << "-" << comm << ") weight: " << w << "." << endl;
+    #endif
+    if (weights[s] == 0)
+    {
+      weights[s] = w;
+      if (w != 0)
+        neigh_comms.push_back(comm);
+    }
+    else
+      weights[s] += w;
+    if (weights_all != nullptr)
+    {
+      if ((*weights_all)[s] == 0)
+      {
+        (*weights_all)[s] = w;
+        if (w != 0)
+          neigh_comms_all->push_back(comm);
+      }
+      else
+        (*weights_all)[s] += w;
+    }
   }
-
-  if (comm < this->_cached_weight_to_community.size())
-    return this->_cached_weight_to_community[comm];
-  else
-    return 0;
 }
 
 /****************************************************************************
- Calculate what is the total weight going from a community to a node.
-
-    Parameters:
-      v      -- The node which to check.
-      comm   -- The community which to check.
+  Reset the cached weights of the communities of the previously cached node,
+  rather than of all communities, so that caching takes time proportional to
+  the degree of the node instead of the number of communities. Communities
+  beyond the current number of communities, or whose administration was
+  removed from a sparse graph, were already removed.
 *****************************************************************************/
-Weight MutableVertexPartition::weight_from_comm(Id v, Id comm) const noexcept
+void MutableVertexPartition::reset_neigh_communities(vector<Weight>& weights, vector<Id>& neigh_comms) const
 {
-  if (this->_current_node_cache_community_from != v)
+  for (Id comm : neigh_comms)
   {
-    this->cache_neigh_communities(v, IGRAPH_IN);
-    this->_current_node_cache_community_from = v;
+    Id s = this->slot(comm);
+    if (s < weights.size())
+      weights[s] = 0;
   }
-
-  if (comm < this->_cached_weight_from_community.size())
-    return this->_cached_weight_from_community[comm];
-  else
-    return 0;
+  neigh_comms.clear();
 }
 
 void MutableVertexPartition::cache_neigh_communities(Id v, igraph_neimode_t mode) const noexcept
 {
-  // TODO: We can probably calculate at once the IN, OUT and ALL
-  // rather than this being called multiple times.
-
   // Weight between vertex and community
   #ifdef DEBUG
     cerr << "Weight MutableVertexPartition::cache_neigh_communities(" << v << ", " << mode << ")." << endl;
   #endif
-  vector<Weight>* _cached_weight_tofrom_community = nullptr;
-  vector<Id>* _cached_neighs = nullptr;
-  switch (mode)
+  if (!this->graph->is_directed())
+    mode = IGRAPH_ALL;
+
+  if (mode == IGRAPH_ALL)
   {
-    case IGRAPH_IN:
-      _cached_weight_tofrom_community = &(this->_cached_weight_from_community);
-      _cached_neighs = &(this->_cached_neigh_comms_from);
-      break;
-    case IGRAPH_OUT:
-      _cached_weight_tofrom_community = &(this->_cached_weight_to_community);
-      _cached_neighs = &(this->_cached_neigh_comms_to);
-      break;
-    case IGRAPH_ALL:
-      _cached_weight_tofrom_community = &(this->_cached_weight_all_community);
-      _cached_neighs = &(this->_cached_neigh_comms_all);
-      break;
+    this->reset_neigh_communities(this->_cached_weight_all_community, this->_cached_neigh_comms_all);
+    if (this->graph->is_directed())
+    {
+      // The incoming and outgoing edges together are all edges, so that all
+      // three caches are filled at once.
+      this->reset_neigh_communities(this->_cached_weight_to_community, this->_cached_neigh_comms_to);
+      this->reset_neigh_communities(this->_cached_weight_from_community, this->_cached_neigh_comms_from);
+      this->add_weight_neigh_communities(v, IGRAPH_OUT,
+        this->_cached_weight_to_community, this->_cached_neigh_comms_to,
+        &this->_cached_weight_all_community, &this->_cached_neigh_comms_all);
+      this->add_weight_neigh_communities(v, IGRAPH_IN,
+        this->_cached_weight_from_community, this->_cached_neigh_comms_from,
+        &this->_cached_weight_all_community, &this->_cached_neigh_comms_all);
+      this->_current_node_cache_community_to = v;
+      this->_current_node_cache_community_from = v;
+    }
+    else
+      this->add_weight_neigh_communities(v, IGRAPH_ALL,
+        this->_cached_weight_all_community, this->_cached_neigh_comms_all, nullptr, nullptr);
+    this->_current_node_cache_community_all = v;
   }
-
-  // Reset cached communities
-  std::fill(_cached_weight_tofrom_community->begin(), _cached_weight_tofrom_community->end(), 0);
-
-  // Loop over all incident edges
-  vector<Id> const& neighbours = this->graph->get_neighbours(v, mode);
-  vector<Id> const& neighbour_edges = this->graph->get_neighbour_edges(v, mode);
-
-  Id degree = neighbours.size();
-
-  // Reset cached neighbours
-  _cached_neighs->clear();
-  _cached_neighs->reserve(degree);
-  for (Id idx = 0; idx < degree; idx++)
+  else if (mode == IGRAPH_OUT)
   {
-    Id u = neighbours[idx];
-    Id e = neighbour_edges[idx];
-
-    // If it is an edge to the requested community
-    #ifdef DEBUG
-      Id u_comm = this->_membership[u];
-    #endif
-    Id comm = this->_membership[u];
-    // Get the weight of the edge
-    Weight w = this->graph->edge_weight(e);
-    // Self loops appear twice here if the graph is undirected, so divide by 2.0 in that case.
-    if (u == v && !this->graph->is_directed())
-        w /= 2.0;
-    #ifdef DEBUG
-      cerr << "\t" << "Edge (" << v << "-" << u << "), Comm (" << comm << "-" << u_comm << ") weight: " << w << "." << endl;
-    #endif
-    (*_cached_weight_tofrom_community)[comm] += w;
-    // REMARK: Notice in the rare case of negative weights, being exactly equal
-    // for a certain community, that this community may then potentially be added multiple
-    // times to the _cached_neighs. However, I don' believe this causes any further issue,
-    // so that's why I leave this here as is.
-    if ((*_cached_weight_tofrom_community)[comm] != 0)
-      _cached_neighs->push_back(comm);
+    this->reset_neigh_communities(this->_cached_weight_to_community, this->_cached_neigh_comms_to);
+    this->add_weight_neigh_communities(v, IGRAPH_OUT,
+      this->_cached_weight_to_community, this->_cached_neigh_comms_to, nullptr, nullptr);
+    this->_current_node_cache_community_to = v;
+  }
+  else
+  {
+    this->reset_neigh_communities(this->_cached_weight_from_community, this->_cached_neigh_comms_from);
+    this->add_weight_neigh_communities(v, IGRAPH_IN,
+      this->_cached_weight_from_community, this->_cached_neigh_comms_from, nullptr, nullptr);
+    this->_current_node_cache_community_from = v;
   }
   #ifdef DEBUG
     cerr << "exit Graph::cache_neigh_communities(" << v << ", " << mode << ")." << endl;
@@ -763,26 +1137,12 @@ vector<Id> const& MutableVertexPartition::get_neigh_comms(Id v, igraph_neimode_t
   switch (mode)
   {
     case IGRAPH_IN:
-      if (this->_current_node_cache_community_from != v)
-      {
-        cache_neigh_communities(v, mode);
-        this->_current_node_cache_community_from = v;
-      }
-      return this->_cached_neigh_comms_from;
     case IGRAPH_OUT:
-      if (this->_current_node_cache_community_to != v)
-      {
-        cache_neigh_communities(v, mode);
-        this->_current_node_cache_community_to = v;
-      }
-      return this->_cached_neigh_comms_to;
     case IGRAPH_ALL:
-      if (this->_current_node_cache_community_all != v)
-      {
-        cache_neigh_communities(v, mode);
-        this->_current_node_cache_community_all = v;
-      }
-      return this->_cached_neigh_comms_all;
+      this->cached_weight_communities(v, mode);
+      if (mode == IGRAPH_ALL || !this->graph->is_directed())
+        return this->_cached_neigh_comms_all;
+      return mode == IGRAPH_OUT ? this->_cached_neigh_comms_to : this->_cached_neigh_comms_from;
   }
   throw LeidenException("Problem obtaining neighbour communities, invalid mode.");
 }
@@ -800,3 +1160,345 @@ set<Id> MutableVertexPartition::get_neigh_comms(Id v, igraph_neimode_t mode, vec
   }
   return neigh_comms;
 }
+
+/****************************************************************************
+  The communities of membership, numbered below the number of communities
+  nb_comms. Communities below the number of nodes, as for the membership of
+  a partition, are kept as they are (so that some of them may be empty), and
+  membership itself is returned. Otherwise, the communities are renumbered
+  consecutively in renumbered, in order of their first node, through a hash
+  table.
+*****************************************************************************/
+static vector<Id> const& community_numbers(vector<Id> const& membership, vector<Id>& renumbered, Id& nb_comms)
+{
+  const Id n = membership.size();
+  nb_comms = max_community(membership);
+  if (nb_comms <= n)
+    return membership;
+
+  renumbered.resize(n);
+  nb_comms = 0;
+  std::unordered_map<Id, Id> new_comm;
+  for (Id v = 0; v < n; v++)
+  {
+    auto it = new_comm.emplace(membership[v], nb_comms);
+    if (it.second)
+      nb_comms++;
+    renumbered[v] = it.first->second;
+  }
+  return renumbered;
+}
+
+/****************************************************************************
+  Run task(i, thread) for i = 0, ..., nb_tasks - 1 on (at most) nb_threads
+  threads, each taking the next task in turn. No tasks are started after a
+  task throws, and its exception is rethrown once all threads are done.
+*****************************************************************************/
+template <class Task> static void run_tasks(Id nb_tasks, Id nb_threads, Task const& task)
+{
+  if (nb_threads > nb_tasks)
+    nb_threads = nb_tasks;
+
+  Id next_task = 0;
+  std::exception_ptr error;
+  std::mutex mutex;
+
+  auto worker = [&](Id thread)
+  {
+    try
+    {
+      while (true)
+      {
+        Id i;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (error || next_task == nb_tasks)
+            break;
+          i = next_task++;
+        }
+        task(i, thread);
+      }
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error)
+        error = std::current_exception();
+    }
+  };
+
+  vector<std::thread> threads;
+  for (Id thread = 1; thread < nb_threads; thread++)
+    threads.push_back(std::thread(worker, thread));
+  worker(0);
+  for (std::thread& thread : threads)
+    thread.join();
+  if (error)
+    std::rethrow_exception(error);
+}
+
+// Number of consecutive (sorted) nodes of which the contingency table is
+// counted at once by compare_memberships
+static const Id CONTINGENCY_CHUNK_SIZE = 1 << 14;
+
+/****************************************************************************
+  Compare two memberships of the same nodes, using their contingency table
+  n_ij, the number of nodes in community i of membership1 and community j of
+  membership2, with row sums a_i and column sums b_j.
+
+  The nodes are sorted on their community in membership1 (by counting sort),
+  so that the rows of the contingency table are counted one at a time, in a
+  vector over the communities of membership2 of which only the non-zero
+  entries are visited and reset, as for the neighbour communities of a node.
+  Hence, the full contingency table is never stored.
+
+  All steps are split over nb_threads threads (all cores if 0) by ranges of
+  nodes, rather than by communities, so that even memberships with a few
+  large communities are compared in parallel:
+    - The counting sort counts the community sizes of each range of nodes,
+      and merges these partial counts into the positions of the nodes of
+      each range. The number of ranges is limited, so that their counts take
+      no more memory than the sorted nodes.
+    - The contingency table is counted over chunks of CONTINGENCY_CHUNK_SIZE
+      sorted nodes. The terms of a row within a chunk are computed directly,
+      while the partial counts of a row that is split over several chunks
+      are merged once all chunks are counted.
+  The chunks do not depend on the number of threads, and the terms are
+  summed in order afterwards, so that neither does the result.
+
+  The mutual information is I = sum_ij n_ij/n log(n n_ij / (a_i b_j)), and
+  the entropy is H(A) = -sum_i a_i/n log(a_i/n) for membership1, and
+  likewise for membership2. The normalised mutual information is
+  2 I / (H(A) + H(B)), which is 1 if both entropies are zero, and the
+  variation of information is H(A) + H(B) - 2 I. The adjusted Rand index
+  compares the number of pairs of nodes in the same community in both
+  memberships, sum_ij C(n_ij, 2), to its expected value for random
+  memberships with the same community sizes; it is 1 if this index can only
+  take one value, e.g. if both memberships have one community.
+
+  Parameters:
+    membership1 -- The first membership.
+    membership2 -- The second membership, of the same nodes.
+    nb_threads  -- The number of threads.
+*****************************************************************************/
+MembershipComparison compare_memberships(vector<Id> const& membership1, vector<Id> const& membership2)
+{
+  return compare_memberships(membership1, membership2, 0);
+}
+
+MembershipComparison compare_memberships(vector<Id> const& membership1, vector<Id> const& membership2, Id nb_threads)
+{
+  #ifdef DEBUG
+    cerr << "MembershipComparison compare_memberships(" << membership1.size() << " nodes)" << endl;
+  #endif
+  const Id n = membership1.size();
+  if (membership2.size() != n)
+    throw LeidenException("Memberships should be of the same length.");
+
+  MembershipComparison comparison;
+  comparison.nmi = 1.0;
+  comparison.ari = 1.0;
+  comparison.vi = 0.0;
+  if (n == 0)
+    return comparison;
+  if (nb_threads == 0)
+    nb_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  vector<Id> renumbered1, renumbered2;
+  Id nb_comms1, nb_comms2;
+  vector<Id> const& comm1 = community_numbers(membership1, renumbered1, nb_comms1);
+  vector<Id> const& comm2 = community_numbers(membership2, renumbered2, nb_comms2);
+
+  // Community sizes of each range of nodes, after which range_next1[r][c]
+  // is the next position of the nodes of community c of range r
+  const Id nb_ranges = std::max<Id>(std::min(nb_threads, n/(nb_comms1 + nb_comms2)), 1);
+  const Id range_size = (n + nb_ranges - 1)/nb_ranges;
+  vector< vector<Id> > range_next1(nb_ranges), range_size2(nb_ranges);
+  run_tasks(nb_ranges, nb_threads, [&](Id r, Id thread)
+  {
+    range_next1[r].assign(nb_comms1, 0);
+    range_size2[r].assign(nb_comms2, 0);
+    const Id end = std::min((r + 1)*range_size, n);
+    for (Id v = r*range_size; v < end; v++)
+    {
+      range_next1[r][comm1[v]]++;
+      range_size2[r][comm2[v]]++;
+    }
+  });
+
+  // The communities in membership2 of the nodes of community c of
+  // membership1 are comm2_by_comm1[start[c]], ..., comm2_by_comm1[start[c + 1] - 1],
+  // in order of the nodes
+  vector<Id> size1(nb_comms1), size2(nb_comms2, 0);
+  vector<Id> start(nb_comms1 + 1);
+  Id position = 0;
+  for (Id c = 0; c < nb_comms1; c++)
+  {
+    start[c] = position;
+    for (Id r = 0; r < nb_ranges; r++)
+    {
+      Id count = range_next1[r][c];
+      range_next1[r][c] = position;
+      position += count;
+    }
+    size1[c] = position - start[c];
+  }
+  start[nb_comms1] = position;
+  for (Id r = 0; r < nb_ranges; r++)
+  {
+    for (Id c = 0; c < nb_comms2; c++)
+      size2[c] += range_size2[r][c];
+    vector<Id>().swap(range_size2[r]);
+  }
+
+  vector<Id> comm2_by_comm1(n);
+  run_tasks(nb_ranges, nb_threads, [&](Id r, Id thread)
+  {
+    vector<Id>& next = range_next1[r];
+    const Id end = std::min((r + 1)*range_size, n);
+    for (Id v = r*range_size; v < end; v++)
+      comm2_by_comm1[next[comm1[v]]++] = comm2[v];
+    vector<Id>().swap(next);
+  });
+  vector<Id>().swap(renumbered1);
+  vector<Id>().swap(renumbered2);
+
+  const Weight log_n = log((Weight)n);
+  vector<Weight> log_size2(nb_comms2);
+  for (Id c = 0; c < nb_comms2; c++)
+    log_size2[c] = size2[c] > 0 ? log((Weight)size2[c]) : 0.0;
+
+  // Terms of the mutual information and number of pairs per row
+  vector<Weight> row_information(nb_comms1, 0.0);
+  vector<Id> row_pairs(nb_comms1, 0);
+
+  // Compute the terms of row c1 from its counts nb_nodes[c2] for the
+  // communities c2 in comms, and reset these counts
+  auto row_terms = [&](Id c1, vector<Id>& nb_nodes, vector<Id>& comms)
+  {
+    const Weight log_size1 = log((Weight)size1[c1]);
+    Weight information = 0.0;
+    Id pairs = 0;
+    for (Id c2 : comms)
+    {
+      Id n_ij = nb_nodes[c2];
+      information += n_ij*(log((Weight)n_ij) + log_n - log_size1 - log_size2[c2]);
+      pairs += n_ij*(n_ij - 1)/2;
+      nb_nodes[c2] = 0;
+    }
+    comms.clear();
+    row_information[c1] = information;
+    row_pairs[c1] = pairs;
+  };
+
+  // Partial counts (community in membership2 and its number of nodes) of
+  // the rows that are split over chunks. Position 2k is for the first row of
+  // chunk k if it starts before the chunk, and position 2k + 1 for its last
+  // row if it ends after the chunk (and does not start before it).
+  const Id nb_chunks = (n + CONTINGENCY_CHUNK_SIZE - 1)/CONTINGENCY_CHUNK_SIZE;
+  vector<Id> split_row(2*nb_chunks, nb_comms1);
+  vector< vector< pair<Id, Id> > > split_counts(2*nb_chunks);
+
+  // Row of the contingency table and its non-zero entries per thread
+  vector< vector<Id> > thread_nb_nodes(nb_threads), thread_comms(nb_threads);
+  run_tasks(nb_chunks, nb_threads, [&](Id k, Id thread)
+  {
+    vector<Id>& nb_nodes = thread_nb_nodes[thread];
+    vector<Id>& comms = thread_comms[thread];
+    if (nb_nodes.empty())
+      nb_nodes.assign(nb_comms2, 0);
+
+    const Id chunk_start = k*CONTINGENCY_CHUNK_SIZE;
+    const Id chunk_end = std::min(chunk_start + CONTINGENCY_CHUNK_SIZE, n);
+    // The last community starting at or before the chunk, which is the
+    // (non-empty) community of its first node
+    Id c1 = std::upper_bound(start.begin(), start.end(), chunk_start) - start.begin() - 1;
+    for (; c1 < nb_comms1 && start[c1] < chunk_end; c1++)
+    {
+      const Id row_start = std::max(start[c1], chunk_start);
+      const Id row_end = std::min(start[c1 + 1], chunk_end);
+      for (Id i = row_start; i < row_end; i++)
+      {
+        Id c2 = comm2_by_comm1[i];
+        if (nb_nodes[c2]++ == 0)
+          comms.push_back(c2);
+      }
+      if (start[c1] >= chunk_start && start[c1 + 1] <= chunk_end)
+        row_terms(c1, nb_nodes, comms);
+      else if (!comms.empty())
+      {
+        Id split = 2*k + (start[c1] < chunk_start ? 0 : 1);
+        split_row[split] = c1;
+        for (Id c2 : comms)
+        {
+          split_counts[split].push_back(make_pair(c2, nb_nodes[c2]));
+          nb_nodes[c2] = 0;
+        }
+        comms.clear();
+      }
+    }
+  });
+  vector< vector<Id> >().swap(thread_nb_nodes);
+  vector< vector<Id> >().swap(thread_comms);
+
+  // The partial counts of a split row are at consecutive positions, which
+  // are merged in order of the chunks, so that the communities of the row
+  // are in the same order as if it was not split.
+  {
+    vector<Id> nb_nodes(nb_comms2, 0);
+    vector<Id> comms;
+    for (Id split = 0; split < 2*nb_chunks; split++)
+    {
+      if (split_row[split] == nb_comms1)
+        continue;
+      for (pair<Id, Id> const& count : split_counts[split])
+      {
+        if (nb_nodes[count.first] == 0)
+          comms.push_back(count.first);
+        nb_nodes[count.first] += count.second;
+      }
+      vector< pair<Id, Id> >().swap(split_counts[split]);
+      Id next = split + 1;
+      while (next < 2*nb_chunks && split_row[next] == nb_comms1)
+        next++;
+      if (next == 2*nb_chunks || split_row[next] != split_row[split])
+        row_terms(split_row[split], nb_nodes, comms);
+    }
+  }
+
+  Weight information = 0.0, entropy1 = 0.0, entropy2 = 0.0;
+  Id pairs = 0, pairs1 = 0, pairs2 = 0;
+  for (Id c = 0; c < nb_comms1; c++)
+  {
+    if (size1[c] == 0)
+      continue;
+    information += row_information[c];
+    pairs += row_pairs[c];
+    entropy1 += size1[c]*log((Weight)size1[c]);
+    pairs1 += size1[c]*(size1[c] - 1)/2;
+  }
+  for (Id c = 0; c < nb_comms2; c++)
+  {
+    if (size2[c] == 0)
+      continue;
+    entropy2 += size2[c]*log_size2[c];
+    pairs2 += size2[c]*(size2[c] - 1)/2;
+  }
+  information /= n;
+  entropy1 = log_n - entropy1/n;
+  entropy2 = log_n - entropy2/n;
+
+  if (entropy1 + entropy2 > 0)
+    comparison.nmi = 2*information/(entropy1 + entropy2);
+  comparison.vi = std::max(entropy1 + entropy2 - 2*information, 0.0);
+
+  const Weight expected_pairs = n > 1 ? (Weight)pairs1*pairs2/((Weight)n*(n - 1)/2) : 0.0;
+  const Weight max_pairs = 0.5*(pairs1 + pairs2);
+  if (max_pairs != expected_pairs)
+    comparison.ari = (pairs - expected_pairs)/(max_pairs - expected_pairs);
+
+  #ifdef DEBUG
+    cerr << "exit compare_memberships(), nmi " << comparison.nmi << ", ari " << comparison.ari << ", vi " << comparison.vi << "." << endl;
+  #endif
+  return comparison;
+}
@@ -1,4 +1,131 @@
 #include "Optimiser.h"
+#include "ModularityVertexPartition.h"
+#include "CPMVertexPartition.h"
+#include "RBConfigurationVertexPartition.h"
+#include "RBERVertexPartition.h"
+#include "SignificanceVertexPartition.h"
+#include "SurpriseVertexPartition.h"
+#include <typeinfo>
+#include <thread>
+#include <mutex>
+#include <exception>
+
+/****************************************************************************
+  Call the quality function of a partition that is known to be exactly of the
+  type Partition. The qualified call is not dispatched virtually, so that the
+  compiler may resolve (and inline) it directly. For the generic
+  MutableVertexPartition the call remains virtual.
+****************************************************************************/
+template <class Partition> inline void diff_move_all(MutableVertexPartition* partition, Id v, vector<Id> const& comms, vector<Weight>& gains)
+{
+  static_cast<Partition*>(partition)->Partition::diff_move_all(v, comms, gains);
+}
+
+template <> inline void diff_move_all<MutableVertexPartition>(MutableVertexPartition* partition, Id v, vector<Id> const& comms, vector<Weight>& gains)
+{
+  partition->diff_move_all(v, comms, gains);
+}
+
+/****************************************************************************
+  Whether all partitions are exactly of the type Partition (and not of some
+  further derived type).
+****************************************************************************/
+template <class Partition> bool has_type(vector<MutableVertexPartition*> const& partitions)
+{
+  for (MutableVertexPartition* partition : partitions)
+    if (typeid(*partition) != typeid(Partition))
+      return false;
+  return true;
+}
+
+/****************************************************************************
+  The nodes whose community changed from membership before to membership
+  after, in increasing order. Since communities may have been renumbered,
+  each community before is identified with the community after that most of
+  its nodes are in (the first one reaching that number of nodes in case of a
+  tie).
+****************************************************************************/
+static vector<Id> changed_community(vector<Id> const& before, vector<Id> const& after)
+{
+  Id n = before.size();
+  Id nb_before = 0, nb_after = 0;
+  for (Id v = 0; v < n; v++)
+  {
+    nb_before = std::max(nb_before, before[v] + 1);
+    nb_after = std::max(nb_after, after[v] + 1);
+  }
+
+  // Group the nodes by their community before
+  vector<Id> comm_start(nb_before + 1, 0);
+  for (Id v = 0; v < n; v++)
+    comm_start[before[v] + 1]++;
+  for (Id c = 0; c < nb_before; c++)
+    comm_start[c + 1] += comm_start[c];
+  vector<Id> comm_nodes(n);
+  vector<Id> comm_pos(comm_start.begin(), comm_start.end() - 1);
+  for (Id v = 0; v < n; v++)
+    comm_nodes[comm_pos[before[v]]++] = v;
+
+  vector<Id> changed_nodes;
+  vector<Id> nb_nodes_after(nb_after, 0);
+  for (Id c = 0; c < nb_before; c++)
+  {
+    Id c_after = nb_after;
+    Id max_nb_nodes = 0;
+    for (Id i = comm_start[c]; i < comm_start[c + 1]; i++)
+    {
+      Id comm = after[comm_nodes[i]];
+      if (++nb_nodes_after[comm] > max_nb_nodes)
+      {
+        max_nb_nodes = nb_nodes_after[comm];
+        c_after = comm;
+      }
+    }
+    for (Id i = comm_start[c]; i < comm_start[c + 1]; i++)
+    {
+      Id v = comm_nodes[i];
+      if (after[v] != c_after)
+        changed_nodes.push_back(v);
+      nb_nodes_after[after[v]] = 0;
+    }
+  }
+  sort(changed_nodes.begin(), changed_nodes.end());
+  return changed_nodes;
+}
+
+/****************************************************************************
+  Collapse the graphs of all layers by their partitions, which all have the
+  same membership. Layers whose graphs share their topology (i.e. are on the
+  same igraph_t) are collapsed at once, so that their topology is aggregated
+  only once per level, see Graph::collapse_graphs. The collapsed graphs of
+  such layers then again share their topology on the next level.
+****************************************************************************/
+static vector<const Graph*> collapse_layers(vector<const Graph*> const& graphs, vector<MutableVertexPartition*> const& partitions)
+{
+  Id nb_layers = graphs.size();
+  vector<const Graph*> collapsed_graphs(nb_layers, nullptr);
+  for (Id layer = 0; layer < nb_layers; layer++)
+  {
+    if (collapsed_graphs[layer] != nullptr)
+      continue;
+    vector<Id> same_layers;
+    vector<const Graph*> same_graphs;
+    vector<MutableVertexPartition*> same_partitions;
+    for (Id other = layer; other < nb_layers; other++)
+    {
+      if (graphs[other]->get_igraph() == graphs[layer]->get_igraph())
+      {
+        same_layers.push_back(other);
+        same_graphs.push_back(graphs[other]);
+        same_partitions.push_back(partitions[other]);
+      }
+    }
+    vector<Graph*> same_collapsed_graphs = Graph::collapse_graphs(same_graphs, same_partitions);
+    for (Id i = 0; i < same_layers.size(); i++)
+      collapsed_graphs[same_layers[i]] = same_collapsed_graphs[i];
+  }
+  return collapsed_graphs;
+}
 
 /****************************************************************************
   Create a new Optimiser object
@@ -24,23 +151,69 @@
 Optimiser::Optimiser(): consider_comms(Optimiser::ALL_NEIGH_COMMS),
   refine_partition(true), refine_consider_comms(Optimiser::ALL_NEIGH_COMMS),
   optimise_routine(Optimiser::MOVE_NODES), refine_routine(Optimiser::MERGE_NODES),
-  consider_empty_community(true)
+  consider_empty_community(true), node_order(Optimiser::RAND_ORDER),
+  statistics(),
+  progress_callback(), progress_interval(10000), time_limit(0.0),
+  _stopped(false), _level(0), _has_deadline(false), _deadline(),
+  rng(rand()), _vertex_queue(), _node_degrees(),
+  _comms(), _comm_is_candidate(), _improvs(), _layer_improvs(),
+  _active_layers(), _active_layers_start(), _all_layers_active(true)
 {
-  const int err = igraph_rng_init(&rng, &igraph_rngtype_mt19937)
-    || igraph_rng_seed(&rng, rand());
-  if(err)
-    throw LeidenException("Optimiser(), rand initialization failed: " + std::to_string(err));
 }
 
 Optimiser::~Optimiser()
 {
-  igraph_rng_destroy(&rng);
+}
+
+/*****************************************************************************
+  Statistics of the optimisation, see OptimiserStatistics.
+*****************************************************************************/
+OptimiserStatistics::OptimiserStatistics() :
+  level_nodes(), level_edges(), nb_moves_per_pass(),
+  move_seconds(0.0), refine_seconds(0.0), collapse_seconds(0.0), init_admin_seconds(0.0),
+  nb_visits(0), nb_moves(0), nb_reactivations(0), nb_diff_moves(0), nb_candidates(0),
+  peak_scratch_memory(0)
+{ }
+
+void OptimiserStatistics::reset()
+{
+  *this = OptimiserStatistics();
+}
+
+#ifdef STATISTICS
+void Optimiser::update_peak_scratch_memory()
+{
+  size_t memory = this->_vertex_queue.memory() +
+                  this->_node_degrees.capacity()*sizeof(Id) +
+                  this->_comms.capacity()*sizeof(Id) +
+                  this->_comm_is_candidate.capacity()*sizeof(char) +
+                  (this->_improvs.capacity() + this->_layer_improvs.capacity())*sizeof(Weight);
+  if (memory > this->statistics.peak_scratch_memory)
+    this->statistics.peak_scratch_memory = memory;
+}
+#endif
+
+bool Optimiser::check_progress(Id nb_visits)
+{
+  if (!this->_stopped)
+  {
+    if (this->_has_deadline && steady_clock::now() >= this->_deadline)
+      this->_stopped = true;
+    else if (this->progress_callback && !this->progress_callback(this->_level, nb_visits))
+      this->_stopped = true;
+    #ifdef DEBUG
+      if (this->_stopped)
+        cerr << "Stopping optimisation at level " << this->_level << " after " << nb_visits << " visits." << endl;
+    #endif
+  }
+  return !this->_stopped;
 }
 
 void Optimiser::print_settings()
 {
   cerr << "Consider communities method:\t" << this->consider_comms << endl;
   cerr << "Refine partition:\t" << this->refine_partition << endl;
+  cerr << "Node order:\t" << this->node_order << endl;
 }
 
 /*****************************************************************************
@@ -63,9 +236,66 @@ Weight Optimiser::optimise_partition(MutableVertexPartition* partition)
   optimize the provided partition.
 *****************************************************************************/
 Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights)
+{
+  return this->optimise_partition(partitions, layer_weights, nullptr, nullptr);
+}
+
+/*****************************************************************************
+  Optimise the provided partition(s), starting from their current membership
+  and only reconsidering the nodes that changed (and their neighbours) at
+  first.
+
+  This is meant for dynamic graphs: if the partition was optimised for a
+  previous version of the graph, from which only a few edges were inserted or
+  deleted, the changed nodes are the endpoints of these edges. Nodes whose
+  neighbourhood did not change are then not visited at all when moving nodes
+  on the original graph, and communities that none of the changed or moved
+  nodes belong(ed) to are not refined, but aggregated as a whole, because
+  their refinement is still valid. From the first aggregate graph on, the
+  optimisation proceeds as usual, but on a graph that is typically much
+  smaller than it would be when starting from singletons.
+*****************************************************************************/
+Weight Optimiser::optimise_partition(MutableVertexPartition* partition, vector<Id> const& changed_nodes)
+{
+  vector<MutableVertexPartition*> partitions(1);
+  partitions[0] = partition;
+  vector<Weight> layer_weights(1, 1.0);
+  return this->optimise_partition(partitions, layer_weights, &changed_nodes, nullptr);
+}
+
+Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights, vector<Id> const& changed_nodes)
+{
+  return this->optimise_partition(partitions, layer_weights, &changed_nodes, nullptr);
+}
+
+Weight Optimiser::optimise_partition(MutableVertexPartition* partition, vector<Id> const& changed_nodes, vector<Id>& moved_nodes)
+{
+  vector<MutableVertexPartition*> partitions(1);
+  partitions[0] = partition;
+  vector<Weight> layer_weights(1, 1.0);
+  return this->optimise_partition(partitions, layer_weights, &changed_nodes, &moved_nodes);
+}
+
+Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights, vector<Id> const& changed_nodes, vector<Id>& moved_nodes)
+{
+  return this->optimise_partition(partitions, layer_weights, &changed_nodes, &moved_nodes);
+}
+
+/*****************************************************************************
+  Change the edges of the graph of the partition in place, updating the
+  community weights of the partition for the changed edges only, and then
+  warm start from the endpoints of the changed edges, as above.
+*****************************************************************************/
+Weight Optimiser::optimise_partition(MutableVertexPartition* partition, EdgeDelta const& delta)
+{
+  vector<Id> changed_nodes = partition->change_edges(delta);
+  return this->optimise_partition(partition, changed_nodes);
+}
+
+Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights, vector<Id> const* changed_nodes, vector<Id>* moved_nodes)
 {
   #ifdef DEBUG
-    cerr << "void Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights)" << endl;
+    cerr << "void Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights, vector<Id> const* changed_nodes, vector<Id>* moved_nodes)" << endl;
   #endif
 
   Weight q = 0.0;
@@ -91,6 +321,57 @@ Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
     if (graphs[layer]->vcount() != n)
       throw LeidenException("Number of nodes are not equal for all graphs.");
 
+  // The membership is read from the first layer, which therefore should not
+  // be sparse. The order of the layers does not matter otherwise, so that we
+  // simply start from the first layer that is not sparse.
+  if (graphs[0]->is_sparse())
+  {
+    Id first = 0;
+    while (first < nb_layers && graphs[first]->is_sparse())
+      first++;
+    if (first == nb_layers)
+      throw LeidenException("At least one layer should not be sparse.");
+    vector<MutableVertexPartition*> reordered_partitions(partitions);
+    vector<Weight> reordered_layer_weights(layer_weights);
+    std::rotate(reordered_partitions.begin(), reordered_partitions.begin() + first, reordered_partitions.end());
+    std::rotate(reordered_layer_weights.begin(), reordered_layer_weights.begin() + first, reordered_layer_weights.end());
+    return this->optimise_partition(reordered_partitions, reordered_layer_weights, changed_nodes, moved_nodes);
+  }
+
+  // Nodes from which to start moving nodes on the original graph, i.e. the
+  // changed nodes and their neighbours (duplicates are only queued once).
+  vector<Id> start_nodes;
+  if (changed_nodes != nullptr)
+  {
+    for (Id v : *changed_nodes)
+    {
+      if (v >= n)
+        throw LeidenException("Changed node is not a node of the graph.");
+      start_nodes.push_back(v);
+      for (Id layer = 0; layer < nb_layers; layer++)
+      {
+        vector<Id> const& neighs = graphs[layer]->get_neighbours(v, IGRAPH_ALL);
+        start_nodes.insert(start_nodes.end(), neighs.begin(), neighs.end());
+      }
+    }
+  }
+  // Communities affected by the change, which should be refined
+  vector<bool> comm_affected;
+  // Membership from which to start, to determine which nodes moved
+  vector<Id> start_membership;
+  if (changed_nodes != nullptr)
+    start_membership = partitions[0]->membership();
+
+  #ifdef STATISTICS
+    this->statistics.reset();
+    auto start = steady_clock::now();
+  #endif
+  this->_stopped = false;
+  this->_level = 0;
+  this->_has_deadline = (this->time_limit > 0);
+  if (this->_has_deadline)
+    this->_deadline = steady_clock::now() + std::chrono::duration_cast<steady_clock::duration>(duration<double>(this->time_limit));
+
   // Initialize the vector of the collapsed graphs for all layers
   vector<const Graph*> collapsed_graphs(nb_layers);
   vector<MutableVertexPartition*> collapsed_partitions(nb_layers);
@@ -111,6 +392,15 @@ Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
   Weight improv = 0.0;
   do
   {
+    // Stop before starting on a new level if requested
+    if (!this->check_progress(0))
+      break;
+
+    #ifdef STATISTICS
+      this->statistics.level_nodes.push_back(collapsed_graphs[0]->vcount());
+      this->statistics.level_edges.push_back(collapsed_graphs[0]->ecount());
+      start = steady_clock::now();
+    #endif
 
     // Optimise partition for collapsed graph
     #ifdef DEBUG
@@ -119,11 +409,41 @@ Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
         q += partitions[layer]->quality()*layer_weights[layer];
       cerr << "Quality before moving " <<  q << endl;
     #endif
+    int warm_start = (changed_nodes != nullptr && this->_level == 0);
     if (this->optimise_routine == Optimiser::MOVE_NODES)
-      improv += this->move_nodes(collapsed_partitions, layer_weights);
+    {
+      if (warm_start)
+        improv += this->move_nodes(collapsed_partitions, layer_weights, this->consider_comms, this->consider_empty_community, &start_nodes);
+      else
+        improv += this->move_nodes(collapsed_partitions, layer_weights);
+    }
     else if (this->optimise_routine == Optimiser::MERGE_NODES)
       improv += this->merge_nodes(collapsed_partitions, layer_weights);
 
+    if (warm_start)
+    {
+      // The communities of the changed nodes are affected, and so are the
+      // communities that nodes moved from or to.
+      comm_affected.assign(partitions[0]->n_communities(), false);
+      for (Id v : *changed_nodes)
+        comm_affected[partitions[0]->membership(v)] = true;
+      for (Id v = 0; v < n; v++)
+      {
+        Id v_comm = partitions[0]->membership(v);
+        if (v_comm != start_membership[v])
+        {
+          comm_affected[v_comm] = true;
+          if (start_membership[v] < comm_affected.size())
+            comm_affected[start_membership[v]] = true;
+        }
+      }
+    }
+
+    #ifdef STATISTICS
+      this->statistics.move_seconds += duration<double>(steady_clock::now() - start).count();
+      start = steady_clock::now();
+    #endif
+
     #ifdef DEBUG
       cerr << "Found " << collapsed_partitions[0]->n_communities() << " communities, improved " << improv << endl;
       q = 0.0;
@@ -144,6 +464,14 @@ Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
           partitions[layer]->from_coarse_partition(collapsed_partitions[layer]);
       }
     }
+    #ifdef STATISTICS
+      this->statistics.init_admin_seconds += duration<double>(steady_clock::now() - start).count();
+    #endif
+
+    // If we were stopped while moving nodes, the partition now reflects all
+    // moves so far, and we should not aggregate any further.
+    if (this->_stopped)
+      break;
 
     #ifdef DEBUG
       q = 0.0;
@@ -172,10 +500,42 @@ Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
       #ifdef DEBUG
         cerr << "\tBefore SLM " << collapsed_partitions[0]->n_communities() << " communities." << endl;
       #endif
-      for (Id layer = 0; layer < nb_layers; layer++)
+      #ifdef STATISTICS
+        start = steady_clock::now();
+      #endif
+      if (warm_start)
+      {
+        // Start the refinement from singletons in the affected communities,
+        // and from the entire community for the other communities.
+        vector<Id> sub_membership(n);
+        vector<Id> sub_comm(comm_affected.size(), n);
+        Id nb_sub_comms = 0;
+        for (Id v = 0; v < n; v++)
+        {
+          Id v_comm = collapsed_partitions[0]->membership(v);
+          if (comm_affected[v_comm])
+            sub_membership[v] = nb_sub_comms++;
+          else
+          {
+            if (sub_comm[v_comm] == n)
+              sub_comm[v_comm] = nb_sub_comms++;
+            sub_membership[v] = sub_comm[v_comm];
+          }
+        }
+        for (Id layer = 0; layer < nb_layers; layer++)
+          sub_collapsed_partitions[layer] = collapsed_partitions[layer]->create(collapsed_graphs[layer], sub_membership);
+      }
+      else
       {
-        sub_collapsed_partitions[layer] = collapsed_partitions[layer]->create(collapsed_graphs[layer]);
+        for (Id layer = 0; layer < nb_layers; layer++)
+        {
+          sub_collapsed_partitions[layer] = collapsed_partitions[layer]->create(collapsed_graphs[layer]);
+        }
       }
+      #ifdef STATISTICS
+        this->statistics.init_admin_seconds += duration<double>(steady_clock::now() - start).count();
+        start = steady_clock::now();
+      #endif
 
       // Then move around nodes but restrict movement to within original communities.
       #ifdef DEBUG
@@ -185,6 +545,15 @@ Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
         this->move_nodes_constrained(sub_collapsed_partitions, layer_weights, refine_consider_comms, collapsed_partitions[0]);
       else if (this->refine_routine == Optimiser::MERGE_NODES)
         this->merge_nodes_constrained(sub_collapsed_partitions, layer_weights, refine_consider_comms, collapsed_partitions[0]);
+      #ifdef STATISTICS
+        this->statistics.refine_seconds += duration<double>(steady_clock::now() - start).count();
+      #endif
+      if (this->_stopped)
+      {
+        for (Id layer = 0; layer < nb_layers; layer++)
+          delete sub_collapsed_partitions[layer];
+        break;
+      }
       #ifdef DEBUG
         cerr << "\tAfter applying refinement found " << sub_collapsed_partitions[0]->n_communities() << " communities." << endl;
       #endif
@@ -197,10 +566,13 @@ Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
       }
 
       // Collapse graph based on sub collapsed partition
-      for (Id layer = 0; layer < nb_layers; layer++)
-      {
-        new_collapsed_graphs[layer] = collapsed_graphs[layer]->collapse_graph(sub_collapsed_partitions[layer]);
-      }
+      #ifdef STATISTICS
+        start = steady_clock::now();
+      #endif
+      new_collapsed_graphs = collapse_layers(collapsed_graphs, sub_collapsed_partitions);
+      #ifdef STATISTICS
+        this->statistics.collapse_seconds += duration<double>(steady_clock::now() - start).count();
+      #endif
 
       // Determine the membership for the collapsed graph
       vector<Id> new_collapsed_membership(new_collapsed_graphs[0]->vcount());
@@ -226,24 +598,42 @@ Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
       aggregate_further = (new_collapsed_graphs[0]->vcount() < collapsed_graphs[0]->vcount()) &&
                           (collapsed_graphs[0]->vcount() > collapsed_partitions[0]->n_communities());
       // Create new collapsed partition
+      #ifdef STATISTICS
+        start = steady_clock::now();
+      #endif
       for (Id layer = 0; layer < nb_layers; layer++)
       {
         delete sub_collapsed_partitions[layer];  // ATTENTION: may delete also collapsed_graphs
         new_collapsed_partitions[layer] = collapsed_partitions[layer]->create(new_collapsed_graphs[layer], new_collapsed_membership);
       }
+      #ifdef STATISTICS
+        this->statistics.init_admin_seconds += duration<double>(steady_clock::now() - start).count();
+      #endif
     }
     else
     {
+      #ifdef STATISTICS
+        start = steady_clock::now();
+      #endif
+      new_collapsed_graphs = collapse_layers(collapsed_graphs, collapsed_partitions);
+      #ifdef STATISTICS
+        this->statistics.collapse_seconds += duration<double>(steady_clock::now() - start).count();
+      #endif
       for (Id layer = 0; layer < nb_layers; layer++)
       {
-        new_collapsed_graphs[layer] = collapsed_graphs[layer]->collapse_graph(collapsed_partitions[layer]);
         #ifdef DEBUG
           cerr << "Layer " << layer << endl;
           cerr << "Old collapsed graph " << collapsed_graphs[layer] << ", vcount is " << collapsed_graphs[layer]->vcount() << endl;
           cerr << "New collapsed graph " << new_collapsed_graphs[layer] << ", vcount is " << new_collapsed_graphs[layer]->vcount() << endl;
         #endif
         // Create collapsed partition (i.e. default partition of each node in its own community).
+        #ifdef STATISTICS
+          start = steady_clock::now();
+        #endif
         new_collapsed_partitions[layer] = collapsed_partitions[layer]->create(new_collapsed_graphs[layer]);
+        #ifdef STATISTICS
+          this->statistics.init_admin_seconds += duration<double>(steady_clock::now() - start).count();
+        #endif
       }
       aggregate_further = (new_collapsed_graphs[0]->vcount() < collapsed_graphs[0]->vcount()) &&
                           (collapsed_graphs[0]->vcount() > collapsed_partitions[0]->n_communities());
@@ -292,7 +682,10 @@ Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
       }
     #endif // DEBUG
 
+    this->_level++;
   } while (aggregate_further);
+  this->_level = 0;
+  this->_has_deadline = false;
 
   // Clean up memory after use.
   for (Id layer = 0; layer < nb_layers; layer++)
@@ -306,6 +699,9 @@ Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
   // Make sure the resulting communities are called 0,...,r-1
   // where r is the number of communities.
   q = 0.0;
+  #ifdef STATISTICS
+    start = steady_clock::now();
+  #endif
   vector<Id> membership = MutableVertexPartition::renumber_communities(partitions);
   // We only renumber the communities for the first graph,
   // since the communities for the other graphs should just be equal
@@ -315,6 +711,11 @@ Weight Optimiser::optimise_partition(vector<MutableVertexPartition*> partitions,
     partitions[layer]->renumber_communities(membership);
     q += partitions[layer]->quality()*layer_weights[layer];
   }
+  if (moved_nodes != nullptr)
+    *moved_nodes = changed_community(start_membership, membership);
+  #ifdef STATISTICS
+    this->statistics.init_admin_seconds += duration<double>(steady_clock::now() - start).count();
+  #endif
   return improv;
 }
 
@@ -396,6 +797,31 @@ Weight Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
 }
 
 Weight Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights, int consider_comms, int consider_empty_community)
+{
+  return this->move_nodes(partitions, layer_weights, consider_comms, consider_empty_community, nullptr);
+}
+
+Weight Optimiser::move_nodes(vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights, int consider_comms, int consider_empty_community, vector<Id> const* nodes)
+{
+  // Dispatch once to the kernel for the type of the partitions
+  if (has_type<ModularityVertexPartition>(partitions))
+    return this->move_nodes_kernel<ModularityVertexPartition>(partitions, layer_weights, consider_comms, consider_empty_community, nodes);
+  else if (has_type<CPMVertexPartition>(partitions))
+    return this->move_nodes_kernel<CPMVertexPartition>(partitions, layer_weights, consider_comms, consider_empty_community, nodes);
+  else if (has_type<RBConfigurationVertexPartition>(partitions))
+    return this->move_nodes_kernel<RBConfigurationVertexPartition>(partitions, layer_weights, consider_comms, consider_empty_community, nodes);
+  else if (has_type<RBERVertexPartition>(partitions))
+    return this->move_nodes_kernel<RBERVertexPartition>(partitions, layer_weights, consider_comms, consider_empty_community, nodes);
+  else if (has_type<SignificanceVertexPartition>(partitions))
+    return this->move_nodes_kernel<SignificanceVertexPartition>(partitions, layer_weights, consider_comms, consider_empty_community, nodes);
+  else if (has_type<SurpriseVertexPartition>(partitions))
+    return this->move_nodes_kernel<SurpriseVertexPartition>(partitions, layer_weights, consider_comms, consider_empty_community, nodes);
+  else
+    return this->move_nodes_kernel<MutableVertexPartition>(partitions, layer_weights, consider_comms, consider_empty_community, nodes);
+}
+
+template <class Partition>
+Weight Optimiser::move_nodes_kernel(vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights, int consider_comms, int consider_empty_community, vector<Id> const* nodes)
 {
   #ifdef DEBUG
     cerr << "Weight Optimiser::move_nodes_multiplex(vector<MutableVertexPartition*> partitions, vector<Weight> weights)" << endl;
@@ -417,23 +843,48 @@ Weight Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
   for (Id layer = 0; layer < nb_layers; layer++)
     if (graphs[layer]->vcount() != n)
       throw LeidenException("Number of nodes are not equal for all graphs.");
+  if (graphs[0]->is_sparse())
+    throw LeidenException("The first layer should not be sparse.");
+  this->index_active_layers(graphs);
   // Number of moved nodes during one loop
   Id nb_moves = 0;
 
   // Establish vertex order
   // We normally initialize the normal vertex order
   // of considering node 0,1,...
-  queue<Id> vertex_order;
-  vector<int> is_node_stable(n, false);
   // But if we use a random order, we shuffle this order.
-  vector<Id> nodes = range(n);
-  shuffle(nodes, &rng);
-  for (vector<Id>::iterator it_node = nodes.begin();
-       it_node != nodes.end();
-       it_node++)
+  // A node is stable (i.e. need not be considered) as long as it is not queued.
+  // Unstable neighbours are reconsidered in the order they became unstable,
+  // unless they are prioritised in buckets, see node_order.
+  // If only some nodes are given, all other nodes are initially stable.
+  int prioritise = (this->node_order == CHANGE_ORDER || this->node_order == IMPROV_ORDER);
+  VertexQueue& vertex_order = this->_vertex_queue;
+  vertex_order.reset(n, prioritise ? NB_PRIORITY_BUCKETS : 1);
+  if (nodes == nullptr)
+    vertex_order.push_all_shuffled(&rng);
+  else
   {
-    vertex_order.push(*it_node);
+    vector<Id> shuffled_nodes(*nodes);
+    shuffle(shuffled_nodes, &rng);
+    for (Id v : shuffled_nodes)
+      vertex_order.push(v);
   }
+  if (this->node_order == DEGREE_ORDER)
+  {
+    // Consider nodes with a high degree (summed over all layers) first. The
+    // degrees are summed once, rather than in every comparison.
+    vector<Id>& degrees = this->_node_degrees;
+    degrees.assign(n, 0);
+    for (Id layer = 0; layer < nb_layers; layer++)
+      for (Id v = 0; v < n; v++)
+        degrees[v] += graphs[layer]->degree(v, IGRAPH_ALL);
+    vertex_order.sort([&degrees](Id v, Id u)
+    {
+      return degrees[v] > degrees[u];
+    });
+  }
+  // Total improvement of all moves, used for prioritising by improvement
+  Weight total_moves_improv = 0.0;
 
   // Initialize the degree vector
   // If we want to debug the function, we will calculate some additional values.
@@ -443,16 +894,37 @@ Weight Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
   // (2) - The quality function should be exactly the same value after
   //       aggregating/collapsing the graph.
 
+  #ifdef STATISTICS
+    // Nodes are considered in passes: the first pass consists of all nodes,
+    // and each next pass of the nodes that were queued at the end of the
+    // previous pass.
+    Id pass_remaining = 0;
+  #endif
+
+  this->_stopped = false;
+  Id nb_visits = 0;
+
   // As long as the queue is not empty
   while(!vertex_order.empty())
   {
-    Id v = vertex_order.front(); vertex_order.pop();
+    if (!this->visit_node(nb_visits))
+      break;
 
-    set<Id> comms;
-    const Graph* graph = nullptr;
+    #ifdef STATISTICS
+      if (pass_remaining == 0)
+      {
+        pass_remaining = vertex_order.size();
+        this->statistics.nb_moves_per_pass.push_back(0);
+      }
+      pass_remaining--;
+    #endif
+
+    Id v = vertex_order.pop();
+
+    this->_comms.clear();
     MutableVertexPartition* partition = nullptr;
     // What is the current community of the node (this should be the same for all layers)
-    Id v_comm = partitions[0]->membership(v);
+    Id v_comm = partitions[0]->membership<false>(v);
 
     if (consider_comms == ALL_COMMS)
     {
@@ -462,7 +934,7 @@ Weight Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
         {
           if (partitions[layer]->cnodes(comm) > 0)
           {
-            comms.insert(comm);
+            this->add_candidate_comm(comm);
             break; // Break from for loop in layer
           }
         }
@@ -472,58 +944,36 @@ Weight Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
     else if (consider_comms == ALL_NEIGH_COMMS)
     {
       /****************************ALL NEIGH COMMS*****************************/
-      for (Id layer = 0; layer < nb_layers; layer++)
+      for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
       {
+        Id layer = *it_layer;
         vector<Id> const& neigh_comm_layer = partitions[layer]->get_neigh_comms(v, IGRAPH_ALL);
-        comms.insert(neigh_comm_layer.begin(), neigh_comm_layer.end());
+        for (Id comm : neigh_comm_layer)
+          this->add_candidate_comm(comm);
       }
     }
     else if (consider_comms == RAND_COMM)
     {
       /****************************RAND COMM***********************************/
-      comms.insert( partitions[0]->membership(graphs[0]->get_random_node(&rng)) );
+      this->add_candidate_comm( partitions[0]->membership<false>(graphs[0]->get_random_node(&rng)) );
     }
     else if (consider_comms == RAND_NEIGH_COMM)
     {
       /****************************RAND NEIGH COMM*****************************/
       Id rand_layer = get_random_int(0, nb_layers - 1, &rng);
       if (graphs[rand_layer]->degree(v, IGRAPH_ALL) > 0)
-        comms.insert( partitions[0]->membership(graphs[rand_layer]->get_random_neighbour(v, IGRAPH_ALL, &rng)) );
+        this->add_candidate_comm( partitions[0]->membership<false>(graphs[rand_layer]->get_random_neighbour(v, IGRAPH_ALL, &rng)) );
     }
 
     #ifdef DEBUG
-      cerr << "Consider " << comms.size() << " communities for moving." << endl;
+      cerr << "Consider " << this->_comms.size() << " communities for moving." << endl;
     #endif
 
-    Id max_comm = v_comm;
-    Weight max_improv = 0.0;
-    for (set<Id>::iterator comm_it = comms.begin();
-         comm_it!= comms.end();
-         comm_it++)
-    {
-      Id comm = *comm_it;
-      Weight possible_improv = 0.0;
-
-      // Consider the improvement of moving to a community for all layers
-      for (Id layer = 0; layer < nb_layers; layer++)
-      {
-        graph = graphs[layer];
-        partition = partitions[layer];
-        // Make sure to multiply it by the weight per layer
-        possible_improv += layer_weights[layer]*partition->diff_move(v, comm);
-      }
-
-      if (possible_improv > max_improv)
-      {
-        max_comm = comm;
-        max_improv = possible_improv;
-      }
-    }
+    this->sort_candidate_comms();
 
     // Check if we should move to an empty community
     if (consider_empty_community)
     {
-      graph = graphs[0];
       partition = partitions[0];
       if ( partition->cnodes(v_comm) > 1 )  // We should not move a node when it is already in its own empty community (this may otherwise create more empty communities than nodes)
       {
@@ -539,28 +989,32 @@ Weight Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
           for (Id layer = 1; layer < nb_layers; layer++)
               partitions[layer]->add_empty_community();
         }
-
-        Weight possible_improv = 0.0;
-        for (Id layer = 0; layer < nb_layers; layer++)
-        {
-          possible_improv += layer_weights[layer]*partitions[layer]->diff_move(v, comm);
-        }
-        #ifdef DEBUG
-          cerr << "Improvement to empty community: " << possible_improv << ", maximum improvement: " << max_improv << endl;
-        #endif
-        if (possible_improv > max_improv)
-        {
-          max_improv = possible_improv;
-          max_comm = comm;
-        }
+        // The empty community is considered last, so that it is only chosen
+        // if it is strictly better than all other communities. It is evaluated
+        // together with the other candidates, so that the terms of the current
+        // community need not be calculated again.
+        this->_comms.push_back(comm);
       }
     }
 
-    is_node_stable[v] = true;
+    Id max_comm = v_comm;
+    Weight max_improv = 0.0;
+    this->diff_move_candidates<Partition>(v, partitions, layer_weights);
+    for (Id i = 0; i < this->_comms.size(); i++)
+    {
+      if (this->_improvs[i] > max_improv)
+      {
+        max_comm = this->_comms[i];
+        max_improv = this->_improvs[i];
+      }
+    }
 
     // If we actually plan to move the node
     if (max_comm != v_comm)
     {
+      #ifdef STATISTICS
+        this->statistics.nb_moves++;
+      #endif
         // Keep track of improvement
         total_improv += max_improv;
 
@@ -569,8 +1023,9 @@ Weight Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
           Weight q_improv = 0;
         #endif
 
-        for (Id layer = 0; layer < nb_layers; layer++)
+        for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
         {
+          Id layer = *it_layer;
           MutableVertexPartition* partition = partitions[layer];
 
           #ifdef DEBUG
@@ -601,25 +1056,70 @@ Weight Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
           }
         #endif
 
-        // Mark neighbours as unstable (if not in new community)
-        vector<Id> const& neighs = graph->get_neighbours(v, IGRAPH_ALL);
-        for (vector<Id>::const_iterator it_neigh = neighs.begin();
-             it_neigh != neighs.end(); it_neigh++)
+        // Determine the priority of the neighbours that become unstable.
+        // When prioritising by improvement, each doubling with respect to
+        // the mean improvement of the moves so far is one bucket higher.
+        Id bucket = 0;
+        total_moves_improv += max_improv;
+        if (this->node_order == IMPROV_ORDER)
         {
-          Id u = *it_neigh;
-          // If the neighbour was stable and is not in the new community, we
-          // should mark it as unstable, and add it to the queue
-          if (is_node_stable[u] && partition->membership(v) != max_comm)
+          Weight mean_improv = total_moves_improv/(nb_moves + 1);
+          Weight ratio = max_improv/mean_improv;
+          // The ratio may not be positive and finite (e.g. for infinite
+          // improvements), in which case the middle bucket is used.
+          bucket = NB_PRIORITY_BUCKETS/2;
+          if (ratio > 0 && std::isfinite(ratio))
           {
-            vertex_order.push(u);
-            is_node_stable[u] = false;
+            double b = NB_PRIORITY_BUCKETS/2 + floor(log2(ratio));
+            bucket = b < 0 ? 0 : (b >= NB_PRIORITY_BUCKETS ? NB_PRIORITY_BUCKETS - 1 : (Id)b);
+          }
+        }
+
+        // Mark neighbours in any of the layers as unstable (if not in new
+        // community). A neighbour in multiple layers is only queued once.
+        for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
+        {
+          Id layer = *it_layer;
+          const Graph* graph = graphs[layer];
+          vector<Id> const& neighs = graph->get_neighbours(v, IGRAPH_ALL);
+          vector<Id> const& neigh_edges = graph->get_neighbour_edges(v, IGRAPH_ALL);
+          for (Id idx = 0; idx < neighs.size(); idx++)
+          {
+            Id u = neighs[idx];
+            // If the neighbour is in the new community, it already
+            // benefits from the move, so there is no need to reconsider it.
+            if (vertex_order.is_queued(u) || partitions[0]->membership<false>(u) == max_comm)
+              continue;
+            if (this->node_order == CHANGE_ORDER)
+            {
+              // The priority is the share of the strength of the neighbour
+              // that is due to the edge with the moved node.
+              Weight u_strength = graph->strength(u, IGRAPH_OUT);
+              if (graph->is_directed())
+                u_strength += graph->strength(u, IGRAPH_IN);
+              Weight share = u_strength != 0 ? fabs(graph->edge_weight(neigh_edges[idx])/u_strength) : 0;
+              bucket = share < 1 ? (Id)(share*NB_PRIORITY_BUCKETS) : NB_PRIORITY_BUCKETS - 1;
+            }
+            // The neighbour was stable and is not in the new community, so
+            // we should mark it as unstable, and add it to the queue
+            vertex_order.push(u, bucket);
+            #ifdef STATISTICS
+              this->statistics.nb_reactivations++;
+            #endif
           }
         }
         // Keep track of number of moves
         nb_moves += 1;
+        #ifdef STATISTICS
+          this->statistics.nb_moves_per_pass.back()++;
+        #endif
       }
   }
 
+  #ifdef STATISTICS
+    this->update_peak_scratch_memory();
+  #endif
+
   partitions[0]->renumber_communities();
   vector<Id> const& membership = partitions[0]->membership();
   for (Id layer = 1; layer < nb_layers; layer++)
@@ -632,12 +1132,119 @@ Weight Optimiser::move_nodes(vector<MutableVertexPartition*> partitions, vector<
   return total_improv;
 }
 
+/*****************************************************************************
+  Calculate the improvement of moving node v to each of the candidate
+  communities in _comms, summed over all layers and weighted by the layer
+  weights, in _improvs. All candidates are evaluated in a single call per
+  layer, so that the terms of the current community of v are only calculated
+  once. The candidates should have been sorted by sort_candidate_comms.
+*****************************************************************************/
+template <class Partition>
+void Optimiser::diff_move_candidates(Id v, vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights)
+{
+  Id nb_comms = this->_comms.size();
+  #ifdef STATISTICS
+    this->statistics.nb_visits++;
+    this->statistics.nb_candidates += nb_comms;
+    this->statistics.nb_diff_moves += nb_comms*partitions.size();
+  #endif
+  this->_improvs.assign(nb_comms, 0.0);
+  // Layers in which v is not active do not change the improvements
+  for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
+  {
+    Id layer = *it_layer;
+    diff_move_all<Partition>(partitions[layer], v, this->_comms, this->_layer_improvs);
+    // Make sure to multiply it by the weight per layer
+    for (Id i = 0; i < nb_comms; i++)
+      this->_improvs[i] += layer_weights[layer]*this->_layer_improvs[i];
+  }
+}
+
+/*****************************************************************************
+  Index the layers in which each node is active, see _active_layers. All
+  nodes are active in a layer that is not sparse, and only its active
+  vertices in a sparse layer. The index is built by a counting sort over the
+  layers, so that it takes time proportional to the number of nodes plus the
+  number of active vertices of the sparse layers.
+*****************************************************************************/
+void Optimiser::index_active_layers(vector<const Graph*> const& graphs)
+{
+  Id nb_layers = graphs.size();
+  Id n = graphs[0]->vcount();
+  this->_all_layers_active = true;
+  for (Id layer = 0; layer < nb_layers; layer++)
+    if (graphs[layer]->is_sparse())
+      this->_all_layers_active = false;
+
+  if (this->_all_layers_active)
+  {
+    this->_active_layers = range(nb_layers);
+    this->_active_layers_start.clear();
+    return;
+  }
+
+  // First let _active_layers_start[v + 1] be the number of layers of v, which
+  // are then used as insertion positions, so that afterwards
+  // _active_layers_start[v + 1] is the end of the layers of v.
+  Id nb_dense_layers = 0;
+  this->_active_layers_start.assign(n + 2, 0);
+  for (Id layer = 0; layer < nb_layers; layer++)
+  {
+    if (graphs[layer]->is_sparse())
+    {
+      for (Id i = 0; i < graphs[layer]->active_vcount(); i++)
+        this->_active_layers_start[graphs[layer]->vertex(i) + 2]++;
+    }
+    else
+      nb_dense_layers++;
+  }
+  for (Id v = 0; v < n; v++)
+    this->_active_layers_start[v + 2] += this->_active_layers_start[v + 1] + nb_dense_layers;
+
+  this->_active_layers.resize(this->_active_layers_start[n + 1]);
+  for (Id layer = 0; layer < nb_layers; layer++)
+  {
+    const Graph* graph = graphs[layer];
+    if (graph->is_sparse())
+    {
+      for (Id i = 0; i < graph->active_vcount(); i++)
+        this->_active_layers[this->_active_layers_start[graph->vertex(i) + 1]++] = layer;
+    }
+    else
+    {
+      for (Id v = 0; v < n; v++)
+        this->_active_layers[this->_active_layers_start[v + 1]++] = layer;
+    }
+  }
+  this->_active_layers_start.pop_back();
+}
+
 Weight Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights)
 {
   return this->merge_nodes(partitions, layer_weights, this->consider_comms);
 }
 
 Weight Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights, int consider_comms)
+{
+  // Dispatch once to the kernel for the type of the partitions
+  if (has_type<ModularityVertexPartition>(partitions))
+    return this->merge_nodes_kernel<ModularityVertexPartition>(partitions, layer_weights, consider_comms);
+  else if (has_type<CPMVertexPartition>(partitions))
+    return this->merge_nodes_kernel<CPMVertexPartition>(partitions, layer_weights, consider_comms);
+  else if (has_type<RBConfigurationVertexPartition>(partitions))
+    return this->merge_nodes_kernel<RBConfigurationVertexPartition>(partitions, layer_weights, consider_comms);
+  else if (has_type<RBERVertexPartition>(partitions))
+    return this->merge_nodes_kernel<RBERVertexPartition>(partitions, layer_weights, consider_comms);
+  else if (has_type<SignificanceVertexPartition>(partitions))
+    return this->merge_nodes_kernel<SignificanceVertexPartition>(partitions, layer_weights, consider_comms);
+  else if (has_type<SurpriseVertexPartition>(partitions))
+    return this->merge_nodes_kernel<SurpriseVertexPartition>(partitions, layer_weights, consider_comms);
+  else
+    return this->merge_nodes_kernel<MutableVertexPartition>(partitions, layer_weights, consider_comms);
+}
+
+template <class Partition>
+Weight Optimiser::merge_nodes_kernel(vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights, int consider_comms)
 {
   #ifdef DEBUG
     cerr << "Weight Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector<Weight> weights)" << endl;
@@ -661,6 +1268,9 @@ Weight Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
   for (Id layer = 0; layer < nb_layers; layer++)
     if (graphs[layer]->vcount() != n)
       throw LeidenException("Number of nodes are not equal for all graphs.");
+  if (graphs[0]->is_sparse())
+    throw LeidenException("The first layer should not be sparse.");
+  this->index_active_layers(graphs);
 
   // Establish vertex order
   // We normally initialize the normal vertex order
@@ -670,14 +1280,20 @@ Weight Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
   // But if we use a random order, we shuffle this order.
   shuffle(vertex_order, &rng);
 
+  this->_stopped = false;
+  Id nb_visits = 0;
+
   // Iterate over all nodes
   for (vector<Id>::iterator it = vertex_order.begin();
        it != vertex_order.end(); it++)
   {
+    if (!this->visit_node(nb_visits))
+      break;
+
     Id v = *it;
 
     // What is the current community of the node (this should be the same for all layers)
-    Id v_comm = partitions[0]->membership(v);
+    Id v_comm = partitions[0]->membership<false>(v);
 
     #ifdef DEBUG
       cerr << "Consider moving node " << v << " from " << v_comm << "." << endl;
@@ -685,8 +1301,7 @@ Weight Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
 
     if (partitions[0]->cnodes(v_comm) == 1)
     {
-      set<Id> comms;
-      MutableVertexPartition* partition = nullptr;
+      this->_comms.clear();
 
       if (consider_comms == ALL_COMMS)
       {
@@ -696,7 +1311,7 @@ Weight Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
           {
             if (partitions[layer]->cnodes(comm) > 0)
             {
-              comms.insert(comm);
+              this->add_candidate_comm(comm);
               break; // Break from for loop in layer
             }
           }
@@ -706,16 +1321,18 @@ Weight Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
       else if (consider_comms == ALL_NEIGH_COMMS)
       {
         /****************************ALL NEIGH COMMS*****************************/
-        for (Id layer = 0; layer < nb_layers; layer++)
+        for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
         {
+          Id layer = *it_layer;
           vector<Id> const& neigh_comm_layer = partitions[layer]->get_neigh_comms(v, IGRAPH_ALL);
-          comms.insert(neigh_comm_layer.begin(), neigh_comm_layer.end());
+          for (Id comm : neigh_comm_layer)
+            this->add_candidate_comm(comm);
         }
       }
       else if (consider_comms == RAND_COMM)
       {
         /****************************RAND COMM***********************************/
-        comms.insert( partitions[0]->membership(graphs[0]->get_random_node(&rng)) );
+        this->add_candidate_comm( partitions[0]->membership<false>(graphs[0]->get_random_node(&rng)) );
       }
       else if (consider_comms == RAND_NEIGH_COMM)
       {
@@ -726,44 +1343,37 @@ Weight Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
         {
           // Make sure there is also a probability not to move the node
           if (get_random_int(0, k, &rng) > 0)
-            comms.insert( partitions[0]->membership(graphs[rand_layer]->get_random_neighbour(v, IGRAPH_ALL, &rng)) );
+            this->add_candidate_comm( partitions[0]->membership<false>(graphs[rand_layer]->get_random_neighbour(v, IGRAPH_ALL, &rng)) );
         }
       }
 
       #ifdef DEBUG
-        cerr << "Consider " << comms.size() << " communities for moving node " << v << "." << endl;
+        cerr << "Consider " << this->_comms.size() << " communities for moving node " << v << "." << endl;
       #endif
 
       Id max_comm = v_comm;
       Weight max_improv = 0.0;
-      for (set<Id>::iterator comm_it = comms.begin();
-           comm_it!= comms.end();
-           comm_it++)
+      this->sort_candidate_comms();
+      this->diff_move_candidates<Partition>(v, partitions, layer_weights);
+      for (Id i = 0; i < this->_comms.size(); i++)
       {
-        Id comm = *comm_it;
-        Weight possible_improv = 0.0;
-
-        // Consider the improvement of moving to a community for all layers
-        for (Id layer = 0; layer < nb_layers; layer++)
-        {
-          partition = partitions[layer];
-          // Make sure to multiply it by the weight per layer
-          possible_improv += layer_weights[layer]*partition->diff_move(v, comm);
-        }
         #ifdef DEBUG
-          cerr << "Improvement of " << possible_improv << " when move to " << comm << "." << endl;
+          cerr << "Improvement of " << this->_improvs[i] << " when move to " << this->_comms[i] << "." << endl;
         #endif
 
-        if (possible_improv >= max_improv)
+        if (this->_improvs[i] >= max_improv)
         {
-          max_comm = comm;
-          max_improv = possible_improv;
+          max_comm = this->_comms[i];
+          max_improv = this->_improvs[i];
         }
       }
 
       // If we actually plan to move the node
       if (max_comm != v_comm)
       {
+        #ifdef STATISTICS
+          this->statistics.nb_moves++;
+        #endif
           // Keep track of improvement
           total_improv += max_improv;
 
@@ -772,8 +1382,9 @@ Weight Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
             Weight q_improv = 0;
           #endif
 
-          for (Id layer = 0; layer < nb_layers; layer++)
+          for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
           {
+            Id layer = *it_layer;
             MutableVertexPartition* partition = partitions[layer];
 
             #ifdef DEBUG
@@ -807,6 +1418,10 @@ Weight Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector
       }
   }
 
+  #ifdef STATISTICS
+    this->update_peak_scratch_memory();
+  #endif
+
   partitions[0]->renumber_communities();
   vector<Id> const& membership = partitions[0]->membership();
   for (Id layer = 1; layer < nb_layers; layer++)
@@ -825,6 +1440,26 @@ Weight Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
 }
 
 Weight Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights, int consider_comms, MutableVertexPartition* constrained_partition)
+{
+  // Dispatch once to the kernel for the type of the partitions
+  if (has_type<ModularityVertexPartition>(partitions))
+    return this->move_nodes_constrained_kernel<ModularityVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+  else if (has_type<CPMVertexPartition>(partitions))
+    return this->move_nodes_constrained_kernel<CPMVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+  else if (has_type<RBConfigurationVertexPartition>(partitions))
+    return this->move_nodes_constrained_kernel<RBConfigurationVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+  else if (has_type<RBERVertexPartition>(partitions))
+    return this->move_nodes_constrained_kernel<RBERVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+  else if (has_type<SignificanceVertexPartition>(partitions))
+    return this->move_nodes_constrained_kernel<SignificanceVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+  else if (has_type<SurpriseVertexPartition>(partitions))
+    return this->move_nodes_constrained_kernel<SurpriseVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+  else
+    return this->move_nodes_constrained_kernel<MutableVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+}
+
+template <class Partition>
+Weight Optimiser::move_nodes_constrained_kernel(vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights, int consider_comms, MutableVertexPartition* constrained_partition)
 {
   #ifdef DEBUG
     cerr << "Weight Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights, vector<Id> const& constrained_membership)" << endl;
@@ -846,25 +1481,20 @@ Weight Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
   for (Id layer = 0; layer < nb_layers; layer++)
     if (graphs[layer]->vcount() != n)
       throw LeidenException("Number of nodes are not equal for all graphs.");
+  if (graphs[0]->is_sparse())
+    throw LeidenException("The first layer should not be sparse.");
+  this->index_active_layers(graphs);
   // Number of moved nodes during one loop
   Id nb_moves = 0;
 
   // Establish vertex order
   // We normally initialize the normal vertex order
   // of considering node 0,1,...
-  queue<Id> vertex_order;
-  vector<int> is_node_stable(n, false);
   // But if we use a random order, we shuffle this order.
-  vector<Id> nodes = range(n);
-  shuffle(nodes, &rng);
-  for (vector<Id>::iterator it_node = nodes.begin();
-       it_node != nodes.end();
-       it_node++)
-  {
-    vertex_order.push(*it_node);
-  }
-
-  vector< vector<Id> > constrained_comms = constrained_partition->get_communities();
+  // A node is stable (i.e. need not be considered) as long as it is not queued.
+  VertexQueue& vertex_order = this->_vertex_queue;
+  vertex_order.reset(n);
+  vertex_order.push_all_shuffled(&rng);
 
   // Initialize the degree vector
   // If we want to debug the function, we will calculate some additional values.
@@ -874,45 +1504,67 @@ Weight Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
   // (2) - The quality function should be exactly the same value after
   //       aggregating/collapsing the graph.
 
+  #ifdef STATISTICS
+    // Nodes are considered in passes: the first pass consists of all nodes,
+    // and each next pass of the nodes that were queued at the end of the
+    // previous pass.
+    Id pass_remaining = 0;
+  #endif
+
+  this->_stopped = false;
+  Id nb_visits = 0;
+
   // As long as the queue is not empty
   while(!vertex_order.empty())
   {
-    Id v = vertex_order.front(); vertex_order.pop();
+    if (!this->visit_node(nb_visits))
+      break;
 
-    set<Id> comms;
-    const Graph* graph = nullptr;
-    MutableVertexPartition* partition = nullptr;
+    #ifdef STATISTICS
+      if (pass_remaining == 0)
+      {
+        pass_remaining = vertex_order.size();
+        this->statistics.nb_moves_per_pass.push_back(0);
+      }
+      pass_remaining--;
+    #endif
+
+    Id v = vertex_order.pop();
+
+    this->_comms.clear();
     // What is the current community of the node (this should be the same for all layers)
-    Id v_comm = partitions[0]->membership(v);
+    Id v_comm = partitions[0]->membership<false>(v);
 
     if (consider_comms == ALL_COMMS)
     {
         // Add all communities to the set comms that are within the constrained community.
         Id v_constrained_comm = constrained_partition->membership(v);
-        for (vector<Id>::const_iterator u_constrained_comm_it = constrained_comms[v_constrained_comm].begin();
-             u_constrained_comm_it != constrained_comms[v_constrained_comm].end();
+        for (vector<Id>::const_iterator u_constrained_comm_it = constrained_partition->community_begin(v_constrained_comm);
+             u_constrained_comm_it != constrained_partition->community_end(v_constrained_comm);
              u_constrained_comm_it++)
         {
           Id u = *u_constrained_comm_it;
-          Id u_comm = partitions[0]->membership(u);
-          comms.insert(u_comm);
+          Id u_comm = partitions[0]->membership<false>(u);
+          this->add_candidate_comm(u_comm);
         }
     }
     else if (consider_comms == ALL_NEIGH_COMMS)
     {
         /****************************ALL NEIGH COMMS*****************************/
-        for (Id layer = 0; layer < nb_layers; layer++)
+        for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
         {
+          Id layer = *it_layer;
           set<Id> neigh_comm_layer = partitions[layer]->get_neigh_comms(v, IGRAPH_ALL, constrained_partition->membership());
-          comms.insert(neigh_comm_layer.begin(), neigh_comm_layer.end());
+          for (Id comm : neigh_comm_layer)
+            this->add_candidate_comm(comm);
         }
     }
     else if (consider_comms == RAND_COMM)
     {
       /****************************RAND COMM***********************************/
         Id v_constrained_comm = constrained_partition->membership(v);
-        Id random_idx = get_random_int(0, constrained_comms[v_constrained_comm].size() - 1, &rng);
-        comms.insert(constrained_comms[v_constrained_comm][random_idx]);
+        Id random_idx = get_random_int(0, constrained_partition->cnodes(v_constrained_comm) - 1, &rng);
+        this->add_candidate_comm(*(constrained_partition->community_begin(v_constrained_comm) + random_idx));
     }
     else if (consider_comms == RAND_NEIGH_COMM)
     {
@@ -921,54 +1573,44 @@ Weight Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
         // frequency of the communities among the neighbours. Notice this is no
         // longer
         vector<Id> all_neigh_comms_incl_dupes;
-        for (Id layer = 0; layer < nb_layers; layer++)
+        for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
         {
+          Id layer = *it_layer;
           set<Id> neigh_comm_layer = partitions[layer]->get_neigh_comms(v, IGRAPH_ALL, constrained_partition->membership());
           all_neigh_comms_incl_dupes.insert(all_neigh_comms_incl_dupes.end(), neigh_comm_layer.begin(), neigh_comm_layer.end());
         }
         if (all_neigh_comms_incl_dupes.size() > 0)
         {
           Id random_idx = get_random_int(0, all_neigh_comms_incl_dupes.size() - 1, &rng);
-          comms.insert(all_neigh_comms_incl_dupes[random_idx]);
+          this->add_candidate_comm(all_neigh_comms_incl_dupes[random_idx]);
         }
     }
 
     #ifdef DEBUG
-      cerr << "Consider " << comms.size() << " communities for moving." << endl;
+      cerr << "Consider " << this->_comms.size() << " communities for moving." << endl;
     #endif
 
     Id max_comm = v_comm;
     Weight max_improv = 0.0;
 
-    for (set<Id>::iterator comm_it = comms.begin();
-         comm_it!= comms.end();
-         comm_it++)
+    this->sort_candidate_comms();
+    this->diff_move_candidates<Partition>(v, partitions, layer_weights);
+    for (Id i = 0; i < this->_comms.size(); i++)
     {
-      Id comm = *comm_it;
-      Weight possible_improv = 0.0;
-
-      // Consider the improvement of moving to a community for all layers
-      for (Id layer = 0; layer < nb_layers; layer++)
-      {
-        graph = graphs[layer];
-        partition = partitions[layer];
-        // Make sure to multiply it by the weight per layer
-        possible_improv += layer_weights[layer]*partition->diff_move(v, comm);
-      }
-
       // Check if improvement is best
-      if (possible_improv > max_improv)
+      if (this->_improvs[i] > max_improv)
       {
-        max_comm = comm;
-        max_improv = possible_improv;
+        max_comm = this->_comms[i];
+        max_improv = this->_improvs[i];
       }
     }
 
-    is_node_stable[v] = true;
-
     // If we actually plan to move the nove
     if (max_comm != v_comm)
     {
+      #ifdef STATISTICS
+        this->statistics.nb_moves++;
+      #endif
       // Keep track of improvement
       total_improv += max_improv;
 
@@ -977,8 +1619,9 @@ Weight Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
         Weight q_improv = 0;
       #endif
 
-      for (Id layer = 0; layer < nb_layers; layer++)
+      for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
       {
+        Id layer = *it_layer;
         MutableVertexPartition* partition = partitions[layer];
 
         #ifdef DEBUG
@@ -1009,28 +1652,45 @@ Weight Optimiser::move_nodes_constrained(vector<MutableVertexPartition*> partiti
         }
       #endif
 
-      // Mark neighbours as unstable (if not in new community)
-      vector<Id> const& neighs = graph->get_neighbours(v, IGRAPH_ALL);
-      for (vector<Id>::const_iterator it_neigh = neighs.begin();
-           it_neigh != neighs.end(); it_neigh++)
+      // Mark neighbours in any of the layers as unstable (if not in new
+      // community). Neighbours in another constrained community cannot be
+      // affected by the move, since they can only move within their own.
+      Id v_constrained_comm = constrained_partition->membership(v);
+      for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
       {
-        Id u = *it_neigh;
-        // If the neighbour was stable and is not in the new community, we
-        // should mark it as unstable, and add it to the queue
-        if (is_node_stable[u] && partition->membership(v) != max_comm)
+        Id layer = *it_layer;
+        vector<Id> const& neighs = graphs[layer]->get_neighbours(v, IGRAPH_ALL);
+        for (vector<Id>::const_iterator it_neigh = neighs.begin();
+             it_neigh != neighs.end(); it_neigh++)
         {
-          vertex_order.push(u);
-          is_node_stable[u] = false;
+          Id u = *it_neigh;
+          // If the neighbour was stable and is not in the new community, we
+          // should mark it as unstable, and add it to the queue
+          if (partitions[0]->membership<false>(u) != max_comm &&
+              constrained_partition->membership(u) == v_constrained_comm &&
+              vertex_order.push(u))
+          {
+            #ifdef STATISTICS
+              this->statistics.nb_reactivations++;
+            #endif
+          }
         }
       }
 
       // Keep track of number of moves
       nb_moves += 1;
+      #ifdef STATISTICS
+        this->statistics.nb_moves_per_pass.back()++;
+      #endif
     }
     #ifdef DEBUG
       cerr << "Moved " << nb_moves << " nodes." << endl;
     #endif
   }
+  #ifdef STATISTICS
+    this->update_peak_scratch_memory();
+  #endif
+
   partitions[0]->renumber_communities();
   vector<Id> const& membership = partitions[0]->membership();
   for (Id layer = 1; layer < nb_layers; layer++)
@@ -1049,6 +1709,26 @@ Weight Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
 }
 
 Weight Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partitions, vector<Weight> layer_weights, int consider_comms, MutableVertexPartition* constrained_partition)
+{
+  // Dispatch once to the kernel for the type of the partitions
+  if (has_type<ModularityVertexPartition>(partitions))
+    return this->merge_nodes_constrained_kernel<ModularityVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+  else if (has_type<CPMVertexPartition>(partitions))
+    return this->merge_nodes_constrained_kernel<CPMVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+  else if (has_type<RBConfigurationVertexPartition>(partitions))
+    return this->merge_nodes_constrained_kernel<RBConfigurationVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+  else if (has_type<RBERVertexPartition>(partitions))
+    return this->merge_nodes_constrained_kernel<RBERVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+  else if (has_type<SignificanceVertexPartition>(partitions))
+    return this->merge_nodes_constrained_kernel<SignificanceVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+  else if (has_type<SurpriseVertexPartition>(partitions))
+    return this->merge_nodes_constrained_kernel<SurpriseVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+  else
+    return this->merge_nodes_constrained_kernel<MutableVertexPartition>(partitions, layer_weights, consider_comms, constrained_partition);
+}
+
+template <class Partition>
+Weight Optimiser::merge_nodes_constrained_kernel(vector<MutableVertexPartition*> const& partitions, vector<Weight> const& layer_weights, int consider_comms, MutableVertexPartition* constrained_partition)
 {
   #ifdef DEBUG
     cerr << "Weight Optimiser::merge_nodes(vector<MutableVertexPartition*> partitions, vector<Weight> weights)" << endl;
@@ -1072,6 +1752,9 @@ Weight Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
   for (Id layer = 0; layer < nb_layers; layer++)
     if (graphs[layer]->vcount() != n)
       throw LeidenException("Number of nodes are not equal for all graphs.");
+  if (graphs[0]->is_sparse())
+    throw LeidenException("The first layer should not be sparse.");
+  this->index_active_layers(graphs);
 
   // Establish vertex order
   // We normally initialize the normal vertex order
@@ -1082,50 +1765,55 @@ Weight Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
   // But if we use a random order, we shuffle this order.
   shuffle(vertex_order, &rng);
 
-  vector< vector<Id> > constrained_comms = constrained_partition->get_communities();
+  this->_stopped = false;
+  Id nb_visits = 0;
 
   // For each node
   for (vector<Id>::iterator it = vertex_order.begin();
        it != vertex_order.end(); it++)
   {
+    if (!this->visit_node(nb_visits))
+      break;
+
     Id v = *it;
 
     // What is the current community of the node (this should be the same for all layers)
-    Id v_comm = partitions[0]->membership(v);
+    Id v_comm = partitions[0]->membership<false>(v);
 
     if (partitions[0]->cnodes(v_comm) == 1)
     {
-      set<Id> comms;
-      MutableVertexPartition* partition = nullptr;
+      this->_comms.clear();
 
       if (consider_comms == ALL_COMMS)
       {
           // Add all communities to the set comms that are within the constrained community.
           Id v_constrained_comm = constrained_partition->membership(v);
-          for (vector<Id>::const_iterator u_constrained_comm_it = constrained_comms[v_constrained_comm].begin();
-               u_constrained_comm_it != constrained_comms[v_constrained_comm].end();
+          for (vector<Id>::const_iterator u_constrained_comm_it = constrained_partition->community_begin(v_constrained_comm);
+               u_constrained_comm_it != constrained_partition->community_end(v_constrained_comm);
                u_constrained_comm_it++)
           {
             Id u = *u_constrained_comm_it;
-            Id u_comm = partitions[0]->membership(u);
-            comms.insert(u_comm);
+            Id u_comm = partitions[0]->membership<false>(u);
+            this->add_candidate_comm(u_comm);
           }
       }
       else if (consider_comms == ALL_NEIGH_COMMS)
       {
           /****************************ALL NEIGH COMMS*****************************/
-          for (Id layer = 0; layer < nb_layers; layer++)
+          for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
           {
+            Id layer = *it_layer;
             set<Id> neigh_comm_layer = partitions[layer]->get_neigh_comms(v, IGRAPH_ALL, constrained_partition->membership());
-            comms.insert(neigh_comm_layer.begin(), neigh_comm_layer.end());
+            for (Id comm : neigh_comm_layer)
+              this->add_candidate_comm(comm);
           }
       }
       else if (consider_comms == RAND_COMM)
       {
         /****************************RAND COMM***********************************/
           Id v_constrained_comm = constrained_partition->membership(v);
-          Id random_idx = get_random_int(0, constrained_comms[v_constrained_comm].size() - 1, &rng);
-          comms.insert(constrained_comms[v_constrained_comm][random_idx]);
+          Id random_idx = get_random_int(0, constrained_partition->cnodes(v_constrained_comm) - 1, &rng);
+          this->add_candidate_comm(*(constrained_partition->community_begin(v_constrained_comm) + random_idx));
       }
       else if (consider_comms == RAND_NEIGH_COMM)
       {
@@ -1134,8 +1822,9 @@ Weight Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
           // frequency of the communities among the neighbours. Notice this is no
           // longer
           vector<Id> all_neigh_comms_incl_dupes;
-          for (Id layer = 0; layer < nb_layers; layer++)
+          for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
           {
+            Id layer = *it_layer;
             set<Id> neigh_comm_layer = partitions[layer]->get_neigh_comms(v, IGRAPH_ALL, constrained_partition->membership());
             all_neigh_comms_incl_dupes.insert(all_neigh_comms_incl_dupes.end(), neigh_comm_layer.begin(), neigh_comm_layer.end());
           }
@@ -1146,42 +1835,34 @@ Weight Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
             if (get_random_int(0, k, &rng) > 0)
             {
               Id random_idx = get_random_int(0, k - 1, &rng);
-              comms.insert(all_neigh_comms_incl_dupes[random_idx]);
+              this->add_candidate_comm(all_neigh_comms_incl_dupes[random_idx]);
             }
           }
       }
 
       #ifdef DEBUG
-        cerr << "Consider " << comms.size() << " communities for moving." << endl;
+        cerr << "Consider " << this->_comms.size() << " communities for moving." << endl;
       #endif
 
       Id max_comm = v_comm;
       Weight max_improv = 0.0;
-      for (set<Id>::iterator comm_it = comms.begin();
-           comm_it!= comms.end();
-           comm_it++)
+      this->sort_candidate_comms();
+      this->diff_move_candidates<Partition>(v, partitions, layer_weights);
+      for (Id i = 0; i < this->_comms.size(); i++)
       {
-        Id comm = *comm_it;
-        Weight possible_improv = 0.0;
-
-        // Consider the improvement of moving to a community for all layers
-        for (Id layer = 0; layer < nb_layers; layer++)
-        {
-          partition = partitions[layer];
-          // Make sure to multiply it by the weight per layer
-          possible_improv += layer_weights[layer]*partition->diff_move(v, comm);
-        }
-
-        if (possible_improv >= max_improv)
+        if (this->_improvs[i] >= max_improv)
         {
-          max_comm = comm;
-          max_improv = possible_improv;
+          max_comm = this->_comms[i];
+          max_improv = this->_improvs[i];
         }
       }
 
       // If we actually plan to move the node
       if (max_comm != v_comm)
       {
+        #ifdef STATISTICS
+          this->statistics.nb_moves++;
+        #endif
           // Keep track of improvement
           total_improv += max_improv;
 
@@ -1190,8 +1871,9 @@ Weight Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
             Weight q_improv = 0;
           #endif
 
-          for (Id layer = 0; layer < nb_layers; layer++)
+          for (Id const* it_layer = this->active_layers_begin(v); it_layer != this->active_layers_end(v); it_layer++)
           {
+            Id layer = *it_layer;
             MutableVertexPartition* partition = partitions[layer];
 
             #ifdef DEBUG
@@ -1225,6 +1907,10 @@ Weight Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
       }
   }
 
+  #ifdef STATISTICS
+    this->update_peak_scratch_memory();
+  #endif
+
   partitions[0]->renumber_communities();
   vector<Id> const& membership = partitions[0]->membership();
   for (Id layer = 1; layer < nb_layers; layer++)
@@ -1236,3 +1922,518 @@ Weight Optimiser::merge_nodes_constrained(vector<MutableVertexPartition*> partit
   }
   return total_improv;
 }
+
+/*****************************************************************************
+  Resolution profile of a partition with a linear resolution parameter.
+
+  The range of resolution parameters is bisected as long as the bisection
+  values (the total internal weight) of the best partitions found for both
+  ends of an interval differ by more than min_diff_bisect_value, and the
+  interval is larger than min_diff_resolution (on a logarithmic scale if
+  both ends are positive, unless linear_bisection). Each resolution parameter
+  is probed by optimising a partition starting from singletons, which is
+  repeated while it improves, up to number_iterations times (or until it is
+  stable if number_iterations <= 0).
+
+  The bisection proceeds by levels: both ends of the range are probed
+  first, and every next level probes the midpoints of all intervals of the
+  previous level that should still be bisected. An interval of which the
+  midpoint equals one of its ends is not bisected, so that the bisection
+  always ends. The probes of a level run concurrently on nb_threads threads,
+  each with a copy of the settings of this optimiser (but without the
+  progress callback) and a single partition that is reset for every probe.
+  The first thread uses the graph of partition, the others a clone of that
+  graph, since the neighbour caches of a graph cannot be shared between
+  threads. The clones share the adjacency of the graph, so that the threads
+  only call igraph (serialised by igraph_mutex, see GraphHelper.h) to create
+  and destroy the collapsed graphs. The random generator for a probe is
+  derived from its resolution parameter, and the partitions found at a level
+  are merged in order of their resolution parameters once all probes of the
+  level are done, so that the profile only depends on the seed, and not on
+  the number of threads.
+
+  As the quality is linear in the resolution parameter (see
+  LinearResolutionParameterVertexPartition), only the membership, the total
+  internal weight and the resolution penalty of every partition found are
+  kept, so that comparing partitions at some resolution parameter is cheap.
+  Because of the randomness of the optimisation, a partition found for one
+  resolution parameter may be better than the partition found for another,
+  which is then replaced, so that the bisection values remain (mostly)
+  monotone. Finally, the best partition for every resolution parameter
+  probed follows from the upper envelope of the qualities of all partitions,
+  and only the resolution parameters at which the bisection value changes
+  are kept.
+*****************************************************************************/
+vector<LinearResolutionParameterVertexPartition*> Optimiser::resolution_profile(LinearResolutionParameterVertexPartition* partition,
+  Weight resolution_min, Weight resolution_max)
+{
+  return this->resolution_profile(partition, resolution_min, resolution_max, 1.0, 1e-3, false, 1, 0);
+}
+
+vector<LinearResolutionParameterVertexPartition*> Optimiser::resolution_profile(LinearResolutionParameterVertexPartition* partition,
+  Weight resolution_min, Weight resolution_max, Weight min_diff_bisect_value, Weight min_diff_resolution,
+  bool linear_bisection, int number_iterations, Id nb_threads)
+{
+  #ifdef DEBUG
+    cerr << "vector<LinearResolutionParameterVertexPartition*> Optimiser::resolution_profile(" << resolution_min << ", " << resolution_max << ")" << endl;
+  #endif
+  if (resolution_min > resolution_max)
+    throw LeidenException("The minimum resolution parameter should not be larger than the maximum.");
+  if (!(min_diff_resolution > 0))
+    throw LeidenException("The minimum difference in resolution parameter should be positive.");
+  if (nb_threads == 0)
+    nb_threads = std::max(std::thread::hardware_concurrency(), 1u);
+
+  const Graph* graph = partition->get_graph();
+  const Id n = graph->vcount();
+  const RNG rng = this->rng.stream(this->rng.next());
+
+  // All partitions found, with their total internal weight and penalty
+  vector< vector<Id> > memberships;
+  vector<Weight> weights;
+  vector<Weight> penalties;
+  // Best partition found so far for each resolution parameter probed
+  map<Weight, Id> best;
+  auto is_better = [&](Id i, Id j, Weight resolution)
+  {
+    return weights[i] - resolution*penalties[i] > weights[j] - resolution*penalties[j];
+  };
+
+  // Partition and optimiser of every thread, created when the thread probes
+  // its first resolution parameter. The partitions own the clones of the
+  // graph, if any.
+  vector<LinearResolutionParameterVertexPartition*> thread_partitions(nb_threads, nullptr);
+  vector<Optimiser> thread_optimisers(nb_threads, *this);
+  for (Optimiser& optimiser : thread_optimisers)
+    optimiser.progress_callback = ProgressCallback();
+
+  // Resolution parameters probed at the current level, with the interval
+  // that each of them bisects (not for both ends of the range), and the
+  // partitions found for them
+  vector<Weight> level;
+  vector< pair<Weight, Weight> > level_intervals;
+  vector< vector<Id> > level_memberships;
+  vector<Weight> level_weights;
+  vector<Weight> level_penalties;
+  level.push_back(resolution_min);
+  if (resolution_min < resolution_max)
+    level.push_back(resolution_max);
+  // Intervals to be bisected at the next level, in increasing order
+  vector< pair<Weight, Weight> > intervals;
+
+  Id next_probe = 0;
+  std::exception_ptr error;
+  std::mutex mutex;
+  auto worker = [&](Id thread)
+  {
+    try
+    {
+      while (true)
+      {
+        Id k;
+        {
+          std::lock_guard<std::mutex> lock(mutex);
+          if (error || next_probe >= level.size())
+            break;
+          k = next_probe++;
+        }
+        Weight resolution = level[k];
+        #ifdef DEBUG
+          cerr << "Probe resolution parameter " << resolution << " on thread " << thread << "." << endl;
+        #endif
+        LinearResolutionParameterVertexPartition*& worker_partition = thread_partitions[thread];
+        if (!worker_partition)
+        {
+          Graph* worker_graph = thread > 0 ? graph->clone() : nullptr;
+          try
+          {
+            worker_partition = static_cast<LinearResolutionParameterVertexPartition*>(
+              partition->create(thread > 0 ? worker_graph : graph));
+          }
+          catch (...)
+          {
+            delete worker_graph;
+            throw;
+          }
+        }
+        Optimiser& optimiser = thread_optimisers[thread];
+        worker_partition->set_membership(range(n));
+        worker_partition->resolution_parameter = resolution;
+        uint64_t resolution_bits;
+        memcpy(&resolution_bits, &resolution, sizeof(resolution_bits));
+        optimiser.rng = rng.stream(resolution_bits);
+        int nb_iterations = 0;
+        while (optimiser.optimise_partition(worker_partition) > 0 &&
+               (nb_iterations < number_iterations || number_iterations <= 0))
+          nb_iterations++;
+        level_memberships[k] = worker_partition->membership();
+        level_weights[k] = worker_partition->total_weight_in_all_comms();
+        level_penalties[k] = worker_partition->resolution_penalty();
+      }
+    }
+    catch (...)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      if (!error)
+        error = std::current_exception();
+    }
+  };
+
+  while (!level.empty())
+  {
+    // Probe all resolution parameters of the level concurrently
+    level_memberships.assign(level.size(), vector<Id>());
+    level_weights.assign(level.size(), 0.0);
+    level_penalties.assign(level.size(), 0.0);
+    next_probe = 0;
+    vector<std::thread> threads;
+    for (Id thread = 1; thread < std::min<Id>(nb_threads, level.size()); thread++)
+      threads.push_back(std::thread(worker, thread));
+    worker(0);
+    for (std::thread& thread : threads)
+      thread.join();
+    if (error)
+      break;
+
+    // Merge the partitions in order of the level. A new partition replaces
+    // the best partition of other resolution parameters if it is better, and
+    // the best partition for its own resolution parameter is determined.
+    for (Id k = 0; k < level.size(); k++)
+    {
+      Weight resolution = level[k];
+      Id i = memberships.size();
+      memberships.push_back(std::move(level_memberships[k]));
+      weights.push_back(level_weights[k]);
+      penalties.push_back(level_penalties[k]);
+      for (pair<const Weight, Id>& resolution_best : best)
+        if (is_better(i, resolution_best.second, resolution_best.first))
+          resolution_best.second = i;
+      Id best_i = i;
+      for (Id j = 0; j < i; j++)
+        if (is_better(j, best_i, resolution))
+          best_i = j;
+      best[resolution] = best_i;
+    }
+
+    intervals.clear();
+    if (level_intervals.empty())
+    {
+      if (resolution_min < resolution_max)
+        intervals.push_back(make_pair(resolution_min, resolution_max));
+    }
+    else
+    {
+      for (Id k = 0; k < level.size(); k++)
+      {
+        intervals.push_back(make_pair(level_intervals[k].first, level[k]));
+        intervals.push_back(make_pair(level[k], level_intervals[k].second));
+      }
+    }
+
+    // Bisect the intervals of which both ends still differ sufficiently. An
+    // interval of which the midpoint equals one of its ends (as the floating
+    // point numbers are too close) cannot be bisected any further.
+    level.clear();
+    level_intervals.clear();
+    for (pair<Weight, Weight> const& interval : intervals)
+    {
+      Weight diff_bisect_value = fabs(weights[best[interval.first]] - weights[best[interval.second]]);
+      bool log_scale = interval.first > 0 && interval.second > 0 && !linear_bisection;
+      Weight diff_resolution = log_scale ? log(interval.second/interval.first) : fabs(interval.second - interval.first);
+      if (diff_bisect_value <= min_diff_bisect_value || diff_resolution <= min_diff_resolution)
+        continue;
+      Weight resolution = log_scale ? sqrt(interval.first*interval.second) : (interval.first + interval.second)/2.0;
+      if (resolution <= interval.first || resolution >= interval.second || best.count(resolution))
+        continue;
+      level.push_back(resolution);
+      level_intervals.push_back(interval);
+    }
+  }
+  for (LinearResolutionParameterVertexPartition* worker_partition : thread_partitions)
+    delete worker_partition;
+  if (error)
+    std::rethrow_exception(error);
+
+  // Upper envelope of the qualities weights[i] - resolution*penalties[i] of
+  // all partitions. The partitions are ordered by decreasing penalty (i.e.
+  // the best partition for increasingly large resolution parameters), where
+  // only the largest weight is considered for equal penalties, and partitions
+  // that are never strictly better than both neighbouring partitions on the
+  // envelope are removed.
+  vector<Id> order = range(memberships.size());
+  sort(order.begin(), order.end(), [&](Id i, Id j)
+  {
+    return penalties[i] > penalties[j] || (penalties[i] == penalties[j] && weights[i] > weights[j]);
+  });
+  vector<Id> envelope;
+  for (Id i : order)
+  {
+    if (!envelope.empty() && penalties[envelope.back()] == penalties[i])
+      continue;
+    while (envelope.size() >= 2)
+    {
+      Id i1 = envelope[envelope.size() - 2], i2 = envelope.back();
+      if ((weights[i1] - weights[i2])*(penalties[i2] - penalties[i]) >= (weights[i2] - weights[i])*(penalties[i1] - penalties[i2]))
+        envelope.pop_back();
+      else
+        break;
+    }
+    envelope.push_back(i);
+  }
+
+  // Best partition for every resolution parameter probed (in increasing
+  // order), only keeping those at which the bisection value changes.
+  vector<LinearResolutionParameterVertexPartition*> profile;
+  Id e = 0;
+  Id previous_i = memberships.size();
+  for (pair<const Weight, Id> const& resolution_best : best)
+  {
+    Weight resolution = resolution_best.first;
+    while (e + 1 < envelope.size() && !is_better(envelope[e], envelope[e + 1], resolution))
+      e++;
+    Id i = is_better(envelope[e], resolution_best.second, resolution) ? envelope[e] : resolution_best.second;
+    if (previous_i == memberships.size() || weights[i] != weights[previous_i])
+    {
+      LinearResolutionParameterVertexPartition* profile_partition =
+        static_cast<LinearResolutionParameterVertexPartition*>(partition->create(graph, memberships[i]));
+      profile_partition->resolution_parameter = resolution;
+      profile.push_back(profile_partition);
+    }
+    previous_i = i;
+  }
+  #ifdef DEBUG
+    cerr << "exit Optimiser::resolution_profile(), probed " << memberships.size() << " resolution parameters, kept " << profile.size() << "." << endl;
+  #endif
+  return profile;
+}
+
+/*****************************************************************************
+  Resolution sweep of a partition with a linear resolution parameter.
+
+  Rather than optimising every resolution parameter from singletons, the
+  resolution parameters are processed in decreasing order, and the partition
+  for each resolution parameter is initialised with the membership of the
+  partition found for the previous (i.e. next larger) one. Only the partition
+  for the largest resolution parameter starts from singletons. Since the
+  communities tend to merge for smaller resolution parameters, the first
+  levels of the optimisation then find few improvements.
+
+  With aggregate, the communities of the previous partition are not refined
+  but aggregated as a whole, as for a warm start without changed nodes (see
+  optimise_partition), so that the optimisation starts directly from the
+  aggregate graph of the previous partition. This is considerably faster for
+  large graphs, but communities cannot be split anymore, so that the quality
+  may be somewhat lower than without aggregating.
+
+  If the optimisation is stopped (see progress_callback), the partitions of
+  the remaining resolution parameters are not optimised, but equal to the
+  last partition found.
+*****************************************************************************/
+vector<LinearResolutionParameterVertexPartition*> Optimiser::resolution_sweep(LinearResolutionParameterVertexPartition* partition,
+  vector<Weight> resolutions)
+{
+  return this->resolution_sweep(partition, resolutions, false);
+}
+
+vector<LinearResolutionParameterVertexPartition*> Optimiser::resolution_sweep(LinearResolutionParameterVertexPartition* partition,
+  vector<Weight> resolutions, bool aggregate)
+{
+  #ifdef DEBUG
+    cerr << "vector<LinearResolutionParameterVertexPartition*> Optimiser::resolution_sweep(" << resolutions.size() << " resolution parameters, " << aggregate << ")" << endl;
+  #endif
+  const Graph* graph = partition->get_graph();
+  sort(resolutions.begin(), resolutions.end());
+
+  vector<LinearResolutionParameterVertexPartition*> sweep(resolutions.size(), nullptr);
+  vector<Id> membership = range(graph->vcount());
+  const vector<Id> no_changed_nodes;
+  bool stopped = false;
+  try
+  {
+    for (size_t i = resolutions.size(); i-- > 0; )
+    {
+      sweep[i] = static_cast<LinearResolutionParameterVertexPartition*>(partition->create(graph, membership));
+      sweep[i]->resolution_parameter = resolutions[i];
+      if (!stopped)
+      {
+        #ifdef DEBUG
+          cerr << "Sweep resolution parameter " << resolutions[i] << endl;
+        #endif
+        // There is nothing to aggregate if all communities are singletons
+        if (aggregate && sweep[i]->n_communities() < graph->vcount())
+          this->optimise_partition(sweep[i], no_changed_nodes);
+        else
+          this->optimise_partition(sweep[i]);
+        stopped = this->_stopped;
+        membership = sweep[i]->membership();
+      }
+    }
+  }
+  catch (...)
+  {
+    for (LinearResolutionParameterVertexPartition* sweep_partition : sweep)
+      delete sweep_partition;
+    throw;
+  }
+  this->_stopped = stopped;
+  #ifdef DEBUG
+    cerr << "exit Optimiser::resolution_sweep()" << endl;
+  #endif
+  return sweep;
+}
+
+/*****************************************************************************
+  Ensemble of independent optimisations of a partition.
+
+  Each of the nb_runs runs starts from the current membership of partition,
+  and is optimised for number_iterations iterations (or until there is no
+  improvement if negative) with its own random stream, derived from the
+  random generator of this optimiser and the index of the run. The runs are
+  distributed over nb_threads threads (all cores if 0), each with its own
+  partition and optimiser, so that the result does not depend on the number
+  of threads. The graph is not changed by the runs, and is shared by all
+  threads, each of the other threads using a clone that shares its topology,
+  since the neighbours are cached by the graph.
+
+  The partition is then set to the best partition found, preferring the
+  first run for equal qualities, and its quality is returned. Only the best
+  membership so far is kept, and the agreement of the edges is counted after
+  each run, so that the memberships of all runs are never stored. Each
+  thread counts the agreement of its own runs, so that the threads only
+  synchronise to take a run and to compare their quality with the best one.
+
+  Parameters:
+    partition         -- The partition to optimise, which determines the graph
+                         and the type of the partitions of the runs.
+    nb_runs           -- The number of runs.
+    number_iterations -- The number of iterations of each run.
+    nb_threads        -- The number of threads.
+    edge_agreement    -- If not nullptr, set to the fraction of the runs in
+                         which both endpoints of each edge are in the same
+                         community.
+*****************************************************************************/
+Weight Optimiser::ensemble(MutableVertexPartition* partition, Id nb_runs)
+{
+  return this->ensemble(partition, nb_runs, 2, 0, nullptr);
+}
+
+Weight Optimiser::ensemble(MutableVertexPartition* partition, Id nb_runs, int number_iterations, Id nb_threads, vector<Weight>* edge_agreement)
+{
+  #ifdef DEBUG
+    cerr << "Weight Optimiser::ensemble(" << nb_runs << " runs, " << number_iterations << " iterations)" << endl;
+  #endif
+  if (nb_runs == 0)
+    throw LeidenException("The number of runs should be positive.");
+  if (nb_threads == 0)
+    nb_threads = std::max(std::thread::hardware_concurrency(), 1u);
+  if (nb_threads > nb_runs)
+    nb_threads = nb_runs;
+
+  const Graph* graph = partition->get_graph();
+  const Id n = graph->vcount();
+  const Id m = graph->ecount();
+  const RNG rng = this->rng.stream(this->rng.next());
+  vector<Id> start_membership(n);
+  for (Id v = 0; v < n; v++)
+    start_membership[v] = partition->membership(v);
+
+  // Number of runs in which the endpoints of each edge are in the same
+  // community, counted by each thread for its own runs without any locking,
+  // and summed once all runs are done
+  vector< vector<Id> > nb_agree(nb_threads);
+
+  Id next_run = 0;
+  Id best_run = nb_runs;
+  Weight best_quality = 0.0;
+  vector<Id> best_membership;
+  std::exception_ptr error;
+  std::mutex mutex;
+
+  auto worker = [&](Id thread)
+  {
+    Graph* worker_graph = nullptr;
+    MutableVertexPartition* worker_partition = nullptr;
+    std::unique_lock<std::mutex> lock(mutex, std::defer_lock);
+    try
+    {
+      if (thread > 0)
+        worker_graph = graph->clone();
+      const Graph* run_graph = thread > 0 ? worker_graph : graph;
+      // The partition owns the clone of the graph, if any
+      worker_partition = partition->create(run_graph, start_membership);
+      Optimiser optimiser(*this);
+      optimiser.progress_callback = ProgressCallback();
+      vector<Id>& thread_nb_agree = nb_agree[thread];
+      if (edge_agreement != nullptr)
+        thread_nb_agree.resize(m, 0);
+
+      lock.lock();
+      while (!error && next_run < nb_runs)
+      {
+        Id run = next_run++;
+        lock.unlock();
+
+        #ifdef DEBUG
+          cerr << "Run " << run << " on thread " << thread << "." << endl;
+        #endif
+        worker_partition->set_membership(start_membership);
+        optimiser.rng = rng.stream(run);
+        for (int iteration = 0; iteration < number_iterations || number_iterations < 0; iteration++)
+          if (optimiser.optimise_partition(worker_partition) <= 0 && number_iterations < 0)
+            break;
+        Weight quality = worker_partition->quality();
+        for (Id e = 0; e < thread_nb_agree.size(); e++)
+        {
+          pair<Id, Id> endpoints = run_graph->get_endpoints(e);
+          if (worker_partition->membership(endpoints.first) == worker_partition->membership(endpoints.second))
+            thread_nb_agree[e]++;
+        }
+
+        lock.lock();
+        if (best_run == nb_runs || quality > best_quality || (quality == best_quality && run < best_run))
+        {
+          best_run = run;
+          best_quality = quality;
+          best_membership = worker_partition->membership();
+        }
+      }
+    }
+    catch (...)
+    {
+      if (!lock.owns_lock())
+        lock.lock();
+      if (!error)
+        error = std::current_exception();
+    }
+    if (lock.owns_lock())
+      lock.unlock();
+    if (worker_partition)
+      delete worker_partition;
+    else if (worker_graph)
+      delete worker_graph;
+  };
+
+  vector<std::thread> threads;
+  for (Id thread = 1; thread < nb_threads; thread++)
+    threads.push_back(std::thread(worker, thread));
+  worker(0);
+  for (std::thread& thread : threads)
+    thread.join();
+  if (error)
+    std::rethrow_exception(error);
+
+  partition->set_membership(best_membership);
+  if (edge_agreement != nullptr)
+  {
+    edge_agreement->assign(m, 0.0);
+    for (vector<Id> const& thread_nb_agree : nb_agree)
+      for (Id e = 0; e < thread_nb_agree.size(); e++)
+        (*edge_agreement)[e] += thread_nb_agree[e];
+    for (Id e = 0; e < m; e++)
+      (*edge_agreement)[e] /= nb_runs;
+  }
+  #ifdef DEBUG
+    cerr << "exit Optimiser::ensemble(), best run " << best_run << " with quality " << best_quality << "." << endl;
+  #endif
+  return best_quality;
+}
@@ -3,6 +3,7 @@ from .VertexPartition import LinearResolutionParameterVertexPartition
 from collections import namedtuple
 from math import log, sqrt
 import sys
+import time
 
 # Check if working with Python 3
 PY3 = (sys.version > '3')
@@ -75,6 +76,7 @@ class Optimiser(object):
   def __init__(self):
     """ Create a new Optimiser object """
     self._optimiser = _c_leiden._new_Optimiser()
+    self._progress_callback = None
 
   #########################################################3
   # consider_comms
@@ -217,6 +219,137 @@ class Optimiser(object):
   def consider_empty_community(self, value):
     _c_leiden._Optimiser_set_consider_empty_community(self._optimiser, value)
 
+  #########################################################3
+  # node_order
+  @property
+  def node_order(self):
+    """ Determine in what order nodes are considered in :func:`move_nodes`.
+
+    Nodes that become unstable because a neighbour moved are considered again
+    after the initial order, unless they are prioritised.
+
+    Notes
+    -------
+    This attribute should be set to one of the following values
+
+    * :attr:`leidenalg.RAND_ORDER`
+      Consider nodes in a random order and unstable nodes in the order they
+      became unstable (default).
+
+    * :attr:`leidenalg.DEGREE_ORDER`
+      Consider nodes in order of decreasing degree, which is summed over all
+      layers.
+
+    * :attr:`leidenalg.CHANGE_ORDER`
+      Consider first the unstable nodes whose neighbourhood changed most,
+      relative to the strength of the node.
+
+    * :attr:`leidenalg.IMPROV_ORDER`
+      Consider first the unstable nodes that became unstable by a move with a
+      large improvement.
+    """
+    return _c_leiden._Optimiser_get_node_order(self._optimiser)
+
+  @node_order.setter
+  def node_order(self, value):
+    _c_leiden._Optimiser_set_node_order(self._optimiser, value)
+
+  #########################################################3
+  # statistics
+  @property
+  def statistics(self):
+    """ dict: statistics of the last call to :func:`optimise_partition`, or
+    ``None`` if the package was not built with statistics (i.e. by ``python
+    setup.py build --statistics``), in which case they are not collected at
+    all. Direct calls to :func:`move_nodes`, :func:`merge_nodes` and their
+    constrained variants are added to the statistics of the last call.
+
+    The statistics consist of
+
+    * ``level_nodes`` and ``level_edges``: the number of nodes and edges of
+      the (aggregate) graph at each level.
+
+    * ``nb_moves_per_pass``: the number of moves in each pass of
+      :func:`move_nodes` or :func:`move_nodes_constrained`. The first pass
+      of each call considers all nodes, and each next pass considers the
+      nodes that were reconsidered during the previous pass.
+
+    * ``move_seconds``, ``refine_seconds``, ``collapse_seconds`` and
+      ``init_admin_seconds``: the time spent in moving nodes, refining
+      the partition, collapsing the graph and creating partitions.
+
+    * ``nb_visits``, ``nb_moves`` and ``nb_reactivations``: the number of
+      times a node was considered for moving, was actually moved, and was
+      reconsidered because a neighbour moved.
+
+    * ``nb_diff_moves`` and ``nb_candidates``: the number of evaluations of
+      the difference in quality (summed over all layers) and the number of
+      candidate communities (summed over all visits).
+
+    * ``peak_scratch_memory``: the largest memory (in bytes) used by the
+      internal buffers of the optimiser.
+    """
+    return _c_leiden._Optimiser_get_statistics(self._optimiser)
+
+  #########################################################3
+  # progress and cancellation
+  def set_progress_callback(self, callback, interval=10000):
+    """ Set a function that is called to report the progress of the
+    optimisation, and which can stop it.
+
+    The callback is called at the start of each level (i.e. aggregation) of
+    :func:`optimise_partition`, and every ``interval`` node visits of
+    :func:`move_nodes`, :func:`merge_nodes` and their constrained variants.
+    While optimising, the GIL is released, and it is only held again during
+    the calls of the callback, so that other threads may run in the meantime.
+
+    Parameters
+    ----------
+    callback
+      Function called as ``callback(level, nb_visits)``, with the current
+      level of :func:`optimise_partition` (starting from 0) and the number of
+      node visits so far in the current moving or merging of nodes. If it
+      returns ``False`` (or raises an exception), the optimisation stops as
+      soon as possible, see :attr:`stopped`. If ``None``, no callback is
+      called.
+
+    interval : int
+      Number of node visits between calls of the callback. If 0, the callback
+      is only called per level.
+
+    Examples
+    --------
+
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> optimiser = la.Optimiser()
+    >>> optimiser.set_progress_callback(lambda level, nb_visits: level < 2)
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> diff = optimiser.optimise_partition(partition)
+    """
+    _c_leiden._Optimiser_set_progress_callback(self._optimiser, callback, interval)
+    # Keep a reference, since the optimiser only holds a borrowed one.
+    self._progress_callback = callback
+
+  @property
+  def time_limit(self):
+    """ float: maximum time (in seconds) that :func:`optimise_partition`
+    and :func:`optimise_partition_multiplex` may take for all iterations
+    together, or 0 for no limit. When the limit is reached, the optimisation
+    stops as soon as possible (see :attr:`stopped`), and the partition is the
+    best one found so far. The time is only checked at the start of each level
+    and every ``interval`` node visits (see :func:`set_progress_callback`). """
+    return _c_leiden._Optimiser_get_time_limit(self._optimiser)
+
+  @time_limit.setter
+  def time_limit(self, value):
+    _c_leiden._Optimiser_set_time_limit(self._optimiser, value)
+
+  @property
+  def stopped(self):
+    """ bool: whether the last optimisation was stopped early by the progress
+    callback or the time limit. """
+    return _c_leiden._Optimiser_get_stopped(self._optimiser)
+
   ##########################################################
   # Set rng seed
   def set_rng_seed(self, value):
@@ -229,7 +362,8 @@ class Optimiser(object):
     """
     _c_leiden._Optimiser_set_rng_seed(self._optimiser, value)
 
-  def optimise_partition(self, partition, n_iterations=2):
+  def optimise_partition(self, partition, n_iterations=2, changed_nodes=None,
+                         added_edges=None, removed_edges=None, updated_edges=None):
     """ Optimise the given partition.
 
     Parameters
@@ -242,11 +376,36 @@ class Optimiser(object):
       are run. If the number of iterations is negative, the Leiden algorithm is
       run until an iteration in which there was no improvement.
 
+    changed_nodes
+      If not ``None``, the optimisation is warm-started from the current
+      membership of the partition, and only reconsiders the given nodes and
+      their neighbours at first, see `Notes <#notes-warm-start>`_.
+
+    added_edges, removed_edges, updated_edges
+      If any of these is not ``None``, the edges of the graph of the partition
+      are first changed by :func:`~VertexPartition.MutableVertexPartition.change_edges`,
+      after which the optimisation is warm-started from the endpoints of the
+      changed edges (in addition to any ``changed_nodes``).
+
     Returns
     -------
     float
       Improvement in quality function.
 
+    .. _notes-warm-start:
+
+    Notes
+    -----
+
+    Warm-starting is meant for graphs that change over time. If the partition
+    was optimised for a previous version of the graph, and edges were inserted
+    or deleted since, the changed nodes are the endpoints of these edges. Nodes
+    of which the neighbourhood did not change are then not considered at first,
+    and only the communities affected by the change are refined, so that
+    updating the partition takes much less time than optimising it again. Each
+    next iteration starts from the nodes that changed community in the previous
+    iteration.
+
     Examples
     --------
 
@@ -255,24 +414,42 @@ class Optimiser(object):
     >>> partition = la.ModularityVertexPartition(G)
     >>> diff = optimiser.optimise_partition(partition)
 
+    When the graph changes a little, the partition can be updated by
+    warm-starting from the previous membership:
+
+    >>> G.add_edges([(0, 33), (5, 20)])
+    >>> partition = la.ModularityVertexPartition(G, initial_membership=partition.membership)
+    >>> diff = optimiser.optimise_partition(partition, changed_nodes=[0, 33, 5, 20])
+
+    Rather than creating a new partition, the edges of the partition can also
+    be changed in place, which only updates the weights of the communities
+    for the changed edges:
+
+    >>> diff = optimiser.optimise_partition(partition, added_edges=[(1, 30)], removed_edges=[0])
+
     """
 
-    itr = 0
-    diff = 0
-    continue_iteration = itr < n_iterations or n_iterations < 0
-    while continue_iteration:
-      diff_inc = _c_leiden._Optimiser_optimise_partition(self._optimiser, partition._partition)
-      diff += diff_inc
-      itr += 1
-      if n_iterations < 0:
-        continue_iteration = (diff_inc > 0)
+    if added_edges is not None or removed_edges is not None or updated_edges is not None:
+      changed_edge_nodes = partition.change_edges(added_edges, removed_edges, updated_edges)
+      if changed_nodes is None:
+        changed_nodes = changed_edge_nodes
       else:
-        continue_iteration = itr < n_iterations
-
-    partition._update_internal_membership()
+        changed_nodes = sorted(set(changed_nodes).union(changed_edge_nodes))
+
+    if changed_nodes is None:
+      optimise = lambda: _c_leiden._Optimiser_optimise_partition(self._optimiser, partition._partition)
+    else:
+      optimise = self._warm_started(
+        lambda nodes: _c_leiden._Optimiser_optimise_partition(self._optimiser, partition._partition, nodes),
+        changed_nodes)
+
+    try:
+      diff = self._iterate(optimise, n_iterations)
+    finally:
+      partition._update_internal_membership()
     return diff
 
-  def optimise_partition_multiplex(self, partitions, layer_weights=None, n_iterations=2):
+  def optimise_partition_multiplex(self, partitions, layer_weights=None, n_iterations=2, changed_nodes=None):
     """ Optimise the given partitions simultaneously.
 
     Parameters
@@ -288,6 +465,12 @@ class Optimiser(object):
       are run. If the number of iterations is negative, the Leiden algorithm is
       run until an iteration in which there was no improvement.
 
+    changed_nodes
+      If not ``None``, the optimisation is warm-started from the current
+      membership of the partitions, and only reconsiders the given nodes (in
+      any layer) and their neighbours at first, see
+      :func:`optimise_partition`.
+
     Returns
     -------
     float
@@ -353,23 +536,129 @@ class Optimiser(object):
     if not layer_weights:
       layer_weights = [1]*len(partitions)
 
-    itr = 0
-    diff = 0
-    continue_iteration = itr < n_iterations or n_iterations < 0
-    while continue_iteration:
-      diff_inc = _c_leiden._Optimiser_optimise_partition_multiplex(
+    if changed_nodes is None:
+      optimise = lambda: _c_leiden._Optimiser_optimise_partition_multiplex(
         self._optimiser,
         [partition._partition for partition in partitions],
         layer_weights)
-      diff += diff_inc
-      itr += 1
-      if n_iterations < 0:
-        continue_iteration = (diff_inc > 0)
-      else:
-        continue_iteration = itr < n_iterations
+    else:
+      optimise = self._warm_started(
+        lambda nodes: _c_leiden._Optimiser_optimise_partition_multiplex(
+          self._optimiser,
+          [partition._partition for partition in partitions],
+          layer_weights,
+          nodes),
+        changed_nodes)
+
+    try:
+      diff = self._iterate(optimise, n_iterations)
+    finally:
+      for partition in partitions:
+        partition._update_internal_membership()
+    return diff
+
+  def ensemble(self, partition, n_runs, n_iterations=2, n_threads=0, edge_agreement=False):
+    """ Optimise the given partition a number of times independently, and keep
+    the best partition found.
 
-    for partition in partitions:
+    Parameters
+    ----------
+    partition
+      The :class:`~VertexPartition.MutableVertexPartition` to optimise. Each
+      run starts from its current membership, and afterwards it holds the
+      best membership found.
+
+    n_runs : int
+      Number of independent runs.
+
+    n_iterations : int
+      Number of iterations of the Leiden algorithm in each run, see
+      :func:`optimise_partition`.
+
+    n_threads : int
+      Number of threads to use. If ``0``, as many threads as there are cores
+      are used.
+
+    edge_agreement : bool
+      If ``True``, also return for each edge the fraction of runs in which both
+      of its endpoints ended up in the same community.
+
+    Returns
+    -------
+    float
+      Quality of the best partition found.
+
+    list of float
+      Fraction of runs in which the endpoints of each edge were in the same
+      community, only returned if ``edge_agreement`` is ``True``.
+
+    Notes
+    -----
+    Each run uses its own random stream, derived from the random number
+    generator of the optimiser, so that the result does not depend on the
+    number of threads. If several runs reach the same quality, the earliest
+    one is kept. The progress callback is not called during the runs.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> optimiser = la.Optimiser()
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> quality, agreement = optimiser.ensemble(partition, n_runs=10,
+    ...                                         edge_agreement=True)
+    """
+    try:
+      result = _c_leiden._Optimiser_ensemble(
+        self._optimiser, partition._partition, n_runs,
+        number_iterations=n_iterations,
+        nb_threads=n_threads,
+        edge_agreement=edge_agreement)
+    finally:
       partition._update_internal_membership()
+    return result
+
+  def _warm_started(self, optimise, changed_nodes):
+    """ Turn optimise(nodes), a single warm-started iteration of the Leiden
+    algorithm, into a function without arguments for :func:`_iterate`. The
+    first iteration starts from changed_nodes, and each next iteration from the
+    nodes that changed community in the previous iteration, as returned by
+    optimise(nodes) together with the improvement. """
+    changed_nodes = list(changed_nodes)
+    def iteration():
+      if not changed_nodes:
+        return 0
+      diff, changed_nodes[:] = optimise(changed_nodes)
+      return diff
+    return iteration
+
+  def _iterate(self, optimise, n_iterations):
+    """ Run optimise, a single iteration of the Leiden algorithm, for
+    n_iterations iterations (or until there is no improvement if negative),
+    unless stopped by the progress callback or the time limit, which applies
+    to all iterations together. """
+    time_limit = self.time_limit
+    start = time.time()
+    itr = 0
+    diff = 0
+    continue_iteration = itr < n_iterations or n_iterations < 0
+    try:
+      while continue_iteration:
+        if time_limit > 0:
+          remaining = time_limit - (time.time() - start)
+          if remaining <= 0:
+            break
+          _c_leiden._Optimiser_set_time_limit(self._optimiser, remaining)
+        diff_inc = optimise()
+        diff += diff_inc
+        itr += 1
+        if self.stopped:
+          continue_iteration = False
+        elif n_iterations < 0:
+          continue_iteration = (diff_inc > 0)
+        else:
+          continue_iteration = itr < n_iterations
+    finally:
+      _c_leiden._Optimiser_set_time_limit(self._optimiser, time_limit)
     return diff
 
   def move_nodes(self, partition, consider_comms=None):
@@ -562,11 +851,12 @@ class Optimiser(object):
         partition_type,
         resolution_range,
         weights=None,
-        bisect_func=lambda p: p.bisect_value(),
+        bisect_func=None,
         min_diff_bisect_value=1,
         min_diff_resolution=1e-3,
         linear_bisection=False,
         number_iterations=1,
+        n_threads=0,
         **kwargs
         ):
     """ Use bisectioning on the resolution parameter in order to construct a
@@ -595,22 +885,24 @@ class Optimiser(object):
     Other Parameters
     ----------------
     bisect_func
-      The function used for bisectioning. For the methods currently
-      implemented, this should usually not be altered.
+      The function used for bisectioning. By default, the bisectioning is done
+      on :func:`~VertexPartition.LinearResolutionParameterVertexPartition.bisect_value`
+      in C++. Any other function is supported by bisectioning in Python,
+      which is slower and does not use multiple threads.
 
     min_diff_bisect_value
-      The difference in the value returned by the bisect_func below which the
+      The difference in the bisect_value of two partitions below which the
       bisectioning stops (i.e. by default, a difference of a single edge does
       not trigger further bisectioning).
 
     min_diff_resolution
-      The difference in resolution below which the bisectioning stops. For
-      positive differences, the logarithmic difference is used by default, i.e.
-      ``diff = log(res_1) - log(res_2) = log(res_1/res_2)``, for which ``diff >
-      min_diff_resolution`` to continue bisectioning. Set the linear_bisection
-      to true in order to use only linear bisectioning (in the case of negative
-      resolution parameters for example, which can happen with negative
-      weights).
+      The difference in resolution below which the bisectioning stops, which
+      should be positive. For positive differences, the logarithmic difference
+      is used by default, i.e. ``diff = log(res_1) - log(res_2) =
+      log(res_1/res_2)``, for which ``diff > min_diff_resolution`` to continue
+      bisectioning. Set the linear_bisection to true in order to use only
+      linear bisectioning (in the case of negative resolution parameters for
+      example, which can happen with negative weights).
 
     linear_bisection
       Whether the bisectioning will be done on a linear or on a logarithmic
@@ -620,6 +912,24 @@ class Optimiser(object):
       Indicates the number of iterations of the algorithm to run. If negative
       (or zero) the algorithm is run until a stable iteration.
 
+    n_threads
+      The number of threads on which different resolution values are
+      optimised concurrently. If zero, all available cores are used.
+
+    Notes
+    -----
+    The bisectioning is done in C++, where all resolution values share the
+    same graph, and the partitions are only compared using their total
+    internal weight and the term multiplied by the resolution parameter in the
+    quality, which is linear in the resolution parameter. The partitions are
+    only created on ``graph`` for the resolution values that are kept.
+
+    The resolution range is bisected level by level, where all resolution
+    values of a level are optimised concurrently, and their partitions are
+    compared in a fixed order once the level is done. The profile therefore
+    does not depend on the number of threads, and is reproducible using
+    :func:`set_rng_seed`.
+
     Examples
     --------
     >>> G = ig.Graph.Famous('Zachary')
@@ -627,14 +937,48 @@ class Optimiser(object):
     >>> profile = optimiser.resolution_profile(G, la.CPMVertexPartition,
     ...                                        resolution_range=(0,1))
     """
+    assert issubclass(partition_type, LinearResolutionParameterVertexPartition), "Bisectioning only works on partitions with a linear resolution parameter."
+    if not min_diff_resolution > 0:
+      raise ValueError("The minimum difference in resolution parameter should be positive.")
+    if bisect_func is not None and bisect_func is not partition_type.bisect_value:
+      return self._bisect_resolution_profile(graph, partition_type, resolution_range,
+          weights, bisect_func, min_diff_bisect_value, min_diff_resolution,
+          linear_bisection, number_iterations, **kwargs)
+
+    # The partition determines the graph and the type of all the partitions
+    # of the profile.
+    partition = partition_type(graph,
+                               weights=weights,
+                               resolution_parameter=resolution_range[0],
+                               **kwargs)
+    profile = _c_leiden._Optimiser_resolution_profile(
+        self._optimiser, partition._partition,
+        resolution_range[0], resolution_range[1],
+        min_diff_bisect_value=min_diff_bisect_value,
+        min_diff_resolution=min_diff_resolution,
+        linear_bisection=linear_bisection,
+        number_iterations=number_iterations,
+        nb_threads=n_threads)
+    return [partition_type(graph,
+                           initial_membership=membership,
+                           weights=weights,
+                           resolution_parameter=resolution,
+                           **kwargs)
+            for resolution, membership in profile]
+
+  def _bisect_resolution_profile(self, graph, partition_type, resolution_range,
+        weights, bisect_func, min_diff_bisect_value, min_diff_resolution,
+        linear_bisection, number_iterations, **kwargs):
+    """ Bisectioning in Python for :func:`resolution_profile`, which supports
+    any bisect_func. """
 
     # Helper function for cleaning values to be a stepwise function
     def clean_stepwise(bisect_values):
       # Check best partition for each resolution parameter
-      for res, bisect in bisect_values.iteritems():
+      for res, bisect in list(bisect_values.items()):
         best_bisect = bisect
         best_quality = bisect.partition.quality(res)
-        for res2, bisect2 in bisect_values.iteritems():
+        for res2, bisect2 in bisect_values.items():
           if bisect2.partition.quality(res) > best_quality:
             best_bisect = bisect2
             best_quality = bisect2.partition.quality(res)
@@ -643,7 +987,7 @@ class Optimiser(object):
 
       # We only need to keep the changes in the bisection values
       bisect_list = sorted([(res, part.bisect_value) for res, part in
-        bisect_values.iteritems()], key=lambda x: x[0])
+        bisect_values.items()], key=lambda x: x[0])
       for (res1, v1), (res2, v2) \
           in zip(bisect_list,
                  bisect_list[1:]):
@@ -652,7 +996,7 @@ class Optimiser(object):
         if v1 == v2:
           del bisect_values[res2]
 
-      for res, bisect in bisect_values.iteritems():
+      for res, bisect in bisect_values.items():
         bisect.partition.resolution_parameter = res
 
     # We assume here that the bisection values are
@@ -660,46 +1004,38 @@ class Optimiser(object):
     # parameter values.
     def ensure_monotonicity(bisect_values, new_res):
       # First check if this partition improves on any other partition
-      for res, bisect_part in bisect_values.iteritems():
+      for res, bisect_part in list(bisect_values.items()):
         if bisect_values[new_res].partition.quality(res) > bisect_part.partition.quality(res):
           bisect_values[res] = bisect_values[new_res]
       # Then check what is best partition for the new_res
       current_quality = bisect_values[new_res].partition.quality(new_res)
       best_res = new_res
-      for res, bisect_part in bisect_values.iteritems():
+      for res, bisect_part in bisect_values.items():
         if bisect_part.partition.quality(new_res) > current_quality:
-          best_res = new_res
+          best_res = res
+          current_quality = bisect_part.partition.quality(new_res)
       bisect_values[new_res] = bisect_values[best_res]
 
-    def find_partition(self, graph, partition_type, weights=None, **kwargs):
+    def find_partition(resolution_parameter):
       partition = partition_type(graph,
-                             weights=weights,
-                             **kwargs)
+                                 weights=weights,
+                                 resolution_parameter=resolution_parameter,
+                                 **kwargs)
       n_itr = 0
       while self.optimise_partition(partition) > 0 and \
         (n_itr < number_iterations or number_iterations <= 0):
         n_itr += 1
-      return partition
+      return BisectPartition(partition=partition,
+                             bisect_value=bisect_func(partition))
 
-    assert issubclass(partition_type, LinearResolutionParameterVertexPartition), "Bisectioning only works on partitions with a linear resolution parameter."
-    # Start actual bisectioning
-    bisect_values = {}
-    stack_res_range = []
-    # Push first range onto the stack
-    stack_res_range.append(resolution_range)
-    # Make sure the bisection values are calculated
     # The namedtuple we will use in the bisection function
     BisectPartition = namedtuple('BisectPartition',
         ['partition', 'bisect_value'])
-    partition = find_partition(self, graph=graph, partition_type=partition_type,
-        weights=weights,resolution_parameter=resolution_range[0],
-        **kwargs)
-    bisect_values[resolution_range[0]] = BisectPartition(partition=partition,
-                                bisect_value=bisect_func(partition))
-    partition = find_partition(self, graph=graph, partition_type=partition_type,
-        weights=weights, resolution_parameter=resolution_range[1], **kwargs)
-    bisect_values[resolution_range[1]] = BisectPartition(partition=partition,
-                                bisect_value=bisect_func(partition))
+    bisect_values = {}
+    for res in resolution_range:
+      bisect_values[res] = find_partition(res)
+    # Push first range onto the stack
+    stack_res_range = [tuple(resolution_range)]
     # While stack of ranges not yet empty
     while stack_res_range:
       # Get the current range from the stack
@@ -714,7 +1050,6 @@ class Optimiser(object):
       else:
         diff_resolution = abs(current_range[1] - current_range[0])
       # Check if we still want to scan a smaller interval
-      # If we would like to bisect this interval
       if diff_bisect_value > min_diff_bisect_value and \
          diff_resolution > min_diff_resolution:
         # Determine new resolution value
@@ -722,17 +1057,16 @@ class Optimiser(object):
           new_res = sqrt(current_range[1]*current_range[0])
         else:
           new_res = sum(current_range)/2.0
-        # Bisect left (push on stack)
+        # The interval cannot be bisected any further if the new resolution
+        # value equals one of its ends
+        if new_res in current_range:
+          continue
+        # Bisect left and right (push on stack)
         stack_res_range.append((current_range[0], new_res))
-        # Bisect right (push on stack)
         stack_res_range.append((new_res, current_range[1]))
-        # If we haven't scanned this resolution value yet,
-        # do so now
-        if not bisect_values.has_key(new_res):
-          partition = find_partition(self, graph, partition_type=partition_type,
-              weights=weights, resolution_parameter=new_res, **kwargs)
-          bisect_values[new_res] = BisectPartition(partition=partition,
-                                      bisect_value=bisect_func(partition))
+        # If we haven't scanned this resolution value yet, do so now
+        if new_res not in bisect_values:
+          bisect_values[new_res] = find_partition(new_res)
           # Because of stochastic differences in different runs, the monotonicity
           # of the bisection values might be violated, so check for any
           # inconsistencies
@@ -741,7 +1075,72 @@ class Optimiser(object):
     # Ensure we only keep those resolution values for which
     # the bisection values actually changed, instead of all of them
     clean_stepwise(bisect_values)
-    # Use an ordered dict so that when iterating over it, the results appear in
-    # increasing order based on the resolution value.
     return sorted((bisect.partition for res, bisect in
-      bisect_values.iteritems()), key=lambda x: x.resolution_parameter)
+      bisect_values.items()), key=lambda x: x.resolution_parameter)
+
+  def resolution_sweep(self,
+        graph,
+        partition_type,
+        resolutions,
+        weights=None,
+        aggregate=False,
+        **kwargs
+        ):
+    """ Find a partition for each of a number of resolution values, starting
+    each optimisation from the partition found for a neighbouring resolution
+    value.
+
+    Parameters
+    ----------
+    graph
+      The graph for which to find the partitions.
+
+    partition_type
+      The type of :class:`~VertexPartition.MutableVertexPartition` used
+      to find a partition (must have a linear resolution parameter).
+
+    resolutions
+      The resolution values for which to find a partition.
+
+    weights
+      If provided, indicates the edge attribute to use as a weight.
+
+    aggregate
+      If ``True``, the communities found for a resolution value are not split
+      for smaller resolution values, so that the optimisation can start from
+      the aggregate graph of these communities. This is faster, but may give
+      partitions of a somewhat lower quality.
+
+    Returns
+    -------
+    list of :class:`~VertexPartition.MutableVertexPartition`
+      A list of partitions, sorted by resolution value.
+
+    Notes
+    -----
+    The resolution values are processed from large to small, so that only the
+    partition for the largest resolution value is optimised from singletons,
+    and each other partition starts from the (finer) partition found for the
+    next larger resolution value. This is usually much faster than optimising
+    every resolution value from singletons.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> optimiser = la.Optimiser()
+    >>> sweep = optimiser.resolution_sweep(G, la.CPMVertexPartition,
+    ...                                    resolutions=[0.01*i for i in range(100)])
+    """
+    assert issubclass(partition_type, LinearResolutionParameterVertexPartition), "Sweeping only works on partitions with a linear resolution parameter."
+
+    partition = partition_type(graph, weights=weights, **kwargs)
+    sweep = _c_leiden._Optimiser_resolution_sweep(
+        self._optimiser, partition._partition,
+        [float(resolution) for resolution in resolutions],
+        aggregate=aggregate)
+    return [partition_type(graph,
+                           initial_membership=membership,
+                           weights=weights,
+                           resolution_parameter=resolution,
+                           **kwargs)
+            for resolution, membership in sweep]
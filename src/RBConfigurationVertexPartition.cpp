@@ -40,7 +40,7 @@ Weight RBConfigurationVertexPartition::diff_move(Id v, Id new_comm)
   #ifdef DEBUG
     cerr << "Weight RBConfigurationVertexPartition::diff_move(" << v << ", " << new_comm << ")" << endl;
   #endif
-  Id old_comm = this->_membership[v];
+  Id old_comm = this->membership(v);
   Weight diff = 0.0;
   Weight total_weight = this->graph->total_weight()*(2.0 - this->graph->is_directed());
 
@@ -120,42 +120,85 @@ Weight RBConfigurationVertexPartition::diff_move(Id v, Id new_comm)
 }
 
 /*****************************************************************************
-  Give the modularity of the partition.
-
-  We here use the unscaled version of modularity, in other words, we don"t
-  normalise by the number of edges.
+  Calculate the difference in moving node v to each of the candidate
+  communities, see diff_move. The node and old community terms are only
+  calculated once.
 ******************************************************************************/
-Weight RBConfigurationVertexPartition::quality(Weight resolution_parameter) const
+template <bool directed, bool sparse>
+void RBConfigurationVertexPartition::diff_move_all_impl(Id v, vector<Id> const& candidates, vector<Weight>& gains)
 {
   #ifdef DEBUG
-    cerr << "Weight ModularityVertexPartition::quality()" << endl;
+    cerr << "void RBConfigurationVertexPartition::diff_move_all_impl<" << directed << ", " << sparse << ">(" << v << ", " << candidates.size() << " candidates)" << endl;
   #endif
-  Weight mod = 0.0;
+  Id nb_candidates = candidates.size();
+  gains.assign(nb_candidates, 0.0);
+  Id old_comm = this->membership<sparse>(v);
+  Weight total_weight = this->graph->total_weight()*(directed ? 1.0 : 2.0);
 
-  Weight m;
-  if (this->graph->is_directed())
-    m = this->graph->total_weight();
-  else
-    m = 2*this->graph->total_weight();
+  if(!total_weight)  // Note: strict comparison is fine here
+    return;
 
-  if(!m)  // Note: strict comparison is fine here
-    return 0;
+  Weight k_out = this->graph->strength(v, IGRAPH_OUT);
+  Weight k_in = directed ? this->graph->strength(v, IGRAPH_IN) : k_out;
+  Weight self_weight = this->graph->node_self_weight(v);
+  Weight diff_old = (this->weight_to_comm<sparse>(v, old_comm) - this->resolution_parameter*k_out*this->total_weight_to_comm<sparse>(old_comm)/total_weight) + \
+             (this->weight_from_comm<directed, sparse>(v, old_comm) - this->resolution_parameter*k_in*this->total_weight_from_comm<sparse>(old_comm)/total_weight);
 
-  for (Id c = 0; c < this->n_communities(); c++)
+  for (Id i = 0; i < nb_candidates; i++)
   {
-    Weight w = this->total_weight_in_comm(c);
-    Weight w_out = this->total_weight_from_comm(c);
-    Weight w_in = this->total_weight_to_comm(c);
-    #ifdef DEBUG
-      Id csize = this->csize(c);
-      cerr << "\t" << "Comm: " << c << ", size=" << csize << ", w=" << w << ", w_out=" << w_out << ", w_in=" << w_in << "." << endl;
-    #endif
-    mod += w - resolution_parameter*w_out*w_in/((this->graph->is_directed() ? 1.0 : 4.0)*this->graph->total_weight());
+    Id new_comm = candidates[i];
+    if (new_comm == old_comm)
+      continue;
+    Weight K_out_new = this->total_weight_from_comm<sparse>(new_comm) + k_out;
+    Weight K_in_new = this->total_weight_to_comm<sparse>(new_comm) + k_in;
+    Weight diff_new = (this->weight_to_comm<sparse>(v, new_comm) + self_weight - this->resolution_parameter*k_out*K_in_new/total_weight) + \
+               (this->weight_from_comm<directed, sparse>(v, new_comm) + self_weight - this->resolution_parameter*k_in*K_out_new/total_weight);
+    gains[i] = diff_new - diff_old;
+  }
+}
+
+void RBConfigurationVertexPartition::diff_move_all(Id v, vector<Id> const& candidates, vector<Weight>& gains)
+{
+  if (this->graph->is_directed())
+  {
+    if (this->graph->is_sparse())
+      this->diff_move_all_impl<true, true>(v, candidates, gains);
+    else
+      this->diff_move_all_impl<true, false>(v, candidates, gains);
+  }
+  else
+  {
+    if (this->graph->is_sparse())
+      this->diff_move_all_impl<false, true>(v, candidates, gains);
+    else
+      this->diff_move_all_impl<false, false>(v, candidates, gains);
   }
-  Weight q = (2.0 - this->graph->is_directed())*mod;
+}
+
+/*****************************************************************************
+  Give the modularity of the partition.
+
+  We here use the unscaled version of modularity, in other words, we don"t
+  normalise by the number of edges. The sum over all communities of the
+  products of their outgoing and incoming weights is kept up to date when
+  moving nodes, so that the quality does not loop over the communities.
+******************************************************************************/
+Weight RBConfigurationVertexPartition::quality(Weight resolution_parameter) const
+{
+  #ifdef DEBUG
+    cerr << "Weight RBConfigurationVertexPartition::quality()" << endl;
+  #endif
+  Weight q = (2.0 - this->graph->is_directed())*(this->total_weight_in_all_comms() - resolution_parameter*this->resolution_penalty());
   #ifdef DEBUG
     cerr << "exit Weight RBConfigurationVertexPartition::quality()" << endl;
     cerr << "return " << q << endl << endl;
   #endif
   return q;
 }
+
+Weight RBConfigurationVertexPartition::resolution_penalty() const
+{
+  if (!this->graph->total_weight())  // Note: strict comparison is fine here
+    return 0;
+  return this->total_weight_from_to_all_comms()/((this->graph->is_directed() ? 1.0 : 4.0)*this->graph->total_weight());
+}
@@ -7,21 +7,29 @@ using std::endl;
 #endif
 
 SignificanceVertexPartition::SignificanceVertexPartition(const Graph* graph
-  , vector<Id> const& membership): MutableVertexPartition(graph, membership)
+  , vector<Id> const& membership): MutableVertexPartition(graph, membership), fast_kl(false)
 {}
 
 SignificanceVertexPartition::SignificanceVertexPartition(const Graph* graph)
-  : MutableVertexPartition(graph)
+  : MutableVertexPartition(graph), fast_kl(false)
+{}
+
+SignificanceVertexPartition::SignificanceVertexPartition(const Graph* graph
+  , vector<Id> const& membership, bool fast_kl): MutableVertexPartition(graph, membership), fast_kl(fast_kl)
+{}
+
+SignificanceVertexPartition::SignificanceVertexPartition(const Graph* graph, bool fast_kl)
+  : MutableVertexPartition(graph), fast_kl(fast_kl)
 {}
 
 SignificanceVertexPartition* SignificanceVertexPartition::create(const Graph* graph) const
 {
-  return new SignificanceVertexPartition(graph);
+  return new SignificanceVertexPartition(graph, this->fast_kl);
 }
 
 SignificanceVertexPartition* SignificanceVertexPartition::create(const Graph* graph, vector<Id> const& membership) const
 {
-  return new SignificanceVertexPartition(graph, membership);
+  return new SignificanceVertexPartition(graph, membership, this->fast_kl);
 }
 
 SignificanceVertexPartition::~SignificanceVertexPartition()
@@ -108,8 +116,8 @@ Weight SignificanceVertexPartition::diff_move(Id v, Id new_comm)
 
     // Calculate actual diff
 
-    diff =   (Weight)N_oldx*KLL(q_oldx, p) + (Weight)N_newx*KLL(q_newx, p)
-           - (Weight)N_old *KLL(q_old,  p) - (Weight)N_new *KLL(q_new,  p);
+    diff =   (Weight)N_oldx*this->diff_KLL(q_oldx, p) + (Weight)N_newx*this->diff_KLL(q_newx, p)
+           - (Weight)N_old *this->diff_KLL(q_old,  p) - (Weight)N_new *this->diff_KLL(q_new,  p);
     #ifdef DEBUG
       cerr << "\t" << "diff: " << diff << "." << endl;
     #endif
@@ -121,6 +129,110 @@ Weight SignificanceVertexPartition::diff_move(Id v, Id new_comm)
   return diff;
 }
 
+/*****************************************************************************
+  Calculate the difference in moving node v to each of the candidate
+  communities, see diff_move. The contribution of the old community, before
+  and after removing v, is only calculated once.
+******************************************************************************/
+template <bool directed, bool fast, bool sparse>
+void SignificanceVertexPartition::diff_move_all_impl(Id v, vector<Id> const& candidates, vector<Weight>& gains)
+{
+  #ifdef DEBUG
+    cerr << "void SignificanceVertexPartition::diff_move_all_impl<" << directed << ", " << fast << ", " << sparse << ">(" << v << ", " << candidates.size() << " candidates)" << endl;
+  #endif
+  Id nb_candidates = candidates.size();
+  gains.assign(nb_candidates, 0.0);
+  Id old_comm = this->membership<sparse>(v);
+  Id nsize = this->graph->node_size(v);
+  Weight normalise = (directed ? 1.0 : 2.0);
+  Weight p = this->graph->density();
+  Weight sw = this->graph->node_self_weight(v);
+  // The density is the same for all candidates, so that for the fast
+  // approximation log(p) and log(1 - p) need to be calculated only once.
+  Weight log_p = fast ? log(p) : 0.0;
+  Weight log_1_p = fast ? log(1.0 - p) : 0.0;
+  auto KLL_p = [p, log_p, log_1_p](Weight q)
+  {
+    return fast ? KLL_fast(q, p, log_p, log_1_p) : KLL(q, p);
+  };
+
+  // Old comm, before and after move
+  Id n_old = this->csize<sparse>(old_comm);
+  Id N_old = this->graph->possible_edges(n_old);
+  Weight m_old = this->total_weight_in_comm<sparse>(old_comm);
+  Weight q_old = 0.0;
+  if (N_old > 0)
+    q_old = m_old/N_old;
+  Id n_oldx = n_old - nsize;
+  Id N_oldx = this->graph->possible_edges(n_oldx);
+  Weight wtc = this->weight_to_comm<sparse>(v, old_comm) - sw;
+  Weight wfc = this->weight_from_comm<directed, sparse>(v, old_comm) - sw;
+  Weight m_oldx = m_old - wtc/normalise - wfc/normalise - sw;
+  Weight q_oldx = 0.0;
+  if (N_oldx > 0)
+    q_oldx = m_oldx/N_oldx;
+  Weight KLL_oldx = (Weight)N_oldx*KLL_p(q_oldx);
+  Weight KLL_old = (Weight)N_old*KLL_p(q_old);
+
+  for (Id i = 0; i < nb_candidates; i++)
+  {
+    Id new_comm = candidates[i];
+    if (new_comm == old_comm)
+      continue;
+    Id n_new = this->csize<sparse>(new_comm);
+    Id N_new = this->graph->possible_edges(n_new);
+    Weight m_new = this->total_weight_in_comm<sparse>(new_comm);
+    Weight q_new = 0.0;
+    if (N_new > 0)
+      q_new = m_new/N_new;
+    Id N_newx = this->graph->possible_edges(n_new + nsize);
+    Weight m_newx = m_new + this->weight_to_comm<sparse>(v, new_comm)/normalise + this->weight_from_comm<directed, sparse>(v, new_comm)/normalise + sw;
+    Weight q_newx = 0.0;
+    if (N_newx > 0)
+      q_newx = m_newx/N_newx;
+    gains[i] =   KLL_oldx + (Weight)N_newx*KLL_p(q_newx)
+               - KLL_old  - (Weight)N_new *KLL_p(q_new);
+  }
+}
+
+void SignificanceVertexPartition::diff_move_all(Id v, vector<Id> const& candidates, vector<Weight>& gains)
+{
+  if (this->graph->is_directed())
+  {
+    if (this->fast_kl)
+    {
+      if (this->graph->is_sparse())
+        this->diff_move_all_impl<true, true, true>(v, candidates, gains);
+      else
+        this->diff_move_all_impl<true, true, false>(v, candidates, gains);
+    }
+    else
+    {
+      if (this->graph->is_sparse())
+        this->diff_move_all_impl<true, false, true>(v, candidates, gains);
+      else
+        this->diff_move_all_impl<true, false, false>(v, candidates, gains);
+    }
+  }
+  else
+  {
+    if (this->fast_kl)
+    {
+      if (this->graph->is_sparse())
+        this->diff_move_all_impl<false, true, true>(v, candidates, gains);
+      else
+        this->diff_move_all_impl<false, true, false>(v, candidates, gains);
+    }
+    else
+    {
+      if (this->graph->is_sparse())
+        this->diff_move_all_impl<false, false, true>(v, candidates, gains);
+      else
+        this->diff_move_all_impl<false, false, false>(v, candidates, gains);
+    }
+  }
+}
+
 /********************************************************************************
    Calculate the significance of the partition.
 *********************************************************************************/
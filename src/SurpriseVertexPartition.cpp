@@ -4,20 +4,27 @@ using std::endl;
 
 
 SurpriseVertexPartition::SurpriseVertexPartition(const Graph* graph, vector<Id> const& membership)
-  : MutableVertexPartition(graph, membership)
+  : MutableVertexPartition(graph, membership), fast_kl(false)
 {}
 
-SurpriseVertexPartition::SurpriseVertexPartition(const Graph* graph): MutableVertexPartition(graph)
+SurpriseVertexPartition::SurpriseVertexPartition(const Graph* graph): MutableVertexPartition(graph), fast_kl(false)
+{}
+
+SurpriseVertexPartition::SurpriseVertexPartition(const Graph* graph, vector<Id> const& membership, bool fast_kl)
+  : MutableVertexPartition(graph, membership), fast_kl(fast_kl)
+{}
+
+SurpriseVertexPartition::SurpriseVertexPartition(const Graph* graph, bool fast_kl): MutableVertexPartition(graph), fast_kl(fast_kl)
 {}
 
 SurpriseVertexPartition* SurpriseVertexPartition::create(const Graph* graph) const
 {
-  return new SurpriseVertexPartition(graph);
+  return new SurpriseVertexPartition(graph, this->fast_kl);
 }
 
 SurpriseVertexPartition* SurpriseVertexPartition::create(const Graph* graph, vector<Id> const& membership) const
 {
-  return new SurpriseVertexPartition(graph, membership);
+  return new SurpriseVertexPartition(graph, membership, this->fast_kl);
 }
 
 SurpriseVertexPartition::~SurpriseVertexPartition()
@@ -98,7 +105,7 @@ Weight SurpriseVertexPartition::diff_move(Id v, Id new_comm)
       cerr << "\t" << "q:\t" << q << ", s:\t"  << s << "." << endl;
       cerr << "\t" << "q_new:\t" << q_new << ", s_new:\t"  << s_new << "." << endl;
     #endif
-    diff = m*(KLL(q_new, s_new) - KLL(q, s));
+    diff = m*(this->diff_KLL(q_new, s_new) - this->diff_KLL(q, s));
 
     #ifdef DEBUG
       cerr << "\t" << "diff: " << diff << "." << endl;
@@ -111,6 +118,90 @@ Weight SurpriseVertexPartition::diff_move(Id v, Id new_comm)
   return diff;
 }
 
+/*****************************************************************************
+  Calculate the difference in moving node v to each of the candidate
+  communities, see diff_move. The current surprise and the terms of the old
+  community are only calculated once.
+******************************************************************************/
+template <bool directed, bool fast, bool sparse>
+void SurpriseVertexPartition::diff_move_all_impl(Id v, vector<Id> const& candidates, vector<Weight>& gains)
+{
+  #ifdef DEBUG
+    cerr << "void SurpriseVertexPartition::diff_move_all_impl<" << directed << ", " << fast << ", " << sparse << ">(" << v << ", " << candidates.size() << " candidates)" << endl;
+  #endif
+  Id nb_candidates = candidates.size();
+  gains.assign(nb_candidates, 0.0);
+  Weight m = this->graph->total_weight();
+
+  if(!m)  // Note: strict comparison is fine here
+    return;
+
+  Id old_comm = this->membership<sparse>(v);
+  Id nsize = this->graph->node_size(v);
+  Weight normalise = (directed ? 1.0 : 2.0);
+  Id n2 = this->graph->possible_edges(this->graph->total_size());
+  Weight mc = this->total_weight_in_all_comms();
+  Id nc2 = this->total_possible_edges_in_all_comms();
+
+  Id n_old = this->csize<sparse>(old_comm);
+  Weight sw = this->graph->node_self_weight(v);
+  Weight wtc = this->weight_to_comm<sparse>(v, old_comm) - sw;
+  Weight wfc = this->weight_from_comm<directed, sparse>(v, old_comm) - sw;
+  Weight m_old = wtc/normalise + wfc/normalise + sw;
+  Weight KLL_current = fast ? KLL_fast(mc/m, (Weight)nc2/(Weight)n2) : KLL(mc/m, (Weight)nc2/(Weight)n2);
+
+  for (Id i = 0; i < nb_candidates; i++)
+  {
+    Id new_comm = candidates[i];
+    if (new_comm == old_comm)
+      continue;
+    Id n_new = this->csize<sparse>(new_comm);
+    Weight m_new = this->weight_to_comm<sparse>(v, new_comm)/normalise + this->weight_from_comm<directed, sparse>(v, new_comm)/normalise + sw;
+    Weight q_new = (mc - m_old + m_new)/m;
+    Weight delta_nc2 = 2.0*nsize*(ptrdiff_t)(n_new - n_old + nsize)/normalise;
+    Weight s_new = (Weight)(nc2 + delta_nc2)/(Weight)n2;
+    gains[i] = m*((fast ? KLL_fast(q_new, s_new) : KLL(q_new, s_new)) - KLL_current);
+  }
+}
+
+void SurpriseVertexPartition::diff_move_all(Id v, vector<Id> const& candidates, vector<Weight>& gains)
+{
+  if (this->graph->is_directed())
+  {
+    if (this->fast_kl)
+    {
+      if (this->graph->is_sparse())
+        this->diff_move_all_impl<true, true, true>(v, candidates, gains);
+      else
+        this->diff_move_all_impl<true, true, false>(v, candidates, gains);
+    }
+    else
+    {
+      if (this->graph->is_sparse())
+        this->diff_move_all_impl<true, false, true>(v, candidates, gains);
+      else
+        this->diff_move_all_impl<true, false, false>(v, candidates, gains);
+    }
+  }
+  else
+  {
+    if (this->fast_kl)
+    {
+      if (this->graph->is_sparse())
+        this->diff_move_all_impl<false, true, true>(v, candidates, gains);
+      else
+        this->diff_move_all_impl<false, true, false>(v, candidates, gains);
+    }
+    else
+    {
+      if (this->graph->is_sparse())
+        this->diff_move_all_impl<false, false, true>(v, candidates, gains);
+      else
+        this->diff_move_all_impl<false, false, false>(v, candidates, gains);
+    }
+  }
+}
+
 Weight SurpriseVertexPartition::quality() const
 {
   #ifdef DEBUG
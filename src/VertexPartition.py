@@ -52,6 +52,9 @@ class MutableVertexPartition(_ig.VertexClustering):
       initial_membership = list(initial_membership)
 
     super(MutableVertexPartition, self).__init__(graph, initial_membership)
+    # Whether the graph is a copy of the original graph, owned by this
+    # partition, which may be changed in place.
+    self._owns_graph = False
 
   @classmethod
   def _FromCPartition(cls, partition):
@@ -145,6 +148,37 @@ class MutableVertexPartition(_ig.VertexClustering):
     """
     return _c_leiden._MutableVertexPartition_diff_move(self._partition, v, new_comm)
 
+  def diff_move_all(self, v, candidates):
+    """ Calculate the difference in the quality function if node ``v`` is
+    moved to each of the candidate communities.
+
+    Parameters
+    ----------
+    v
+      The node to move.
+
+    candidates
+      The communities to move to.
+
+    Returns
+    -------
+    list of float
+      Difference in quality function for each candidate, see
+      :func:`diff_move`.
+
+    Notes
+    -----
+    This is the function used by the optimiser, which may calculate the
+    differences for all candidates at once more efficiently than calling
+    :func:`diff_move` for each of them.
+
+    Examples
+    --------
+    >>> partition = la.ModularityVertexPartition(ig.Graph.Famous('Zachary'))
+    >>> diffs = partition.diff_move_all(v=0, candidates=[1, 2, 3])
+    """
+    return _c_leiden._MutableVertexPartition_diff_move_all(self._partition, v, list(candidates))
+
   def aggregate_partition(self, membership_partition=None):
     """ Aggregate the graph according to the current partition and provide a
     default partition for it.
@@ -202,6 +236,84 @@ class MutableVertexPartition(_ig.VertexClustering):
     self._membership[v] = new_comm
     self._modularity_dirty = True
 
+  def change_edges(self, added_edges=None, removed_edges=None, updated_edges=None):
+    """ Change the edges of the graph, while keeping the membership.
+
+    The community weights of the partition are updated for the changed edges
+    only, rather than recomputed. The weights of the updated edges are
+    changed first, then the removed edges are removed and finally the added
+    edges are added, so that the ids of the updated and removed edges refer
+    to the graph before the change.
+
+    Parameters
+    ----------
+    added_edges : list of tuple
+      Edges ``(u, v)`` to add with a weight of 1, or edges ``(u, v, w)`` to
+      add with a weight of ``w``.
+
+    removed_edges : list of int
+      Ids of the edges to remove.
+
+    updated_edges : list of tuple
+      Pairs ``(e, w)`` to set the weight of edge ``e`` to ``w``.
+
+    Returns
+    -------
+    list of int
+      The endpoints of the changed edges, which can be passed on as the
+      ``changed_nodes`` of :func:`Optimiser.optimise_partition`.
+
+    Notes
+    -----
+    The first change replaces the :attr:`graph` of the partition by a copy,
+    which is then kept for later changes, so that the original graph, and any
+    other partitions on it, are not changed. The ``weight`` attribute of the
+    edges of this copy holds the weights used by the partition; other edge
+    attributes are not updated.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> partition = la.ModularityVertexPartition(G)
+    >>> changed_nodes = partition.change_edges(added_edges=[(0, 9)], removed_edges=[0])
+    """
+    added_edges = list(added_edges) if added_edges is not None else []
+    removed_edges = list(removed_edges) if removed_edges is not None else []
+    updated_edges = list(updated_edges) if updated_edges is not None else []
+
+    added_weights = None
+    if any(len(edge) == 3 for edge in added_edges):
+      added_weights = [float(edge[2]) if len(edge) == 3 else 1.0 for edge in added_edges]
+    added_edges = [(edge[0], edge[1]) for edge in added_edges]
+
+    changed_nodes = _c_leiden._MutableVertexPartition_change_edges(self._partition,
+        added_edges, added_weights, removed_edges,
+        [e for e, w in updated_edges], [float(w) for e, w in updated_edges])
+
+    # Keep the graph of the python object in line with the graph of the
+    # partition, which no longer shares the original graph. The original
+    # graph is copied only once, after which the copy is changed in place.
+    if not self._owns_graph:
+      self._graph = self._graph.copy()
+      if removed_edges:
+        self._graph.delete_edges(removed_edges)
+      if added_edges:
+        self._graph.add_edges(added_edges)
+      _, _, weights, _ = _c_leiden._MutableVertexPartition_get_py_igraph(self._partition)
+      self._graph.es['weight'] = weights
+      self._owns_graph = True
+    else:
+      for e, w in updated_edges:
+        self._graph.es[e]['weight'] = float(w)
+      if removed_edges:
+        self._graph.delete_edges(removed_edges)
+      if added_edges:
+        m = self._graph.ecount()
+        self._graph.add_edges(added_edges)
+        self._graph.es[m:]['weight'] = added_weights if added_weights is not None else 1.0
+    self._modularity_dirty = True
+    return changed_nodes
+
   def from_coarse_partition(self, partition, coarse_node=None):
     """ Update current partition according to coarser partition.
 
@@ -493,7 +605,7 @@ class SurpriseVertexPartition(MutableVertexPartition):
           `10.1103/PhysRevE.92.022816 <http://doi.org/10.1103/PhysRevE.92.022816>`_
   """
 
-  def __init__(self, graph, initial_membership=None, weights=None, node_sizes=None):
+  def __init__(self, graph, initial_membership=None, weights=None, node_sizes=None, fast_kl=False):
     """
     Parameters
     ----------
@@ -511,6 +623,12 @@ class SurpriseVertexPartition(MutableVertexPartition):
       Sizes of nodes are necessary to know the size of communities in aggregate
       graphs. Usually this is set to 1 for all nodes, but in specific cases
       this could be changed.
+
+    fast_kl : boolean
+      If ``True``, approximate the logarithms of the KL divergence when
+      calculating the difference of moving a node, with an absolute error
+      below ``2e-10`` in the divergence. This speeds up optimisation, but does
+      not affect :func:`quality`, which remains exact.
     """
     if initial_membership is not None:
       initial_membership = list(initial_membership)
@@ -527,7 +645,7 @@ class SurpriseVertexPartition(MutableVertexPartition):
         weights = list(weights)
 
     self._partition = _c_leiden._new_SurpriseVertexPartition(pygraph_t,
-        initial_membership, weights)
+        initial_membership, weights, fast_kl)
     self._update_internal_membership()
 
 class SignificanceVertexPartition(MutableVertexPartition):
@@ -564,7 +682,7 @@ class SignificanceVertexPartition(MutableVertexPartition):
   .. [1] Traag, V. A., Krings, G., & Van Dooren, P. (2013). Significant scales in community structure.
          Scientific Reports, 3, 2930. `10.1038/srep02930 <http://doi.org/10.1038/srep02930>`_
   """
-  def __init__(self, graph, initial_membership=None, node_sizes=None):
+  def __init__(self, graph, initial_membership=None, node_sizes=None, fast_kl=False):
     """
     Parameters
     ----------
@@ -579,6 +697,12 @@ class SignificanceVertexPartition(MutableVertexPartition):
       Sizes of nodes are necessary to know the size of communities in aggregate
       graphs. Usually this is set to 1 for all nodes, but in specific cases
       this could be changed.
+
+    fast_kl : boolean
+      If ``True``, approximate the logarithms of the KL divergence when
+      calculating the difference of moving a node. The divergence of each
+      community then has an absolute error below ``2e-10``, which is weighted
+      by its number of possible edges. The :func:`quality` remains exact.
     """
     if initial_membership is not None:
       initial_membership = list(initial_membership)
@@ -587,7 +711,7 @@ class SignificanceVertexPartition(MutableVertexPartition):
 
     pygraph_t = _get_py_capsule(graph)
 
-    self._partition = _c_leiden._new_SignificanceVertexPartition(pygraph_t, initial_membership)
+    self._partition = _c_leiden._new_SignificanceVertexPartition(pygraph_t, initial_membership, fast_kl)
     self._update_internal_membership()
 
 class LinearResolutionParameterVertexPartition(MutableVertexPartition):
@@ -636,6 +760,28 @@ class LinearResolutionParameterVertexPartition(MutableVertexPartition):
   def quality(self, resolution_parameter=None):
     return _c_leiden._ResolutionParameterVertexPartition_quality(self._partition, resolution_parameter)
 
+  def quality_terms(self):
+    """ The terms :math:`E` and :math:`F` of the quality :math:`Q = E - \\gamma F`.
+
+    Both terms are kept up to date when moving nodes, so that they (and hence
+    the quality for any resolution parameter) are available in constant time.
+
+    Returns
+    -------
+    tuple of float
+      The terms ``(E, F)``, so that ``quality(resolution_parameter) == E -
+      resolution_parameter*F``.
+
+    Examples
+    --------
+    >>> G = ig.Graph.Famous('Zachary')
+    >>> partition = la.CPMVertexPartition(G, resolution_parameter=0.1)
+    >>> E, F = partition.quality_terms()
+    >>> abs(partition.quality(0.5) - (E - 0.5*F)) < 1e-10
+    True
+    """
+    return _c_leiden._LinearResolutionParameterVertexPartition_quality_terms(self._partition)
+
 class RBERVertexPartition(LinearResolutionParameterVertexPartition):
   """ Implements Reichardt and Bornholdt's Potts model with a configuration null model.
   This quality function is well-defined only for positive edge weights.
@@ -40,11 +40,20 @@ from .functions import RAND_NEIGH_COMM
 from .functions import MOVE_NODES
 from .functions import MERGE_NODES
 
+from .functions import RAND_ORDER
+from .functions import DEGREE_ORDER
+from .functions import CHANGE_ORDER
+from .functions import IMPROV_ORDER
+
 from .functions import find_partition
 from .functions import find_partition_multiplex
 from .functions import find_partition_temporal
 from .functions import slices_to_layers
 from .functions import time_slices_to_layers
+from .functions import compare_memberships
+from .functions import write_membership
+from .functions import read_membership
+from .functions import membership_to_text
 
 from .Optimiser import Optimiser
 from .VertexPartition import ModularityVertexPartition
@@ -9,6 +9,11 @@ from ._c_leiden import RAND_NEIGH_COMM
 from ._c_leiden import MOVE_NODES
 from ._c_leiden import MERGE_NODES
 
+from ._c_leiden import RAND_ORDER
+from ._c_leiden import DEGREE_ORDER
+from ._c_leiden import CHANGE_ORDER
+from ._c_leiden import IMPROV_ORDER
+
 from collections import Counter
 
 # Check if working with Python 3
@@ -166,7 +171,7 @@ def find_partition_temporal(graphs, partition_type,
                             interslice_weight=1,
                             slice_attr='slice', vertex_id_attr='id',
                             edge_type_attr='type', weight_attr='weight',
-                            n_iterations=2, seed=None,
+                            n_iterations=2, seed=None, sparse=False,
                             **kwargs):
   """ Detect communities for temporal graphs.
 
@@ -176,9 +181,8 @@ def find_partition_temporal(graphs, partition_type,
   nodes in two consecutive slices have an identical value of the
   ``vertex_id_attr`` they are coupled.  The ``vertex_id_attr`` should hence be
   unique in each slice. The nodes are then coupled with a weight of
-  ``interslice_weight`` which is set in the edge attribute ``weight_attr``. No
-  weight is set if the ``interslice_weight`` is None (i.e.  corresponding in
-  practice with a weight of 1). See :func:`time_slices_to_layers` for
+  ``interslice_weight`` which is set in the edge attribute ``weight_attr``. A
+  weight of 1 is set if the ``interslice_weight`` is None. See :func:`time_slices_to_layers` for
   a more detailed explanation.
 
   Parameters
@@ -214,9 +218,20 @@ def find_partition_temporal(graphs, partition_type,
     Seed for the random number generator. By default uses a random seed
     if nothing is specified.
 
+  sparse : boolean
+    If ``True``, the layer of each slice only holds the nodes of that slice,
+    so that the memory and the time of the optimisation scale with the size
+    of the slices rather than with the number of slices times the number of
+    all nodes. This is mostly useful for many slices. The results are the
+    same as without ``sparse``.
+
   **kwargs
     Remaining keyword arguments, passed on to constructor of
-    ``partition_type``.
+    ``partition_type``. The edges of the layers are weighted by
+    ``weight_attr`` if ``partition_type`` accepts weights, unless ``weights``
+    is passed, which may be ``None`` for unweighted layers, or the name of
+    the edge attribute of the slices to use instead. The node sizes of the
+    layers are determined by the slices, so that ``node_sizes`` is ignored.
 
   Returns
   -------
@@ -244,48 +259,216 @@ def find_partition_temporal(graphs, partition_type,
   ...                                                      la.ModularityVertexPartition,
   ...                                                      interslice_weight=1)
   """
-  # Create layers
-  G_layers, G_interslice, G = time_slices_to_layers(graphs,
-                                                    interslice_weight,
-                                                    slice_attr=slice_attr,
-                                                    vertex_id_attr=vertex_id_attr,
-                                                    edge_type_attr=edge_type_attr,
-                                                    weight_attr=weight_attr)
-  # Optimise partitions
-  arg_dict = {}
-  if 'node_sizes' in partition_type.__init__.__code__.co_varnames:
-    arg_dict['node_sizes'] = 'node_size'
-
+  # The layers of the slices are weighted in the same way as when creating
+  # partitions on them with kwargs, so that for example the layers of a
+  # SignificanceVertexPartition remain unweighted. In the layers each node
+  # has a size of 1 in its own slice and of 0 in the other slices.
   if 'weights' in partition_type.__init__.__code__.co_varnames:
-    arg_dict['weights'] = 'weight'
-
-  arg_dict.update(kwargs)
+    slice_weight_attr = kwargs.pop('weights', weight_attr)
+  else:
+    slice_weight_attr = None
+  kwargs.pop('node_sizes', None)
+  if slice_weight_attr is not None and not isinstance(slice_weight_attr, str):
+    raise ValueError("The weights of the layers should be the name of an edge attribute of the slices, or None.")
+
+  # The layers and their partitions are created natively, without any
+  # intermediate igraph graphs, of the same type as a partition constructed
+  # with kwargs.
+  G_slices = _time_slices_coupling(graphs, interslice_weight, slice_attr, weight_attr)
+  slices, slice_lists = _slices_to_lists(G_slices, slice_attr, vertex_id_attr, weight_attr)
+  if slice_weight_attr is None:
+    slice_lists['slice_weights'] = [[1]*H.ecount() for H in slices]
+  elif slice_weight_attr != weight_attr:
+    slice_lists['slice_weights'] = [H.es[slice_weight_attr] for H in slices]
+  partition = partition_type(_ig.Graph(1), **kwargs)
+  partitions = _c_leiden._slices_to_partitions(partition._partition, sparse=sparse, **slice_lists)
 
-  partitions = []
-  for H in G_layers:
-    arg_dict['graph'] = H
-    partitions.append(partition_type(**arg_dict))
-
-  # We can always take the same interslice partition, as this should have no
-  # cost in the optimisation.
-  partition_interslice = CPMVertexPartition(G_interslice, resolution_parameter=0,
-                                            node_sizes='node_size', weights=weight_attr)
+  # Optimise partitions
   optimiser = Optimiser()
 
   if (not seed is None):
     optimiser.set_rng_seed(seed)
 
-  improvement = optimiser.optimise_partition_multiplex(partitions + [partition_interslice], n_iterations=n_iterations)
+  layer_weights = [1]*len(partitions)
+  improvement = optimiser._iterate(
+    lambda: _c_leiden._Optimiser_optimise_partition_multiplex(
+      optimiser._optimiser, partitions, layer_weights),
+    n_iterations)
 
-  # Transform results back into original form.
-  membership = {(v[slice_attr], v[vertex_id_attr]): m for v, m in zip(G.vs, partitions[0].membership)}
+  # Transform results back into original form: node i of slice s is node
+  # offset(s) + i of the layers, where offset(s) is the number of nodes in
+  # the slices before s. The interslice layer is never sparse, so that it has
+  # the membership of all nodes.
+  membership = _c_leiden._MutableVertexPartition_get_membership(partitions[-1])
 
   membership_time_slices = []
-  for slice_idx, H in enumerate(graphs):
-    membership_slice = [membership[(slice_idx, v[vertex_id_attr])] for v in H.vs]
-    membership_time_slices.append(list(membership_slice))
+  offset = 0
+  for H in graphs:
+    membership_time_slices.append(list(membership[offset:offset + H.vcount()]))
+    offset += H.vcount()
   return membership_time_slices, improvement
 
+def compare_memberships(membership1, membership2, n_threads=0):
+  """ Compare two memberships of the same nodes.
+
+  Parameters
+  ----------
+  membership1, membership2 : list of int, buffer of int, or :class:`ig.VertexClustering`
+    The memberships to compare. Objects supporting the buffer protocol with
+    integer items, such as numpy arrays, are read without conversion. The
+    community numbers should be non-negative, but need not be consecutive.
+
+  n_threads : int
+    Number of threads to use. If ``0``, as many threads as there are cores
+    are used. The nodes are split over the threads, so that also memberships
+    with a few large communities are compared in parallel, and the result
+    does not depend on the number of threads.
+
+  Returns
+  -------
+  dict
+    The normalised mutual information (``nmi``), the adjusted Rand index
+    (``ari``) and the variation of information (``vi``).
+
+  Notes
+  -----
+  The normalised mutual information is :math:`2 I(A, B) / (H(A) + H(B))`
+  [1]_, and the variation of information is :math:`H(A) + H(B) - 2 I(A, B)`
+  [2]_, using natural logarithms. The adjusted Rand index is as in [3]_. This
+  is much faster than :func:`ig.compare_communities` for large graphs, and can
+  be used to monitor the stability of partitions across the runs of
+  :func:`Optimiser.ensemble` or the resolution values of
+  :func:`Optimiser.resolution_sweep`.
+
+  References
+  ----------
+  .. [1] Danon, L., Diaz-Guilera, A., Duch, J., & Arenas, A. (2005).
+         Comparing community structure identification. Journal of Statistical
+         Mechanics: Theory and Experiment, 2005(09), P09008.
+
+  .. [2] Meila, M. (2007). Comparing clusterings - an information based
+         distance. Journal of Multivariate Analysis, 98(5), 873-895.
+
+  .. [3] Hubert, L., & Arabie, P. (1985). Comparing partitions. Journal of
+         Classification, 2(1), 193-218.
+
+  Examples
+  --------
+  >>> G = ig.Graph.Famous('Zachary')
+  >>> optimiser = la.Optimiser()
+  >>> sweep = optimiser.resolution_sweep(G, la.CPMVertexPartition,
+  ...                                    resolutions=[0.05, 0.1, 0.2])
+  >>> nmi = [la.compare_memberships(P, Q)['nmi'] for P, Q in zip(sweep, sweep[1:])]
+  """
+  if isinstance(membership1, _ig.VertexClustering):
+    membership1 = membership1.membership
+  if isinstance(membership2, _ig.VertexClustering):
+    membership2 = membership2.membership
+  return _c_leiden._compare_memberships(membership1, membership2, nb_threads=n_threads)
+
+def write_membership(filename, membership, levels=None):
+  """ Write a membership, and optionally its hierarchy, to a binary file.
+
+  Parameters
+  ----------
+  filename : string
+    The file to write.
+
+  membership : list of int, buffer of int, or :class:`ig.VertexClustering`
+    The membership of the nodes, for example after
+    :func:`~VertexPartition.MutableVertexPartition.renumber_communities`.
+
+  levels : list of (list of int or buffer of int)
+    If provided, the levels of the hierarchy of the membership, where
+    ``levels[0]`` maps the nodes to the communities of the first level, and
+    ``levels[l]`` maps the communities of level ``l - 1`` to those of level
+    ``l``.
+
+  Notes
+  -----
+  The file can be loaded without any parsing, for example by
+  :func:`read_membership`, or by memory mapping it. It starts with a header
+  of 64 bytes, in native byte order: the magic ``LEIDENMB``, the byte order
+  mark ``0x0102030405060708`` (8 bytes), the version (4 bytes), the width of
+  the entries in bytes (4 bytes, either 4 or 8), the number of nodes, the
+  number of communities and the number of levels ``L`` (8 bytes each), and
+  16 reserved bytes. It is followed by the ``L`` sizes of the levels (8 bytes
+  each), and then by the membership and the levels, with entries of the given
+  width. Each of these arrays starts at a multiple of 64 bytes.
+
+  See Also
+  --------
+  :func:`read_membership`
+
+  :func:`membership_to_text`
+
+  Examples
+  --------
+  >>> G = ig.Graph.Famous('Zachary')
+  >>> partition = la.find_partition(G, la.ModularityVertexPartition)
+  >>> la.write_membership('membership.bin', partition)
+  """
+  if isinstance(membership, _ig.VertexClustering):
+    membership = membership.membership
+  if levels is not None:
+    levels = list(levels)
+  _c_leiden._write_membership(str(filename), membership, levels=levels)
+
+def read_membership(filename):
+  """ Read a membership, and its hierarchy, from a binary file written by
+  :func:`write_membership`.
+
+  Parameters
+  ----------
+  filename : string
+    The file to read.
+
+  Returns
+  -------
+  list of int
+    The membership of the nodes.
+
+  list of list of int
+    The levels of the hierarchy, which is empty if none was written.
+
+  Examples
+  --------
+  >>> G = ig.Graph.Famous('Zachary')
+  >>> partition = la.find_partition(G, la.ModularityVertexPartition)
+  >>> la.write_membership('membership.bin', partition)
+  >>> membership, levels = la.read_membership('membership.bin')
+  """
+  return _c_leiden._read_membership(str(filename))
+
+def membership_to_text(filename, text_filename, level=None):
+  """ Convert a binary file written by :func:`write_membership` to the text
+  clustering format.
+
+  The text file starts with a line ``# Clusters: <k>, Nodes: <n>, Fuzzy: 0``,
+  followed by a line with the (space separated) nodes of each non-empty
+  community, in order of the communities.
+
+  Parameters
+  ----------
+  filename : string
+    The binary file to read.
+
+  text_filename : string
+    The text file to write.
+
+  level : int
+    If provided, the communities of the nodes at this level of the hierarchy
+    are written instead of the membership.
+
+  Examples
+  --------
+  >>> G = ig.Graph.Famous('Zachary')
+  >>> partition = la.find_partition(G, la.ModularityVertexPartition)
+  >>> la.write_membership('membership.bin', partition)
+  >>> la.membership_to_text('membership.bin', 'membership.cnl')
+  """
+  _c_leiden._membership_to_text(str(filename), str(text_filename), level=level)
+
 #%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 # These are helper functions to create a proper
 # disjoint union in python. The igraph implementation
@@ -315,6 +498,13 @@ def disjoint_union_attrs(graphs):
 #%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%%
 # Conversion to layer graphs
 
+def _time_slices_coupling(graphs, interslice_weight, slice_attr, weight_attr):
+  """ Coupling graph connecting all consecutive time slices. """
+  G_slices = _ig.Graph.Tree(len(graphs), 1, mode=_ig.TREE_UNDIRECTED)
+  G_slices.es[weight_attr] = interslice_weight
+  G_slices.vs[slice_attr] = graphs
+  return G_slices
+
 def time_slices_to_layers(graphs,
                           interslice_weight=1,
                           slice_attr='slice',
@@ -335,9 +525,7 @@ def time_slices_to_layers(graphs,
   :func:`slices_to_layers`
 
   """
-  G_slices = _ig.Graph.Tree(len(graphs), 1, mode=_ig.TREE_UNDIRECTED)
-  G_slices.es[weight_attr] = interslice_weight
-  G_slices.vs[slice_attr] = graphs
+  G_slices = _time_slices_coupling(graphs, interslice_weight, slice_attr, weight_attr)
   return slices_to_layers(G_slices,
                           slice_attr,
                           vertex_id_attr,
@@ -438,61 +626,82 @@ def slices_to_layers(G_coupling,
   :func:`time_slices_to_layers`
 
   """
+  slices, slice_lists = _slices_to_lists(G_coupling, slice_attr, vertex_id_attr, weight_attr)
+  layers = _c_leiden._slices_to_layers(**slice_lists)
+  directed = slice_lists['directed']
+
+  # All layers have the vertex attributes of all slices.
+  vertex_attrs = {}
+  for attr in set(attr for H in slices for attr in H.vertex_attributes()):
+    vertex_attrs[attr] = [value for H in slices for value in get_attrs_or_nones(H.vs, attr)]
+
+  G_layers = [None]*len(slices)
+  for slice_idx, H in enumerate(slices):
+    n, edges, weights, node_sizes = layers[slice_idx]
+    edge_attrs = dict((attr, H.es[attr]) for attr in H.edge_attributes())
+    edge_attrs[weight_attr] = weights
+    edge_attrs[edge_type_attr] = ['intraslice']*len(edges)
+    G_layers[slice_idx] = _ig.Graph(n=n, edges=edges, directed=directed,
+                                    vertex_attrs=dict(vertex_attrs, node_size=node_sizes),
+                                    edge_attrs=edge_attrs)
+
+  # Create one graph for the interslice links.
+  n, edges, weights, node_sizes = layers[-1]
+  G_interslice = _ig.Graph(n=n, edges=edges, directed=directed,
+                           vertex_attrs=dict(vertex_attrs, node_size=node_sizes),
+                           edge_attrs={weight_attr: weights,
+                                       edge_type_attr: ['interslice']*len(edges)})
+
+  # The complete graph has the edges of all slices, followed by the interslice
+  # edges.
+  G = _ig.Graph(n=n, directed=directed, vertex_attrs=vertex_attrs,
+                edges=[edge for H in G_layers + [G_interslice] for edge in H.get_edgelist()])
+  for attr in set(attr for H in G_layers for attr in H.edge_attributes()):
+    G.es[attr] = [value for H in G_layers + [G_interslice] for value in get_attrs_or_nones(H.es, attr)]
+
+  return G_layers, G_interslice, G
+
+def _slices_to_lists(G_coupling, slice_attr, vertex_id_attr, weight_attr):
+  """ The slices of a coupling graph, and the lists of the node ids, edges and
+  edge weights of the slices and of the coupling edges and their weights from
+  which the layers are created natively (see :func:`slices_to_layers`). """
   if not slice_attr in G_coupling.vertex_attributes():
     raise ValueError("Could not find the vertex attribute {0} in the coupling graph.".format(slice_attr))
 
   if not weight_attr in G_coupling.edge_attributes():
     raise ValueError("Could not find the edge attribute {0} in the coupling graph.".format(weight_attr))
 
-  # Create disjoint union of the time graphs
-  for v_slice in G_coupling.vs:
-    H = v_slice[slice_attr]
-    H.vs[slice_attr] = v_slice.index
+  slices = G_coupling.vs[slice_attr]
+  directed = len(slices) > 0 and slices[0].is_directed()
+
+  # The layers are built natively from the edge lists of the slices, for
+  # which the node ids are mapped to consecutive integers.
+  node_ids = {}
+  slice_ids = []
+  slice_edges = []
+  slice_weights = []
+  for slice_idx, H in enumerate(slices):
+    H.vs[slice_attr] = slice_idx
     if not vertex_id_attr in H.vertex_attributes():
       raise ValueError("Could not find the vertex attribute {0} to identify nodes in different slices.".format(vertex_id_attr ))
     if not weight_attr in H.edge_attributes():
       H.es[weight_attr] = 1
-
-  G = disjoint_union_attrs(G_coupling.vs[slice_attr])
-  G.es[edge_type_attr] = 'intraslice'
-
-  for v_slice in G_coupling.vs:
-    for u_slice in v_slice.neighbors(mode=_ig.OUT):
-      if v_slice.index < u_slice.index or G_coupling.is_directed():
-        nodes_v = G.vs.select(lambda v: v[slice_attr]==v_slice.index)[vertex_id_attr]
-        if len(set(nodes_v)) != len(nodes_v):
-          err = '\n'.join(
-            ['\t{0} {1} times'.format(item, count) for item, count in Counter(nodes_v).items() if count > 1]
-            )
-          raise ValueError('No unique IDs for slice {0}, require unique IDs:\n{1}'.format(v_slice.index, err))
-        nodes_u = G.vs.select(lambda v: v[slice_attr]==u_slice.index)[vertex_id_attr]
-        if len(set(nodes_u)) != len(nodes_u):
-          err = '\n'.join(
-            ['\t{0} {1} times'.format(item, count) for item, count in Counter(nodes_u).items() if count > 1]
-            )
-          raise ValueError('No unique IDs for slice {0}, require unique IDs:\n{1}'.format(u_slice.index, err))
-        common_nodes = set(nodes_v).intersection(set(nodes_u))
-        nodes_v = sorted([v for v in G.vs if v[slice_attr] == v_slice.index and v[vertex_id_attr] in common_nodes], key=lambda v: v[vertex_id_attr])
-        nodes_u = sorted([v for v in G.vs if v[slice_attr] == u_slice.index and v[vertex_id_attr] in common_nodes], key=lambda v: v[vertex_id_attr])
-        edges = zip(nodes_v, nodes_u)
-        e_start = G.ecount()
-        G.add_edges(edges)
-        e_end = G.ecount()
-        e_idx = range(e_start, e_end)
-        interslice_weight = G_coupling.es[G_coupling.get_eid(v_slice, u_slice)][weight_attr]
-        if not interslice_weight is None:
-          G.es[e_idx][weight_attr] = interslice_weight
-        G.es[e_idx][edge_type_attr] = 'interslice'
-
-  # Convert aggregate graph to individual layers for each time slice.
-  G_layers = [None]*G_coupling.vcount()
-  for v_slice in G_coupling.vs:
-    H = G.subgraph_edges(G.es.select(_within=[v.index for v in G.vs if v[slice_attr] == v_slice.index]), delete_vertices=False)
-    H.vs['node_size'] = [1 if v[slice_attr] == v_slice.index else 0 for v in H.vs]
-    G_layers[v_slice.index] = H
-
-  # Create one graph for the interslice links.
-  G_interslice = G.subgraph_edges(G.es.select(type_eq='interslice'), delete_vertices=False)
-  G_interslice.vs['node_size'] = 0
-
-  return G_layers, G_interslice, G
+    nodes = H.vs[vertex_id_attr]
+    ids = [node_ids.setdefault(node, len(node_ids)) for node in nodes]
+    if len(set(ids)) != len(ids):
+      err = '\n'.join(
+        ['\t{0} {1} times'.format(item, count) for item, count in Counter(nodes).items() if count > 1]
+        )
+      raise ValueError('No unique IDs for slice {0}, require unique IDs:\n{1}'.format(slice_idx, err))
+    slice_ids.append(ids)
+    slice_edges.append(H.get_edgelist())
+    slice_weights.append(H.es[weight_attr])
+
+  coupling_weights = [1 if w is None else w for w in G_coupling.es[weight_attr]]
+  return slices, dict(slice_ids=slice_ids,
+                      slice_edges=slice_edges,
+                      slice_weights=slice_weights,
+                      coupling_edges=G_coupling.get_edgelist(),
+                      coupling_weights=coupling_weights,
+                      directed=directed,
+                      coupling_directed=G_coupling.is_directed())
@@ -21,6 +21,34 @@ using std::isnan;
     Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
     delete optimiser;
   }
+
+  vector<Id> nodes_from_py(PyObject* py_nodes)
+  {
+    size_t nb_nodes = PyList_Size(py_nodes);
+    vector<Id> nodes(nb_nodes);
+    for (size_t i = 0; i < nb_nodes; i++)
+    {
+      PyObject* py_item = PyList_GetItem(py_nodes, i);
+      if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
+      {
+        Py_ssize_t v = PyNumber_AsSsize_t(py_item, nullptr);
+        if (v < 0)
+          throw LeidenException("Node cannot be negative.");
+        nodes[i] = v;
+      }
+      else
+        throw LeidenException("Expected integer value for node.");
+    }
+    return nodes;
+  }
+
+  PyObject* nodes_to_py(vector<Id> const& nodes)
+  {
+    PyObject* py_nodes = PyList_New(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++)
+      PyList_SetItem(py_nodes, i, PyLong_FromSize_t(nodes[i]));
+    return py_nodes;
+  }
 #ifdef __cplusplus
 extern "C"
 {
@@ -43,15 +71,16 @@ extern "C"
   {
     PyObject* py_optimiser = nullptr;
     PyObject* py_partition = nullptr;
+    PyObject* py_changed_nodes = nullptr;
 
-    static char* kwlist[] = {"optimiser", "partition", nullptr};
+    static char* kwlist[] = {"optimiser", "partition", "changed_nodes", nullptr};
 
     #ifdef DEBUG
       cerr << "Parsing arguments..." << endl;
     #endif
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO", kwlist,
-                                     &py_optimiser, &py_partition))
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|O", kwlist,
+                                     &py_optimiser, &py_partition, &py_changed_nodes))
         return nullptr;
 
     #ifdef DEBUG
@@ -74,16 +103,43 @@ extern "C"
       cerr << "Using partition at address " << partition << endl;
     #endif
 
+    bool warm_start = (py_changed_nodes != nullptr && py_changed_nodes != Py_None);
+    vector<Id> changed_nodes, moved_nodes;
+    if (warm_start)
+    {
+      try
+      {
+        changed_nodes = nodes_from_py(py_changed_nodes);
+      }
+      catch (std::exception const& e)
+      {
+        PyErr_SetString(PyExc_TypeError, e.what());
+        return nullptr;
+      }
+    }
+
     double q = 0.0;
+    // The GIL is released while optimising, and only reacquired for calling
+    // the progress callback, see _Optimiser_set_progress_callback.
+    PyThreadState* thread_state = PyEval_SaveThread();
     try
     {
-      q = optimiser->optimise_partition(partition);
+      if (warm_start)
+        q = optimiser->optimise_partition(partition, changed_nodes, moved_nodes);
+      else
+        q = optimiser->optimise_partition(partition);
     }
     catch (std::exception e)
     {
+      PyEval_RestoreThread(thread_state);
       PyErr_SetString(PyExc_ValueError, e.what());
       return nullptr;
     }
+    PyEval_RestoreThread(thread_state);
+    if (PyErr_Occurred())
+      return nullptr; // Raised by the progress callback
+    if (warm_start)
+      return Py_BuildValue("(dN)", q, nodes_to_py(moved_nodes));
     return PyFloat_FromDouble(q);
   }
 
@@ -92,8 +148,9 @@ extern "C"
     PyObject* py_optimiser = nullptr;
     PyObject* py_partitions = nullptr;
     PyObject* py_layer_weights = nullptr;
+    PyObject* py_changed_nodes = nullptr;
 
-    if (!PyArg_ParseTuple(args, "OOO", &py_optimiser, &py_partitions, &py_layer_weights))
+    if (!PyArg_ParseTuple(args, "OOO|O", &py_optimiser, &py_partitions, &py_layer_weights, &py_changed_nodes))
         return nullptr;
 
     size_t nb_partitions = PyList_Size(py_partitions);
@@ -150,16 +207,41 @@ extern "C"
       cerr << "Using optimiser at address " << optimiser << endl;
     #endif
 
+    bool warm_start = (py_changed_nodes != nullptr && py_changed_nodes != Py_None);
+    vector<Id> changed_nodes, moved_nodes;
+    if (warm_start)
+    {
+      try
+      {
+        changed_nodes = nodes_from_py(py_changed_nodes);
+      }
+      catch (std::exception const& e)
+      {
+        PyErr_SetString(PyExc_TypeError, e.what());
+        return nullptr;
+      }
+    }
+
     double q = 0.0;
+    PyThreadState* thread_state = PyEval_SaveThread();
     try
     {
-      q = optimiser->optimise_partition(partitions, layer_weights);
+      if (warm_start)
+        q = optimiser->optimise_partition(partitions, layer_weights, changed_nodes, moved_nodes);
+      else
+        q = optimiser->optimise_partition(partitions, layer_weights);
     }
     catch (std::exception e)
     {
+      PyEval_RestoreThread(thread_state);
       PyErr_SetString(PyExc_ValueError, e.what());
       return nullptr;
     }
+    PyEval_RestoreThread(thread_state);
+    if (PyErr_Occurred())
+      return nullptr; // Raised by the progress callback
+    if (warm_start)
+      return Py_BuildValue("(dN)", q, nodes_to_py(moved_nodes));
     return PyFloat_FromDouble(q);
   }
 
@@ -203,15 +285,20 @@ extern "C"
       consider_comms = optimiser->consider_comms;
 
     double q  = 0.0;
+    PyThreadState* thread_state = PyEval_SaveThread();
     try
     {
       q = optimiser->move_nodes(partition, consider_comms);
     }
     catch (std::exception e)
     {
+      PyEval_RestoreThread(thread_state);
       PyErr_SetString(PyExc_ValueError, e.what());
       return nullptr;
     }
+    PyEval_RestoreThread(thread_state);
+    if (PyErr_Occurred())
+      return nullptr; // Raised by the progress callback
     return PyFloat_FromDouble(q);
   }
 
@@ -255,15 +342,20 @@ extern "C"
       consider_comms = optimiser->consider_comms;
 
     double q = 0.0;
+    PyThreadState* thread_state = PyEval_SaveThread();
     try
     {
       q = optimiser->merge_nodes(partition, consider_comms);
     }
     catch (std::exception e)
     {
+      PyEval_RestoreThread(thread_state);
       PyErr_SetString(PyExc_ValueError, e.what());
       return nullptr;
     }
+    PyEval_RestoreThread(thread_state);
+    if (PyErr_Occurred())
+      return nullptr; // Raised by the progress callback
     return PyFloat_FromDouble(q);
   }
 
@@ -316,15 +408,20 @@ extern "C"
       consider_comms = optimiser->refine_consider_comms;
 
     double q = 0.0;
+    PyThreadState* thread_state = PyEval_SaveThread();
     try
     {
       q = optimiser->move_nodes_constrained(partition, consider_comms, constrained_partition);
     }
     catch (std::exception e)
     {
+      PyEval_RestoreThread(thread_state);
       PyErr_SetString(PyExc_ValueError, e.what());
       return nullptr;
     }
+    PyEval_RestoreThread(thread_state);
+    if (PyErr_Occurred())
+      return nullptr; // Raised by the progress callback
     return PyFloat_FromDouble(q);
   }
 
@@ -377,15 +474,20 @@ extern "C"
       consider_comms = optimiser->refine_consider_comms;
 
     double q = 0.0;
+    PyThreadState* thread_state = PyEval_SaveThread();
     try
     {
       q = optimiser->merge_nodes_constrained(partition, consider_comms, constrained_partition);
     }
     catch (std::exception e)
     {
+      PyEval_RestoreThread(thread_state);
       PyErr_SetString(PyExc_ValueError, e.what());
       return nullptr;
     }
+    PyEval_RestoreThread(thread_state);
+    if (PyErr_Occurred())
+      return nullptr; // Raised by the progress callback
     return PyFloat_FromDouble(q);
   }
 
@@ -712,6 +814,70 @@ extern "C"
     return PyBool_FromLong(optimiser->consider_empty_community);
   }
 
+  PyObject* _Optimiser_set_node_order(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = nullptr;
+    int node_order = Optimiser::RAND_ORDER;
+    static char* kwlist[] = {"optimiser", "node_order", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Oi", kwlist,
+                                     &py_optimiser, &node_order))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "set_node_order(" << node_order << ");" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    optimiser->node_order = node_order;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_get_node_order(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = nullptr;
+    static char* kwlist[] = {"optimiser", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "get_node_order();" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    #ifdef IS_PY3K
+    return PyLong_FromLong(optimiser->node_order);
+    #else
+    return PyInt_FromLong(optimiser->node_order);
+    #endif
+  }
+
   PyObject* _Optimiser_set_refine_partition(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_optimiser = nullptr;
@@ -806,6 +972,457 @@ extern "C"
     Py_INCREF(Py_None);
     return Py_None;
   }
+
+  PyObject* _Optimiser_set_progress_callback(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = nullptr;
+    PyObject* py_callback = nullptr;
+    Py_ssize_t interval = 10000;
+    static char* kwlist[] = {"optimiser", "callback", "interval", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|n", kwlist,
+                                     &py_optimiser, &py_callback, &interval))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "set_progress_callback(" << py_callback << ", " << interval << ");" << endl;
+    #endif
+
+    if (py_callback != Py_None && !PyCallable_Check(py_callback))
+    {
+      PyErr_SetString(PyExc_TypeError, "Progress callback should be callable.");
+      return nullptr;
+    }
+    if (interval < 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "Progress interval should not be negative.");
+      return nullptr;
+    }
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    optimiser->progress_interval = interval;
+    if (py_callback == Py_None)
+    {
+      optimiser->progress_callback = nullptr;
+    }
+    else
+    {
+      // The callback is called while the GIL is released, so it should be
+      // reacquired. Exceptions raised by the callback stop the optimisation,
+      // and are raised again once the optimisation returns. The Python
+      // Optimiser keeps a reference to the callback.
+      optimiser->progress_callback = [py_callback](Id level, Id nb_visits)
+      {
+        PyGILState_STATE gil_state = PyGILState_Ensure();
+        PyObject* result = PyObject_CallFunction(py_callback, "nn", (Py_ssize_t)level, (Py_ssize_t)nb_visits);
+        bool proceed = (result != nullptr && result != Py_False);
+        Py_XDECREF(result);
+        PyGILState_Release(gil_state);
+        return proceed;
+      };
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_set_time_limit(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = nullptr;
+    double time_limit = 0.0;
+    static char* kwlist[] = {"optimiser", "time_limit", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "Od", kwlist,
+                                     &py_optimiser, &time_limit))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "set_time_limit(" << time_limit << ");" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    optimiser->time_limit = time_limit;
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _Optimiser_get_time_limit(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = nullptr;
+    static char* kwlist[] = {"optimiser", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "get_time_limit();" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    return PyFloat_FromDouble(optimiser->time_limit);
+  }
+
+  PyObject* _Optimiser_get_stopped(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = nullptr;
+    static char* kwlist[] = {"optimiser", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "get_stopped();" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule optimiser at address " << py_optimiser << endl;
+    #endif
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+
+    return PyBool_FromLong(optimiser->stopped());
+  }
+
+  PyObject* _Optimiser_get_statistics(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = nullptr;
+    static char* kwlist[] = {"optimiser", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_optimiser))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "get_statistics();" << endl;
+    #endif
+
+    #ifndef STATISTICS
+      // Statistics are not collected at all
+      Py_INCREF(Py_None);
+      return Py_None;
+    #else
+      #ifdef DEBUG
+        cerr << "Capsule optimiser at address " << py_optimiser << endl;
+      #endif
+      Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+      #ifdef DEBUG
+        cerr << "Using optimiser at address " << optimiser << endl;
+      #endif
+
+      OptimiserStatistics const& statistics = optimiser->statistics;
+      size_t nb_levels = statistics.level_nodes.size();
+      PyObject* py_level_nodes = PyList_New(nb_levels);
+      PyObject* py_level_edges = PyList_New(nb_levels);
+      for (size_t level = 0; level < nb_levels; level++)
+      {
+        PyList_SetItem(py_level_nodes, level, PyLong_FromSize_t(statistics.level_nodes[level]));
+        PyList_SetItem(py_level_edges, level, PyLong_FromSize_t(statistics.level_edges[level]));
+      }
+      size_t nb_passes = statistics.nb_moves_per_pass.size();
+      PyObject* py_nb_moves_per_pass = PyList_New(nb_passes);
+      for (size_t pass = 0; pass < nb_passes; pass++)
+        PyList_SetItem(py_nb_moves_per_pass, pass, PyLong_FromSize_t(statistics.nb_moves_per_pass[pass]));
+
+      return Py_BuildValue("{s:N,s:N,s:N,s:d,s:d,s:d,s:d,s:N,s:N,s:N,s:N,s:N,s:N}",
+        "level_nodes", py_level_nodes,
+        "level_edges", py_level_edges,
+        "nb_moves_per_pass", py_nb_moves_per_pass,
+        "move_seconds", statistics.move_seconds,
+        "refine_seconds", statistics.refine_seconds,
+        "collapse_seconds", statistics.collapse_seconds,
+        "init_admin_seconds", statistics.init_admin_seconds,
+        "nb_visits", PyLong_FromSize_t(statistics.nb_visits),
+        "nb_moves", PyLong_FromSize_t(statistics.nb_moves),
+        "nb_reactivations", PyLong_FromSize_t(statistics.nb_reactivations),
+        "nb_diff_moves", PyLong_FromSize_t(statistics.nb_diff_moves),
+        "nb_candidates", PyLong_FromSize_t(statistics.nb_candidates),
+        "peak_scratch_memory", PyLong_FromSize_t(statistics.peak_scratch_memory));
+    #endif
+  }
+
+  PyObject* _Optimiser_resolution_profile(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = nullptr;
+    PyObject* py_partition = nullptr;
+    double resolution_min = 0.0;
+    double resolution_max = 0.0;
+    double min_diff_bisect_value = 1.0;
+    double min_diff_resolution = 1e-3;
+    int linear_bisection = false;
+    int number_iterations = 1;
+    Py_ssize_t nb_threads = 0;
+    static char* kwlist[] = {"optimiser", "partition", "resolution_min", "resolution_max",
+                             "min_diff_bisect_value", "min_diff_resolution", "linear_bisection",
+                             "number_iterations", "nb_threads", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOdd|ddiin", kwlist,
+                                     &py_optimiser, &py_partition, &resolution_min, &resolution_max,
+                                     &min_diff_bisect_value, &min_diff_resolution, &linear_bisection,
+                                     &number_iterations, &nb_threads))
+        return nullptr;
+
+    if (nb_threads < 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "The number of threads should not be negative.");
+      return nullptr;
+    }
+
+    #ifdef DEBUG
+      cerr << "resolution_profile(" << py_partition << ", " << resolution_min << ", " << resolution_max << ");" << endl;
+    #endif
+
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+    LinearResolutionParameterVertexPartition* partition =
+      dynamic_cast<LinearResolutionParameterVertexPartition*>(decapsule_MutableVertexPartition(py_partition));
+    if (!partition)
+    {
+      PyErr_SetString(PyExc_TypeError, "Bisectioning only works on partitions with a linear resolution parameter.");
+      return nullptr;
+    }
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+
+    // The threads of the profile never call the progress callback, so that the
+    // GIL can be released for the whole profile.
+    vector<LinearResolutionParameterVertexPartition*> profile;
+    PyThreadState* thread_state = PyEval_SaveThread();
+    try
+    {
+      profile = optimiser->resolution_profile(partition, resolution_min, resolution_max,
+        min_diff_bisect_value, min_diff_resolution, linear_bisection, number_iterations, nb_threads);
+    }
+    catch (std::exception const& e)
+    {
+      PyEval_RestoreThread(thread_state);
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return nullptr;
+    }
+    PyEval_RestoreThread(thread_state);
+
+    // Only the resolution parameters and memberships are returned, from which
+    // the partitions are created on the Python graph.
+    PyObject* py_profile = PyList_New(profile.size());
+    for (size_t i = 0; i < profile.size(); i++)
+    {
+      size_t n = profile[i]->get_graph()->vcount();
+      PyObject* py_membership = PyList_New(n);
+      for (size_t v = 0; v < n; v++)
+        PyList_SetItem(py_membership, v, PyLong_FromSize_t(profile[i]->membership(v)));
+      PyList_SetItem(py_profile, i, Py_BuildValue("(dN)", profile[i]->resolution_parameter, py_membership));
+      delete profile[i];
+    }
+    return py_profile;
+  }
+
+  PyObject* _Optimiser_resolution_sweep(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = nullptr;
+    PyObject* py_partition = nullptr;
+    PyObject* py_resolutions = nullptr;
+    int aggregate = false;
+    static char* kwlist[] = {"optimiser", "partition", "resolutions", "aggregate", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOO|i", kwlist,
+                                     &py_optimiser, &py_partition, &py_resolutions, &aggregate))
+        return nullptr;
+
+    if (!PyList_Check(py_resolutions))
+    {
+      PyErr_SetString(PyExc_TypeError, "Expected a list of resolution parameters.");
+      return nullptr;
+    }
+    size_t nb_resolutions = PyList_Size(py_resolutions);
+    vector<Weight> resolutions(nb_resolutions);
+    for (size_t i = 0; i < nb_resolutions; i++)
+    {
+      resolutions[i] = PyFloat_AsDouble(PyList_GetItem(py_resolutions, i));
+      if (PyErr_Occurred())
+        return nullptr;
+    }
+
+    #ifdef DEBUG
+      cerr << "resolution_sweep(" << py_partition << ", " << nb_resolutions << " resolution parameters, " << aggregate << ");" << endl;
+    #endif
+
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+    LinearResolutionParameterVertexPartition* partition =
+      dynamic_cast<LinearResolutionParameterVertexPartition*>(decapsule_MutableVertexPartition(py_partition));
+    if (!partition)
+    {
+      PyErr_SetString(PyExc_TypeError, "Sweeping only works on partitions with a linear resolution parameter.");
+      return nullptr;
+    }
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+
+    // The GIL is released as in _Optimiser_optimise_partition, the progress
+    // callback acquiring it again when called.
+    vector<LinearResolutionParameterVertexPartition*> sweep;
+    PyThreadState* thread_state = PyEval_SaveThread();
+    try
+    {
+      sweep = optimiser->resolution_sweep(partition, resolutions, aggregate);
+    }
+    catch (std::exception const& e)
+    {
+      PyEval_RestoreThread(thread_state);
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return nullptr;
+    }
+    PyEval_RestoreThread(thread_state);
+    if (PyErr_Occurred())
+    {
+      // Raised by the progress callback
+      for (LinearResolutionParameterVertexPartition* sweep_partition : sweep)
+        delete sweep_partition;
+      return nullptr;
+    }
+
+    PyObject* py_sweep = PyList_New(sweep.size());
+    for (size_t i = 0; i < sweep.size(); i++)
+    {
+      size_t n = sweep[i]->get_graph()->vcount();
+      PyObject* py_membership = PyList_New(n);
+      for (size_t v = 0; v < n; v++)
+        PyList_SetItem(py_membership, v, PyLong_FromSize_t(sweep[i]->membership(v)));
+      PyList_SetItem(py_sweep, i, Py_BuildValue("(dN)", sweep[i]->resolution_parameter, py_membership));
+      delete sweep[i];
+    }
+    return py_sweep;
+  }
+
+  PyObject* _Optimiser_ensemble(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_optimiser = nullptr;
+    PyObject* py_partition = nullptr;
+    Py_ssize_t nb_runs = 0;
+    int number_iterations = 2;
+    Py_ssize_t nb_threads = 0;
+    int edge_agreement = false;
+    static char* kwlist[] = {"optimiser", "partition", "nb_runs", "number_iterations",
+                             "nb_threads", "edge_agreement", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOn|ini", kwlist,
+                                     &py_optimiser, &py_partition, &nb_runs, &number_iterations,
+                                     &nb_threads, &edge_agreement))
+        return nullptr;
+
+    if (nb_runs <= 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "The number of runs should be positive.");
+      return nullptr;
+    }
+    if (nb_threads < 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "The number of threads should not be negative.");
+      return nullptr;
+    }
+
+    #ifdef DEBUG
+      cerr << "ensemble(" << py_partition << ", " << nb_runs << ", " << number_iterations << ");" << endl;
+    #endif
+
+    Optimiser* optimiser = decapsule_Optimiser(py_optimiser);
+    #ifdef DEBUG
+      cerr << "Using optimiser at address " << optimiser << endl;
+    #endif
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+
+    // The runs never call the progress callback, so that the GIL can be
+    // released for the whole ensemble, as for the resolution profile.
+    Weight quality = 0.0;
+    vector<Weight> agreement;
+    PyThreadState* thread_state = PyEval_SaveThread();
+    try
+    {
+      quality = optimiser->ensemble(partition, nb_runs, number_iterations, nb_threads,
+        edge_agreement ? &agreement : nullptr);
+    }
+    catch (std::exception const& e)
+    {
+      PyEval_RestoreThread(thread_state);
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return nullptr;
+    }
+    PyEval_RestoreThread(thread_state);
+
+    if (!edge_agreement)
+      return PyFloat_FromDouble(quality);
+
+    PyObject* py_agreement = PyList_New(agreement.size());
+    for (size_t e = 0; e < agreement.size(); e++)
+      PyList_SetItem(py_agreement, e, PyFloat_FromDouble(agreement[e]));
+    return Py_BuildValue("(dN)", quality, py_agreement);
+  }
 #ifdef __cplusplus
 }
 #endif
@@ -168,6 +168,200 @@ void del_MutableVertexPartition(PyObject* py_partition)
   delete partition;
 }
 
+PyObject* py_igraph_from_graph(const Graph* graph)
+{
+  size_t n = graph->vcount();
+  size_t m = graph->ecount();
+
+  PyObject* edges = PyList_New(m);
+  for (size_t e = 0; e < m; e++)
+  {
+    vector<size_t> edge = graph->edge(e);
+    PyList_SetItem(edges, e, Py_BuildValue("(KK)", edge[0], edge[1]));
+  }
+
+  PyObject* weights = PyList_New(m);
+  for (size_t e = 0; e < m; e++)
+  {
+    PyObject* item = PyFloat_FromDouble(graph->edge_weight(e));
+    PyList_SetItem(weights, e, item);
+  }
+
+  PyObject* node_sizes = PyList_New(n);
+  for (size_t v = 0; v < n; v++)
+  {
+    #ifdef IS_PY3K
+      PyObject* item = PyLong_FromSize_t(graph->node_size(v));
+    #else
+      PyObject* item = PyInt_FromSize_t(graph->node_size(v));
+    #endif
+    PyList_SetItem(node_sizes, v, item);
+  }
+
+  return Py_BuildValue("lNNN", n, edges, weights, node_sizes);
+}
+
+template <class T> static bool read_membership(const void* buffer, vector<Id>& membership)
+{
+  const T* items = (const T*) buffer;
+  for (size_t v = 0; v < membership.size(); v++)
+  {
+    if (items[v] < 0)
+      return false;
+    membership[v] = (Id) items[v];
+  }
+  return true;
+}
+
+/****************************************************************************
+  Read a membership from a Python object. Objects supporting the buffer
+  protocol with integer items, such as numpy arrays or array.array, are read
+  directly from their memory, other objects as a sequence of integers.
+*****************************************************************************/
+vector<Id> membership_from_py(PyObject* py_membership)
+{
+  vector<Id> membership;
+  if (PyObject_CheckBuffer(py_membership))
+  {
+    Py_buffer view;
+    if (PyObject_GetBuffer(py_membership, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) != 0)
+    {
+      PyErr_Clear();
+      throw LeidenException("Expected a contiguous buffer for the membership.");
+    }
+    const char* format = view.format != nullptr ? view.format : "B";
+    if (*format == '@')
+      format++;
+    bool is_signed = strchr("bhilqn", *format) != nullptr;
+    bool is_unsigned = strchr("BHILQN", *format) != nullptr;
+    bool valid = *format != '\0' && format[1] == '\0' && (is_signed || is_unsigned) && view.ndim <= 1;
+    if (valid)
+    {
+      membership.resize(view.len/view.itemsize);
+      switch (view.itemsize)
+      {
+        case 1: valid = is_signed ? read_membership<int8_t>(view.buf, membership)  : read_membership<uint8_t>(view.buf, membership);  break;
+        case 2: valid = is_signed ? read_membership<int16_t>(view.buf, membership) : read_membership<uint16_t>(view.buf, membership); break;
+        case 4: valid = is_signed ? read_membership<int32_t>(view.buf, membership) : read_membership<uint32_t>(view.buf, membership); break;
+        case 8: valid = is_signed ? read_membership<int64_t>(view.buf, membership) : read_membership<uint64_t>(view.buf, membership); break;
+        default: valid = false;
+      }
+    }
+    PyBuffer_Release(&view);
+    if (!valid)
+      throw LeidenException("Expected a buffer of non-negative integer values for the membership.");
+  }
+  else
+  {
+    PyObject* py_items = PySequence_Fast(py_membership, "");
+    if (py_items == nullptr)
+    {
+      PyErr_Clear();
+      throw LeidenException("Expected a sequence or buffer for the membership.");
+    }
+    size_t n = PySequence_Fast_GET_SIZE(py_items);
+    membership.resize(n);
+    for (size_t v = 0; v < n; v++)
+    {
+      membership[v] = PyLong_AsUnsignedLongLong(PySequence_Fast_GET_ITEM(py_items, v));
+      if (PyErr_Occurred())
+      {
+        PyErr_Clear();
+        Py_DECREF(py_items);
+        throw LeidenException("Expected non-negative integer values for the membership.");
+      }
+    }
+    Py_DECREF(py_items);
+  }
+  return membership;
+}
+
+/****************************************************************************
+  Create the layers of coupled slices (see Graph::slices_to_layers) from the
+  Python lists of the node ids, edges and edge weights of each slice, and of
+  the coupling edges and their weights. The layers of the slices are sparse
+  graphs if sparse. The layers are created without the GIL.
+*****************************************************************************/
+static vector<Graph*> slices_to_layers_from_py(PyObject* py_slice_ids,
+  PyObject* py_slice_edges, PyObject* py_slice_weights,
+  PyObject* py_coupling_edges, PyObject* py_coupling_weights,
+  int directed, int coupling_directed, int sparse)
+{
+  size_t nb_slices = PyList_Size(py_slice_ids);
+  if (PyList_Size(py_slice_edges) != (Py_ssize_t)nb_slices || PyList_Size(py_slice_weights) != (Py_ssize_t)nb_slices)
+    throw LeidenException("Number of edge lists and edge weights should be equal to the number of slices.");
+
+  vector< vector<Id> > slice_ids(nb_slices);
+  vector< vector< pair<Id, Id> > > slice_edges(nb_slices);
+  vector< vector<Weight> > slice_weights(nb_slices);
+  unsigned long long v, u;
+  for (size_t s = 0; s < nb_slices; s++)
+  {
+    PyObject* py_ids = PyList_GetItem(py_slice_ids, s);
+    size_t n = PyList_Size(py_ids);
+    slice_ids[s].resize(n);
+    for (size_t i = 0; i < n; i++)
+    {
+      slice_ids[s][i] = PyLong_AsUnsignedLongLong(PyList_GetItem(py_ids, i));
+      if (PyErr_Occurred())
+        throw LeidenException("Expected non-negative integer value for node ids.");
+    }
+
+    PyObject* py_edges = PyList_GetItem(py_slice_edges, s);
+    size_t m = PyList_Size(py_edges);
+    slice_edges[s].resize(m);
+    for (size_t e = 0; e < m; e++)
+    {
+      if (!PyArg_ParseTuple(PyList_GetItem(py_edges, e), "KK", &v, &u))
+        throw LeidenException("Expected pairs of integer values for edges.");
+      slice_edges[s][e] = make_pair(v, u);
+    }
+
+    PyObject* py_weights = PyList_GetItem(py_slice_weights, s);
+    size_t nb_weights = PyList_Size(py_weights);
+    slice_weights[s].resize(nb_weights);
+    for (size_t e = 0; e < nb_weights; e++)
+    {
+      slice_weights[s][e] = PyFloat_AsDouble(PyList_GetItem(py_weights, e));
+      if (PyErr_Occurred())
+        throw LeidenException("Expected floating point value for edge weights.");
+    }
+  }
+
+  size_t nb_coupling = PyList_Size(py_coupling_edges);
+  vector< pair<Id, Id> > coupling_edges(nb_coupling);
+  for (size_t c = 0; c < nb_coupling; c++)
+  {
+    if (!PyArg_ParseTuple(PyList_GetItem(py_coupling_edges, c), "KK", &v, &u))
+      throw LeidenException("Expected pairs of integer values for coupling edges.");
+    coupling_edges[c] = make_pair(v, u);
+  }
+  size_t nb_coupling_weights = PyList_Size(py_coupling_weights);
+  vector<Weight> coupling_weights(nb_coupling_weights);
+  for (size_t c = 0; c < nb_coupling_weights; c++)
+  {
+    coupling_weights[c] = PyFloat_AsDouble(PyList_GetItem(py_coupling_weights, c));
+    if (PyErr_Occurred())
+      throw LeidenException("Expected floating point value for coupling weights.");
+  }
+
+  vector<Graph*> layers;
+  PyThreadState* thread_state = PyEval_SaveThread();
+  try
+  {
+    layers = Graph::slices_to_layers(slice_ids, slice_edges, slice_weights,
+                                     coupling_edges, coupling_weights,
+                                     directed, coupling_directed, sparse);
+  }
+  catch (...)
+  {
+    PyEval_RestoreThread(thread_state);
+    throw;
+  }
+  PyEval_RestoreThread(thread_state);
+  return layers;
+}
+
 #ifdef __cplusplus
 extern "C"
 {
@@ -245,11 +439,12 @@ extern "C"
   {
     PyObject* py_obj_graph = nullptr;
     PyObject* py_initial_membership = nullptr;
+    int fast_kl = false;
 
-    static char* kwlist[] = {"graph", "initial_membership", nullptr};
+    static char* kwlist[] = {"graph", "initial_membership", "fast_kl", nullptr};
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|O", kwlist,
-                                     &py_obj_graph, &py_initial_membership))
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|Oi", kwlist,
+                                     &py_obj_graph, &py_initial_membership, &fast_kl))
         return nullptr;
 
     try
@@ -288,10 +483,10 @@ extern "C"
           }
         }
 
-        partition = new SignificanceVertexPartition(graph, initial_membership);
+        partition = new SignificanceVertexPartition(graph, initial_membership, fast_kl);
       }
       else
-        partition = new SignificanceVertexPartition(graph);
+        partition = new SignificanceVertexPartition(graph, fast_kl);
 
       PyObject* py_partition = capsule_MutableVertexPartition(partition);
       #ifdef DEBUG
@@ -313,11 +508,12 @@ extern "C"
     PyObject* py_obj_graph = nullptr;
     PyObject* py_initial_membership = nullptr;
     PyObject* py_weights = nullptr;
+    int fast_kl = false;
 
-    static char* kwlist[] = {"graph", "initial_membership", "weights", nullptr};
+    static char* kwlist[] = {"graph", "initial_membership", "weights", "fast_kl", nullptr};
 
-    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OO", kwlist,
-                                     &py_obj_graph, &py_initial_membership, &py_weights))
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O|OOi", kwlist,
+                                     &py_obj_graph, &py_initial_membership, &py_weights, &fast_kl))
         return nullptr;
 
     try
@@ -356,10 +552,10 @@ extern "C"
           }
         }
 
-        partition = new SurpriseVertexPartition(graph, initial_membership);
+        partition = new SurpriseVertexPartition(graph, initial_membership, fast_kl);
       }
       else
-        partition = new SurpriseVertexPartition(graph);
+        partition = new SurpriseVertexPartition(graph, fast_kl);
 
       PyObject* py_partition = capsule_MutableVertexPartition(partition);
       #ifdef DEBUG
@@ -616,37 +812,7 @@ extern "C"
       cerr << "Using partition at address " << partition << endl;
     #endif
 
-    const Graph* graph = partition->get_graph();
-
-    size_t n = graph->vcount();
-    size_t m = graph->ecount();
-
-    PyObject* edges = PyList_New(m);
-    for (size_t e = 0; e < m; e++)
-    {
-      vector<size_t> edge = graph->edge(e);
-      PyList_SetItem(edges, e, Py_BuildValue("(KK)", edge[0], edge[1]));
-    }
-
-    PyObject* weights = PyList_New(m);
-    for (size_t e = 0; e < m; e++)
-    {
-      PyObject* item = PyFloat_FromDouble(graph->edge_weight(e));
-      PyList_SetItem(weights, e, item);
-    }
-
-    PyObject* node_sizes = PyList_New(n);
-    for (size_t v = 0; v < n; v++)
-    {
-      #ifdef IS_PY3K
-        PyObject* item = PyLong_FromSize_t(graph->node_size(v));
-      #else
-        PyObject* item = PyInt_FromSize_t(graph->node_size(v));
-      #endif
-      PyList_SetItem(node_sizes, v, item);
-    }
-
-    return Py_BuildValue("lOOO", n, edges, weights, node_sizes);
+    return py_igraph_from_graph(partition->get_graph());
   }
 
   PyObject* _MutableVertexPartition_from_coarse_partition(PyObject *self, PyObject *args, PyObject *keywds)
@@ -804,6 +970,82 @@ extern "C"
     return PyFloat_FromDouble(diff);
   }
 
+  PyObject* _MutableVertexPartition_diff_move_all(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = nullptr;
+    size_t v;
+    PyObject* py_candidates = nullptr;
+
+    static char* kwlist[] = {"partition", "v", "candidates", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OKO", kwlist,
+                                     &py_partition, &v, &py_candidates))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "diff_move_all(" << v << ");" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule partition at address " << py_partition << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+
+    if (v >= partition->get_graph()->vcount())
+    {
+      PyErr_SetString(PyExc_ValueError, "Node is not a node of the graph.");
+      return nullptr;
+    }
+
+    size_t nb_candidates = PyList_Size(py_candidates);
+    vector<Id> candidates(nb_candidates);
+    for (size_t i = 0; i < nb_candidates; i++)
+    {
+      PyObject* py_item = PyList_GetItem(py_candidates, i);
+      if (PyNumber_Check(py_item) && PyIndex_Check(py_item))
+      {
+        Py_ssize_t comm = PyNumber_AsSsize_t(py_item, nullptr);
+        // The kernels do not check whether the candidates are communities
+        if (comm < 0 || (size_t)comm >= partition->n_communities())
+        {
+          PyErr_SetString(PyExc_ValueError, "Candidate is not a community of the partition.");
+          return nullptr;
+        }
+        candidates[i] = comm;
+      }
+      else
+      {
+        PyErr_SetString(PyExc_TypeError, "Expected integer value for candidate.");
+        return nullptr;
+      }
+    }
+
+    vector<Weight> gains;
+    try
+    {
+      partition->diff_move_all(v, candidates, gains);
+    }
+    catch (std::exception const& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return nullptr;
+    }
+
+    PyObject* py_gains = PyList_New(nb_candidates);
+    for (size_t i = 0; i < nb_candidates; i++)
+      PyList_SetItem(py_gains, i, PyFloat_FromDouble(gains[i]));
+    return py_gains;
+  }
+
   PyObject* _MutableVertexPartition_move_node(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_partition = nullptr;
@@ -1285,6 +1527,126 @@ extern "C"
     return Py_None;
   }
 
+  PyObject* _MutableVertexPartition_change_edges(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = nullptr;
+    PyObject* py_added_edges = nullptr;
+    PyObject* py_added_weights = nullptr;
+    PyObject* py_removed_edges = nullptr;
+    PyObject* py_updated_edges = nullptr;
+    PyObject* py_updated_weights = nullptr;
+
+    static char* kwlist[] = {"partition", "added_edges", "added_weights", "removed_edges", "updated_edges", "updated_weights", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOOOOO", kwlist,
+                                     &py_partition, &py_added_edges, &py_added_weights,
+                                     &py_removed_edges, &py_updated_edges, &py_updated_weights))
+        return nullptr;
+
+    EdgeDelta delta;
+    size_t nb_added = PyList_Size(py_added_edges);
+    delta.added_edges.resize(nb_added);
+    for (size_t i = 0; i < nb_added; i++)
+    {
+      unsigned long long u, v;
+      if (!PyArg_ParseTuple(PyList_GetItem(py_added_edges, i), "KK", &u, &v))
+        return nullptr;
+      delta.added_edges[i] = make_pair(u, v);
+    }
+    if (py_added_weights != Py_None)
+    {
+      size_t nb_weights = PyList_Size(py_added_weights);
+      delta.added_weights.resize(nb_weights);
+      for (size_t i = 0; i < nb_weights; i++)
+      {
+        PyObject* py_item = PyList_GetItem(py_added_weights, i);
+        if (!PyNumber_Check(py_item))
+        {
+          PyErr_SetString(PyExc_TypeError, "Expected floating point value for weight vector.");
+          return nullptr;
+        }
+        delta.added_weights[i] = PyFloat_AsDouble(py_item);
+      }
+    }
+
+    size_t nb_removed = PyList_Size(py_removed_edges);
+    delta.removed_edges.resize(nb_removed);
+    for (size_t i = 0; i < nb_removed; i++)
+    {
+      PyObject* py_item = PyList_GetItem(py_removed_edges, i);
+      if (!PyNumber_Check(py_item) || !PyIndex_Check(py_item))
+      {
+        PyErr_SetString(PyExc_TypeError, "Expected integer value for edge vector.");
+        return nullptr;
+      }
+      Py_ssize_t e = PyNumber_AsSsize_t(py_item, nullptr);
+      if (e < 0)
+      {
+        PyErr_SetString(PyExc_ValueError, "Edge cannot be negative.");
+        return nullptr;
+      }
+      delta.removed_edges[i] = e;
+    }
+
+    size_t nb_updated = PyList_Size(py_updated_edges);
+    if ((size_t)PyList_Size(py_updated_weights) != nb_updated)
+    {
+      PyErr_SetString(PyExc_ValueError, "Weights vector inconsistent length with the number of edges to update.");
+      return nullptr;
+    }
+    delta.updated_edges.resize(nb_updated);
+    delta.updated_weights.resize(nb_updated);
+    for (size_t i = 0; i < nb_updated; i++)
+    {
+      PyObject* py_item = PyList_GetItem(py_updated_edges, i);
+      PyObject* py_weight = PyList_GetItem(py_updated_weights, i);
+      if (!PyNumber_Check(py_item) || !PyIndex_Check(py_item) || !PyNumber_Check(py_weight))
+      {
+        PyErr_SetString(PyExc_TypeError, "Expected an integer edge and a floating point weight.");
+        return nullptr;
+      }
+      Py_ssize_t e = PyNumber_AsSsize_t(py_item, nullptr);
+      if (e < 0)
+      {
+        PyErr_SetString(PyExc_ValueError, "Edge cannot be negative.");
+        return nullptr;
+      }
+      delta.updated_edges[i] = e;
+      delta.updated_weights[i] = PyFloat_AsDouble(py_weight);
+    }
+
+    #ifdef DEBUG
+      cerr << "change_edges(+" << nb_added << ", -" << nb_removed << ", ~" << nb_updated << ");" << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+
+    vector<Id> changed_nodes;
+    try
+    {
+      changed_nodes = partition->change_edges(delta);
+    }
+    catch (std::exception const & e )
+    {
+      string s = "Could not change edges: " + string(e.what());
+      PyErr_SetString(PyExc_BaseException, s.c_str());
+      return nullptr;
+    }
+
+    PyObject* py_changed_nodes = PyList_New(changed_nodes.size());
+    for (size_t i = 0; i < changed_nodes.size(); i++)
+      PyList_SetItem(py_changed_nodes, i, PyLong_FromSize_t(changed_nodes[i]));
+    return py_changed_nodes;
+  }
+
   PyObject* _ResolutionParameterVertexPartition_get_resolution(PyObject *self, PyObject *args, PyObject *keywds)
   {
     PyObject* py_partition = nullptr;
@@ -1397,6 +1759,377 @@ extern "C"
     return PyFloat_FromDouble(q);
   }
 
+  PyObject* _LinearResolutionParameterVertexPartition_quality_terms(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = nullptr;
+
+    static char* kwlist[] = {"partition", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "O", kwlist,
+                                     &py_partition))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "quality_terms();" << endl;
+    #endif
+
+    #ifdef DEBUG
+      cerr << "Capsule partition at address " << py_partition << endl;
+    #endif
+
+    LinearResolutionParameterVertexPartition* partition = (LinearResolutionParameterVertexPartition*)decapsule_MutableVertexPartition(py_partition);
+
+    #ifdef DEBUG
+      cerr << "Using partition at address " << partition << endl;
+    #endif
+
+    // quality(resolution_parameter) = scale*(weight - resolution_parameter*penalty)
+    double scale = 2.0 - partition->get_graph()->is_directed();
+    return Py_BuildValue("(dd)", scale*partition->total_weight_in_all_comms(),
+                                 scale*partition->resolution_penalty());
+  }
+
+  PyObject* _slices_to_layers(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_slice_ids = nullptr;
+    PyObject* py_slice_edges = nullptr;
+    PyObject* py_slice_weights = nullptr;
+    PyObject* py_coupling_edges = nullptr;
+    PyObject* py_coupling_weights = nullptr;
+    int directed = false;
+    int coupling_directed = false;
+
+    static char* kwlist[] = {"slice_ids", "slice_edges", "slice_weights", "coupling_edges", "coupling_weights", "directed", "coupling_directed", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOOOO|ii", kwlist,
+                                     &py_slice_ids, &py_slice_edges, &py_slice_weights,
+                                     &py_coupling_edges, &py_coupling_weights,
+                                     &directed, &coupling_directed))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "slices_to_layers();" << endl;
+    #endif
+
+    vector<Graph*> layers;
+    try
+    {
+      layers = slices_to_layers_from_py(py_slice_ids, py_slice_edges, py_slice_weights,
+                                        py_coupling_edges, py_coupling_weights,
+                                        directed, coupling_directed, false);
+    }
+    catch (std::exception const& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return nullptr;
+    }
+
+    PyObject* py_layers = PyList_New(layers.size());
+    for (size_t i = 0; i < layers.size(); i++)
+    {
+      PyList_SetItem(py_layers, i, py_igraph_from_graph(layers[i]));
+      delete layers[i];
+    }
+    return py_layers;
+  }
+
+  PyObject* _slices_to_partitions(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_partition = nullptr;
+    PyObject* py_slice_ids = nullptr;
+    PyObject* py_slice_edges = nullptr;
+    PyObject* py_slice_weights = nullptr;
+    PyObject* py_coupling_edges = nullptr;
+    PyObject* py_coupling_weights = nullptr;
+    int directed = false;
+    int coupling_directed = false;
+    int sparse = false;
+
+    static char* kwlist[] = {"partition", "slice_ids", "slice_edges", "slice_weights", "coupling_edges", "coupling_weights", "directed", "coupling_directed", "sparse", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OOOOOO|iii", kwlist,
+                                     &py_partition, &py_slice_ids, &py_slice_edges, &py_slice_weights,
+                                     &py_coupling_edges, &py_coupling_weights,
+                                     &directed, &coupling_directed, &sparse))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "slices_to_partitions();" << endl;
+    #endif
+
+    MutableVertexPartition* partition = decapsule_MutableVertexPartition(py_partition);
+
+    // The partitions of the layers of the slices are of the same type as
+    // partition, and the partition of the interslice layer is a
+    // CPMVertexPartition without any resolution, so that it has no cost. Each
+    // partition owns its layer. The interslice layer is never sparse, so that
+    // its partition has the membership of all nodes.
+    vector<Graph*> layers;
+    vector<MutableVertexPartition*> partitions;
+    try
+    {
+      layers = slices_to_layers_from_py(py_slice_ids, py_slice_edges, py_slice_weights,
+                                        py_coupling_edges, py_coupling_weights,
+                                        directed, coupling_directed, sparse);
+      partitions.reserve(layers.size());
+      for (size_t i = 0; i + 1 < layers.size(); i++)
+        partitions.push_back(partition->create(layers[i]));
+      partitions.push_back(new CPMVertexPartition(layers.back(), 0.0));
+    }
+    catch (std::exception const& e)
+    {
+      for (MutableVertexPartition* layer_partition : partitions)
+        delete layer_partition;
+      for (size_t i = partitions.size(); i < layers.size(); i++)
+        delete layers[i];
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return nullptr;
+    }
+
+    PyObject* py_partitions = PyList_New(partitions.size());
+    for (size_t i = 0; i < partitions.size(); i++)
+      PyList_SetItem(py_partitions, i, capsule_MutableVertexPartition(partitions[i]));
+    return py_partitions;
+  }
+
+  PyObject* _compare_memberships(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    PyObject* py_membership1 = nullptr;
+    PyObject* py_membership2 = nullptr;
+    Py_ssize_t nb_threads = 0;
+
+    static char* kwlist[] = {"membership1", "membership2", "nb_threads", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "OO|n", kwlist,
+                                     &py_membership1, &py_membership2, &nb_threads))
+        return nullptr;
+
+    if (nb_threads < 0)
+    {
+      PyErr_SetString(PyExc_ValueError, "The number of threads should not be negative.");
+      return nullptr;
+    }
+
+    #ifdef DEBUG
+      cerr << "compare_memberships();" << endl;
+    #endif
+
+    MembershipComparison comparison;
+    try
+    {
+      vector<Id> membership1 = membership_from_py(py_membership1);
+      vector<Id> membership2 = membership_from_py(py_membership2);
+
+      PyThreadState* thread_state = PyEval_SaveThread();
+      try
+      {
+        comparison = compare_memberships(membership1, membership2, nb_threads);
+      }
+      catch (...)
+      {
+        PyEval_RestoreThread(thread_state);
+        throw;
+      }
+      PyEval_RestoreThread(thread_state);
+    }
+    catch (std::exception const& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return nullptr;
+    }
+
+    return Py_BuildValue("{s:d,s:d,s:d}",
+                         "nmi", comparison.nmi,
+                         "ari", comparison.ari,
+                         "vi", comparison.vi);
+  }
+
+  PyObject* _write_membership(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    char* filename = nullptr;
+    PyObject* py_membership = nullptr;
+    PyObject* py_levels = nullptr;
+
+    static char* kwlist[] = {"filename", "membership", "levels", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "sO|O", kwlist,
+                                     &filename, &py_membership, &py_levels))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "write_membership(" << filename << ");" << endl;
+    #endif
+
+    try
+    {
+      vector<Id> membership = membership_from_py(py_membership);
+      vector< vector<Id> > levels;
+      if (py_levels != nullptr && py_levels != Py_None)
+      {
+        size_t nb_levels = PyList_Size(py_levels);
+        if (PyErr_Occurred())
+        {
+          PyErr_Clear();
+          throw LeidenException("Expected a list of levels.");
+        }
+        levels.resize(nb_levels);
+        for (size_t l = 0; l < nb_levels; l++)
+          levels[l] = membership_from_py(PyList_GetItem(py_levels, l));
+      }
+
+      PyThreadState* thread_state = PyEval_SaveThread();
+      try
+      {
+        write_membership(filename, membership, levels);
+      }
+      catch (...)
+      {
+        PyEval_RestoreThread(thread_state);
+        throw;
+      }
+      PyEval_RestoreThread(thread_state);
+    }
+    catch (std::exception const& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return nullptr;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
+
+  PyObject* _read_membership(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    char* filename = nullptr;
+
+    static char* kwlist[] = {"filename", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "s", kwlist, &filename))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "read_membership(" << filename << ");" << endl;
+    #endif
+
+    vector<Id> membership;
+    vector< vector<Id> > levels;
+    try
+    {
+      PyThreadState* thread_state = PyEval_SaveThread();
+      try
+      {
+        read_membership(filename, membership, levels);
+      }
+      catch (...)
+      {
+        PyEval_RestoreThread(thread_state);
+        throw;
+      }
+      PyEval_RestoreThread(thread_state);
+    }
+    catch (std::exception const& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return nullptr;
+    }
+
+    PyObject* py_membership = PyList_New(membership.size());
+    for (size_t v = 0; v < membership.size(); v++)
+      PyList_SetItem(py_membership, v, PyLong_FromSize_t(membership[v]));
+    PyObject* py_levels = PyList_New(levels.size());
+    for (size_t l = 0; l < levels.size(); l++)
+    {
+      PyObject* py_level = PyList_New(levels[l].size());
+      for (size_t c = 0; c < levels[l].size(); c++)
+        PyList_SetItem(py_level, c, PyLong_FromSize_t(levels[l][c]));
+      PyList_SetItem(py_levels, l, py_level);
+    }
+    return Py_BuildValue("(NN)", py_membership, py_levels);
+  }
+
+  PyObject* _membership_to_text(PyObject *self, PyObject *args, PyObject *keywds)
+  {
+    char* filename = nullptr;
+    char* text_filename = nullptr;
+    PyObject* py_level = nullptr;
+
+    static char* kwlist[] = {"filename", "text_filename", "level", nullptr};
+
+    #ifdef DEBUG
+      cerr << "Parsing arguments..." << endl;
+    #endif
+
+    if (!PyArg_ParseTupleAndKeywords(args, keywds, "ss|O", kwlist,
+                                     &filename, &text_filename, &py_level))
+        return nullptr;
+
+    #ifdef DEBUG
+      cerr << "membership_to_text(" << filename << ", " << text_filename << ");" << endl;
+    #endif
+
+    try
+    {
+      bool has_level = py_level != nullptr && py_level != Py_None;
+      Id level = 0;
+      if (has_level)
+      {
+        level = PyLong_AsUnsignedLongLong(py_level);
+        if (PyErr_Occurred())
+        {
+          PyErr_Clear();
+          throw LeidenException("Expected a non-negative integer value for the level.");
+        }
+      }
+
+      PyThreadState* thread_state = PyEval_SaveThread();
+      try
+      {
+        if (has_level)
+          membership_to_text(filename, text_filename, level);
+        else
+          membership_to_text(filename, text_filename);
+      }
+      catch (...)
+      {
+        PyEval_RestoreThread(thread_state);
+        throw;
+      }
+      PyEval_RestoreThread(thread_state);
+    }
+    catch (std::exception const& e)
+    {
+      PyErr_SetString(PyExc_ValueError, e.what());
+      return nullptr;
+    }
+
+    Py_INCREF(Py_None);
+    return Py_None;
+  }
 #ifdef __cplusplus
 }
 #endif
@@ -1,6 +1,11 @@
 import unittest
 import igraph as ig
 import leidenalg
+import array
+import os
+import tempfile
+import random
+import struct
 
 import sys
 PY3 = (sys.version > '3');
@@ -45,6 +50,132 @@ class OptimiserTest(unittest.TestCase):
           partition.diff_move(v.index, c), 1e-10, # Allow for a small difference up to rounding error.
           msg="Was able to move a node to a better community, violating node optimality.");
 
+  def test_move_nodes_reactivation(self):
+    G = ig.Graph.Erdos_Renyi(100, p=5./100, directed=False, loops=False);
+    partition = leidenalg.CPMVertexPartition(G, resolution_parameter=0.1);
+    self.optimiser.move_nodes(partition, consider_comms=leidenalg.ALL_NEIGH_COMMS);
+    statistics = self.optimiser.statistics;
+    if statistics is None:
+      self.skipTest("Statistics are not collected.");
+    # Neighbours of moved nodes should be reconsidered in further passes
+    self.assertGreater(statistics['nb_reactivations'], 0);
+    self.assertGreater(len(statistics['nb_moves_per_pass']), 1);
+    self.assertGreater(statistics['nb_moves_per_pass'][0], 0);
+    # The statistics are reset by each optimisation
+    self.optimiser.optimise_partition(partition);
+    statistics = self.optimiser.statistics;
+    self.assertEqual(statistics['level_nodes'][0], G.vcount());
+    self.assertGreater(len(statistics['nb_moves_per_pass']), 0);
+    self.assertLessEqual(sum(statistics['nb_moves_per_pass']), statistics['nb_moves']);
+
+  def test_statistics(self):
+    G = ig.Graph.Erdos_Renyi(100, p=5./100, directed=False, loops=False);
+    partition = leidenalg.ModularityVertexPartition(G);
+    self.optimiser.optimise_partition(partition);
+    statistics = self.optimiser.statistics;
+    if statistics is None:
+      self.skipTest("Statistics are not collected.");
+    self.assertEqual(statistics['level_nodes'][0], G.vcount());
+    self.assertEqual(statistics['level_edges'][0], G.ecount());
+    self.assertGreaterEqual(statistics['nb_visits'], G.vcount());
+    self.assertGreater(statistics['nb_moves'], 0);
+    self.assertGreaterEqual(statistics['nb_diff_moves'], statistics['nb_candidates']);
+    self.assertGreater(statistics['peak_scratch_memory'], 0);
+
+  def test_progress_callback(self):
+    G = ig.Graph.Erdos_Renyi(100, p=5./100, directed=False, loops=False);
+    calls = [];
+    def callback(level, nb_visits):
+      calls.append((level, nb_visits));
+      return True;
+    self.optimiser.set_progress_callback(callback, interval=10);
+    partition = leidenalg.ModularityVertexPartition(G);
+    self.optimiser.optimise_partition(partition);
+    self.assertFalse(self.optimiser.stopped);
+    self.assertGreater(len(calls), 1);
+    self.assertIn((0, 0), calls);
+    self.assertTrue(all(nb_visits % 10 == 0 for level, nb_visits in calls));
+
+  def test_progress_callback_stop(self):
+    G = ig.Graph.Erdos_Renyi(100, p=5./100, directed=False, loops=False);
+    self.optimiser.set_progress_callback(lambda level, nb_visits: False);
+    partition = leidenalg.ModularityVertexPartition(G);
+    diff = self.optimiser.optimise_partition(partition, n_iterations=-1);
+    self.assertTrue(self.optimiser.stopped);
+    self.assertEqual(diff, 0);
+    self.assertListEqual(
+        partition.sizes(), [1]*G.vcount(),
+        msg="Partition changed although the optimisation was stopped immediately.");
+    self.optimiser.set_progress_callback(None);
+    self.optimiser.optimise_partition(partition);
+    self.assertFalse(self.optimiser.stopped);
+
+  def test_time_limit(self):
+    self.optimiser.time_limit = 1.5;
+    self.assertEqual(self.optimiser.time_limit, 1.5);
+    G = ig.Graph.Famous('Zachary');
+    partition = leidenalg.ModularityVertexPartition(G);
+    self.optimiser.optimise_partition(partition);
+    self.assertFalse(self.optimiser.stopped);
+    self.assertEqual(self.optimiser.time_limit, 1.5);
+
+  def test_rng_seed(self):
+    G = ig.Graph.Erdos_Renyi(100, p=5./100, directed=False, loops=False);
+    memberships = [];
+    for i in range(2):
+      optimiser = leidenalg.Optimiser();
+      optimiser.set_rng_seed(42);
+      partition = leidenalg.ModularityVertexPartition(G);
+      optimiser.optimise_partition(partition);
+      memberships.append(partition.membership);
+    self.assertListEqual(
+        memberships[0], memberships[1],
+        msg="Optimising with the same seed gives different partitions.");
+
+  def test_warm_start(self):
+    G = ig.Graph.SBM(200, pref_matrix=[[0.2, 0.01], [0.01, 0.2]], block_sizes=[100, 100]);
+    partition = leidenalg.ModularityVertexPartition(G);
+    self.optimiser.optimise_partition(partition);
+    changed_nodes = list(G.es[0].tuple) + [0, 150, 1, 199, 50, 120];
+    G.delete_edges([0]);
+    G.add_edges([(0, 150), (1, 199), (50, 120)]);
+    partition = leidenalg.ModularityVertexPartition(G, initial_membership=partition.membership);
+    quality = partition.quality();
+    self.optimiser.optimise_partition(partition, n_iterations=-1, changed_nodes=changed_nodes);
+    self.assertGreaterEqual(partition.quality(), quality - 1e-10);
+    self.assertEqual(len(partition.membership), G.vcount());
+    self.assertRaises(
+        ValueError,
+        self.optimiser.optimise_partition, partition, changed_nodes=[G.vcount()]);
+
+  def test_warm_start_edge_delta(self):
+    G = ig.Graph.SBM(200, pref_matrix=[[0.2, 0.01], [0.01, 0.2]], block_sizes=[100, 100]);
+    m = G.ecount();
+    partition = leidenalg.ModularityVertexPartition(G);
+    self.optimiser.optimise_partition(partition);
+    self.optimiser.optimise_partition(partition, n_iterations=-1,
+                                      added_edges=[(0, 150), (1, 199), (50, 120)], removed_edges=[0]);
+    # The partition is the same as one for the changed graph from scratch
+    H = G.copy();
+    H.delete_edges([0]);
+    H.add_edges([(0, 150), (1, 199), (50, 120)]);
+    fresh_partition = leidenalg.ModularityVertexPartition(H, initial_membership=partition.membership);
+    self.assertAlmostEqual(partition.quality(), fresh_partition.quality(), places=10);
+    self.assertEqual(partition.graph.ecount(), m + 2);
+    self.assertEqual(G.ecount(), m);
+
+  def test_warm_start_no_changed_nodes(self):
+    G = ig.Graph.Famous('Zachary');
+    partition = leidenalg.ModularityVertexPartition(G);
+    self.optimiser.optimise_partition(partition);
+    membership = partition.membership;
+    diff = self.optimiser.optimise_partition(partition, changed_nodes=[]);
+    self.assertEqual(diff, 0);
+    self.assertListEqual(partition.membership, membership);
+    # Neither does an empty change of the edges
+    self.optimiser.optimise_partition(partition, updated_edges=[]);
+    self.assertListEqual(partition.membership, membership);
+
   def test_optimiser(self):
     G = reduce(ig.Graph.disjoint_union, (ig.Graph.Tree(10, 3, mode=ig.TREE_UNDIRECTED) for i in range(10)));
     partition = leidenalg.CPMVertexPartition(G, resolution_parameter=0);
@@ -54,6 +185,18 @@ class OptimiserTest(unittest.TestCase):
         partition.sizes(), 10*[10],
         msg="After optimising partition failed to find different components with CPMVertexPartition(resolution_parameter=0)");
 
+  def test_node_order(self):
+    G = reduce(ig.Graph.disjoint_union, (ig.Graph.Tree(10, 3, mode=ig.TREE_UNDIRECTED) for i in range(10)));
+    for node_order in [leidenalg.RAND_ORDER, leidenalg.DEGREE_ORDER,
+                       leidenalg.CHANGE_ORDER, leidenalg.IMPROV_ORDER]:
+      partition = leidenalg.CPMVertexPartition(G, resolution_parameter=0);
+      self.optimiser.node_order = node_order;
+      self.assertEqual(self.optimiser.node_order, node_order);
+      self.optimiser.optimise_partition(partition);
+      self.assertListEqual(
+          partition.sizes(), 10*[10],
+          msg="After optimising partition with node order {0} failed to find different components with CPMVertexPartition(resolution_parameter=0)".format(node_order));
+
   def test_neg_weight_bipartite(self):
     G = ig.Graph.Full_Bipartite(50, 50);
     G.es['weight'] = -0.1;
@@ -74,6 +217,212 @@ class OptimiserTest(unittest.TestCase):
       profile[-1].sizes(), [1]*G.vcount(),
       msg="Resolution profile incorrect: at resolution 1, not equal to a singleton partition for CPM.");
 
+  def test_resolution_profile_bisect_func(self):
+    G = ig.Graph.Famous('Zachary');
+    profile = self.optimiser.resolution_profile(G, leidenalg.CPMVertexPartition, resolution_range=(0,1),
+                                                bisect_func=lambda p: len(p));
+    self.assertListEqual(profile[0].sizes(), [G.vcount()]);
+    self.assertListEqual(profile[-1].sizes(), [1]*G.vcount());
+    resolutions = [partition.resolution_parameter for partition in profile];
+    self.assertListEqual(resolutions, sorted(resolutions));
+
+  def test_resolution_profile_threads(self):
+    G = ig.Graph.Famous('Zachary');
+    profiles = [];
+    for n_threads in [1, 4]:
+      self.optimiser.set_rng_seed(42);
+      profile = self.optimiser.resolution_profile(G, leidenalg.RBConfigurationVertexPartition,
+                                                  resolution_range=(0.1, 10), n_threads=n_threads);
+      resolutions = [partition.resolution_parameter for partition in profile];
+      self.assertListEqual(resolutions, sorted(resolutions));
+      for partition in profile:
+        for other in profile:
+          self.assertLessEqual(
+            other.quality(partition.resolution_parameter), partition.quality() + 1e-10,
+            msg="Resolution profile incorrect: a partition in the profile is better at another resolution.");
+      profiles.append([(partition.resolution_parameter, partition.membership) for partition in profile]);
+    self.assertListEqual(profiles[0], profiles[1],
+      msg="Resolution profile incorrect: the profile depends on the number of threads.");
+    self.assertRaises(ValueError,
+      self.optimiser.resolution_profile, G, leidenalg.CPMVertexPartition,
+      resolution_range=(1, 0));
+    self.assertRaises(ValueError,
+      self.optimiser.resolution_profile, G, leidenalg.CPMVertexPartition,
+      resolution_range=(0, 1), min_diff_resolution=0);
+
+  def test_resolution_sweep(self):
+    G = ig.Graph.Famous('Zachary');
+    resolutions = [0.05*i for i in range(21)];
+    for aggregate in [False, True]:
+      sweep = self.optimiser.resolution_sweep(G, leidenalg.CPMVertexPartition,
+                                              resolutions=resolutions[::-1], aggregate=aggregate);
+      self.assertListEqual([partition.resolution_parameter for partition in sweep], resolutions);
+      self.assertListEqual(
+        sweep[0].sizes(), [G.vcount()],
+        msg="Resolution sweep incorrect: at resolution 0, not equal to a single community for CPM.");
+      self.assertListEqual(
+        sweep[-1].sizes(), [1]*G.vcount(),
+        msg="Resolution sweep incorrect: at resolution 1, not equal to a singleton partition for CPM.");
+
+  def test_resolution_sweep_callback_error(self):
+    G = ig.Graph.Famous('Zachary');
+    def callback(level, nb_visits):
+      raise RuntimeError('stop');
+    self.optimiser.set_progress_callback(callback);
+    self.assertRaises(RuntimeError, self.optimiser.resolution_sweep, G, leidenalg.CPMVertexPartition,
+                      resolutions=[0.1, 0.5]);
+
+  def test_ensemble(self):
+    G = ig.Graph.Famous('Zachary');
+    results = [];
+    for n_threads in [1, 3]:
+      self.optimiser.set_rng_seed(42);
+      partition = leidenalg.ModularityVertexPartition(G);
+      quality, agreement = self.optimiser.ensemble(partition, n_runs=6,
+                                                   n_threads=n_threads, edge_agreement=True);
+      self.assertAlmostEqual(quality, partition.quality(), places=10);
+      self.assertEqual(len(agreement), G.ecount());
+      self.assertTrue(all(0 <= a <= 1 for a in agreement));
+      results.append((partition.membership, agreement));
+    self.assertEqual(
+      results[0], results[1],
+      msg="Ensemble depends on the number of threads.");
+    partition = leidenalg.ModularityVertexPartition(G);
+    agreement = self.optimiser.ensemble(partition, n_runs=1, edge_agreement=True)[1];
+    self.assertListEqual(
+      agreement,
+      [float(partition.membership[e.source] == partition.membership[e.target]) for e in G.es],
+      msg="Agreement of a single run does not follow its membership.");
+    self.assertRaises(ValueError, self.optimiser.ensemble, partition, n_runs=0);
+
+  def test_compare_memberships(self):
+    G = ig.Graph.Famous('Zachary');
+    sweep = self.optimiser.resolution_sweep(G, leidenalg.CPMVertexPartition,
+                                            resolutions=[0.05, 0.1, 0.2, 0.5]);
+    for P, Q in zip(sweep, sweep[1:]):
+      for n_threads in [1, 2]:
+        comparison = leidenalg.compare_memberships(P, array.array('q', Q.membership), n_threads=n_threads);
+        for measure, method in [('nmi', 'nmi'), ('ari', 'adjusted_rand'), ('vi', 'vi')]:
+          self.assertAlmostEqual(
+            comparison[measure], ig.compare_communities(P, Q, method=method), places=10,
+            msg="Comparison ({0}) differs from igraph.".format(measure));
+    comparison = leidenalg.compare_memberships([3, 3, 7, 7], [0, 0, 1, 1]);
+    for measure, value in [('nmi', 1.0), ('ari', 1.0), ('vi', 0.0)]:
+      self.assertAlmostEqual(comparison[measure], value, places=10);
+    self.assertRaises(ValueError, leidenalg.compare_memberships, [0, 1], [0]);
+    self.assertRaises(ValueError, leidenalg.compare_memberships, [0, -1], [0, 0]);
+
+  def test_compare_memberships_chunks(self):
+    # The contingency table is counted in chunks of 16384 nodes, which the
+    # few large communities of P are split over.
+    n = 50000;
+    random.seed(42);
+    P = [random.randint(0, 2) for v in range(n)];
+    Q = [p if random.random() < 0.5 else random.randint(0, 999) for p in P];
+    comparisons = [leidenalg.compare_memberships(P, Q, n_threads=n_threads) for n_threads in [1, 2, 4]];
+    for comparison in comparisons:
+      self.assertDictEqual(comparison, comparisons[0]);
+    for measure, method in [('nmi', 'nmi'), ('ari', 'adjusted_rand'), ('vi', 'vi')]:
+      self.assertAlmostEqual(
+        comparisons[0][measure], ig.compare_communities(P, Q, method=method), places=10,
+        msg="Comparison ({0}) differs from igraph.".format(measure));
+
+  def test_membership_io(self):
+    G = ig.Graph.Famous('Zachary');
+    partition = leidenalg.find_partition(G, leidenalg.ModularityVertexPartition, seed=42);
+    levels = [partition.membership, [0]*len(partition)];
+    directory = tempfile.mkdtemp();
+    filename = os.path.join(directory, 'membership.bin');
+    text_filename = os.path.join(directory, 'membership.cnl');
+    leidenalg.write_membership(filename, partition, levels=levels);
+    self.assertEqual(os.path.getsize(filename) % 64, 0);
+    self.assertEqual(leidenalg.read_membership(filename), (partition.membership, levels));
+    leidenalg.membership_to_text(filename, text_filename);
+    with open(text_filename) as f:
+      lines = f.read().splitlines();
+    self.assertEqual(lines[0], '# Clusters: {0}, Nodes: {1}, Fuzzy: 0'.format(len(partition), G.vcount()));
+    self.assertListEqual([[int(v) for v in line.split()] for line in lines[1:]], list(partition));
+    leidenalg.membership_to_text(filename, text_filename, level=1);
+    with open(text_filename) as f:
+      self.assertEqual(f.read().splitlines()[1:], [' '.join(str(v) for v in range(G.vcount()))]);
+    self.assertRaises(ValueError, leidenalg.membership_to_text, filename, text_filename, level=2);
+    self.assertRaises(ValueError, leidenalg.read_membership, text_filename);
+    # A truncated file, or a header with too many nodes, is an error rather
+    # than a huge allocation
+    with open(filename, 'rb') as f:
+      data = f.read();
+    with open(filename, 'wb') as f:
+      f.write(data[:-64]);
+    self.assertRaises(ValueError, leidenalg.read_membership, filename);
+    with open(filename, 'wb') as f:
+      f.write(data[:24] + struct.pack('=Q', 2**60) + data[32:]);
+    self.assertRaises(ValueError, leidenalg.read_membership, filename);
+    for f in [filename, text_filename]:
+      os.remove(f);
+    os.rmdir(directory);
+
+  def test_slices_to_layers(self):
+    G_1 = ig.Graph.Ring(10);
+    G_1.vs['id'] = range(10);
+    G_2 = ig.Graph.Ring(5);
+    G_2.vs['id'] = range(5, 10)[::-1];
+    G_layers, G_interslice, G = leidenalg.time_slices_to_layers([G_1, G_2], interslice_weight=0.5);
+    self.assertEqual(len(G_layers), 2);
+    for H in G_layers + [G_interslice, G]:
+      self.assertEqual(H.vcount(), 15);
+    self.assertListEqual(G_layers[1].vs['node_size'], [0]*10 + [1]*5);
+    self.assertListEqual(G_interslice.vs['node_size'], [0]*15);
+    self.assertListEqual(G_interslice.es['weight'], [0.5]*5);
+    for e in G_interslice.es:
+      self.assertEqual(G.vs[e.source]['id'], G.vs[e.target]['id']);
+      self.assertNotEqual(G.vs[e.source]['slice'], G.vs[e.target]['slice']);
+    self.assertEqual(G.ecount(), 10 + 5 + 5);
+    membership, improvement = leidenalg.find_partition_temporal([G_1, G_2], leidenalg.CPMVertexPartition,
+                                                                interslice_weight=1, resolution_parameter=0);
+    self.assertListEqual(membership, [[0]*10, [0]*5]);
+    G_2.vs['id'] = [5]*5;
+    self.assertRaises(ValueError, leidenalg.time_slices_to_layers, [G_1, G_2]);
+
+  def test_find_partition_temporal(self):
+    G_1 = ig.Graph.Full(5) + ig.Graph.Full(5);
+    G_1.vs['id'] = range(10);
+    G_2 = G_1.copy();
+    G_2.vs['id'] = range(10)[::-1];
+    membership, improvement = leidenalg.find_partition_temporal([G_1, G_2], leidenalg.ModularityVertexPartition,
+                                                                interslice_weight=0.1, seed=42);
+    self.assertEqual(len(membership), 2);
+    for membership_slice in membership:
+      self.assertEqual(len(membership_slice), 10);
+      self.assertEqual(len(set(membership_slice[:5])), 1);
+      self.assertEqual(len(set(membership_slice[5:])), 1);
+      self.assertNotEqual(membership_slice[0], membership_slice[5]);
+    # Nodes with the same id are in the same community in both slices
+    for v in range(10):
+      self.assertEqual(membership[0][v], membership[1][9 - v]);
+    membership_sparse, improvement_sparse = leidenalg.find_partition_temporal([G_1, G_2], leidenalg.ModularityVertexPartition,
+                                                                              interslice_weight=0.1, seed=42, sparse=True);
+    self.assertListEqual(membership_sparse, membership);
+    self.assertAlmostEqual(improvement_sparse, improvement);
+    # The weights and node sizes of the layers may still be passed
+    membership_weights, improvement_weights = leidenalg.find_partition_temporal([G_1, G_2], leidenalg.CPMVertexPartition,
+                                                                                interslice_weight=0.1, seed=42,
+                                                                                weights='weight', node_sizes='node_size');
+    membership_unweighted, improvement_unweighted = leidenalg.find_partition_temporal([G_1, G_2], leidenalg.CPMVertexPartition,
+                                                                                      interslice_weight=0.1, seed=42,
+                                                                                      weights=None);
+    self.assertListEqual(membership_weights, membership_unweighted);
+    # The layers of Significance remain unweighted
+    H_1 = G_1.copy();
+    H_1.es['weight'] = 2;
+    H_2 = G_2.copy();
+    H_2.es['weight'] = 2;
+    membership, improvement = leidenalg.find_partition_temporal([G_1, G_2], leidenalg.SignificanceVertexPartition,
+                                                                interslice_weight=0.1, seed=42);
+    membership_weighted, improvement_weighted = leidenalg.find_partition_temporal([H_1, H_2], leidenalg.SignificanceVertexPartition,
+                                                                                  interslice_weight=0.1, seed=42);
+    self.assertListEqual(membership_weighted, membership);
+    self.assertAlmostEqual(improvement_weighted, improvement);
+
 #%%
 if __name__ == '__main__':
   #%%
@@ -151,6 +151,91 @@ class BaseTest:
           s, partition.total_weight_in_all_comms())
         );
 
+    @data(*graphs)
+    def test_quality_terms(self, graph):
+      if not issubclass(self.partition_type, leidenalg.VertexPartition.LinearResolutionParameterVertexPartition):
+        raise unittest.SkipTest('Only linear resolution parameter partitions have quality terms');
+      weights = 'weight' if 'weight' in graph.es.attributes() else None;
+      partition = self.partition_type(graph, weights=weights, resolution_parameter=0.5);
+      self.optimiser.optimise_partition(partition);
+      # The terms are updated when moving nodes, so compare them to a partition
+      # for which they are calculated from scratch.
+      fresh_partition = self.partition_type(graph, initial_membership=partition.membership,
+                                            weights=weights, resolution_parameter=0.5);
+      E, F = partition.quality_terms();
+      fresh_E, fresh_F = fresh_partition.quality_terms();
+      self.assertAlmostEqual(E, fresh_E, places=5);
+      self.assertAlmostEqual(F, fresh_F, places=5);
+      for resolution_parameter in [0, 0.5, 2]:
+        self.assertAlmostEqual(
+          partition.quality(resolution_parameter),
+          E - resolution_parameter*F,
+          places=5,
+          msg='Quality not equal to E - resolution_parameter*F.');
+
+    def assertSameWeights(self, partition, weights, weighted):
+      # The weights are updated for the changed edges only, so compare them to
+      # a partition for which they are calculated from scratch.
+      self.assertEqual(partition.graph.ecount(), len(weights));
+      if weighted:
+        fresh_partition = self.partition_type(partition.graph, initial_membership=partition.membership,
+                                              weights=weights);
+      else:
+        fresh_partition = self.partition_type(partition.graph, initial_membership=partition.membership);
+      for c in range(len(partition)):
+        self.assertAlmostEqual(partition.total_weight_in_comm(c), fresh_partition.total_weight_in_comm(c), places=5);
+        self.assertAlmostEqual(partition.total_weight_from_comm(c), fresh_partition.total_weight_from_comm(c), places=5);
+        self.assertAlmostEqual(partition.total_weight_to_comm(c), fresh_partition.total_weight_to_comm(c), places=5);
+      self.assertAlmostEqual(partition.total_weight_in_all_comms(), fresh_partition.total_weight_in_all_comms(), places=5);
+      self.assertAlmostEqual(partition.quality(), fresh_partition.quality(), places=5);
+
+    @data(*graphs)
+    def test_change_edges(self, graph):
+      # Significance is only defined for unweighted graphs
+      weighted = self.partition_type != leidenalg.SignificanceVertexPartition;
+      if weighted and 'weight' in graph.es.attributes():
+        weights = list(graph.es['weight']);
+      else:
+        weights = [1.0]*graph.ecount();
+      m = graph.ecount();
+      if weighted:
+        partition = self.partition_type(graph, weights=weights);
+      else:
+        partition = self.partition_type(graph);
+      self.optimiser.move_nodes(partition);
+      n = graph.vcount();
+
+      # Add edges
+      added_edges = [(random.randrange(n), random.randrange(n)) for i in range(5)];
+      added_weights = [random.random() + 0.5 if weighted else 1.0 for edge in added_edges];
+      changed_nodes = partition.change_edges(
+        added_edges=[(u, v, w) for (u, v), w in zip(added_edges, added_weights)]);
+      weights += added_weights;
+      self.assertEqual(changed_nodes, sorted(set(u for edge in added_edges for u in edge)));
+      self.assertSameWeights(partition, weights, weighted);
+
+      # Remove edges
+      removed_edges = random.sample(range(len(weights)), 5);
+      endpoints = [partition.graph.es[e].tuple for e in removed_edges];
+      changed_nodes = partition.change_edges(removed_edges=removed_edges);
+      weights = [w for e, w in enumerate(weights) if e not in removed_edges];
+      self.assertEqual(changed_nodes, sorted(set(u for edge in endpoints for u in edge)));
+      self.assertSameWeights(partition, weights, weighted);
+
+      # Update the weights of edges
+      if weighted:
+        updated_edges = [(e, random.random() + 0.5) for e in random.sample(range(len(weights)), 5)];
+        partition.change_edges(updated_edges=updated_edges);
+        for e, w in updated_edges:
+          weights[e] = w;
+        self.assertSameWeights(partition, weights, weighted);
+
+      # The graph of the partition holds the changed weights
+      self.assertEqual(partition.graph.es['weight'], weights);
+
+      # The original graph is not changed
+      self.assertEqual(graph.ecount(), m);
+
 class ModularityVertexPartitionTest(BaseTest.MutableVertexPartitionTest):
   def setUp(self):
     super(ModularityVertexPartitionTest, self).setUp();
@@ -184,11 +269,53 @@ class SurpriseVertexPartitionTest(BaseTest.MutableVertexPartitionTest):
     super(SurpriseVertexPartitionTest, self).setUp();
     self.partition_type = leidenalg.SurpriseVertexPartition;
 
+  def test_fast_kl(self):
+    G = ig.Graph.Erdos_Renyi(100, p=5./100, directed=False, loops=False);
+    membership = [random.randint(0, 9) for v in range(G.vcount())];
+    partition = leidenalg.SurpriseVertexPartition(G, initial_membership=membership);
+    fast_partition = leidenalg.SurpriseVertexPartition(G, initial_membership=membership, fast_kl=True);
+    # The difference consists of two divergences, multiplied by the number of edges
+    for v in range(G.vcount()):
+      for c in range(10):
+        self.assertAlmostEqual(
+          fast_partition.diff_move(v, c), partition.diff_move(v, c),
+          delta=4e-10*G.ecount(),
+          msg='Approximate diff_move differs too much from exact diff_move.');
+    candidates = list(range(10));
+    for v in range(G.vcount()):
+      for fast_diff, diff in zip(fast_partition.diff_move_all(v, candidates), partition.diff_move_all(v, candidates)):
+        self.assertAlmostEqual(
+          fast_diff, diff,
+          delta=4e-10*G.ecount(),
+          msg='Approximate diff_move_all differs too much from exact diff_move_all.');
+
 class SignificanceVertexPartitionTest(BaseTest.MutableVertexPartitionTest):
   def setUp(self):
     super(SignificanceVertexPartitionTest, self).setUp();
     self.partition_type = leidenalg.SignificanceVertexPartition;
 
+  def test_fast_kl(self):
+    G = ig.Graph.Erdos_Renyi(100, p=5./100, directed=False, loops=False);
+    membership = [random.randint(0, 9) for v in range(G.vcount())];
+    partition = leidenalg.SignificanceVertexPartition(G, initial_membership=membership);
+    fast_partition = leidenalg.SignificanceVertexPartition(G, initial_membership=membership, fast_kl=True);
+    # The difference consists of four divergences, each multiplied by at most
+    # the number of possible edges
+    n = G.vcount();
+    for v in range(n):
+      for c in range(10):
+        self.assertAlmostEqual(
+          fast_partition.diff_move(v, c), partition.diff_move(v, c),
+          delta=4*2e-10*n*(n-1)/2,
+          msg='Approximate diff_move differs too much from exact diff_move.');
+    candidates = list(range(10));
+    for v in range(n):
+      for fast_diff, diff in zip(fast_partition.diff_move_all(v, candidates), partition.diff_move_all(v, candidates)):
+        self.assertAlmostEqual(
+          fast_diff, diff,
+          delta=4*2e-10*n*(n-1)/2,
+          msg='Approximate diff_move_all differs too much from exact diff_move_all.');
+
 #%%
 if __name__ == '__main__':
   #%%